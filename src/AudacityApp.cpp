@@ -38,6 +38,7 @@ It handles initialization and termination by subclassing wxApp.
 #include <wx/splash.h>
 #include <wx/stdpaths.h>
 #include <wx/sysopt.h>
+#include <wx/thread.h>
 #include <wx/fontmap.h>
 
 #include <wx/fs_zip.h>
@@ -65,6 +66,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "AColor.h"
 #include "AudioIO.h"
 #include "Benchmark.h"
+#include "BatchRunner.h"
 #include "DirManager.h"
 #include "commands/CommandHandler.h"
 #include "commands/AppCommandEvent.h"
@@ -80,6 +82,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "Screenshot.h"
 #include "Sequence.h"
 #include "WaveTrack.h"
+#include "WorkerPool.h"
 #include "Internat.h"
 #include "prefs/PrefsDialog.h"
 #include "Theme.h"
@@ -89,6 +92,8 @@ It handles initialization and termination by subclassing wxApp.
 #include "SplashDialog.h"
 #include "FFT.h"
 #include "BlockFile.h"
+#include "WaveformCache.h"
+#include "BlockPrefetcher.h"
 #include "ondemand/ODManager.h"
 #include "commands/Keyboard.h"
 #include "widgets/ErrorDialog.h"
@@ -303,6 +308,9 @@ void QuitAudacity(bool bForce)
    //release ODManager Threads
    ODManager::Quit();
 
+   //and the threads that share out mixing and processing
+   WorkerPool::Quit();
+
    //print out profile if we have one by deleting it
    //temporarilly commented out till it is added to all projects
    //delete Profiler::Instance();
@@ -1118,6 +1126,9 @@ bool AudacityApp::OnInit()
    mChecker = NULL;
    mIPCServ = NULL;
 
+   mBatchMode = false;
+   mBatchStatus = 0;
+
 #if defined(__WXGTK__)
    // Workaround for bug 154 -- initialize to false
    inKbdHandler = false;
@@ -1244,8 +1255,15 @@ bool AudacityApp::OnInit()
    }
 #endif
 
+   // Chains applied from the command line show no windows and may run
+   // beside each other and an interactive Audacity, so they write none
+   // of the shared configuration files
+   wxCmdLineParser *batchParser = ParseCommandLine(false);
+   mBatchMode = batchParser && batchParser->Found(wxT("c"));
+   delete batchParser;
+
    // Initialize preferences and language
-   InitPreferences();
+   InitPreferences(mBatchMode);
 
    #if defined(__WXMSW__) && !defined(__WXUNIVERSAL__) && !defined(__CYGWIN__)
       this->AssociateFileTypes();
@@ -1285,6 +1303,7 @@ bool AudacityApp::OnInit()
    InitCommandHandler();
 
    // Initialize the PluginManager
+   PluginManager::Get().SetReadOnly(mBatchMode);
    PluginManager::Get().Initialize();
 
    // Initialize the ModuleManager, including loading found modules
@@ -1397,25 +1416,59 @@ Click the 'Help' button for known issues."),
       exit(1);
    }
 
+   wxString chain;
+   wxArrayString batchFiles;
+   long jobs = wxThread::GetCPUCount();
+   if (parser->Found(wxT("c"), &chain))
+   {
+      for (size_t i = 0, cnt = parser->GetParamCount(); i < cnt; i++)
+         batchFiles.Add(parser->GetParam(i));
+
+      wxString listFile;
+      if (parser->Found(wxT("l"), &listFile) &&
+          !BatchRunner::ReadFileList(listFile, batchFiles))
+      {
+         delete parser;
+
+         wxFprintf(stderr, _("Could not read the file list %s\n"), listFile.c_str());
+         exit(1);
+      }
+
+      parser->Found(wxT("j"), &jobs);
+      if (jobs > 1 && batchFiles.GetCount() > 1)
+      {
+         // Leave the work to copies of ourselves
+         int failed = BatchRunner::ApplyChainInWorkers(chain, batchFiles, (int)jobs);
+         delete parser;
+
+         wxRmdir(DirManager::GetTempDir());
+         exit(failed > 0 ? 1 : 0);
+      }
+   }
+
 // No Splash screen on wx3 whislt we sort out the problem
 // with showing a dialog AND a splash screen during inits.
 #if !wxCHECK_VERSION(3, 0, 0)
-   // BG: Create a temporary window to set as the top window
-   wxImage logoimage((const char **) AudacityLogoWithName_xpm);
-   logoimage.Rescale(logoimage.GetWidth() / 2, logoimage.GetHeight() / 2);
-   wxBitmap logo(logoimage);
-
-   wxSplashScreen *temporarywindow =
-      new wxSplashScreen(logo,
-                         wxSPLASH_CENTRE_ON_SCREEN | wxSPLASH_NO_TIMEOUT,
-                         0,
-                         NULL,
-                         wxID_ANY,
-                         wxDefaultPosition,
-                         wxDefaultSize,
-                         wxSTAY_ON_TOP);
-   temporarywindow->SetTitle(_("Audacity is starting up..."));
-   SetTopWindow(temporarywindow);
+   wxSplashScreen *temporarywindow = NULL;
+   if (!mBatchMode)
+   {
+      // BG: Create a temporary window to set as the top window
+      wxImage logoimage((const char **) AudacityLogoWithName_xpm);
+      logoimage.Rescale(logoimage.GetWidth() / 2, logoimage.GetHeight() / 2);
+      wxBitmap logo(logoimage);
+
+      temporarywindow =
+         new wxSplashScreen(logo,
+                            wxSPLASH_CENTRE_ON_SCREEN | wxSPLASH_NO_TIMEOUT,
+                            0,
+                            NULL,
+                            wxID_ANY,
+                            wxDefaultPosition,
+                            wxDefaultSize,
+                            wxSTAY_ON_TOP);
+      temporarywindow->SetTitle(_("Audacity is starting up..."));
+      SetTopWindow(temporarywindow);
+   }
 #endif
 
    //JKC: Would like to put module loading here.
@@ -1425,6 +1478,16 @@ Click the 'Help' button for known issues."),
    InitDitherers();
    InitAudioIO();
 
+   // How much coarser each level of the waveform summaries is
+   BlockFile::SetSummaryLevelFactor(
+      gPrefs->Read(wxT("/GUI/SummaryLevelFactor"), 16L));
+   // and how much memory those summaries may keep
+   WaveformCache::Get().SetBudget(
+      gPrefs->Read(wxT("/Directories/WaveformCacheMB"), 64L) * 1048576);
+   // and how much each project may read ahead of playback and export
+   BlockPrefetcher::SetBudget(
+      gPrefs->Read(wxT("/Directories/ReadAheadMB"), 32L) * 1048576);
+
 #ifdef __WXMAC__
 
    // On the Mac, users don't expect a program to quit when you close the last window.
@@ -1468,19 +1531,27 @@ Click the 'Help' button for known issues."),
 
 
 #if !wxCHECK_VERSION(3, 0, 0)
-   temporarywindow->Show(false);
-   delete temporarywindow;
+   if (temporarywindow)
+   {
+      temporarywindow->Show(false);
+      delete temporarywindow;
+   }
 #endif
 
-   if( project->mShowSplashScreen )
-      project->OnHelpWelcome();
-
-   // JKC 10-Sep-2007: Enable monitoring from the start.
-   // (recommended by lprod.org).
-   // Monitoring stops again after any
-   // PLAY or RECORD completes.
-   // So we also call StartMonitoring when STOP is called.
-   project->MayStartMonitoring();
+   if (mBatchMode)
+      project->Show(false);
+   else
+   {
+      if( project->mShowSplashScreen )
+         project->OnHelpWelcome();
+
+      // JKC 10-Sep-2007: Enable monitoring from the start.
+      // (recommended by lprod.org).
+      // Monitoring stops again after any
+      // PLAY or RECORD completes.
+      // So we also call StartMonitoring when STOP is called.
+      project->MayStartMonitoring();
+   }
 
    #ifdef USE_FFMPEG
    FFmpegStartup();
@@ -1488,6 +1559,20 @@ Click the 'Help' button for known issues."),
 
    Importer::Get().Initialize();
 
+   //
+   // Chains applied from the command line, in this process
+   //
+   if (mBatchMode)
+   {
+      int failed = BatchRunner::ApplyChainToFiles(project, chain, batchFiles);
+      mBatchStatus = (failed > 0) ? 1 : 0;
+      delete parser;
+
+      // Leave the usual way, so that everything is cleaned up
+      QuitAudacity();
+      return;
+   }
+
    //
    // Auto-recovery
    //
@@ -1619,6 +1704,19 @@ bool AudacityApp::InitTempDir()
    chmod(OSFILENAME(temp), 0755);
    #endif
 
+   if (mBatchMode) {
+      // Each gets a directory of its own, which it removes when done, so
+      // as not to clean up after others, and takes no lock
+      temp += wxString::Format(wxT("%cbatch-%lu"),
+                               wxFILE_SEP_PATH, wxGetProcessId());
+      if (!wxDirExists(temp) && !wxMkdir(temp, 0755)) {
+         wxFprintf(stderr, _("Could not create the directory %s\n"), temp.c_str());
+         return false;
+      }
+      DirManager::SetTempDir(temp);
+      return true;
+   }
+
    bool bSuccess = gPrefs->Write(wxT("/Directories/TempDir"), temp) && gPrefs->Flush();
    DirManager::SetTempDir(temp);
 
@@ -1827,7 +1925,7 @@ void AudacityApp::OnSocketEvent(wxSocketEvent & evt)
 
 #endif
 
-wxCmdLineParser *AudacityApp::ParseCommandLine()
+wxCmdLineParser *AudacityApp::ParseCommandLine(bool giveUsage)
 {
    wxCmdLineParser *parser = new wxCmdLineParser(argc, argv);
    if (!parser)
@@ -1840,6 +1938,10 @@ wxCmdLineParser *AudacityApp::ParseCommandLine()
    parser->AddOption(wxT("b"), wxT("blocksize"), _("set max disk block size in bytes"),
                      wxCMD_LINE_VAL_NUMBER);
 
+   /*i18n-hint: This applies a chain to the files named, with no windows */
+   parser->AddOption(wxT("c"), wxT("chain"), _("apply a chain to the files and exit"),
+                     wxCMD_LINE_VAL_STRING);
+
    /*i18n-hint: This decodes an autosave file */
    parser->AddOption(wxT("d"), wxT("decode"), _("decode an autosave file"),
                      wxCMD_LINE_VAL_STRING);
@@ -1848,6 +1950,14 @@ wxCmdLineParser *AudacityApp::ParseCommandLine()
    parser->AddSwitch(wxT("h"), wxT("help"), _("this help message"),
                      wxCMD_LINE_OPTION_HELP);
 
+   /*i18n-hint: This sets how many copies of Audacity apply a chain at once */
+   parser->AddOption(wxT("j"), wxT("jobs"), _("with --chain, the number of files to process at once"),
+                     wxCMD_LINE_VAL_NUMBER);
+
+   /*i18n-hint: This names a file listing files to apply a chain to */
+   parser->AddOption(wxT("l"), wxT("list"), _("with --chain, a file naming more files, one per line"),
+                     wxCMD_LINE_VAL_STRING);
+
    /*i18n-hint: This runs a set of automatic tests on Audacity itself */
    parser->AddSwitch(wxT("t"), wxT("test"), _("run self diagnostics"));
 
@@ -1861,7 +1971,7 @@ wxCmdLineParser *AudacityApp::ParseCommandLine()
                     wxCMD_LINE_PARAM_MULTIPLE | wxCMD_LINE_PARAM_OPTIONAL);
 
    // Run the parser
-   if (parser->Parse() == 0)
+   if (parser->Parse(giveUsage) == 0)
    {
       return parser;
    }
@@ -2024,7 +2134,9 @@ int AudacityApp::OnExit()
 
    DeInitCommandHandler();
 
-   mRecentFiles->Save(*gPrefs, wxT("RecentFiles"));
+   // Others may be running, so leave the recent files as they are
+   if (!mBatchMode)
+      mRecentFiles->Save(*gPrefs, wxT("RecentFiles"));
    delete mRecentFiles;
 
    FinishPreferences();
@@ -2034,7 +2146,6 @@ int AudacityApp::OnExit()
 #endif
 
    DeinitFFT();
-   BlockFile::Deinit();
 
    DeinitAudioIO();
 
@@ -2063,9 +2174,20 @@ int AudacityApp::OnExit()
    if (mChecker)
       delete mChecker;
 
+   if (mBatchMode)
+      wxRmdir(DirManager::GetTempDir());
+
    return 0;
 }
 
+int AudacityApp::OnRun()
+{
+   int status = wxApp::OnRun();
+
+   // Chains applied from the command line report failures
+   return status ? status : mBatchStatus;
+}
+
 // The following five methods are currently only used on Mac OS,
 // where it's possible to have a menu bar but no windows open.
 // It doesn't hurt any other platforms, though.
@@ -110,6 +110,7 @@ class AudacityApp:public wxApp {
    virtual void OnEventLoopEnter(wxEventLoopBase * pLoop);
 #endif
    virtual int OnExit(void);
+   virtual int OnRun();
    virtual void OnFatalException();
 
 #if defined(__WXGTK__)
@@ -238,10 +239,15 @@ class AudacityApp:public wxApp {
    bool InitTempDir();
    bool CreateSingleInstanceChecker(wxString dir);
 
-   wxCmdLineParser *ParseCommandLine();
+   wxCmdLineParser *ParseCommandLine(bool giveUsage = true);
 
    bool mWindowRectAlreadySaved;
 
+   // Set when applying a chain from the command line with no user
+   // interface, and then the exit status
+   bool mBatchMode;
+   int mBatchStatus;
+
 #if defined(__WXMSW__)
    IPCServ *mIPCServ;
 #else
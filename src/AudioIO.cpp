@@ -28,6 +28,15 @@
   To highlight this deliniation, the file is divided into three parts
   based on what thread context each function is intended to run in.
 
+  \par Recording
+  The Audio Thread doesn't write what is recorded to disk itself.  It
+  copies it out of the capture RingBuffer into chunks allocated when
+  the stream starts, and queues them for a fourth thread, the
+  CaptureThread, which appends them to the tracks.  So neither a slow
+  disk nor the allocation of block files holds up the Audio Thread,
+  and when the CaptureThread falls behind, the audio waits in the
+  RingBuffer.
+
   \par EXPERIMENTAL_MIDI_PLAYBACK
   If EXPERIMENTAL_MIDI_PLAYBACK is defined, this class also manages
   MIDI playback. The reason for putting MIDI here rather than in, say,
@@ -299,6 +308,7 @@ writing audio.
 #include "MixerBoard.h"
 #include "Resample.h"
 #include "RingBuffer.h"
+#include "WorkerPool.h"
 #include "Prefs.h"
 #include "Project.h"
 #include "TimeTrack.h"
@@ -779,6 +789,13 @@ class AudioThread : public wxThread {
 
 #endif
 
+// Appends the chunks of recorded audio that the audio thread queues
+// to the tracks
+class CaptureThread : public AudioThread {
+ public:
+   virtual ExitCode Entry();
+};
+
 #ifdef EXPERIMENTAL_MIDI_OUT
 class MidiThread : public AudioThread {
  public:
@@ -797,6 +814,7 @@ void InitAudioIO()
 {
    gAudioIO = new AudioIO();
    gAudioIO->mThread->Run();
+   gAudioIO->mCaptureThread->Run();
 #ifdef EXPERIMENTAL_MIDI_OUT
    gAudioIO->mMidiThread->Run();
 #endif
@@ -939,6 +957,22 @@ AudioIO::AudioIO()
    mThread = new AudioThread();
    mThread->Create();
 
+   mCaptureChunks = NULL;
+   mNumCaptureChunks = 0;
+   mCaptureChunkFrames = 0;
+   mCaptureFormats = NULL;
+   mCaptureResampleBuf = NULL;
+   mCaptureResampleBufLen = 0;
+   mCaptureChunkFirst = 0;
+   mCaptureChunksQueued = 0;
+   mCaptureQueuePeak = 0;
+   mCaptureQueueFullPasses = 0;
+   mCaptureQueueEmpty = new ODCondition(&mCaptureQueueLock);
+   mPlaybackInputEnded = false;
+   mCaptureThread = new CaptureThread();
+   mPlaybackPool = NULL;
+   mCaptureThread->Create();
+
 #if defined(USE_PORTMIXER)
    mPortMixer = NULL;
    mPreviousHWPlaythrough = -1.0;
@@ -983,11 +1017,15 @@ AudioIO::~AudioIO()
       (Kill is the not-graceful way.) */
    wxTheApp->Yield();
    mThread->Delete();
+   mCaptureThread->Delete();
 
    if(mSilentBuf)
       DeleteSamples(mSilentBuf);
 
    delete mThread;
+   delete mCaptureThread;
+   delete mCaptureQueueEmpty;
+   delete mPlaybackPool;
 
 #ifdef EXPERIMENTAL_SCRUBBING_SUPPORT
    delete mScrubQueue;
@@ -1522,6 +1560,9 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
 
    gPrefs->Read(wxT("/AudioIO/SWPlaythrough"), &mSoftwarePlaythrough, false);
    gPrefs->Read(wxT("/AudioIO/SoundActivatedRecord"), &mPauseRec, false);
+   gPrefs->Read(wxT("/AudioIO/ParallelMixing"), &mParallelMixing, true);
+   if (mParallelMixing && !mPlaybackPool)
+      mPlaybackPool = new WorkerPool(wxThread::GetCPUCount() - 1);
    int silenceLevelDB;
    gPrefs->Read(wxT("/AudioIO/SilenceLevel"), &silenceLevelDB, -50);
    int dBRange;
@@ -1552,7 +1593,7 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
    mCutPreviewGapLen = options.cutPreviewGapLen;
    mPlaybackBuffers = NULL;
    mPlaybackMixers = NULL;
-   mCaptureBuffers = NULL;
+   mCaptureBuffer = NULL;
    mResample = NULL;
 
 #ifdef EXPERIMENTAL_SCRUBBING_SUPPORT
@@ -1586,6 +1627,7 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
    // with ComputeWarpedLength, it is now possible the calculate the warped length with 100% accuracy
    // (ignoring accumulated rounding errors during playback) which fixes the 'missing sound at the end' bug
    mWarpedTime = 0.0;
+   mPlaybackInputEnded = false;
 #ifdef EXPERIMENTAL_SCRUBBING_SUPPORT
    if (scrubbing)
       mWarpedLength = 0.0;
@@ -1740,8 +1782,9 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
 
          if( mNumCaptureChannels > 0 )
          {
-            // Allocate input buffers.  For every input track we allocate
-            // a ring buffer of five seconds
+            // Allocate the input buffer.  All input tracks share one ring
+            // buffer of interleaved frames, so that the callback can convert
+            // and store everything PortAudio gives it in a single step
             sampleCount captureBufferSize =
                (sampleCount)(mRate * mCaptureRingBufferSecs + 0.5);
 
@@ -1753,20 +1796,23 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
                return 0;
             }
 
-            mCaptureBuffers = new RingBuffer* [mCaptureTracks.GetCount()];
             mResample = new Resample* [mCaptureTracks.GetCount()];
             mFactor = sampleRate / mRate;
 
             // Set everything to zero in case we have to delete these due to a memory exception.
-            memset(mCaptureBuffers, 0, sizeof(RingBuffer*)*mCaptureTracks.GetCount());
             memset(mResample, 0, sizeof(Resample*)*mCaptureTracks.GetCount());
 
+            // One ring holds all channels, in the format the device
+            // delivers them; each is converted to its own track's format
+            // when taken out, in CopyCaptureChannel().
+            mCaptureBuffer = new RingBuffer( mCaptureFormat,
+                                             captureBufferSize,
+                                             mCaptureTracks.GetCount() );
+
             for( unsigned int i = 0; i < mCaptureTracks.GetCount(); i++ )
-            {
-               mCaptureBuffers[i] = new RingBuffer( mCaptureTracks[i]->GetSampleFormat(),
-                                                    captureBufferSize );
                mResample[i] = new Resample(true, mFactor, mFactor); // constant rate resampling
-            }
+
+            AllocateCaptureChunks(mCaptureRingBufferSecs);
          }
       }
       catch(std::bad_alloc&)
@@ -1910,6 +1956,100 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
    return mStreamToken;
 }
 
+void AudioIO::AllocateCaptureChunks(double secs)
+{
+   unsigned int numChannels = mCaptureTracks.GetCount();
+
+   // Half a second each, and enough of them to hold as much as the
+   // capture buffer does
+   mCaptureChunkFrames = std::max(1, (int)(mRate * 0.5 + 0.5));
+   mNumCaptureChunks = std::max(2, (int)ceil(secs / 0.5));
+   mCaptureChunkFirst = 0;
+   mCaptureChunksQueued = 0;
+   mCaptureQueuePeak = 0;
+   mCaptureQueueFullPasses = 0;
+
+   // What is resampled is converted to float for the resampler
+   mCaptureFormats = new sampleFormat[numChannels];
+   for( unsigned int i = 0; i < numChannels; i++ )
+      mCaptureFormats[i] = (mFactor == 1.0) ?
+         mCaptureTracks[i]->GetSampleFormat() : floatSample;
+
+   mCaptureChunks = new CaptureChunk[mNumCaptureChunks];
+   // Set everything to NULL in case we have to delete these due to a memory exception.
+   for( int c = 0; c < mNumCaptureChunks; c++ )
+   {
+      mCaptureChunks[c].channels = NULL;
+      mCaptureChunks[c].frames = 0;
+      mCaptureChunks[c].last = false;
+   }
+
+   for( int c = 0; c < mNumCaptureChunks; c++ )
+   {
+      mCaptureChunks[c].channels = new samplePtr[numChannels];
+      memset(mCaptureChunks[c].channels, 0, sizeof(samplePtr) * numChannels);
+      for( unsigned int i = 0; i < numChannels; i++ )
+      {
+         mCaptureChunks[c].channels[i] =
+            NewSamples(mCaptureChunkFrames, mCaptureFormats[i]);
+         if (!mCaptureChunks[c].channels[i])
+            throw std::bad_alloc();
+      }
+   }
+
+   if (mFactor != 1.0)
+   {
+      // With room for what the resampler holds back until the last chunk
+      mCaptureResampleBufLen = (int)(mCaptureChunkFrames * mFactor) + 1024;
+      mCaptureResampleBuf = new float[mCaptureResampleBufLen];
+   }
+}
+
+void AudioIO::DeleteCaptureChunks()
+{
+   // mCaptureThread may still be appending the last of them
+   mCaptureQueueLock.Lock();
+   while (mCaptureChunksQueued > 0)
+      mCaptureQueueEmpty->Wait();
+   mCaptureQueueLock.Unlock();
+
+   if (mCaptureChunks)
+   {
+      for( int c = 0; c < mNumCaptureChunks; c++ )
+      {
+         samplePtr *channels = mCaptureChunks[c].channels;
+         if (!channels)
+            continue;
+         for( unsigned int i = 0; i < mCaptureTracks.GetCount(); i++ )
+            if (channels[i])
+               DeleteSamples(channels[i]);
+         delete[] channels;
+      }
+      delete[] mCaptureChunks;
+      mCaptureChunks = NULL;
+   }
+
+   delete[] mCaptureFormats;
+   mCaptureFormats = NULL;
+   delete[] mCaptureResampleBuf;
+   mCaptureResampleBuf = NULL;
+}
+
+int AudioIO::GetCaptureChunksQueued()
+{
+   ODLocker locker(mCaptureQueueLock);
+   return mCaptureChunksQueued;
+}
+
+void AudioIO::GetCaptureQueueStats(int *numChunks, int *peakChunks,
+                                   int *fullPasses)
+{
+   ODLocker locker(mCaptureQueueLock);
+   *numChunks = mNumCaptureChunks;
+   *peakChunks = mCaptureQueuePeak;
+   *fullPasses = mCaptureQueueFullPasses;
+}
+
 void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
 {
    if (mNumPlaybackChannels > 0)
@@ -1933,14 +2073,14 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
       mPlaybackMixers = NULL;
    }
 
-   if(mCaptureBuffers)
+   if(mCaptureBuffer)
    {
-      for( unsigned int i = 0; i < mCaptureTracks.GetCount(); i++ )
-         delete mCaptureBuffers[i];
-      delete [] mCaptureBuffers;
-      mCaptureBuffers = NULL;
+      delete mCaptureBuffer;
+      mCaptureBuffer = NULL;
    }
 
+   DeleteCaptureChunks();
+
    if(mResample)
    {
       for( unsigned int i = 0; i < mCaptureTracks.GetCount(); i++ )
@@ -2298,9 +2438,17 @@ void AudioIO::StopStream()
          double recordingOffset =
             mLastRecordingOffset + latencyCorrection / 1000.0;
 
+         // Waits for mCaptureThread to append the last of the recording,
+         // which uses the resamplers
+         DeleteCaptureChunks();
+
+         int numChunks, peakChunks, fullPasses;
+         GetCaptureQueueStats(&numChunks, &peakChunks, &fullPasses);
+         wxLogMessage(wxT("Capture queue: %d chunks, at most %d in use, full %d times"),
+                      numChunks, peakChunks, fullPasses);
+
          for( unsigned int i = 0; i < mCaptureTracks.GetCount(); i++ )
             {
-               delete mCaptureBuffers[i];
                delete mResample[i];
 
                WaveTrack* track = mCaptureTracks[i];
@@ -2348,7 +2496,8 @@ void AudioIO::StopStream()
                }
             }
 
-         delete[] mCaptureBuffers;
+         delete mCaptureBuffer;
+         mCaptureBuffer = NULL;
          delete[] mResample;
       }
    }
@@ -2808,6 +2957,85 @@ AudioThread::ExitCode AudioThread::Entry()
    return 0;
 }
 
+CaptureThread::ExitCode CaptureThread::Entry()
+{
+   while( !TestDestroy() )
+   {
+      if( !gAudioIO->WriteCaptureChunks() )
+         Sleep(5);
+   }
+
+   return 0;
+}
+
+bool AudioIO::WriteCaptureChunks()
+{
+   int index;
+   {
+      ODLocker locker(mCaptureQueueLock);
+      if (mCaptureChunksQueued == 0)
+         return false;
+      index = mCaptureChunkFirst;
+   }
+
+   int numChannels = mCaptureTracks.GetCount();
+
+   for (;;)
+   {
+      // Append captured samples to the end of the WaveTracks.
+      // The WaveTracks have their own buffering for efficiency.
+      CaptureChunk &chunk = mCaptureChunks[index];
+      AutoSaveFile blockFileLog;
+
+      for( int i = 0; i < numChannels; i++ )
+      {
+         AutoSaveFile appendLog;
+
+         if( mFactor == 1.0 )
+         {
+            mCaptureTracks[i]-> Append(chunk.channels[i], mCaptureFormats[i],
+                                       chunk.frames, 1, &appendLog);
+         }
+         else
+         {
+            /* we are re-sampling on the fly. The last resampling call
+             * must flush any samples left in the rate conversion buffer
+             * so that they get recorded
+             */
+            int used;
+            int size = mResample[i]->Process(mFactor, (float *)chunk.channels[i],
+                                             chunk.frames, chunk.last, &used,
+                                             mCaptureResampleBuf,
+                                             mCaptureResampleBufLen);
+            mCaptureTracks[i]-> Append((samplePtr)mCaptureResampleBuf,
+                                       floatSample, size, 1, &appendLog);
+         }
+
+         if (!appendLog.IsEmpty())
+         {
+            blockFileLog.StartTag(wxT("recordingrecovery"));
+            blockFileLog.WriteAttr(wxT("id"), mCaptureTracks[i]->GetAutoSaveIdent());
+            blockFileLog.WriteAttr(wxT("channel"), i);
+            blockFileLog.WriteAttr(wxT("numchannels"), numChannels);
+            blockFileLog.WriteSubTree(appendLog);
+            blockFileLog.EndTag(wxT("recordingrecovery"));
+         }
+      }
+
+      if (mListener && !blockFileLog.IsEmpty())
+         mListener->OnAudioIONewBlockFiles(blockFileLog);
+
+      // Only now may the audio thread fill it again
+      ODLocker locker(mCaptureQueueLock);
+      mCaptureChunkFirst = (mCaptureChunkFirst + 1) % mNumCaptureChunks;
+      if (--mCaptureChunksQueued == 0) {
+         mCaptureQueueEmpty->Broadcast();
+         return true;
+      }
+      index = mCaptureChunkFirst;
+   }
+}
+
 
 #ifdef EXPERIMENTAL_MIDI_OUT
 MidiThread::ExitCode MidiThread::Entry()
@@ -2886,17 +3114,7 @@ int AudioIO::GetCommonlyAvailPlayback()
 
 int AudioIO::GetCommonlyAvailCapture()
 {
-   int commonlyAvail = mCaptureBuffers[0]->AvailForGet();
-   unsigned int i;
-
-   for( i = 1; i < mCaptureTracks.GetCount(); i++ )
-   {
-      int avail = mCaptureBuffers[i]->AvailForGet();
-      if( avail < commonlyAvail )
-         commonlyAvail = avail;
-   }
-
-   return commonlyAvail;
+   return mCaptureBuffer->AvailForGet();
 }
 
 #if USE_PORTMIXER
@@ -3032,6 +3250,19 @@ wxString AudioIO::GetDeviceInfo()
       return wxT("Stream is active ... unable to gather information.");
    }
 
+   int numChunks, peakChunks, fullPasses;
+   GetCaptureQueueStats(&numChunks, &peakChunks, &fullPasses);
+   s << wxT("==============================") << e;
+   s << wxT("Last recording's capture queue: ") << numChunks << wxT(" chunks, at most ")
+     << peakChunks << wxT(" in use, full ") << fullPasses << wxT(" times") << e;
+
+   SampleBufferStats bufferStats;
+   GetSampleBufferStats(&bufferStats);
+   s << wxT("Sample buffers: ") << bufferStats.hits << wxT(" reused, ")
+     << bufferStats.misses << wxT(" allocated, ")
+     << (unsigned long)bufferStats.inUse << wxT(" bytes in use (at most ")
+     << (unsigned long)bufferStats.peakInUse << wxT("), ")
+     << (unsigned long)bufferStats.pooled << wxT(" bytes pooled") << e;
 
    int recDeviceNum = Pa_GetDefaultInputDevice();
    int playDeviceNum = Pa_GetDefaultOutputDevice();
@@ -3259,6 +3490,106 @@ wxString AudioIO::GetDeviceInfo()
    return o.GetString();
 }
 
+/// Runs the playback mixers, one per track, and remembers how many
+/// frames each produced
+class PlaybackMixTask : public WorkerTask
+{
+ public:
+   PlaybackMixTask(Mixer **mixers, sampleCount frames, sampleCount *processed)
+      : mMixers(mixers), mFrames(frames), mProcessed(processed) {}
+
+   virtual void Run(int index)
+   {
+      mProcessed[index] = mMixers[index]->Process(mFrames);
+   }
+
+ private:
+   Mixer **mMixers;
+   sampleCount mFrames;
+   sampleCount *mProcessed;
+};
+
+/// Copy count frames from offset of one channel of the interleaved frames
+/// that RingBuffer::PeekGet() returned into a contiguous buffer, converting
+/// them to format.
+static void CopyCaptureChannel(RingBuffer *buffer,
+                               samplePtr region[2], int regionFrames[2],
+                               int offset, int count,
+                               int channel, samplePtr dest, sampleFormat format)
+{
+   sampleFormat bufferFormat = buffer->GetFormat();
+   int channels = buffer->GetChannels();
+   int frameSize = channels * SAMPLE_SIZE(bufferFormat);
+
+   for (int j = 0; j < 2 && count > 0; j++) {
+      if (offset >= regionFrames[j]) {
+         offset -= regionFrames[j];
+         continue;
+      }
+      int frames = std::min(count, regionFrames[j] - offset);
+      CopySamples(region[j] + offset * frameSize +
+                  channel * SAMPLE_SIZE(bufferFormat), bufferFormat,
+                  dest, format, frames, true, channels);
+      dest += frames * SAMPLE_SIZE(format);
+      count -= frames;
+      offset = 0;
+   }
+}
+
+int AudioIO::QueueCaptureChunks(samplePtr region[2], int regionFrames[2],
+                                int frames, bool last)
+{
+   int numChannels = mCaptureTracks.GetCount();
+   int taken = 0;
+
+   // Even with no frames, the last chunk must go, to flush the resamplers
+   for (;;)
+   {
+      int index;
+      bool full;
+      {
+         ODLocker locker(mCaptureQueueLock);
+         full = (mCaptureChunksQueued == mNumCaptureChunks);
+         if (full && !last)
+            mCaptureQueueFullPasses++;
+         index = (mCaptureChunkFirst + mCaptureChunksQueued) % mNumCaptureChunks;
+      }
+
+      if (full)
+      {
+         // Leave the rest in mCaptureBuffer for the next pass; but once
+         // the stream has stopped there will be none, so wait for room
+         if (!last)
+            break;
+         wxMilliSleep(5);
+         continue;
+      }
+
+      // The chunks that aren't queued belong to this thread, so there is no
+      // need to hold the lock while filling one
+      CaptureChunk &chunk = mCaptureChunks[index];
+      int count = std::min(frames - taken, mCaptureChunkFrames);
+      for (int i = 0; i < numChannels; i++)
+         CopyCaptureChannel(mCaptureBuffer, region, regionFrames, taken, count,
+                            i, chunk.channels[i], mCaptureFormats[i]);
+      chunk.frames = count;
+      taken += count;
+      chunk.last = last && taken == frames;
+
+      {
+         ODLocker locker(mCaptureQueueLock);
+         mCaptureChunksQueued++;
+         if (mCaptureChunksQueued > mCaptureQueuePeak)
+            mCaptureQueuePeak = mCaptureChunksQueued;
+      }
+
+      if (taken == frames)
+         break;
+   }
+
+   return taken;
+}
+
 // This method is the data gateway between the audio thread (which
 // communicates with the disk) and the PortAudio callback thread
 // (which communicates with the audio device).
@@ -3300,6 +3631,8 @@ void AudioIO::FillBuffers()
          // This is the purpose of this loop.
          // PRL: or, when scrubbing, we may get work repeatedly from the
          // scrub queue.
+         sampleCount *processedFrames = (sampleCount *)
+            alloca(mPlaybackTracks.GetCount() * sizeof(sampleCount));
          bool done = false;
          do {
             // How many samples to produce for each channel.
@@ -3323,25 +3656,35 @@ void AudioIO::FillBuffers()
                   mWarpedTime += deltat;
             }
 
-            for( i = 0; i < mPlaybackTracks.GetCount(); i++ )
-            {
-               // The mixer here isn't actually mixing: it's just doing
-               // resampling, format conversion, and possibly time track
-               // warping
-               int processed = 0;
-               samplePtr warpedSamples;
-               //don't do anything if we have no length.  In particular, Process() will fail an wxAssert
-               //that causes a crash since this is not the GUI thread and wxASSERT is a GUI call.
+            //don't do anything if we have no length.  In particular, Process() will fail an wxAssert
+            //that causes a crash since this is not the GUI thread and wxASSERT is a GUI call.
 
-               // don't generate either if scrubbing at zero speed.
+            // don't generate either if scrubbing at zero speed.
 #ifdef EXPERIMENTAL_SCRUBBING_SUPPORT
-               const bool silent = (mPlayMode == PLAY_SCRUB) && mSilentScrub;
+            const bool silent = (mPlayMode == PLAY_SCRUB) && mSilentScrub;
 #else
-               const bool silent = false;
+            const bool silent = false;
 #endif
+            // The mixers here aren't actually mixing: they're just doing
+            // resampling, format conversion, and possibly time track
+            // warping, each for its own track, so they can all work at once
+            PlaybackMixTask mixTask(mPlaybackMixers, frames, processedFrames);
+            if (!silent && frames > 0)
+            {
+               if (mParallelMixing)
+                  mPlaybackPool->Run(&mixTask, mPlaybackTracks.GetCount());
+               else
+                  for( i = 0; i < mPlaybackTracks.GetCount(); i++ )
+                     mixTask.Run(i);
+            }
+
+            for( i = 0; i < mPlaybackTracks.GetCount(); i++ )
+            {
+               int processed = 0;
+               samplePtr warpedSamples;
                if (!silent && frames > 0)
                {
-                  processed = mPlaybackMixers[i]->Process(frames);
+                  processed = processedFrames[i];
                   wxASSERT(processed <= frames);
                   warpedSamples = mPlaybackMixers[i]->GetBuffer();
                   mPlaybackBuffers[i]->Put(warpedSamples, floatSample, processed);
@@ -3422,6 +3765,9 @@ void AudioIO::FillBuffers()
             }
                break;
             default:
+               // The rest of the selection is in the ring buffers now
+               if (mWarpedTime >= mWarpedLength)
+                  mPlaybackInputEnded = true;
                done = true;
                break;
             }
@@ -3441,57 +3787,20 @@ void AudioIO::FillBuffers()
       if (mAudioThreadShouldCallFillBuffersOnce ||
           deltat >= mMinCaptureSecsToCopy)
       {
-         // Append captured samples to the end of the WaveTracks.
-         // The WaveTracks have their own buffering for efficiency.
-         AutoSaveFile blockFileLog;
-         int numChannels = mCaptureTracks.GetCount();
-
-         for( i = 0; (int)i < numChannels; i++ )
-         {
-            int avail = commonlyAvail;
-            sampleFormat trackFormat = mCaptureTracks[i]->GetSampleFormat();
-
-            AutoSaveFile appendLog;
-
-            if( mFactor == 1.0 )
-            {
-               samplePtr temp = NewSamples(avail, trackFormat);
-               mCaptureBuffers[i]->Get   (temp, trackFormat, avail);
-               mCaptureTracks[i]-> Append(temp, trackFormat, avail, 1,
-                                          &appendLog);
-               DeleteSamples(temp);
-            }
-            else
-            {
-               int size = lrint(avail * mFactor);
-               samplePtr temp1 = NewSamples(avail, floatSample);
-               samplePtr temp2 = NewSamples(size, floatSample);
-               mCaptureBuffers[i]->Get(temp1, floatSample, avail);
-               /* we are re-sampling on the fly. The last resampling call
-                * must flush any samples left in the rate conversion buffer
-                * so that they get recorded
-                */
-               size = mResample[i]->Process(mFactor, (float *)temp1, avail, !IsStreamActive(),
-                                            &size, (float *)temp2, size);
-               mCaptureTracks[i]-> Append(temp2, floatSample, size, 1,
-                                          &appendLog);
-               DeleteSamples(temp1);
-               DeleteSamples(temp2);
-            }
-
-            if (!appendLog.IsEmpty())
-            {
-               blockFileLog.StartTag(wxT("recordingrecovery"));
-               blockFileLog.WriteAttr(wxT("id"), mCaptureTracks[i]->GetAutoSaveIdent());
-               blockFileLog.WriteAttr(wxT("channel"), (int)i);
-               blockFileLog.WriteAttr(wxT("numchannels"), numChannels);
-               blockFileLog.WriteSubTree(appendLog);
-               blockFileLog.EndTag(wxT("recordingrecovery"));
-            }
-         }
-
-         if (mListener && !blockFileLog.IsEmpty())
-            mListener->OnAudioIONewBlockFiles(blockFileLog);
+         // Hand the captured samples to mCaptureThread, which appends them
+         // to the WaveTracks.  Work on the interleaved frames in place,
+         // taking each channel out with a stride, and release what was
+         // queued afterwards.
+         samplePtr region[2];
+         int regionFrames[2];
+         commonlyAvail = mCaptureBuffer->PeekGet(commonlyAvail,
+                                                 &region[0], &regionFrames[0],
+                                                 &region[1], &regionFrames[1]);
+
+         // Once the stream has stopped, this pass must take everything
+         int taken = QueueCaptureChunks(region, regionFrames, commonlyAvail,
+                                        !IsStreamActive());
+         mCaptureBuffer->Discard(taken);
       }
    }  // end of record buffering
 }
@@ -4156,6 +4465,10 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
          EffectManager & em = EffectManager::Get();
          em.RealtimeProcessStart();
 
+         // Read before the ring buffers, so that if it is set, a short
+         // read below is the end of the input and not an underrun
+         bool inputEnded = gAudioIO->mPlaybackInputEnded;
+
          bool selected = false;
          int group = 0;
          int chanCnt = 0;
@@ -4241,7 +4554,8 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
             if( !cut && selected )
             {
-               len = em.RealtimeProcess(group, chanCnt, tempBufs, len);
+               len = em.RealtimeProcess(group, chanCnt, tempBufs, len,
+                                        framesPerBuffer, inputEnded);
             }
             group++;
 
@@ -4351,12 +4665,10 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
       if( inputBuffer && (numCaptureChannels > 0) )
       {
          unsigned int len = framesPerBuffer;
-         for( t = 0; t < numCaptureChannels; t++) {
-            unsigned int avail =
-               (unsigned int)gAudioIO->mCaptureBuffers[t]->AvailForPut();
-            if (avail < len)
-               len = avail;
-         }
+         unsigned int avail =
+            (unsigned int)gAudioIO->mCaptureBuffer->AvailForPut();
+         if (avail < len)
+            len = avail;
 
          if (len < framesPerBuffer)
          {
@@ -4364,48 +4676,18 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
             wxPrintf(wxT("lost %d samples\n"), (int)(framesPerBuffer - len));
          }
 
-         if (len > 0) {
-            for( t = 0; t < numCaptureChannels; t++) {
-
-               // dmazzoni:
-               // Un-interleave.  Ugly special-case code required because the
-               // capture channels could be in three different sample formats;
-               // it'd be nice to be able to call CopySamples, but it can't
-               // handle multiplying by the gain and then clipping.  Bummer.
-
-               switch(gAudioIO->mCaptureFormat) {
-               case floatSample: {
-                  float *inputFloats = (float *)inputBuffer;
-                  for( i = 0; i < len; i++)
-                     tempFloats[i] =
-                        inputFloats[numCaptureChannels*i+t];
-               } break;
-               case int24Sample:
-                  // We should never get here. Audacity's int24Sample format
-                  // is different from PortAudio's sample format and so we
-                  // make PortAudio return float samples when recording in
-                  // 24-bit samples.
-                  wxASSERT(false);
-                  break;
-               case int16Sample: {
-                  short *inputShorts = (short *)inputBuffer;
-                  short *tempShorts = (short *)tempBuffer;
-                  for( i = 0; i < len; i++) {
-                     float tmp = inputShorts[numCaptureChannels*i+t];
-                     if (tmp > 32767)
-                        tmp = 32767;
-                     if (tmp < -32768)
-                        tmp = -32768;
-                     tempShorts[i] = (short)(tmp);
-                  }
-               } break;
-               } // switch
-
-               gAudioIO->mCaptureBuffers[t]->Put((samplePtr)tempBuffer,
-                                                 gAudioIO->mCaptureFormat,
-                                                 len);
-            }
-         }
+         // We should never get int24Sample here. Audacity's int24Sample
+         // format is different from PortAudio's sample format and so we
+         // make PortAudio return float samples when recording in 24-bit
+         // samples.
+         wxASSERT(gAudioIO->mCaptureFormat != int24Sample);
+
+         // The capture buffer holds frames interleaved just as PortAudio
+         // delivers them, so all channels are converted and stored at once
+         if (len > 0)
+            gAudioIO->mCaptureBuffer->Put((samplePtr)inputBuffer,
+                                          gAudioIO->mCaptureFormat,
+                                          len);
       }
 
       // Update the current time position if not scrubbing
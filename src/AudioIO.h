@@ -34,6 +34,7 @@
 
 #include "WaveTrack.h"
 #include "SampleFormat.h"
+#include "ondemand/ODTaskThread.h"
 
 class AudioIO;
 class RingBuffer;
@@ -41,6 +42,7 @@ class Mixer;
 class Resample;
 class TimeTrack;
 class AudioThread;
+class WorkerPool;
 class Meter;
 class SelectedRegion;
 class TimeTrack;
@@ -252,6 +254,15 @@ class AUDACITY_DLL_API AudioIO {
     * playing actual audio) */
    bool IsMonitoring();
 
+   /** \brief How the block writer kept up with the last (or current)
+    * recording.
+    *
+    * numChunks is the length of the queue between the audio thread and the
+    * thread appending the captured audio to the tracks, peakChunks the most
+    * that were waiting at once, and fullPasses the number of times the audio
+    * thread found the queue full and left the audio in the capture buffer. */
+   void GetCaptureQueueStats(int *numChunks, int *peakChunks, int *fullPasses);
+
    /** \brief Pause and un-pause playback and recording */
    void SetPaused(bool state);
    /** \brief Find out if playback / recording is currently paused */
@@ -436,6 +447,20 @@ private:
                              sampleFormat captureFormat);
    void FillBuffers();
 
+   /** \brief Allocate the chunks that FillBuffers() passes captured audio to
+    * the capture thread in, for about secs of audio.  Throws std::bad_alloc. */
+   void AllocateCaptureChunks(double secs);
+   void DeleteCaptureChunks();
+   /** \brief Move as much of mCaptureBuffer into the queue of chunks as
+    * there is room for.  Called on the audio thread; returns the number of
+    * frames taken. */
+   int QueueCaptureChunks(samplePtr region[2], int regionFrames[2],
+                          int frames, bool last);
+   /** \brief Append the queued chunks to mCaptureTracks.  Called on the
+    * capture thread; returns false if there were none. */
+   bool WriteCaptureChunks();
+   int GetCaptureChunksQueued();
+
 #ifdef EXPERIMENTAL_MIDI_OUT
    void PrepareMidiIterator(bool send = true, double offset = 0);
    bool StartPortMidiStream();
@@ -460,9 +485,8 @@ private:
    /** \brief Get the number of audio samples ready in all of the recording
     * buffers.
     *
-    * Returns the smallest of the number of samples available for storage in
-    * the recording buffers (i.e. the number of samples that can be read from
-    * all record buffers without underflow). */
+    * All channels share one recording buffer of interleaved frames, so this
+    * is the number of frames that can be read from it without underflow. */
    int GetCommonlyAvailCapture();
 
    /** \brief get the index of the supplied (named) recording device, or the
@@ -566,16 +590,43 @@ private:
 #endif
 
    AudioThread        *mThread;
+   AudioThread        *mCaptureThread;   // appends what is recorded to mCaptureTracks
 #ifdef EXPERIMENTAL_MIDI_OUT
    AudioThread         *mMidiThread;
 #endif
    Resample          **mResample;
-   RingBuffer        **mCaptureBuffers;
+   RingBuffer         *mCaptureBuffer;   // interleaved, one channel per capture track
    WaveTrackArray      mCaptureTracks;
+
+   // The audio thread hands recorded audio to mCaptureThread in these, so
+   // that it neither allocates nor waits for the disk.  They are allocated
+   // in StartStream(); the audio thread fills the free ones in turn, and
+   // mCaptureThread empties them in the same order.
+   struct CaptureChunk {
+      samplePtr  *channels;   // one buffer per capture track, in mCaptureFormats
+      int         frames;
+      bool        last;       // the end of the recording, so flush the resamplers
+   };
+   CaptureChunk       *mCaptureChunks;
+   int                 mNumCaptureChunks;
+   int                 mCaptureChunkFrames;
+   sampleFormat       *mCaptureFormats;
+   float              *mCaptureResampleBuf;   // used only by mCaptureThread
+   int                 mCaptureResampleBufLen;
+   // Guards the two indices below, and is held only to change them
+   ODLock              mCaptureQueueLock;
+   // Signalled, with mCaptureQueueLock, when the last queued chunk is written
+   ODCondition        *mCaptureQueueEmpty;
+   int                 mCaptureChunkFirst;    // the oldest queued chunk
+   int                 mCaptureChunksQueued;
+   int                 mCaptureQueuePeak;
+   int                 mCaptureQueueFullPasses;
    RingBuffer        **mPlaybackBuffers;
    WaveTrackArray      mPlaybackTracks;
 
    Mixer             **mPlaybackMixers;
+   bool                mParallelMixing;   // run the playback mixers on mPlaybackPool
+   WorkerPool         *mPlaybackPool;     // not the shared pool, which other work may be holding
    volatile int        mStreamToken;
    static int          mNextStreamToken;
    double              mFactor;
@@ -600,6 +651,9 @@ private:
    sampleFormat        mCaptureFormat;
    int                 mLostSamples;
    volatile bool       mAudioThreadShouldCallFillBuffersOnce;
+   // Set once FillBuffers() has put the end of a straight play in the
+   // ring buffers; only then do realtime effects add their tails
+   volatile bool       mPlaybackInputEnded;
    volatile bool       mAudioThreadFillBuffersLoopRunning;
    volatile bool       mAudioThreadFillBuffersLoopActive;
 
@@ -651,6 +705,7 @@ private:
    AudioIOListener*    mListener;
 
    friend class AudioThread;
+   friend class CaptureThread;
 #ifdef EXPERIMENTAL_MIDI_OUT
    friend class MidiThread;
 #endif
@@ -12,14 +12,46 @@
 \brief The AutoRecoveryDialog prompts the user whether to
 recover previous Audacity projects that were closed incorrectly.
 
+*//****************************************************************//**
+
+\class AutoSaveJournal
+\brief Appends to an autosave file the tracks that changed since it was
+last written, rather than writing the whole project again after each
+edit.
+
+Each track is known by a signature of what can change in it, taken
+without visiting its blocks: the clips, their change counts and those
+of their sequences, envelopes and the track's own settings.  A
+<journal> record, appended as recording recovery data is, holds the
+tracks whose signatures changed.  Once the records add up to the size
+of the file as last written whole, or the project itself changes, the
+file is written whole again.
+
+*//****************************************************************//**
+
+\class JournalRecoveryHandler
+\brief Replays a <journal> record of an autosave file onto the tracks
+already read from it.
+
 *//********************************************************************/
 
 #include "AutoRecovery.h"
 #include "Audacity.h"
 #include "AudacityApp.h"
+#include "Envelope.h"
 #include "FileNames.h"
+#include "LabelTrack.h"
+#include "Sequence.h"
+#include "Tags.h"
+#include "TimeTrack.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
 #include "blockfile/SimpleBlockFile.h"
 
+#ifdef USE_MIDI
+#include "NoteTrack.h"
+#endif
+
 #include <wx/wxprec.h>
 #include <wx/filefn.h>
 #include <wx/dir.h>
@@ -372,6 +404,127 @@ XMLTagHandler* RecordingRecoveryHandler::HandleXMLChild(const wxChar *tag)
    return NULL;
 }
 
+////////////////////////////////////////////////////////////////////////////
+/// Journal recovery handler
+
+JournalRecoveryHandler::JournalRecoveryHandler(AudacityProject* proj)
+{
+   mProject = proj;
+   mNumTracks = -1;
+   mIndex = -1;
+   mNewTrack = NULL;
+}
+
+JournalRecoveryHandler::~JournalRecoveryHandler()
+{
+   // Left over only if the record was cut short
+   delete mNewTrack;
+}
+
+bool JournalRecoveryHandler::HandleXMLTag(const wxChar *tag,
+                                          const wxChar **attrs)
+{
+   const wxChar *name;
+   long *target;
+   if (wxStrcmp(tag, wxT("journal")) == 0)
+   {
+      name = wxT("numtracks");
+      target = &mNumTracks;
+   }
+   else if (wxStrcmp(tag, wxT("journaltrack")) == 0)
+   {
+      name = wxT("index");
+      target = &mIndex;
+   }
+   else
+      return false;
+
+   *target = -1;
+
+   while(*attrs)
+   {
+      const wxChar *attr = *attrs++;
+      const wxChar *value = *attrs++;
+
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (wxStrcmp(attr, name) == 0)
+      {
+         long nValue;
+         if (!XMLValueChecker::IsGoodInt(strValue) || !strValue.ToLong(&nValue) ||
+               (nValue < 0))
+            return false;
+         *target = nValue;
+      }
+   }
+
+   return *target >= 0;
+}
+
+void JournalRecoveryHandler::HandleXMLEndTag(const wxChar *tag)
+{
+   TrackList *tracks = mProject->GetTracks();
+   TrackListIterator iter(tracks);
+
+   if (wxStrcmp(tag, wxT("journaltrack")) == 0)
+   {
+      if (mNewTrack)
+      {
+         // Put the track read in place of the one at its index
+         Track *t = iter.First();
+         for (long i = 0; t && i < mIndex; i++)
+            t = iter.Next();
+
+         if (t)
+            tracks->Replace(t, mNewTrack, true);
+         else
+            tracks->Add(mNewTrack);
+
+         mNewTrack = NULL;
+      }
+      mIndex = -1;
+   }
+   else if (wxStrcmp(tag, wxT("journal")) == 0)
+   {
+      // Drop the tracks beyond those the project had by then
+      long i = 0;
+      Track *t = iter.First();
+      while (t)
+      {
+         if (i++ >= mNumTracks)
+            t = iter.RemoveCurrent(true);
+         else
+            t = iter.Next();
+      }
+   }
+}
+
+XMLTagHandler *JournalRecoveryHandler::HandleXMLChild(const wxChar *tag)
+{
+   if (wxStrcmp(tag, wxT("journaltrack")) == 0)
+      return this; // HandleXMLTag also handles <journaltrack>
+
+   // One track to each <journaltrack>
+   if (mIndex < 0 || mNewTrack)
+      return NULL;
+
+   TrackFactory *factory = mProject->GetTrackFactory();
+   if (wxStrcmp(tag, wxT("wavetrack")) == 0)
+      mNewTrack = factory->NewWaveTrack();
+#ifdef USE_MIDI
+   else if (wxStrcmp(tag, wxT("notetrack")) == 0)
+      mNewTrack = factory->NewNoteTrack();
+#endif
+   else if (wxStrcmp(tag, wxT("labeltrack")) == 0)
+      mNewTrack = factory->NewLabelTrack();
+   else if (wxStrcmp(tag, wxT("timetrack")) == 0)
+      mNewTrack = factory->NewTimeTrack();
+
+   return mNewTrack;
+}
+
 ///
 /// AutoSaveFile class
 ///
@@ -922,3 +1075,230 @@ bool AutoSaveFile::Decode(const wxString & fileName)
 
    return true;
 }
+
+///
+/// AutoSaveJournal class
+///
+
+// An XMLWriter that only takes a hash of what it is given
+class XMLHashWriter : public XMLWriter
+{
+public:
+   XMLHashWriter() : mHash(2166136261u) {}
+
+   wxUint32 GetHash() const { return mHash; }
+
+   void Add(const void *data, size_t len)
+   {
+      // FNV-1a
+      const unsigned char *bytes = (const unsigned char *)data;
+      for (size_t i = 0; i < len; i++)
+      {
+         mHash ^= bytes[i];
+         mHash *= 16777619u;
+      }
+   }
+
+   template<typename T> void AddValue(T value)
+   {
+      Add(&value, sizeof(value));
+   }
+
+   void AddString(const wxString & value)
+   {
+      AddValue(value.Length());
+      Add(value.c_str(), value.Length() * sizeof(wxChar));
+   }
+
+   virtual void StartTag(const wxString & name) { AddValue('<'); AddString(name); }
+   virtual void EndTag(const wxString & name) { AddValue('>'); AddString(name); }
+
+   virtual void WriteAttr(const wxString & name, const wxString & value) { AddString(name); AddString(value); }
+   virtual void WriteAttr(const wxString & name, const wxChar *value) { AddString(name); AddString(value); }
+
+   virtual void WriteAttr(const wxString & name, int value) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, bool value) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, long value) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, long long value) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, size_t value) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, float value, int WXUNUSED(digits)) { AddString(name); AddValue(value); }
+   virtual void WriteAttr(const wxString & name, double value, int WXUNUSED(digits)) { AddString(name); AddValue(value); }
+
+   virtual void WriteData(const wxString & value) { AddString(value); }
+   virtual void Write(const wxString & data) { AddString(data); }
+
+private:
+   wxUint32 mHash;
+};
+
+static void HashClip(XMLHashWriter & hash, WaveClip *clip)
+{
+   Sequence *seq = clip->GetSequence();
+
+   // The pointers tell this clip from one made since; the counts go up
+   // with every change to the samples
+   hash.AddValue((const void *)clip);
+   hash.AddValue((const void *)seq);
+   hash.AddValue(clip->GetDirty());
+   hash.AddValue(seq->GetChangeCount());
+   hash.AddValue(seq->GetNumSamples());
+   hash.AddValue(clip->GetOffset());
+   clip->GetEnvelope()->WriteXML(hash);
+
+   WaveClipList *cutLines = clip->GetCutLines();
+   hash.AddValue(cutLines->GetCount());
+   for (WaveClipList::compatibility_iterator it = cutLines->GetFirst(); it; it = it->GetNext())
+      HashClip(hash, it->GetData());
+}
+
+AutoSaveJournal::AutoSaveJournal()
+{
+   Reset();
+}
+
+void AutoSaveJournal::Reset()
+{
+   mValid = false;
+   mProjectSignature = 0;
+   mTracks.clear();
+   mSignatures.clear();
+   mCheckpointSize = 0;
+   mFileSize = 0;
+}
+
+wxUint32 AutoSaveJournal::ProjectSignature(AudacityProject *project)
+{
+   // What the journal can't carry; the view is left as last written whole
+   XMLHashWriter hash;
+   project->GetTags()->WriteXML(hash);
+   hash.AddValue(project->GetRate());
+   hash.AddValue(project->GetSnapTo());
+   hash.AddString(project->GetSelectionFormat());
+   hash.AddString(project->GetFrequencySelectionFormatName());
+   hash.AddString(project->GetBandwidthSelectionFormatName());
+   return hash.GetHash();
+}
+
+wxUint32 AutoSaveJournal::TrackSignature(Track *t, int ident)
+{
+   XMLHashWriter hash;
+   hash.AddValue((const void *)t);
+   hash.AddValue(ident);
+
+   if (t->GetKind() != Track::Wave)
+   {
+      // Small enough to look at whole
+      t->WriteXML(hash);
+      return hash.GetHash();
+   }
+
+   // Everything WaveTrack::WriteXML writes, but the selection and the
+   // blocks, which the change counts of the clips stand for
+   WaveTrack *wt = (WaveTrack *)t;
+   hash.AddString(wt->GetName());
+   hash.AddValue(wt->GetChannel());
+   hash.AddValue(wt->GetLinked());
+   hash.AddValue(wt->GetMute());
+   hash.AddValue(wt->GetSolo());
+   hash.AddValue(wt->GetActualHeight());
+   hash.AddValue(wt->GetMinimized());
+   hash.AddValue(wt->GetRate());
+   hash.AddValue(wt->GetGain());
+   hash.AddValue(wt->GetPan());
+
+   for (WaveClipList::compatibility_iterator it = wt->GetClipIterator(); it; it = it->GetNext())
+      HashClip(hash, it->GetData());
+
+   return hash.GetHash();
+}
+
+void AutoSaveJournal::Checkpoint(AudacityProject *project, wxFileOffset fileSize)
+{
+   Reset();
+
+   // AudacityProject::WriteXML numbers the wave tracks from 1 when
+   // auto-saving, for recording recovery to find them by
+   int ident = 0;
+   TrackListIterator iter(project->GetTracks());
+   for (Track *t = iter.First(); t; t = iter.Next())
+   {
+      mTracks.push_back(t);
+      mSignatures.push_back(TrackSignature(t, t->GetKind() == Track::Wave ? ++ident : 0));
+   }
+
+   mProjectSignature = ProjectSignature(project);
+   mCheckpointSize = fileSize;
+   mFileSize = fileSize;
+   mValid = true;
+}
+
+bool AutoSaveJournal::Append(AudacityProject *project, const wxString &fileName)
+{
+   if (!mValid || fileName.IsEmpty())
+      return false;
+
+   // Compact once the records add up to as much as the whole
+   if (mFileSize - mCheckpointSize >= mCheckpointSize)
+      return false;
+
+   if (ProjectSignature(project) != mProjectSignature)
+      return false;
+
+   std::vector<Track *> tracks;
+   std::vector<wxUint32> signatures;
+   std::vector<int> idents;
+
+   int ident = 0;
+   TrackListIterator iter(project->GetTracks());
+   for (Track *t = iter.First(); t; t = iter.Next())
+   {
+      idents.push_back(t->GetKind() == Track::Wave ? ++ident : 0);
+      tracks.push_back(t);
+      signatures.push_back(TrackSignature(t, idents.back()));
+   }
+
+   std::vector<size_t> changed;
+   for (size_t i = 0; i < tracks.size(); i++)
+   {
+      if (i >= mTracks.size() || tracks[i] != mTracks[i] || signatures[i] != mSignatures[i])
+         changed.push_back(i);
+   }
+
+   if (changed.empty() && tracks.size() == mTracks.size())
+      return true;
+
+   // Nothing to gain over writing the whole
+   if (!tracks.empty() && changed.size() == tracks.size())
+      return false;
+
+   AutoSaveFile buffer;
+   buffer.StartTag(wxT("journal"));
+   buffer.WriteAttr(wxT("numtracks"), (int)tracks.size());
+   for (size_t i = 0; i < changed.size(); i++)
+   {
+      Track *t = tracks[changed[i]];
+      if (t->GetKind() == Track::Wave)
+         ((WaveTrack *)t)->SetAutoSaveIdent(idents[changed[i]]);
+
+      buffer.StartTag(wxT("journaltrack"));
+      buffer.WriteAttr(wxT("index"), (int)changed[i]);
+      t->WriteXML(buffer);
+      buffer.EndTag(wxT("journaltrack"));
+   }
+   buffer.EndTag(wxT("journal"));
+
+   wxFFile file(fileName, wxT("ab"));
+   if (!file.IsOpened() || !buffer.Append(file))
+   {
+      // The file may end in part of a record; write it whole again
+      Reset();
+      return false;
+   }
+   mFileSize = file.Length();
+   file.Close();
+
+   mTracks.swap(tracks);
+   mSignatures.swap(signatures);
+
+   return true;
+}
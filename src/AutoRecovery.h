@@ -22,6 +22,8 @@
 #include <wx/hashmap.h>
 #include <wx/mstream.h>
 
+#include <vector>
+
 //
 // Show auto recovery dialog if there are projects to recover. Should be
 // called once at Audacity startup.
@@ -58,6 +60,30 @@ private:
    int mAutoSaveIdent;
 };
 
+//
+// XML Handler for a <journal> tag, which puts the tracks that changed
+// since the autosave file was last written whole in place of the old
+//
+class JournalRecoveryHandler: public XMLTagHandler
+{
+public:
+   JournalRecoveryHandler(AudacityProject* proj);
+   virtual ~JournalRecoveryHandler();
+
+   virtual bool HandleXMLTag(const wxChar *tag, const wxChar **attrs);
+   virtual void HandleXMLEndTag(const wxChar *tag);
+   virtual XMLTagHandler *HandleXMLChild(const wxChar *tag);
+
+   // This class only knows reading tags
+   virtual void WriteXML(XMLWriter & WXUNUSED(xmlFile)) { wxASSERT(false); }
+
+private:
+   AudacityProject* mProject;
+   long mNumTracks;
+   long mIndex;
+   Track *mNewTrack;
+};
+
 ///
 /// AutoSaveFile
 ///
@@ -115,5 +141,43 @@ private:
    size_t mAllocSize;
 };
 
+///
+/// AutoSaveJournal
+///
+
+// Keeps an autosave file up to date by appending only the tracks that
+// changed since it was last written, so that autosaving after an edit
+// costs about as much as the tracks edited, however long the project.
+class AUDACITY_DLL_API AutoSaveJournal
+{
+public:
+   AutoSaveJournal();
+
+   /// Forget the file, so that the next autosave writes it whole
+   void Reset();
+
+   /// Note the project as just written whole, to a file of fileSize bytes
+   void Checkpoint(AudacityProject *project, wxFileOffset fileSize);
+
+   /// Append to fileName a <journal> of the tracks changed since the last
+   /// call or checkpoint.  Returns false, having written nothing, if the
+   /// file should be written whole instead.
+   bool Append(AudacityProject *project, const wxString &fileName);
+
+private:
+   static wxUint32 ProjectSignature(AudacityProject *project);
+   static wxUint32 TrackSignature(Track *t, int ident);
+
+   bool mValid;
+   wxUint32 mProjectSignature;
+
+   // The tracks as last written, in order
+   std::vector<Track *> mTracks;
+   std::vector<wxUint32> mSignatures;
+
+   wxFileOffset mCheckpointSize;
+   wxFileOffset mFileSize;
+};
+
 
 #endif
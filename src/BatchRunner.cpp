@@ -0,0 +1,226 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BatchRunner.cpp
+
+*******************************************************************//**
+
+\class BatchRunner
+\brief Applies a chain to files named on the command line, with no
+dialogs, spreading them over several copies of Audacity if asked.
+
+The dialogs of BatchProcessDialog work through one file at a time in
+the one project.  A long list is better shared out among processes,
+as effects and exporters run on the main thread of each.  Workers are
+copies of this program started with --chain and --list, and each is
+given a few files at a time, so that those finishing early take more.
+
+*//****************************************************************//**
+
+\class BatchWorkerProcess
+\brief A copy of Audacity applying a chain to some of the files.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+
+#include <wx/app.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/process.h>
+#include <wx/textfile.h>
+#include <wx/utils.h>
+
+#include "BatchRunner.h"
+#include "BatchCommands.h"
+#include "PlatformCompatibility.h"
+#include "Project.h"
+#include "UndoManager.h"
+
+int BatchRunner::ApplyChainToFiles(AudacityProject *project,
+                                   const wxString &chain,
+                                   const wxArrayString &files)
+{
+   BatchCommands batch;
+   if (!batch.ReadChain(chain)) {
+      wxFprintf(stderr, _("Could not read the chain '%s'\n"), chain.c_str());
+      return files.GetCount();
+   }
+
+   int failed = 0;
+   for (size_t i = 0; i < files.GetCount(); i++) {
+      bool ok = project->Import(files[i]);
+      if (ok) {
+         project->OnSelectAll();
+         ok = batch.ApplyChain(files[i]);
+      }
+
+      if (ok)
+         wxPrintf(_("Applied '%s' to %s\n"), chain.c_str(), files[i].c_str());
+      else {
+         wxPrintf(_("Could not apply '%s' to %s\n"),
+                  chain.c_str(), files[i].c_str());
+         failed++;
+      }
+      fflush(stdout);
+
+      project->GetUndoManager()->ClearStates();
+      project->OnSelectAll();
+      project->OnRemoveTracks();
+      // so that closing the empty project asks nothing
+      project->GetUndoManager()->StateSaved();
+   }
+
+   return failed;
+}
+
+class BatchWorkerProcess : public wxProcess
+{
+public:
+   BatchWorkerProcess(const wxString &listFile, size_t count)
+   {
+      mListFile = listFile;
+      mCount = count;
+      mActive = true;
+      mStatus = -1;
+   }
+
+   bool IsActive()
+   {
+      return mActive;
+   }
+
+   void OnTerminate(int WXUNUSED( pid ), int status)
+   {
+      mStatus = status;
+      mActive = false;
+   }
+
+   int GetStatus()
+   {
+      return mStatus;
+   }
+
+   wxString mListFile;
+   size_t mCount;
+
+private:
+   bool mActive;
+   int mStatus;
+};
+
+// Starts a worker on count files from first.  Returns NULL if it
+// couldn't be started.
+static BatchWorkerProcess *StartWorker(const wxString &chain,
+                                       const wxArrayString &files,
+                                       size_t first, size_t count)
+{
+   wxString listFile = wxFileName::CreateTempFileName(wxT("audacity-chain"));
+   if (listFile.IsEmpty())
+      return NULL;
+
+   wxTextFile tf(listFile);
+   if (!tf.Open()) {
+      wxRemoveFile(listFile);
+      return NULL;
+   }
+   for (size_t i = first; i < first + count; i++)
+      tf.AddLine(files[i]);
+   bool written = tf.Write();
+   tf.Close();
+   if (!written) {
+      wxRemoveFile(listFile);
+      return NULL;
+   }
+
+   wxString exe = PlatformCompatibility::GetExecutablePath();
+   const wxChar *argv[] = {
+      exe.c_str(),
+      wxT("--chain"), chain.c_str(),
+      wxT("--list"), listFile.c_str(),
+      wxT("--jobs"), wxT("1"),
+      NULL
+   };
+
+   BatchWorkerProcess *worker = new BatchWorkerProcess(listFile, count);
+   if (!wxExecute(const_cast<wxChar **>(argv), wxEXEC_ASYNC, worker)) {
+      delete worker;
+      wxRemoveFile(listFile);
+      return NULL;
+   }
+
+   return worker;
+}
+
+int BatchRunner::ApplyChainInWorkers(const wxString &chain,
+                                     const wxArrayString &files,
+                                     int jobs)
+{
+   size_t count = files.GetCount();
+
+   // Small enough runs to keep all the workers busy to the end, big
+   // enough that starting Audacity is a small part of each
+   size_t perRun = count / (std::max(jobs, 1) * 4);
+   perRun = std::max<size_t>(1, std::min<size_t>(perRun, 64));
+
+   std::vector<BatchWorkerProcess *> workers;
+   size_t next = 0;
+   int failed = 0;
+
+   while (next < count || !workers.empty()) {
+      while (next < count && (int)workers.size() < jobs) {
+         size_t n = std::min(perRun, count - next);
+         BatchWorkerProcess *worker = StartWorker(chain, files, next, n);
+         if (worker)
+            workers.push_back(worker);
+         else {
+            wxFprintf(stderr, _("Could not start Audacity for %s and %d more\n"),
+                      files[next].c_str(), (int)n - 1);
+            failed += n;
+         }
+         next += n;
+      }
+
+      wxMilliSleep(10);
+      wxTheApp->Yield();
+
+      for (size_t i = 0; i < workers.size();) {
+         BatchWorkerProcess *worker = workers[i];
+         if (worker->IsActive()) {
+            i++;
+            continue;
+         }
+
+         if (worker->GetStatus() != 0)
+            failed += worker->mCount;
+         wxRemoveFile(worker->mListFile);
+         delete worker;
+         workers.erase(workers.begin() + i);
+      }
+   }
+
+   return failed;
+}
+
+bool BatchRunner::ReadFileList(const wxString &listFile, wxArrayString &files)
+{
+   wxTextFile tf(listFile);
+   if (!tf.Open())
+      return false;
+
+   for (size_t i = 0; i < tf.GetLineCount(); i++) {
+      wxString name = tf[i].Strip(wxString::both);
+      if (!name.IsEmpty())
+         files.Add(name);
+   }
+
+   tf.Close();
+
+   return true;
+}
@@ -0,0 +1,37 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BatchRunner.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BATCH_RUNNER__
+#define __AUDACITY_BATCH_RUNNER__
+
+#include <wx/arrstr.h>
+#include <wx/string.h>
+
+class AudacityProject;
+
+class BatchRunner {
+ public:
+   /// Applies the chain to each file in turn in project, which should be
+   /// empty, writing a line about each one to standard output.  Returns
+   /// the number of files that failed.
+   static int ApplyChainToFiles(AudacityProject *project,
+                                const wxString &chain,
+                                const wxArrayString &files);
+
+   /// Shares the files out among up to jobs copies of this program, each
+   /// given a few at a time and run with --chain.  Returns the number of
+   /// files in the runs that failed.
+   static int ApplyChainInWorkers(const wxString &chain,
+                                  const wxArrayString &files,
+                                  int jobs);
+
+   /// Appends the names in listFile, one to a line, to files
+   static bool ReadFileList(const wxString &listFile, wxArrayString &files);
+};
+
+#endif
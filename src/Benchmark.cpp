@@ -17,13 +17,17 @@ of the BlockFile system.
 
 #include "Audacity.h"
 
+#include <string.h>
+
 #include <wx/log.h>
 #include <wx/textctrl.h>
 #include <wx/button.h>
 #include <wx/checkbox.h>
 #include <wx/choice.h>
 #include <wx/dialog.h>
+#include <wx/file.h>
 #include <wx/filedlg.h>
+#include <wx/filename.h>
 #include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/stattext.h>
@@ -32,12 +36,19 @@ of the BlockFile system.
 #include <wx/valgen.h>
 #include <wx/valtext.h>
 #include <wx/intl.h>
+#include <wx/thread.h>
+
+#include "sndfile.h"
 
 #include "Benchmark.h"
 #include "Project.h"
 #include "WaveTrack.h"
+#include "WaveClip.h"
 #include "Sequence.h"
 #include "Prefs.h"
+#include "Dither.h"
+#include "import/ImportQueue.h"
+#include "ondemand/ODManager.h"
 
 #include "FileDialog.h"
 
@@ -60,6 +71,9 @@ private:
    void HoldPrint(bool hold);
    void FlushPrint();
 
+   bool TimeConversion(long dataSize);
+   bool StressImport(long dataSize, DirManager *dirManager);
+
    bool      mHoldPrint;
    wxString  mToPrint;
 
@@ -70,6 +84,8 @@ private:
 
    bool      mBlockDetail;
    bool      mEditDetail;
+   bool      mConversion;
+   bool      mImport;
 
    wxTextCtrl  *mText;
 
@@ -138,6 +154,8 @@ BenchmarkDialog::BenchmarkDialog(wxWindow *parent):
 
    mBlockDetail = false;
    mEditDetail = false;
+   mConversion = true;
+   mImport = false;
 
    HoldPrint(false);
 
@@ -205,6 +223,16 @@ void BenchmarkDialog::MakeBenchmarkDialog()
                            wxT("false"));
       item->SetValidator(wxGenericValidator(&mEditDetail));
 
+      //
+      item = S.AddCheckBox(wxT("Time sample format conversion (plain and SIMD)"),
+                           wxT("true"));
+      item->SetValidator(wxGenericValidator(&mConversion));
+
+      //
+      item = S.AddCheckBox(wxT("Import several files at once"),
+                           wxT("false"));
+      item->SetValidator(wxGenericValidator(&mImport));
+
       //
       mText = S.Id(StaticTextID).AddTextWindow(wxT(""));
       mText->SetName(wxT("Output"));
@@ -292,6 +320,236 @@ void BenchmarkDialog::FlushPrint()
    mToPrint = wxT("");
 }
 
+// Times Dither::Apply() on dataSize MB of float samples, first with the
+// plain loops and then with the SIMD ones, and checks that the two give
+// the same samples where no dither is involved.
+bool BenchmarkDialog::TimeConversion(long dataSize)
+{
+   struct Case {
+      sampleFormat from;
+      sampleFormat to;
+      Dither::DitherType dither;
+      const wxChar *name;
+   } cases[] = {
+      { floatSample, int16Sample, Dither::none, wxT("float to 16-bit, no dither") },
+      { floatSample, int16Sample, Dither::rectangle, wxT("float to 16-bit, rectangle") },
+      { floatSample, int16Sample, Dither::triangle, wxT("float to 16-bit, triangle") },
+      { floatSample, int16Sample, Dither::shaped, wxT("float to 16-bit, shaped") },
+      { floatSample, int24Sample, Dither::none, wxT("float to 24-bit, no dither") },
+      { int16Sample, floatSample, Dither::none, wxT("16-bit to float") },
+   };
+   const int numCases = sizeof(cases) / sizeof(cases[0]);
+
+   const int len = 65536;
+   int passes = (int)((dataSize * 1048576) / (len * sizeof(float)));
+   if (passes < 1)
+      passes = 1;
+
+   Printf(wxT("Timing sample format conversion (%s)...\n"),
+          Dither::GetSIMDName());
+   FlushPrint();
+   wxTheApp->Yield();
+
+   samplePtr source = NewSamples(len, floatSample);
+   samplePtr plain = NewSamples(len, floatSample);
+   samplePtr simd = NewSamples(len, floatSample);
+
+   // Full scale noise, slightly over the top, so clipping is exercised
+   for (int i = 0; i < len; i++)
+      ((float *)source)[i] = (rand() / (float)RAND_MAX - 0.5f) * 2.2f;
+
+   bool wasEnabled = Dither::IsSIMDEnabled();
+   bool ok = true;
+   Dither dither;
+   wxStopWatch timer;
+
+   for (int c = 0; c < numCases; c++) {
+      const Case &tc = cases[c];
+      samplePtr from = source;
+      if (tc.from != floatSample) {
+         // Prepare integer input from the float noise
+         from = NewSamples(len, tc.from);
+         Dither::SetSIMDEnabled(false);
+         dither.Apply(Dither::none, source, floatSample, from, tc.from, len);
+      }
+
+      long elapsed[2];
+      for (int s = 0; s < 2; s++) {
+         Dither::SetSIMDEnabled(s == 1);
+         samplePtr dest = (s == 1) ? simd : plain;
+         timer.Start();
+         for (int p = 0; p < passes; p++)
+            dither.Apply(tc.dither, from, tc.from, dest, tc.to, len);
+         elapsed[s] = timer.Time();
+      }
+
+      Printf(wxT("%s: %ld ms plain, %ld ms SIMD (%.1fx)\n"), tc.name,
+             elapsed[0], elapsed[1],
+             elapsed[1] > 0 ? elapsed[0] / (double)elapsed[1] : 0.0);
+
+      if (tc.dither == Dither::none &&
+          memcmp(plain, simd, len * SAMPLE_SIZE(tc.to))) {
+         Printf(wxT("Plain and SIMD results differ!\n"));
+         ok = false;
+      }
+
+      if (from != source)
+         DeleteSamples(from);
+
+      FlushPrint();
+      wxTheApp->Yield();
+   }
+
+   Dither::SetSIMDEnabled(wasEnabled);
+
+   DeleteSamples(source);
+   DeleteSamples(plain);
+   DeleteSamples(simd);
+
+   return ok;
+}
+
+// Writes one WAV file of noise per processor, then imports them all at
+// once with the ImportQueue, several times over, and checks that every
+// track has the samples written and block summaries that agree with
+// them.  Blocks made on different threads at the same time must not
+// share any state.
+bool BenchmarkDialog::StressImport(long dataSize, DirManager *dirManager)
+{
+   int numFiles = wxMax(4, wxThread::GetCPUCount());
+   sampleCount len = wxMax((sampleCount)(dataSize * 1048576 / (numFiles * sizeof(short))),
+                           (sampleCount)(4 * 65536));
+   const int rounds = 3;
+
+   Printf(wxT("Importing %d files of %lld samples at once, %d times...\n"),
+          numFiles, (long long)len, rounds);
+   FlushPrint();
+   wxTheApp->Yield();
+
+   // Copy the samples in, and don't ask about it
+   wxString copyEdit =
+      gPrefs->Read(wxT("/FileFormats/CopyOrEditUncompressedData"), wxT("copy"));
+   bool firstAsk =
+      gPrefs->Read(wxT("/Warnings/CopyOrEditUncompressedDataFirstAsk"), true) ? true : false;
+   bool ask =
+      gPrefs->Read(wxT("/Warnings/CopyOrEditUncompressedDataAsk"), true) ? true : false;
+   gPrefs->Write(wxT("/FileFormats/CopyOrEditUncompressedData"), wxT("copy"));
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataFirstAsk"), false);
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataAsk"), false);
+
+   short **data = new short *[numFiles];
+   wxArrayString fileNames;
+   bool ok = true;
+   int i;
+
+   for (i = 0; i < numFiles; i++) {
+      data[i] = new short[len];
+      for (sampleCount s = 0; s < len; s++)
+         data[i][s] = (short)(rand() - RAND_MAX / 2);
+
+      wxString tempName = wxFileName::CreateTempFileName(wxT("audacity-benchmark-"));
+      wxRemoveFile(tempName);
+      fileNames.Add(tempName + wxT(".wav"));
+
+      SF_INFO info;
+      memset(&info, 0, sizeof(info));
+      info.samplerate = 44100;
+      info.channels = 1;
+      info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+      wxFile file;
+      SNDFILE *sf = NULL;
+      ODManager::LockLibSndFileMutex();
+      if (file.Open(fileNames[i], wxFile::write))
+         sf = sf_open_fd(file.fd(), SFM_WRITE, &info, FALSE);
+      if (!sf || sf_writef_short(sf, data[i], len) != len) {
+         Printf(wxT("Could not write %s\n"), fileNames[i].c_str());
+         ok = false;
+      }
+      if (sf)
+         sf_close(sf);
+      ODManager::UnlockLibSndFileMutex();
+   }
+
+   wxStopWatch timer;
+   long elapsed = 0;
+   float *samples = new float[len];
+   float *summary = new float[3 * (len / 256 + 1)];
+
+   for (int round = 0; ok && round < rounds; round++) {
+      ImportQueue queue(dirManager);
+      for (i = 0; i < numFiles; i++)
+         queue.Add(fileNames[i]);
+
+      timer.Start();
+      queue.Import();
+      elapsed += timer.Time();
+
+      for (i = 0; i < numFiles; i++) {
+         Track **tracks = NULL;
+         int numTracks = queue.WasHandled(i) ? queue.GetTracks(i, &tracks) : 0;
+         if (numTracks != 1) {
+            Printf(wxT("%s was not imported in the background\n"),
+                   fileNames[i].c_str());
+            ok = false;
+         }
+         else {
+            WaveTrack *track = (WaveTrack *)tracks[0];
+            short *got = new short[len];
+            if (!track->Get((samplePtr)got, int16Sample, 0, len) ||
+                memcmp(got, data[i], len * sizeof(short))) {
+               Printf(wxT("Samples of %s differ\n"), fileNames[i].c_str());
+               ok = false;
+            }
+            delete[] got;
+
+            // The summaries are what a race between blocks would spoil
+            BlockArray *blocks =
+               track->GetClipByIndex(0)->GetSequence()->GetBlockArray();
+            for (size_t b = 0; b < blocks->Count(); b++) {
+               BlockFile *f = blocks->Item(b)->f;
+               sampleCount blockLen = f->GetLength();
+               sampleCount frames = (blockLen + 255) / 256;
+               f->ReadData((samplePtr)samples, floatSample, 0, blockLen);
+               f->Read256(summary, 0, frames);
+               for (sampleCount s = 0; s < blockLen; s++) {
+                  float *frame = &summary[3 * (s / 256)];
+                  if (samples[s] < frame[0] || samples[s] > frame[1]) {
+                     Printf(wxT("Summary of block %d of %s is wrong\n"),
+                            (int)b, fileNames[i].c_str());
+                     ok = false;
+                     break;
+                  }
+               }
+            }
+         }
+
+         for (int t = 0; t < numTracks; t++)
+            delete tracks[t];
+         delete[] tracks;
+      }
+
+      FlushPrint();
+      wxTheApp->Yield();
+   }
+
+   Printf(wxT("Time to import: %ld ms\n"), elapsed);
+
+   delete[] samples;
+   delete[] summary;
+   for (i = 0; i < numFiles; i++) {
+      wxRemoveFile(fileNames[i]);
+      delete[] data[i];
+   }
+   delete[] data;
+
+   gPrefs->Write(wxT("/FileFormats/CopyOrEditUncompressedData"), copyEdit);
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataFirstAsk"), firstAsk);
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataAsk"), ask);
+   gPrefs->Flush();
+
+   return ok;
+}
+
 void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
 {
    TransferDataFromWindow();
@@ -518,6 +776,12 @@ void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
           wxT("simultaneous tracks that could be played at once: %.1f\n"),
           (nChunks*chunkSize/44100.0)/(elapsed/1000.0));
 
+   if (mConversion && !TimeConversion(dataSize))
+      goto fail;
+
+   if (mImport && !StressImport(dataSize, d))
+      goto fail;
+
    goto success;
 
  fail:
@@ -33,6 +33,13 @@ count hits zero.  DirManager is the class responsible for
 constructing and managing BlockFiles and managing their reference
 counts.
 
+Besides the 256- and 64K-sample summaries stored with the data, a
+BlockFile can give min, max and RMS at every level of a summary pyramid
+(see GetSummaryDivisor()), so that a display column of any width can be
+drawn from a handful of frames.  The levels above 256 are derived from
+the 256-sample summary the first time they are needed, and kept in the
+WaveformCache; the files on disk are the same as ever.
+
 *//****************************************************************//**
 
 \class SummaryInfo
@@ -42,8 +49,10 @@ out.
 
 *//*******************************************************************/
 
+#include <algorithm>
 #include <float.h>
 #include <math.h>
+#include <string.h>
 
 #include <wx/utils.h>
 #include <wx/filefn.h>
@@ -84,7 +93,11 @@ SummaryInfo::SummaryInfo(sampleCount samples)
    totalSummaryBytes = offset256 + (frames256 * bytesPerFrame);
 }
 
-char *BlockFile::fullSummary = 0;
+int BlockFile::sSummaryLevelFactor = 16;
+
+wxLongLong_t BlockFile::sNextSerial = 0;
+ODLock BlockFile::sSerialLock;
+ODLock BlockFile::sRefLock;
 
 /// Initializes the base BlockFile data.  The block is initially
 /// unlocked and its reference count is 1.
@@ -104,6 +117,9 @@ BlockFile::BlockFile(wxFileName fileName, sampleCount samples):
    mSummaryInfo(samples)
 {
    mSilentLog=FALSE;
+
+   ODLocker locker(sSerialLock);
+   mSerial = sNextSerial++;
 }
 
 BlockFile::~BlockFile()
@@ -157,10 +173,17 @@ bool BlockFile::IsLocked()
    return mLockCount > 0;
 }
 
+wxLongLong_t BlockFile::GetNextSerial()
+{
+   ODLocker locker(sSerialLock);
+   return sNextSerial;
+}
+
 /// Increases the reference count of this block by one.  Only
 /// DirManager should call this method.
 void BlockFile::Ref()
 {
+   ODLocker locker(sRefLock);
    mRefCount++;
    BLOCKFILE_DEBUG_OUTPUT("Ref", mRefCount);
 }
@@ -170,20 +193,21 @@ void BlockFile::Ref()
 /// file and deletes this object
 bool BlockFile::Deref()
 {
-   mRefCount--;
-   BLOCKFILE_DEBUG_OUTPUT("Deref", mRefCount);
-   if (mRefCount <= 0) {
+   int refCount;
+   {
+      // Blocks shared between tracks may be released by effects
+      // processing several tracks at once
+      ODLocker locker(sRefLock);
+      refCount = --mRefCount;
+   }
+   BLOCKFILE_DEBUG_OUTPUT("Deref", refCount);
+   if (refCount <= 0) {
       delete this;
       return true;
    } else
       return false;
 }
 
-void BlockFile::Deinit()
-{
-   if(fullSummary)delete[] fullSummary;
-}
-
 /// Get a buffer containing a summary block describing this sample
 /// data.  This must be called by derived classes when they
 /// are constructed, to allow them to construct their summary data,
@@ -192,8 +216,9 @@ void BlockFile::Deinit()
 /// This method also has the side effect of setting the mMin, mMax,
 /// and mRMS members of this class.
 ///
-/// You must not delete the returned buffer; it is static to this
-/// method.
+/// The caller must delete[] the returned buffer.  Blocks may be made
+/// on several threads at once, as by effects and imports running on the
+/// WorkerPool, so no buffer is shared between calls.
 ///
 /// @param buffer A buffer containing the sample data to be analyzed
 /// @param len    The length of the sample data
@@ -201,8 +226,7 @@ void BlockFile::Deinit()
 void *BlockFile::CalcSummary(samplePtr buffer, sampleCount len,
                              sampleFormat format)
 {
-   if(fullSummary)delete[] fullSummary;
-   fullSummary = new char[mSummaryInfo.totalSummaryBytes];
+   char *fullSummary = new char[mSummaryInfo.totalSummaryBytes];
 
    memcpy(fullSummary, headerTag, headerTagLen);
 
@@ -333,6 +357,28 @@ static void ComputeMinMax256(float *summary256,
    *outBads = bad;
 }
 
+/// Whether summary data, as read from disk, carries the header tag and
+/// needs no byte-swapping by FixSummary()
+bool BlockFile::IsSummaryNative(const void *data)
+{
+   if (memcmp(data, headerTag, headerTagLen))
+      return false;
+
+   if (mSummaryInfo.format != floatSample ||
+       mSummaryInfo.fields != 3)
+      return true;
+
+   float *summary64K = (float *)((char *)data + mSummaryInfo.offset64K);
+   float *summary256 = (float *)((char *)data + mSummaryInfo.offset256);
+
+   float min, max;
+   int bad;
+
+   ComputeMinMax256(summary256, &min, &max, &bad);
+
+   return min == summary64K[0] && max == summary64K[1] && bad == 0;
+}
+
 /// Byte-swap the summary data, in case it was saved by a system
 /// on a different platform
 void BlockFile::FixSummary(void *data)
@@ -506,6 +552,175 @@ bool BlockFile::Read64K(float *buffer,
    return true;
 }
 
+sampleCount BlockFile::GetSummaryDivisor(int level)
+{
+   sampleCount divisor = 256;
+   for (int i = 0; i < level; i++)
+      divisor *= sSummaryLevelFactor;
+   return divisor;
+}
+
+void BlockFile::SetSummaryLevelFactor(int factor)
+{
+   // 64K = 256 * factor^n must hold for some n
+   if (factor != 2 && factor != 4 && factor != 16 && factor != 256)
+      factor = 16;
+   sSummaryLevelFactor = factor;
+}
+
+int BlockFile::GetSummaryLevelFactor()
+{
+   return sSummaryLevelFactor;
+}
+
+sampleCount BlockFile::GetSummaryFrames(int level)
+{
+   sampleCount divisor = GetSummaryDivisor(level);
+   return (mLen + divisor - 1) / divisor;
+}
+
+/// Finds where each level of the summary pyramid starts, in floats,
+/// when the levels are laid out one after another from level 1 up to
+/// the first with a single frame.  Returns the total number of floats.
+int BlockFile::GetSummaryPyramidLayout(int factor, std::vector<int> &offsets)
+{
+   offsets.clear();
+
+   int total = 0;
+   sampleCount divisor = 256;
+   sampleCount frames;
+   do {
+      divisor *= factor;
+      frames = (mLen + divisor - 1) / divisor;
+      offsets.push_back(total);
+      total += frames * 3;
+   } while (frames > 1);
+
+   return total;
+}
+
+/// Builds levels 1 and up of the summary pyramid from the 256-sample
+/// summary, weighting each frame by the number of samples it really
+/// covers so that the partial frame at the end of the block doesn't
+/// dilute the RMS.
+bool BlockFile::BuildSummaryPyramid(int factor,
+                                    const std::vector<int> &offsets,
+                                    std::vector<float> &pyramid)
+{
+   if (mLen <= 0 || !IsSummaryAvailable())
+      return false;
+
+   sampleCount frames256 = GetSummaryFrames(0);
+   std::vector<float> level0(frames256 * 3);
+   if (!Read256(&level0[0], 0, frames256))
+      return false;
+
+   std::vector<int> layout;
+   pyramid.resize(GetSummaryPyramidLayout(factor, layout));
+
+   const float *below = &level0[0];
+   sampleCount belowFrames = frames256;
+   sampleCount belowDivisor = 256;
+   for (size_t i = 0; i < offsets.size(); i++) {
+      float *out = &pyramid[offsets[i]];
+      sampleCount outDivisor = belowDivisor * factor;
+      sampleCount outFrames = (mLen + outDivisor - 1) / outDivisor;
+
+      for (sampleCount k = 0; k < outFrames; k++) {
+         float min = FLT_MAX;
+         float max = -FLT_MAX;
+         double sumsq = 0;
+         sampleCount count = 0;
+
+         sampleCount j0 = k * factor;
+         sampleCount j1 = std::min(j0 + factor, belowFrames);
+         for (sampleCount j = j0; j < j1; j++) {
+            sampleCount n = std::min(belowDivisor, mLen - j * belowDivisor);
+            const float *v = below + 3 * j;
+            if (v[0] < min)
+               min = v[0];
+            if (v[1] > max)
+               max = v[1];
+            sumsq += (double)v[2] * v[2] * n;
+            count += n;
+         }
+
+         out[3 * k] = min;
+         out[3 * k + 1] = max;
+         out[3 * k + 2] = count > 0 ? (float)sqrt(sumsq / count) : 0.0f;
+      }
+
+      below = out;
+      belowFrames = outFrames;
+      belowDivisor = outDivisor;
+   }
+
+   return true;
+}
+
+bool BlockFile::GetWaveformCacheKey(WaveformCacheKey *key)
+{
+   wxFileName fileName = GetFileName();
+   if (!fileName.HasName())
+      return false;
+
+   key->name = fileName.GetFullName();
+   key->factor = sSummaryLevelFactor;
+   key->len = mLen;
+   GetMinMax(&key->min, &key->max, &key->rms);
+   return true;
+}
+
+/// Retrieves a portion of any level of the summary pyramid.
+///
+/// @param level   The level of the pyramid; see GetSummaryDivisor()
+/// @param *buffer The area where the summary information will be
+///                written.  It must be at least len*3 long.
+/// @param start   The offset in frames of that level
+/// @param len     The number of frames to read
+bool BlockFile::ReadSummaryLevel(int level, float *buffer,
+                                 sampleCount start, sampleCount len)
+{
+   wxASSERT(start >= 0);
+
+   if (level <= 0)
+      return Read256(buffer, start, len);
+
+   const int factor = sSummaryLevelFactor;
+   std::vector<int> offsets;
+   GetSummaryPyramidLayout(factor, offsets);
+
+   // Above the top, the single frame of the top level is the answer
+   if (level > (int)offsets.size())
+      level = offsets.size();
+
+   sampleCount frames = GetSummaryFrames(level);
+   if (start + len > frames)
+      len = frames - start;
+   if (len <= 0)
+      return false;
+
+   const size_t offset = offsets[level - 1] + 3 * start;
+   const size_t count = 3 * len;
+
+   WaveformCacheKey key;
+   bool cacheable = GetWaveformCacheKey(&key);
+   if (cacheable &&
+       WaveformCache::Get().Read(key, offset, count, buffer))
+      return true;
+
+   std::vector<float> pyramid;
+   if (!BuildSummaryPyramid(factor, offsets, pyramid))
+      return false;
+
+   memcpy(buffer, &pyramid[offset], count * sizeof(float));
+
+   if (cacheable)
+      WaveformCache::Get().Store(key, pyramid);
+
+   return true;
+}
+
 /// Constructs an AliasBlockFile based on the given information about
 /// the aliased file.
 ///
@@ -586,6 +801,7 @@ void AliasBlockFile::WriteSummary()
    summaryFile.Write(summaryData, mSummaryInfo.totalSummaryBytes);
 
    DeleteSamples(sampleData);
+   delete [] (char *) summaryData;
 }
 
 AliasBlockFile::~AliasBlockFile()
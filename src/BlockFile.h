@@ -16,7 +16,11 @@
 #include <wx/ffile.h>
 #include <wx/filename.h>
 
+#include <vector>
+
 #include "WaveTrack.h"
+#include "WaveformCache.h"
+#include "ondemand/ODTaskThread.h"
 
 #include "xml/XMLTagHandler.h"
 #include "xml/XMLWriter.h"
@@ -47,8 +51,6 @@ class BlockFile {
    BlockFile(wxFileName fileName, sampleCount samples);
    virtual ~BlockFile();
 
-   static void Deinit();
-
    // Reading
 
    /// Retrieves audio data from this BlockFile
@@ -77,6 +79,12 @@ class BlockFile {
    virtual sampleCount GetLength() { return mLen; }
    virtual void SetLength(const sampleCount newLen) { mLen = newLen; }
 
+   /// Block files are numbered in the order they are made, so one
+   /// numbered at or above what GetNextSerial() returned at some time
+   /// was made after that time.
+   wxLongLong_t GetSerial() const { return mSerial; }
+   static wxLongLong_t GetNextSerial();
+
    /// Locks this BlockFile, to prevent it from being moved
    virtual void Lock();
    /// Unlock this BlockFile, allowing it to be moved
@@ -94,9 +102,35 @@ class BlockFile {
    /// Returns the 64K summary data block
    virtual bool Read64K(float *buffer, sampleCount start, sampleCount len);
 
+   /// Number of samples summarized by one frame of the given level of the
+   /// summary pyramid.  Level 0 is the 256-sample summary stored on disk;
+   /// each level above it is GetSummaryLevelFactor() times coarser.
+   static sampleCount GetSummaryDivisor(int level);
+   /// How much coarser each level of the summary pyramid is than the one
+   /// below it: 2, 4, 16 or 256, so that 64K is always one of the levels
+   static void SetSummaryLevelFactor(int factor);
+   static int GetSummaryLevelFactor();
+   /// Number of frames of the given summary level this block has
+   sampleCount GetSummaryFrames(int level);
+   /// Reads min, max and rms triples from any level of the summary
+   /// pyramid.  Levels above 0 are built from level 0 the first time
+   /// they are asked for and kept in the WaveformCache, so existing
+   /// summary files work unchanged.
+   virtual bool ReadSummaryLevel(int level, float *buffer,
+                                 sampleCount start, sampleCount len);
+
+   /// Identifies this block's samples to the WaveformCache.  Returns
+   /// false for blocks with no file of their own, which have nothing
+   /// worth caching.
+   virtual bool GetWaveformCacheKey(WaveformCacheKey *key);
+
    /// Returns TRUE if this block references another disk file
    virtual bool IsAlias() { return false; }
 
+   /// Returns TRUE if this block is a record in a shared container
+   /// rather than a disk file of its own
+   virtual bool IsPacked() { return false; }
+
    /// Returns TRUE if this block's complete summary has been computed and is ready (for OD)
    virtual bool IsSummaryAvailable(){return true;}
 
@@ -155,11 +189,23 @@ class BlockFile {
    /// on a different platform
    virtual void FixSummary(void *data);
 
+   /// Whether summary data read from disk is as this machine wrote it
+   bool IsSummaryNative(const void *data);
+
  private:
    int mLockCount;
    int mRefCount;
+   wxLongLong_t mSerial;
+
+   static wxLongLong_t sNextSerial;
+   static ODLock sSerialLock;
+   static ODLock sRefLock;
+
+   static int sSummaryLevelFactor;
 
-   static char *fullSummary;
+   int GetSummaryPyramidLayout(int factor, std::vector<int> &offsets);
+   bool BuildSummaryPyramid(int factor, const std::vector<int> &offsets,
+                            std::vector<float> &pyramid);
 
  protected:
    wxFileName mFileName;
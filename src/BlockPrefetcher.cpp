@@ -0,0 +1,237 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockPrefetcher.cpp
+
+*******************************************************************//**
+
+\class BlockPrefetcher
+\brief Reads the blocks a project is about to need into memory on a
+thread of its own, so that playback and export need not wait on disk.
+
+Sequence::Get() asks for the blocks after those it read whenever it is
+called where the previous call left off, as playback, export and
+effects do, and takes any block it finds here from memory.  Blocks never
+change once written, so the samples are kept under the block name until
+DirManager releases that name, or until the least recently used are
+dropped to stay within the budget.
+
+*//****************************************************************//**
+
+\class BlockPrefetchThread
+\brief The thread of a BlockPrefetcher.
+
+*//*******************************************************************/
+
+#include "BlockPrefetcher.h"
+
+#include <string.h>
+
+#include <wx/log.h>
+#include <wx/thread.h>
+
+#include "BlockFile.h"
+#include "DirManager.h"
+
+// Requests beyond this many are ignored until some are done
+static const size_t sMaxQueued = 64;
+
+class BlockPrefetchThread : public wxThread
+{
+ public:
+   BlockPrefetchThread(BlockPrefetcher *prefetcher)
+      : wxThread(wxTHREAD_JOINABLE), mPrefetcher(prefetcher) {}
+
+   virtual ExitCode Entry()
+   {
+      mPrefetcher->ThreadLoop();
+      return 0;
+   }
+
+ private:
+   BlockPrefetcher *mPrefetcher;
+};
+
+size_t BlockPrefetcher::sBudget = 32 * 1048576;
+
+void BlockPrefetcher::SetBudget(size_t bytes)
+{
+   sBudget = bytes;
+}
+
+size_t BlockPrefetcher::GetBudget()
+{
+   return sBudget;
+}
+
+BlockPrefetcher::BlockPrefetcher(DirManager *dirManager)
+{
+   mDirManager = dirManager;
+   mThread = NULL;
+   mRequestAvailable = new ODCondition(&mLock);
+   mUsage = 0;
+   mQuit = false;
+   mHits = 0;
+   mMisses = 0;
+   mPrefetched = 0;
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+   mLock.Lock();
+   mQuit = true;
+   mRequestAvailable->Broadcast();
+   mLock.Unlock();
+
+   if (mThread) {
+      mThread->Wait();
+      delete mThread;
+   }
+
+   for (size_t i = 0; i < mQueue.size(); i++)
+      mDirManager->Deref(mQueue[i].f);
+
+   delete mRequestAvailable;
+
+   if (mHits + mMisses > 0)
+      wxLogDebug(wxT("BlockPrefetcher: %ld hits, %ld misses, %ld blocks read ahead"),
+                 mHits, mMisses, mPrefetched);
+}
+
+bool BlockPrefetcher::Read(BlockFile *f, samplePtr buffer, sampleFormat format,
+                           sampleCount start, sampleCount len)
+{
+   wxString name = f->GetFileName().GetName();
+   if (name.IsEmpty())
+      return false;
+
+   ODLocker locker(mLock);
+
+   EntryMap::iterator it = mEntries.find(name);
+   if (it == mEntries.end() || start + len > it->second.len) {
+      mMisses++;
+      return false;
+   }
+
+   Entry &entry = it->second;
+   CopySamples((samplePtr)&entry.data[start * SAMPLE_SIZE(entry.format)],
+               entry.format, buffer, format, len);
+
+   mLRU.splice(mLRU.begin(), mLRU, entry.lru);
+   mHits++;
+
+   return true;
+}
+
+void BlockPrefetcher::Prefetch(BlockFile *f, sampleFormat format)
+{
+   if (sBudget == 0 || !f->IsDataAvailable())
+      return;
+
+   // Silent blocks have no file, and nothing to read
+   wxString name = f->GetFileName().GetName();
+   if (name.IsEmpty())
+      return;
+
+   ODLocker locker(mLock);
+
+   if (mQuit || mQueue.size() >= sMaxQueued ||
+       mPending.count(name) || mEntries.count(name))
+      return;
+
+   if (!mThread) {
+      mThread = new BlockPrefetchThread(this);
+      if (mThread->Create() != wxTHREAD_NO_ERROR) {
+         delete mThread;
+         mThread = NULL;
+         return;
+      }
+      mThread->Run();
+   }
+
+   Request request;
+   request.f = f;
+   request.name = name;
+   request.format = format;
+
+   mDirManager->Ref(f);
+   mQueue.push_back(request);
+   mPending.insert(name);
+   mRequestAvailable->Signal();
+}
+
+void BlockPrefetcher::Forget(const wxString &name)
+{
+   ODLocker locker(mLock);
+
+   EntryMap::iterator it = mEntries.find(name);
+   if (it == mEntries.end())
+      return;
+
+   mUsage -= it->second.data.size();
+   mLRU.erase(it->second.lru);
+   mEntries.erase(it);
+}
+
+void BlockPrefetcher::GetStats(long *hits, long *misses, long *prefetched)
+{
+   ODLocker locker(mLock);
+   *hits = mHits;
+   *misses = mMisses;
+   *prefetched = mPrefetched;
+}
+
+void BlockPrefetcher::ThreadLoop()
+{
+   mLock.Lock();
+
+   while (!mQuit) {
+      if (mQueue.empty()) {
+         mRequestAvailable->Wait();
+         continue;
+      }
+
+      Request request = mQueue.front();
+      mQueue.pop_front();
+      mLock.Unlock();
+
+      sampleCount len = request.f->GetLength();
+      std::vector<char> data(len * SAMPLE_SIZE(request.format));
+      bool ok = len > 0 &&
+         request.f->ReadData((samplePtr)&data[0], request.format, 0, len) == len;
+
+      mLock.Lock();
+      mPending.erase(request.name);
+      if (ok && sBudget > 0 && !mEntries.count(request.name)) {
+         Entry &entry = mEntries[request.name];
+         entry.data.swap(data);
+         entry.format = request.format;
+         entry.len = len;
+         mLRU.push_front(request.name);
+         entry.lru = mLRU.begin();
+         mUsage += entry.data.size();
+         mPrefetched++;
+         Trim();
+      }
+      mLock.Unlock();
+
+      // Only now, so that if this was the last reference, Forget() comes
+      // after the entry is made
+      mDirManager->Deref(request.f);
+
+      mLock.Lock();
+   }
+
+   mLock.Unlock();
+}
+
+void BlockPrefetcher::Trim()
+{
+   while (mUsage > sBudget && !mLRU.empty()) {
+      EntryMap::iterator it = mEntries.find(mLRU.back());
+      mUsage -= it->second.data.size();
+      mEntries.erase(it);
+      mLRU.pop_back();
+   }
+}
@@ -0,0 +1,95 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockPrefetcher.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_PREFETCHER__
+#define __AUDACITY_BLOCK_PREFETCHER__
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "Audacity.h"
+#include "SampleFormat.h"
+#include "ondemand/ODTaskThread.h"
+
+class BlockFile;
+class DirManager;
+class BlockPrefetchThread;
+
+class AUDACITY_DLL_API BlockPrefetcher
+{
+ public:
+   BlockPrefetcher(DirManager *dirManager);
+   ~BlockPrefetcher();
+
+   /// Memory the samples read ahead may use in each project; zero turns
+   /// reading ahead off
+   static void SetBudget(size_t bytes);
+   static size_t GetBudget();
+
+   /// Copies len samples from start of f into buffer as format, if f was
+   /// read ahead, and counts a hit; otherwise counts a miss and returns
+   /// false.
+   bool Read(BlockFile *f, samplePtr buffer, sampleFormat format,
+             sampleCount start, sampleCount len);
+
+   /// Has f read into memory as format on the prefetch thread, unless it
+   /// is there or on the way already
+   void Prefetch(BlockFile *f, sampleFormat format);
+
+   /// Drops the samples kept for a block name that is no longer in use,
+   /// as it may be given to a new block
+   void Forget(const wxString &name);
+
+   void GetStats(long *hits, long *misses, long *prefetched);
+
+ private:
+   friend class BlockPrefetchThread;
+   void ThreadLoop();
+
+   struct Request {
+      BlockFile *f;        // with a reference held until it is read
+      wxString name;
+      sampleFormat format;
+   };
+
+   struct Entry {
+      std::vector<char> data;
+      sampleFormat format;
+      sampleCount len;
+      std::list<wxString>::iterator lru;
+   };
+   typedef std::map<wxString, Entry> EntryMap;
+
+   void Trim();
+
+   static size_t sBudget;
+
+   DirManager *mDirManager;
+   BlockPrefetchThread *mThread;   // started on the first request
+
+   // Everything below is guarded by mLock
+   ODLock mLock;
+   ODCondition *mRequestAvailable;
+   std::deque<Request> mQueue;
+   std::set<wxString> mPending;    // names queued or being read
+   EntryMap mEntries;
+   std::list<wxString> mLRU;       // most recently used first
+   size_t mUsage;
+   bool mQuit;
+
+   long mHits;
+   long mMisses;
+   long mPrefetched;
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  CPUFeatures.cpp
+
+*******************************************************************//*!
+
+\file CPUFeatures.cpp
+\brief Finds out at run time which SIMD instruction sets may be used,
+for the code that has versions for several of them.
+
+*//*******************************************************************/
+
+#include "CPUFeatures.h"
+
+#if !defined(AUDACITY_X86_SIMD)
+
+SIMDLevel GetSIMDLevel()
+{
+   return SIMD_NONE;
+}
+
+#else
+
+#if !defined(_MSC_VER)
+   #include <cpuid.h>
+#endif
+
+static void CPUID(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuidex(info, leaf, subleaf);
+   for (int i = 0; i < 4; i++)
+      regs[i] = (unsigned int)info[i];
+#else
+   __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register state the operating system saves on task switches
+static unsigned int XGETBV0()
+{
+#if defined(_MSC_VER)
+   return (unsigned int)_xgetbv(0);
+#else
+   unsigned int eax, edx;
+   __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+   return eax;
+#endif
+}
+
+static SIMDLevel DetectSIMDLevel()
+{
+   unsigned int regs[4];
+
+   CPUID(0, 0, regs);
+   unsigned int maxLeaf = regs[0];
+   if (maxLeaf < 1)
+      return SIMD_NONE;
+
+   CPUID(1, 0, regs);
+   bool sse2 = (regs[3] & (1u << 26)) != 0;
+   bool osxsave = (regs[2] & (1u << 27)) != 0;
+   bool avx = (regs[2] & (1u << 28)) != 0;
+   if (!sse2)
+      return SIMD_NONE;
+
+   // AVX registers are only usable if the OS preserves them
+   if (maxLeaf >= 7 && osxsave && avx && (XGETBV0() & 6) == 6) {
+      CPUID(7, 0, regs);
+      if (regs[1] & (1u << 5))
+         return SIMD_AVX2;
+   }
+
+   return SIMD_SSE2;
+}
+
+SIMDLevel GetSIMDLevel()
+{
+   // Detecting twice in a race is harmless
+   static int sLevel = -1;
+   if (sLevel < 0)
+      sLevel = DetectSIMDLevel();
+   return (SIMDLevel)sLevel;
+}
+
+#endif
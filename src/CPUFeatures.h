@@ -0,0 +1,38 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  CPUFeatures.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_CPU_FEATURES__
+#define __AUDACITY_CPU_FEATURES__
+
+#include "Audacity.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define AUDACITY_X86_SIMD
+#endif
+
+#if defined(AUDACITY_X86_SIMD)
+   #include <immintrin.h>
+
+   // Compiles one function for an instruction set beyond the build's
+   // baseline, so that it can be chosen at run time with GetSIMDLevel().
+   // MSVC takes the intrinsics anywhere without being told.
+   #if defined(_MSC_VER)
+      #include <intrin.h>
+      #define SIMD_TARGET(isa)
+   #else
+      #define SIMD_TARGET(isa) __attribute__((target(isa)))
+   #endif
+#endif
+
+enum SIMDLevel { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 };
+
+/// The widest of the instruction sets above that both the processor and
+/// the operating system support.  Always SIMD_NONE on other processors.
+AUDACITY_DLL_API SIMDLevel GetSIMDLevel();
+
+#endif
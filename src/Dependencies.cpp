@@ -55,9 +55,12 @@ WX_DECLARE_HASH_MAP(BlockFile *, bool,
 
 // Given a project, returns a single array of all SeqBlocks
 // in the current set of tracks.  Enumerating that array allows
-// you to process all block files in the current set.
+// you to process all block files in the current set.  Pass
+// forWriting if you will change the SeqBlocks, as the blocks
+// of the current tracks may be shared with undo states.
 static void GetAllSeqBlocks(AudacityProject *project,
-                            BlockArray *outBlocks)
+                            BlockArray *outBlocks,
+                            bool forWriting = false)
 {
    TrackList *tracks = project->GetTracks();
    TrackListIterator iter(tracks);
@@ -69,7 +72,8 @@ static void GetAllSeqBlocks(AudacityProject *project,
          while(node) {
             WaveClip *clip = node->GetData();
             Sequence *sequence = clip->GetSequence();
-            BlockArray *blocks = sequence->GetBlockArray();
+            BlockArray *blocks = forWriting ?
+               sequence->GetUnsharedBlockArray() : sequence->GetBlockArray();
             int i;
             for (i = 0; i < (int)blocks->GetCount(); i++)
                outBlocks->Add(blocks->Item(i));
@@ -90,7 +94,7 @@ static void ReplaceBlockFiles(AudacityProject *project,
 {
    DirManager *dirManager = project->GetDirManager();
    BlockArray blocks;
-   GetAllSeqBlocks(project, &blocks);
+   GetAllSeqBlocks(project, &blocks, true);
 
    int i;
    for (i = 0; i < (int)blocks.GetCount(); i++) {
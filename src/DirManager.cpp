@@ -94,7 +94,11 @@
 #include "blockfile/PCMAliasBlockFile.h"
 #include "blockfile/ODPCMAliasBlockFile.h"
 #include "blockfile/ODDecodeBlockFile.h"
+#include "blockfile/PackedBlockFile.h"
+#include "blockfile/MappedBlockCache.h"
 #include "DirManager.h"
+#include "WaveformCache.h"
+#include "BlockPrefetcher.h"
 #include "Internat.h"
 #include "Project.h"
 #include "Prefs.h"
@@ -350,6 +354,13 @@ DirManager::DirManager()
    mLoadingTarget = NULL;
    mMaxSamples = -1;
 
+   mUsePackedBlocks = false;
+   if (gPrefs)
+      gPrefs->Read(wxT("/Directories/PackedBlockFiles"), &mUsePackedBlocks, false);
+   mPackedStore.SetDirectory(mytemp);
+
+   mPrefetcher = new BlockPrefetcher(this);
+
    // toplevel pool hash is fully populated to begin
    {
       int i;
@@ -370,6 +381,8 @@ DirManager::~DirManager()
 {
    wxASSERT(mRef == 0); // MM: Otherwise, we shouldn't delete it
 
+   delete mPrefetcher;
+
    numDirManagers--;
    if (numDirManagers == 0) {
       CleanTempDir();
@@ -449,14 +462,21 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
    int total = mBlockFileHash.size();
    int count=0;
 
+   // Packed blocks move with their containers, which must be copied
+   // instead if any of them belongs to the old project
+   bool copyPacked = false;
+
    BlockHash::iterator iter = mBlockFileHash.begin();
    bool success = true;
    while ((iter != mBlockFileHash.end()) && success)
    {
       BlockFile *b = iter->second;
 
-      if (b->IsLocked())
+      if (b->IsLocked()) {
          success = CopyToNewProjectDirectory(b);
+         if (b->IsPacked())
+            copyPacked = true;
+      }
       else{
          success = MoveToNewProjectDirectory(b);
       }
@@ -467,6 +487,9 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       count++;
    }
 
+   if (success)
+      success = mPackedStore.MoveToDirectory(projFull, copyPacked);
+
    if (!success) {
       // If the move failed, we try to move/copy as many files
       // back as possible so that no damage was done.  (No sense
@@ -521,6 +544,9 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       if (count > 0)
          RecursivelyRemove(dirlist, count, false, true, _("Cleaning up cache directories"));
    }
+
+   LoadWaveformCache();
+
    return true;
 }
 
@@ -534,6 +560,35 @@ wxString DirManager::GetProjectName()
    return projName;
 }
 
+static wxString WaveformCacheFileName(const wxString &dataDir)
+{
+   return dataDir + wxFILE_SEP_PATH + wxT("waveform.cache");
+}
+
+void DirManager::LoadWaveformCache()
+{
+   if (projFull.IsEmpty())
+      return;
+
+   WaveformCache::Get().Load(WaveformCacheFileName(projFull));
+}
+
+void DirManager::SaveWaveformCache()
+{
+   if (projFull.IsEmpty())
+      return;
+
+   std::vector<WaveformCacheKey> keys;
+   BlockHash::iterator it;
+   for (it = mBlockFileHash.begin(); it != mBlockFileHash.end(); ++it) {
+      WaveformCacheKey key;
+      if (it->second && it->second->GetWaveformCacheKey(&key))
+         keys.push_back(key);
+   }
+
+   WaveformCache::Get().Save(WaveformCacheFileName(projFull), keys);
+}
+
 wxLongLong DirManager::GetFreeDiskSpace()
 {
    wxLongLong freeSpace = -1;
@@ -563,6 +618,7 @@ wxString DirManager::GetDataFilesDir() const
 void DirManager::SetLocalTempDir(wxString path)
 {
    mytemp = path;
+   mPackedStore.SetDirectory(GetDataFilesDir());
 }
 
 wxFileName DirManager::MakeBlockFilePath(wxString value){
@@ -869,32 +925,77 @@ wxFileName DirManager::MakeBlockFileName()
    return ret;
 }
 
+wxFileName DirManager::ReserveBlockFileName()
+{
+   ODLocker locker(mBlockFileHashLock);
+   wxFileName fileName = MakeBlockFileName();
+   mBlockFileHash[fileName.GetName()] = NULL;
+   return fileName;
+}
+
 BlockFile *DirManager::NewSimpleBlockFile(
                                  samplePtr sampleData, sampleCount sampleLen,
                                  sampleFormat format,
                                  bool allowDeferredWrite)
 {
-   wxFileName fileName = MakeBlockFileName();
+   // Appending to a container is already cheap enough that packed
+   // blocks have no use for the deferred write cache.
+   if (mUsePackedBlocks)
+      return NewPackedBlockFile(sampleData, sampleLen, format);
+
+   wxFileName fileName = ReserveBlockFileName();
 
    BlockFile *newBlockFile =
        new SimpleBlockFile(fileName, sampleData, sampleLen, format,
                            allowDeferredWrite);
 
+   ODLocker locker(mBlockFileHashLock);
    mBlockFileHash[fileName.GetName()]=newBlockFile;
 
    return newBlockFile;
 }
 
+BlockFile *DirManager::NewPackedBlockFile(
+                                 samplePtr sampleData, sampleCount sampleLen,
+                                 sampleFormat format)
+{
+   PackedBlockFile *packedBlockFile =
+       new PackedBlockFile(&mPackedStore, sampleData, sampleLen, format);
+
+   // Keep the samples in an .au file of their own if the container
+   // could not take them (a full disk, say, or too many open files)
+   if (!packedBlockFile->WasAppended()) {
+      delete packedBlockFile;
+
+      wxFileName fileName = ReserveBlockFileName();
+      BlockFile *newBlockFile =
+          new SimpleBlockFile(fileName, sampleData, sampleLen, format);
+
+      ODLocker locker(mBlockFileHashLock);
+      mBlockFileHash[fileName.GetName()]=newBlockFile;
+      return newBlockFile;
+   }
+
+   BlockFile *newBlockFile = packedBlockFile;
+
+   // No directory balancing: packed names never start with 'e'
+   ODLocker locker(mBlockFileHashLock);
+   mBlockFileHash[newBlockFile->GetFileName().GetName()]=newBlockFile;
+
+   return newBlockFile;
+}
+
 BlockFile *DirManager::NewAliasBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel)
 {
-   wxFileName fileName = MakeBlockFileName();
+   wxFileName fileName = ReserveBlockFileName();
 
    BlockFile *newBlockFile =
        new PCMAliasBlockFile(fileName,
                              aliasedFile, aliasStart, aliasLen, aliasChannel);
 
+   ODLocker locker(mBlockFileHashLock);
    mBlockFileHash[fileName.GetName()]=newBlockFile;
    aliasList.Add(aliasedFile);
 
@@ -905,12 +1006,13 @@ BlockFile *DirManager::NewODAliasBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel)
 {
-   wxFileName fileName = MakeBlockFileName();
+   wxFileName fileName = ReserveBlockFileName();
 
    BlockFile *newBlockFile =
        new ODPCMAliasBlockFile(fileName,
                              aliasedFile, aliasStart, aliasLen, aliasChannel);
 
+   ODLocker locker(mBlockFileHashLock);
    mBlockFileHash[fileName.GetName()]=newBlockFile;
    aliasList.Add(aliasedFile);
 
@@ -921,12 +1023,13 @@ BlockFile *DirManager::NewODDecodeBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel, int decodeType)
 {
-   wxFileName fileName = MakeBlockFileName();
+   wxFileName fileName = ReserveBlockFileName();
 
    BlockFile *newBlockFile =
        new ODDecodeBlockFile(fileName,
                              aliasedFile, aliasStart, aliasLen, aliasChannel, decodeType);
 
+   ODLocker locker(mBlockFileHashLock);
    mBlockFileHash[fileName.GetName()]=newBlockFile;
    aliasList.Add(aliasedFile); //OD TODO: check to see if we need to remove this when done decoding.
                                //I don't immediately see a place where aliased files remove when a file is closed.
@@ -954,15 +1057,22 @@ bool DirManager::ContainsBlockFile(wxString filepath) const
 // the BlockFile.
 BlockFile *DirManager::CopyBlockFile(BlockFile *b)
 {
-   if (!b->IsLocked()) {
+   // A packed block can't be moved into our directory on its own later,
+   // so one from another project is always copied into our store.
+   bool foreignPacked = b->IsPacked() &&
+      ((PackedBlockFile *)b)->GetStore() != &mPackedStore;
+
+   if (!b->IsLocked() && !foreignPacked) {
       b->Ref();
       //mchinen:July 13 2009 - not sure about this, but it needs to be added to the hash to be able to save if not locked.
       //note that this shouldn't hurt mBlockFileHash's that already contain the filename, since it should just overwrite.
       //but it's something to watch out for.
       //
       // LLL: Except for silent block files which have uninitialized filename.
-      if (b->GetFileName().IsOk())
+      if (b->GetFileName().IsOk()) {
+         ODLocker locker(mBlockFileHashLock);
          mBlockFileHash[b->GetFileName().GetName()]=b;
+      }
       return b;
    }
 
@@ -972,9 +1082,16 @@ BlockFile *DirManager::CopyBlockFile(BlockFile *b)
       // Block files with uninitialized filename (i.e. SilentBlockFile)
       // just need an in-memory copy.
       b2 = b->Copy(wxFileName());
+   else if (b->IsPacked())
+   {
+      // The copy becomes a new record; the store names it
+      b2 = ((PackedBlockFile *)b)->CopyTo(&mPackedStore);
+      ODLocker locker(mBlockFileHashLock);
+      mBlockFileHash[b2->GetFileName().GetName()]=b2;
+   }
    else
    {
-      wxFileName newFile = MakeBlockFileName();
+      wxFileName newFile = ReserveBlockFileName();
 
       // We assume that the new file should have the same extension
       // as the existing file
@@ -986,13 +1103,19 @@ BlockFile *DirManager::CopyBlockFile(BlockFile *b)
       {
          if( !wxCopyFile(b->GetFileName().GetFullPath(),
                   newFile.GetFullPath()) )
-            return NULL;
+            b2 = NULL;
+         else
+            b2 = b->Copy(newFile);
       }
+      else
+         b2 = b->Copy(newFile);
 
-      b2 = b->Copy(newFile);
-
-      if (b2 == NULL)
+      ODLocker locker(mBlockFileHashLock);
+      if (b2 == NULL) {
+         mBlockFileHash.erase(newFile.GetName());
+         BalanceInfoDel(newFile.GetName());
          return NULL;
+      }
 
       mBlockFileHash[newFile.GetName()]=b2;
       aliasList.Add(newFile.GetFullPath());
@@ -1016,6 +1139,8 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    }
    else if ( !wxStricmp(tag, wxT("simpleblockfile")) )
       pBlockFile = SimpleBlockFile::BuildFromXML(*this, attrs);
+   else if ( !wxStricmp(tag, wxT("packedblockfile")) )
+      pBlockFile = PackedBlockFile::BuildFromXML(*this, attrs);
    else if( !wxStricmp(tag, wxT("pcmaliasblockfile")) )
       pBlockFile = PCMAliasBlockFile::BuildFromXML(*this, attrs);
    else if( !wxStricmp(tag, wxT("odpcmaliasblockfile")) )
@@ -1085,8 +1210,10 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    BlockFile *retrieved = mBlockFileHash[name];
    if (retrieved) {
       // Lock it in order to delete it safely, i.e. without having
-      // it delete the file, too...
-      (*mLoadingTarget)->Lock();
+      // it delete the file, too...  A packed block deletes nothing, and
+      // locking it would keep its container from ever being removed.
+      if (!(*mLoadingTarget)->IsPacked())
+         (*mLoadingTarget)->Lock();
       delete (*mLoadingTarget);
 
       Ref(retrieved); // Add one to its reference count
@@ -1112,6 +1239,10 @@ bool DirManager::MoveOrCopyToNewProjectDirectory(BlockFile *f, bool copy)
       return true;
    }
 
+   // Packed blocks are moved along with their containers in SetProject()
+   if (f->IsPacked())
+      return true;
+
    wxFileName newFileName;
    wxFileName oldFileName=f->GetFileName();
    if (!this->AssignFile(newFileName, f->GetFileName().GetFullName(), false))
@@ -1121,6 +1252,9 @@ bool DirManager::MoveOrCopyToNewProjectDirectory(BlockFile *f, bool copy)
       //check to see that summary exists before we copy.
       bool summaryExisted = f->IsSummaryAvailable();
       if (summaryExisted) {
+         // A mapping would keep the old file busy on Windows
+         if (!copy)
+            MappedBlockCache::Get().Invalidate(f->GetFileName().GetFullPath());
          if(!copy && !wxRenameFile(f->GetFileName().GetFullPath(), newFileName.GetFullPath()))
             return false;
          if(copy && !wxCopyFile(f->GetFileName().GetFullPath(), newFileName.GetFullPath()))
@@ -1189,9 +1323,14 @@ void DirManager::Deref(BlockFile * f)
       // and this block is no longer needed.  Remove it from the hash
       // table.
 
-      mBlockFileHash.erase(theFileName);
-      BalanceInfoDel(theFileName);
+      {
+         ODLocker locker(mBlockFileHashLock);
+         mBlockFileHash.erase(theFileName);
+         BalanceInfoDel(theFileName);
+      }
 
+      // The name may go to a new block now
+      mPrefetcher->Forget(theFileName);
    }
 }
 
@@ -1746,7 +1885,16 @@ void DirManager::FindMissingAUs(
    {
       wxString key = iter->first;
       BlockFile *b = iter->second;
-      if (!b->IsAlias())
+      if (b->IsPacked())
+      {
+         if (!((PackedBlockFile *)b)->IsRecordAvailable())
+         {
+            missingAUHash[key] = b;
+            wxLogWarning(_("Missing data block file: '%s'"),
+                           b->GetFileName().GetFullPath().c_str());
+         }
+      }
+      else if (!b->IsAlias())
       {
          wxFileName fileName = MakeBlockFilePath(key);
          fileName.SetName(key);
@@ -1762,7 +1910,7 @@ void DirManager::FindMissingAUs(
    }
 }
 
-// Find .au and .auf files that are not in the project.
+// Find .au, .auf and container files that are not in the project.
 void DirManager::FindOrphanBlockFiles(
       const wxArrayString& filePathArray,       // input: all files in project directory
       wxArrayString& orphanFilePathArray)       // output: orphan files
@@ -1794,6 +1942,9 @@ void DirManager::FindOrphanBlockFiles(
          if (!(clipboardDM && clipboardDM->ContainsBlockFile(basename)))
             orphanFilePathArray.Add(fullname.GetFullPath());
       }
+      else if (fullname.GetExt().IsSameAs(PackedBlockStore::GetContainerExt()) &&
+               !mPackedStore.IsKnownContainer(fullname.GetFullPath()))
+         orphanFilePathArray.Add(fullname.GetFullPath());
    }
    for (size_t i = 0; i < orphanFilePathArray.GetCount(); i++)
       wxLogWarning(_("Orphan block file: '%s'"), orphanFilePathArray[i].c_str());
@@ -17,9 +17,11 @@
 #include <wx/hashmap.h>
 
 #include "WaveTrack.h"
+#include "blockfile/PackedBlockStore.h"
 
 class wxHashTable;
 class BlockFile;
+class BlockPrefetcher;
 class SequenceTest;
 
 #define FSCKstatus_CLOSE_REQ 0x1
@@ -41,6 +43,7 @@ class DirManager: public XMLTagHandler {
    virtual ~DirManager();
 
    static void SetTempDir(wxString _temp) { globaltemp = _temp; }
+   static wxString GetTempDir() { return globaltemp; }
 
    // MM: Ref count mechanism for the DirManager itself
    void Ref();
@@ -61,6 +64,10 @@ class DirManager: public XMLTagHandler {
                                  sampleFormat format,
                                  bool allowDeferredWrite = false);
 
+   BlockFile *NewPackedBlockFile(samplePtr sampleData,
+                                 sampleCount sampleLen,
+                                 sampleFormat format);
+
    BlockFile *NewAliasBlockFile( wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel);
 
@@ -127,7 +134,7 @@ class DirManager: public XMLTagHandler {
          BlockHash& missingAUFHash);               // output: missing (.auf) AliasBlockFiles
    void FindMissingAUs(
          BlockHash& missingAUHash);                // missing data (.au) blockfiles
-   // Find .au and .auf files that are not in the project.
+   // Find .au, .auf and container files that are not in the project.
    void FindOrphanBlockFiles(
          const wxArrayString& filePathArray,       // input: all files in project directory
          wxArrayString& orphanFilePathArray);      // output: orphan files
@@ -156,9 +163,24 @@ class DirManager: public XMLTagHandler {
    // Fill cache of blockfiles, if caching is enabled (otherwise do nothing)
    void FillBlockfilesCache();
 
+   // Container store for PackedBlockFiles of this project
+   PackedBlockStore *GetPackedBlockStore() { return &mPackedStore; }
+
+   // Reads the blocks this project's sequences are about to need
+   BlockPrefetcher *GetPrefetcher() { return mPrefetcher; }
+
+   // Read the waveform summaries saved with the project, if any, into
+   // the WaveformCache
+   void LoadWaveformCache();
+   // Save the WaveformCache entries for the blocks of this project with it
+   void SaveWaveformCache();
+
  private:
 
    wxFileName MakeBlockFileName();
+   // Chooses a name with MakeBlockFileName and holds it in the hash,
+   // so that other threads making blocks don't take it too
+   wxFileName ReserveBlockFileName();
    wxFileName MakeBlockFilePath(wxString value);
 
    bool MoveOrCopyToNewProjectDirectory(BlockFile *f, bool copy);
@@ -166,6 +188,9 @@ class DirManager: public XMLTagHandler {
    int mRef; // MM: Current refcount
 
    BlockHash mBlockFileHash; // repository for blockfiles
+   // Guards mBlockFileHash, the dir pools and aliasList, as effects may
+   // make and release the blocks of several tracks at once
+   ODLock mBlockFileHashLock;
    DirHash   dirTopPool;    // available toplevel dirs
    DirHash   dirTopFull;    // full toplevel dirs
    DirHash   dirMidPool;    // available two-level dirs
@@ -190,6 +215,13 @@ class DirManager: public XMLTagHandler {
 
    sampleCount mMaxSamples; // max samples per block
 
+   // If true, NewSimpleBlockFile appends to mPackedStore instead of
+   // creating one .au file per block
+   bool mUsePackedBlocks;
+   PackedBlockStore mPackedStore;
+
+   BlockPrefetcher *mPrefetcher;
+
    static wxString globaltemp;
    wxString mytemp;
    static int numDirManagers;
@@ -208,6 +208,10 @@ Dither::Dither()
 {
     // On startup, initialize dither by resetting values
     Reset();
+
+    // Any nonzero, distinct seeds will do
+    for (int i = 0; i < 8; i++)
+        mRandState[i] = 0x9e3779b9u * (i + 1);
 }
 
 void Dither::Reset()
@@ -256,6 +260,11 @@ void Dither::Apply(enum DitherType ditherType,
     if (len == 0)
         return; // nothing to do
 
+    if (destFormat != sourceFormat &&
+        ApplySIMD(ditherType, source, sourceFormat, dest, destFormat,
+                  len, sourceStride, destStride))
+        return;
+
     if (destFormat == sourceFormat)
     {
         // No need to dither, because source and destination
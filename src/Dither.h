@@ -25,6 +25,15 @@ public:
     /// Reset state of the dither.
     void Reset();
 
+    /// Whether Apply() may use the vectorized conversions of
+    /// DitherSIMD.cpp on processors that support them.  On by default;
+    /// turned off to compare with the plain loops.
+    static void SetSIMDEnabled(bool enabled);
+    static bool IsSIMDEnabled();
+
+    /// Name of the instruction set Apply() uses, for information
+    static const wxChar *GetSIMDName();
+
     /// Apply the actual dithering. Expects the source sample in the
     /// 'source' variable, the destination sample in the 'dest' variable,
     /// and hints to the formats of the samples. Even if the sample formats
@@ -43,6 +52,15 @@ private:
     float TriangleDither(float sample);
     float ShapedDither(float sample);
 
+    // Vectorized conversion, in DitherSIMD.cpp.  Returns false if there
+    // is none for these formats or this processor.
+    bool ApplySIMD(DitherType ditherType,
+                   const samplePtr source, sampleFormat sourceFormat,
+                   samplePtr dest, sampleFormat destFormat,
+                   unsigned int len,
+                   unsigned int sourceStride,
+                   unsigned int destStride);
+
     // Dither constants
     static const int BUF_SIZE; /* = 8 */
     static const int BUF_MASK; /* = 7 */
@@ -52,6 +70,9 @@ private:
     int mPhase;
     float mTriangleState;
     float mBuffer[8 /* = BUF_SIZE */];
+
+    // State of the vectorizable noise generator, one per lane
+    unsigned int mRandState[8];
 };
 
 #endif /* __AUDACITY_DITHER_H__ */
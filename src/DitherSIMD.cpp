@@ -0,0 +1,572 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  DitherSIMD.cpp
+
+*******************************************************************//*!
+
+\file DitherSIMD.cpp
+\brief SSE2 and AVX2 versions of the conversions in Dither::Apply().
+
+  Converting between float and integer samples, with or without
+  dither, runs under every read of a track, every mix and every
+  export.  These versions convert four (SSE2) or eight (AVX2) samples
+  at a time, and are chosen at run time according to the processor.
+
+  Without dither the results are exactly those of the plain loops in
+  Dither.cpp: the same scaling, the same clipping to [-1, 1], rounding
+  to nearest even as lrintf does, and the same treatment of NaN.
+  Rectangle and triangle dither draw their noise from a xorshift
+  generator with one state per vector lane instead of from rand(),
+  which is both slow and impossible to vectorize.  Shaped dither feeds
+  each sample's rounding error into the next one, so it stays a
+  sample-by-sample loop, but takes its noise from the same generator.
+
+  Interleaved source or destination buffers are gathered into, or
+  scattered from, small contiguous buffers around the vector code.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+
+#include "float_cast.h"
+
+#include <string.h>
+
+#include <wx/defs.h>
+
+#include "CPUFeatures.h"
+#include "Dither.h"
+
+static bool sSIMDEnabled = true;
+
+void Dither::SetSIMDEnabled(bool enabled)
+{
+    sSIMDEnabled = enabled;
+}
+
+bool Dither::IsSIMDEnabled()
+{
+    return sSIMDEnabled;
+}
+
+#if defined(AUDACITY_X86_SIMD)
+#define DITHER_SIMD
+#endif
+
+#if !defined(DITHER_SIMD)
+
+const wxChar *Dither::GetSIMDName()
+{
+    return wxT("none");
+}
+
+bool Dither::ApplySIMD(DitherType WXUNUSED(ditherType),
+                       const samplePtr WXUNUSED(source),
+                       sampleFormat WXUNUSED(sourceFormat),
+                       samplePtr WXUNUSED(dest),
+                       sampleFormat WXUNUSED(destFormat),
+                       unsigned int WXUNUSED(len),
+                       unsigned int WXUNUSED(sourceStride),
+                       unsigned int WXUNUSED(destStride))
+{
+    return false;
+}
+
+#else
+
+const wxChar *Dither::GetSIMDName()
+{
+    if (!sSIMDEnabled)
+        return wxT("none");
+
+    switch (GetSIMDLevel()) {
+    case SIMD_AVX2:
+        return wxT("AVX2");
+    case SIMD_SSE2:
+        return wxT("SSE2");
+    default:
+        return wxT("none");
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Plain versions of one step, for the samples left over after the
+// vectors, computing exactly what the vector code does
+
+// Uniform noise in [-0.5, 0.5), like DITHER_NOISE in Dither.cpp
+static inline float NextNoise(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    // 23 random bits as the mantissa of a float in [1, 2)
+    union { unsigned int i; float f; } u;
+    u.i = (x >> 9) | 0x3f800000u;
+    return u.f - 1.5f;
+}
+
+static inline float ClipToUnit(float sample)
+{
+    // Same as FROM_FLOAT; NaN passes through
+    return sample > 1.0f ? 1.0f : sample < -1.0f ? -1.0f : sample;
+}
+
+static inline int StoreClipped(float sample, int minBound, int maxBound)
+{
+    int x = lrintf(sample);
+    return x > maxBound ? maxBound : x < minBound ? minBound : x;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SSE2
+
+// Four steps of the per-lane xorshift generator
+SIMD_TARGET("sse2")
+static inline __m128 NoiseSSE2(__m128i *state)
+{
+    __m128i x = *state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    *state = x;
+
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9),
+                                _mm_set1_epi32(0x3f800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.5f));
+}
+
+// Clip to [-1, 1], scale, add dither, and clip to [lo, hi].  NaN ends up
+// at lo, as lrintf gives INT_MIN for it, which is then clipped.
+SIMD_TARGET("sse2")
+static inline __m128i ScaleSSE2(__m128 x, __m128 scale, __m128 noise,
+                                __m128 lo, __m128 hi)
+{
+    x = _mm_min_ps(_mm_set1_ps(1.0f), x);
+    x = _mm_max_ps(_mm_set1_ps(-1.0f), x);
+    x = _mm_add_ps(_mm_mul_ps(x, scale), noise);
+    x = _mm_max_ps(x, lo);
+    x = _mm_min_ps(x, hi);
+    return _mm_cvtps_epi32(x);
+}
+
+template <int ditherType>
+SIMD_TARGET("sse2")
+static void FloatToIntSSE2(const float *src, void *dst, bool toInt16,
+                           unsigned int len,
+                           unsigned int *randState, float *triangleState)
+{
+    const float scaleValue = toInt16 ? float(1 << 15) : float(1 << 23);
+    const int maxBound = toInt16 ? 32767 : 8388607;
+    const int minBound = toInt16 ? -32768 : -8388608;
+    const __m128 scale = _mm_set1_ps(scaleValue);
+    const __m128 lo = _mm_set1_ps((float)minBound);
+    const __m128 hi = _mm_set1_ps((float)maxBound);
+
+    __m128i state = _mm_loadu_si128((const __m128i *)randState);
+    float prev = *triangleState;
+    unsigned int i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        __m128 noise = _mm_setzero_ps();
+        if (ditherType == Dither::rectangle)
+            noise = _mm_sub_ps(noise, NoiseSSE2(&state));
+        else if (ditherType == Dither::triangle) {
+            // r[i] - r[i-1], carrying the last r into the next vector
+            __m128 r = NoiseSSE2(&state);
+            __m128 shifted = _mm_castsi128_ps(
+               _mm_slli_si128(_mm_castps_si128(r), 4));
+            shifted = _mm_move_ss(shifted, _mm_set_ss(prev));
+            noise = _mm_sub_ps(r, shifted);
+            prev = _mm_cvtss_f32(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+
+        __m128i x = ScaleSSE2(_mm_loadu_ps(src + i), scale, noise, lo, hi);
+        if (toInt16)
+            _mm_storel_epi64((__m128i *)((short *)dst + i),
+                             _mm_packs_epi32(x, x));
+        else
+            _mm_storeu_si128((__m128i *)((int *)dst + i), x);
+    }
+
+    _mm_storeu_si128((__m128i *)randState, state);
+
+    for (; i < len; i++) {
+        float sample = ClipToUnit(src[i]) * scaleValue;
+        if (ditherType == Dither::rectangle)
+            sample -= NextNoise(&randState[0]);
+        else if (ditherType == Dither::triangle) {
+            float r = NextNoise(&randState[0]);
+            sample += r - prev;
+            prev = r;
+        }
+        int x = StoreClipped(sample, minBound, maxBound);
+        if (toInt16)
+            ((short *)dst)[i] = (short)x;
+        else
+            ((int *)dst)[i] = x;
+    }
+
+    *triangleState = prev;
+}
+
+SIMD_TARGET("sse2")
+static void Int16ToFloatSSE2(const short *src, float *dst, unsigned int len)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / float(1 << 15));
+    unsigned int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        // Sign extend by unpacking into the high halves and shifting down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+
+    for (; i < len; i++)
+        dst[i] = src[i] / float(1 << 15);
+}
+
+SIMD_TARGET("sse2")
+static void Int24ToFloatSSE2(const int *src, float *dst, unsigned int len)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / float(1 << 23));
+    unsigned int i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+    }
+
+    for (; i < len; i++)
+        dst[i] = src[i] / float(1 << 23);
+}
+
+SIMD_TARGET("sse2")
+static void Int16ToInt24SSE2(const short *src, int *dst, unsigned int len)
+{
+    unsigned int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        // Each word unpacked onto itself and shifted down by 8 is the
+        // sample times 256, with the low byte of the sample below it
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 8);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 8);
+        low = _mm_andnot_si128(_mm_set1_epi32(0xff), low);
+        high = _mm_andnot_si128(_mm_set1_epi32(0xff), high);
+        _mm_storeu_si128((__m128i *)(dst + i), low);
+        _mm_storeu_si128((__m128i *)(dst + i + 4), high);
+    }
+
+    for (; i < len; i++)
+        dst[i] = ((int)src[i]) << 8;
+}
+
+SIMD_TARGET("sse2")
+static void NoiseBlockSSE2(float *dst, unsigned int len, unsigned int *randState)
+{
+    __m128i state = _mm_loadu_si128((const __m128i *)randState);
+    unsigned int i = 0;
+
+    for (; i + 4 <= len; i += 4)
+        _mm_storeu_ps(dst + i, NoiseSSE2(&state));
+
+    _mm_storeu_si128((__m128i *)randState, state);
+
+    for (; i < len; i++)
+        dst[i] = NextNoise(&randState[0]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2
+
+SIMD_TARGET("avx2")
+static inline __m256 NoiseAVX2(__m256i *state)
+{
+    __m256i x = *state;
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    *state = x;
+
+    __m256i bits = _mm256_or_si256(_mm256_srli_epi32(x, 9),
+                                   _mm256_set1_epi32(0x3f800000));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.5f));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i ScaleAVX2(__m256 x, __m256 scale, __m256 noise,
+                                __m256 lo, __m256 hi)
+{
+    x = _mm256_min_ps(_mm256_set1_ps(1.0f), x);
+    x = _mm256_max_ps(_mm256_set1_ps(-1.0f), x);
+    x = _mm256_add_ps(_mm256_mul_ps(x, scale), noise);
+    x = _mm256_max_ps(x, lo);
+    x = _mm256_min_ps(x, hi);
+    return _mm256_cvtps_epi32(x);
+}
+
+template <int ditherType>
+SIMD_TARGET("avx2")
+static void FloatToIntAVX2(const float *src, void *dst, bool toInt16,
+                           unsigned int len,
+                           unsigned int *randState, float *triangleState)
+{
+    const float scaleValue = toInt16 ? float(1 << 15) : float(1 << 23);
+    const int maxBound = toInt16 ? 32767 : 8388607;
+    const int minBound = toInt16 ? -32768 : -8388608;
+    const __m256 scale = _mm256_set1_ps(scaleValue);
+    const __m256 lo = _mm256_set1_ps((float)minBound);
+    const __m256 hi = _mm256_set1_ps((float)maxBound);
+    // Rotates lanes up by one, lane 7 going to lane 0
+    const __m256i rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+
+    __m256i state = _mm256_loadu_si256((const __m256i *)randState);
+    float prev = *triangleState;
+    unsigned int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        __m256 noise = _mm256_setzero_ps();
+        if (ditherType == Dither::rectangle)
+            noise = _mm256_sub_ps(noise, NoiseAVX2(&state));
+        else if (ditherType == Dither::triangle) {
+            __m256 r = NoiseAVX2(&state);
+            __m256 rotated = _mm256_permutevar8x32_ps(r, rotate);
+            __m256 shifted = _mm256_blend_ps(rotated, _mm256_set1_ps(prev), 1);
+            noise = _mm256_sub_ps(r, shifted);
+            prev = _mm_cvtss_f32(_mm256_castps256_ps128(rotated));
+        }
+
+        __m256i x = ScaleAVX2(_mm256_loadu_ps(src + i), scale, noise, lo, hi);
+        if (toInt16) {
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(x),
+                                             _mm256_extracti128_si256(x, 1));
+            _mm_storeu_si128((__m128i *)((short *)dst + i), packed);
+        }
+        else
+            _mm256_storeu_si256((__m256i *)((int *)dst + i), x);
+    }
+
+    _mm256_storeu_si256((__m256i *)randState, state);
+    _mm256_zeroupper();
+
+    for (; i < len; i++) {
+        float sample = ClipToUnit(src[i]) * scaleValue;
+        if (ditherType == Dither::rectangle)
+            sample -= NextNoise(&randState[0]);
+        else if (ditherType == Dither::triangle) {
+            float r = NextNoise(&randState[0]);
+            sample += r - prev;
+            prev = r;
+        }
+        int x = StoreClipped(sample, minBound, maxBound);
+        if (toInt16)
+            ((short *)dst)[i] = (short)x;
+        else
+            ((int *)dst)[i] = x;
+    }
+
+    *triangleState = prev;
+}
+
+SIMD_TARGET("avx2")
+static void Int16ToFloatAVX2(const short *src, float *dst, unsigned int len)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / float(1 << 15));
+    unsigned int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        __m256i s = _mm256_cvtepi16_epi32(
+           _mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), scale));
+    }
+    _mm256_zeroupper();
+
+    for (; i < len; i++)
+        dst[i] = src[i] / float(1 << 15);
+}
+
+SIMD_TARGET("avx2")
+static void Int24ToFloatAVX2(const int *src, float *dst, unsigned int len)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / float(1 << 23));
+    unsigned int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), scale));
+    }
+    _mm256_zeroupper();
+
+    for (; i < len; i++)
+        dst[i] = src[i] / float(1 << 23);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Dispatch
+
+template <int ditherType>
+static void FloatToInt(SIMDLevel level, const float *src, void *dst,
+                       bool toInt16, unsigned int len,
+                       unsigned int *randState, float *triangleState)
+{
+    if (level == SIMD_AVX2)
+        FloatToIntAVX2<ditherType>(src, dst, toInt16, len,
+                                   randState, triangleState);
+    else
+        FloatToIntSSE2<ditherType>(src, dst, toInt16, len,
+                                   randState, triangleState);
+}
+
+// Samples converted per pass through the gather and scatter buffers
+#define SIMD_CHUNK 1024
+
+bool Dither::ApplySIMD(DitherType ditherType,
+                       const samplePtr source, sampleFormat sourceFormat,
+                       samplePtr dest, sampleFormat destFormat,
+                       unsigned int len,
+                       unsigned int sourceStride,
+                       unsigned int destStride)
+{
+    if (!sSIMDEnabled || len < 16)
+        return false;
+
+    SIMDLevel level = GetSIMDLevel();
+    if (level == SIMD_NONE)
+        return false;
+
+    // int24 to int16 goes by way of float, which is exact
+    bool toFloat = (destFormat == floatSample);
+    bool fromFloat = (sourceFormat == floatSample);
+    bool promote = (sourceFormat == int16Sample && destFormat == int24Sample);
+    if (!toFloat && !fromFloat && !promote &&
+        !(sourceFormat == int24Sample && destFormat == int16Sample))
+        return false;
+
+    if (ditherType == triangle || ditherType == shaped)
+        Reset(); // reset dither filter for this new conversion, as Apply() does
+
+    // Gathered source, float intermediate and destination before scatter;
+    // the int buffers are big enough for shorts too
+    int gathered[SIMD_CHUNK];
+    float floats[SIMD_CHUNK];
+    int converted[SIMD_CHUNK];
+    float noise[2 * SIMD_CHUNK];
+
+    const int sourceSize = SAMPLE_SIZE(sourceFormat);
+    const int destSize = SAMPLE_SIZE(destFormat);
+
+    for (unsigned int done = 0; done < len; ) {
+        unsigned int n = len - done;
+        if (n > SIMD_CHUNK)
+            n = SIMD_CHUNK;
+
+        // Source, contiguous
+        const char *s = (const char *)source + done * sourceStride * sourceSize;
+        if (sourceStride != 1) {
+            char *g = (char *)gathered;
+            for (unsigned int i = 0; i < n; i++)
+                memcpy(g + i * sourceSize, s + i * sourceStride * sourceSize,
+                       sourceSize);
+            s = g;
+        }
+
+        // Destination, contiguous
+        char *d = (char *)dest + done * destStride * destSize;
+        char *out = (destStride == 1) ? d : (char *)converted;
+
+        if (toFloat) {
+            if (sourceFormat == int16Sample) {
+                if (level == SIMD_AVX2)
+                    Int16ToFloatAVX2((const short *)s, (float *)out, n);
+                else
+                    Int16ToFloatSSE2((const short *)s, (float *)out, n);
+            }
+            else {
+                if (level == SIMD_AVX2)
+                    Int24ToFloatAVX2((const int *)s, (float *)out, n);
+                else
+                    Int24ToFloatSSE2((const int *)s, (float *)out, n);
+            }
+        }
+        else if (promote)
+            Int16ToInt24SSE2((const short *)s, (int *)out, n);
+        else {
+            const float *f = (const float *)s;
+            if (!fromFloat) {
+                // int24 source; exact, and within [-1, 1) already
+                if (level == SIMD_AVX2)
+                    Int24ToFloatAVX2((const int *)s, floats, n);
+                else
+                    Int24ToFloatSSE2((const int *)s, floats, n);
+                f = floats;
+            }
+
+            bool toInt16 = (destFormat == int16Sample);
+            switch (ditherType) {
+            case none:
+                FloatToInt<none>(level, f, out, toInt16, n,
+                                 mRandState, &mTriangleState);
+                break;
+            case rectangle:
+                FloatToInt<rectangle>(level, f, out, toInt16, n,
+                                      mRandState, &mTriangleState);
+                break;
+            case triangle:
+                FloatToInt<triangle>(level, f, out, toInt16, n,
+                                     mRandState, &mTriangleState);
+                break;
+            case shaped: {
+                // The error feedback makes this inherently serial, but
+                // the noise, two values per sample, comes in vectors
+                NoiseBlockSSE2(noise, 2 * n, mRandState);
+                const int maxBound = toInt16 ? 32767 : 8388607;
+                const int minBound = toInt16 ? -32768 : -8388608;
+                const float scale = toInt16 ? float(1 << 15) : float(1 << 23);
+                for (unsigned int i = 0; i < n; i++) {
+                    float sample = ClipToUnit(f[i]) * scale;
+                    float r = noise[2 * i] + noise[2 * i + 1];
+                    if (sample != sample)  // test for NaN
+                       sample = 0;
+
+                    float xe = sample + mBuffer[mPhase] * SHAPED_BS[0]
+                        + mBuffer[(mPhase - 1) & BUF_MASK] * SHAPED_BS[1]
+                        + mBuffer[(mPhase - 2) & BUF_MASK] * SHAPED_BS[2]
+                        + mBuffer[(mPhase - 3) & BUF_MASK] * SHAPED_BS[3]
+                        + mBuffer[(mPhase - 4) & BUF_MASK] * SHAPED_BS[4];
+                    float result = xe + r;
+                    mPhase = (mPhase + 1) & BUF_MASK;
+                    mBuffer[mPhase] = xe - lrintf(result);
+
+                    int x = StoreClipped(result, minBound, maxBound);
+                    if (toInt16)
+                        ((short *)out)[i] = (short)x;
+                    else
+                        ((int *)out)[i] = x;
+                }
+            }   break;
+            default:
+                return false;
+            }
+        }
+
+        if (out != d) {
+            for (unsigned int i = 0; i < n; i++)
+                memcpy(d + i * destStride * destSize, out + i * destSize,
+                       destSize);
+        }
+
+        done += n;
+    }
+
+    return true;
+}
+
+#endif // DITHER_SIMD
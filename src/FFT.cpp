@@ -109,7 +109,7 @@ void InitFFT()
 }
 
 #ifdef EXPERIMENTAL_USE_REALFFTF
-#include "RealFFTf.h"
+#include "FFTPlanner.h"
 #endif
 
 void DeinitFFT()
@@ -123,6 +123,7 @@ void DeinitFFT()
 #ifdef EXPERIMENTAL_USE_REALFFTF
    // Deallocate any unused RealFFTf tables
    CleanupFFT();
+   FFTPlanner::Deinit();
 #endif
 }
 
@@ -253,14 +254,15 @@ void RealFFT(int NumSamples, float *RealIn, float *RealOut, float *ImagOut)
 #ifdef EXPERIMENTAL_USE_REALFFTF
    // Remap to RealFFTf() function
    int i;
-   HFFT hFFT = GetFFT(NumSamples);
+   const FFTPlan *plan = FFTPlanner::Get().GetPlan(NumSamples);
+   HFFT hFFT = plan->GetTables();
    float *pFFT = new float[NumSamples];
    // Copy the data into the processing buffer
    for(i=0; i<NumSamples; i++)
       pFFT[i] = RealIn[i];
 
    // Perform the FFT
-   RealFFTf(pFFT, hFFT);
+   plan->Forward(pFFT);
 
    // Copy the data into the real and imaginary outputs
    for(i=1;i<(NumSamples/2);i++) {
@@ -277,7 +279,6 @@ void RealFFT(int NumSamples, float *RealIn, float *RealOut, float *ImagOut)
       ImagOut[i] = -ImagOut[NumSamples-i];
    }
    delete [] pFFT;
-   ReleaseFFT(hFFT);
 
 #else
 
@@ -347,7 +348,8 @@ void InverseRealFFT(int NumSamples, float *RealIn, float *ImagIn, float *RealOut
 {
    // Remap to RealFFTf() function
    int i;
-   HFFT hFFT = GetFFT(NumSamples);
+   const FFTPlan *plan = FFTPlanner::Get().GetPlan(NumSamples);
+   HFFT hFFT = plan->GetTables();
    float *pFFT = new float[NumSamples];
    // Copy the data into the processing buffer
    for(i=0; i<(NumSamples/2); i++)
@@ -363,13 +365,12 @@ void InverseRealFFT(int NumSamples, float *RealIn, float *ImagIn, float *RealOut
    pFFT[1] = RealIn[i];
 
    // Perform the FFT
-   InverseRealFFTf(pFFT, hFFT);
+   plan->Inverse(pFFT);
 
    // Copy the data to the (purely real) output buffer
    ReorderToTime(hFFT, pFFT, RealOut);
 
    delete [] pFFT;
-   ReleaseFFT(hFFT);
 }
 #endif // EXPERIMENTAL_USE_REALFFTF
 
@@ -390,14 +391,15 @@ void PowerSpectrum(int NumSamples, float *In, float *Out)
 #ifdef EXPERIMENTAL_USE_REALFFTF
    // Remap to RealFFTf() function
    int i;
-   HFFT hFFT = GetFFT(NumSamples);
+   const FFTPlan *plan = FFTPlanner::Get().GetPlan(NumSamples);
+   HFFT hFFT = plan->GetTables();
    float *pFFT = new float[NumSamples];
    // Copy the data into the processing buffer
    for(i=0; i<NumSamples; i++)
       pFFT[i] = In[i];
 
    // Perform the FFT
-   RealFFTf(pFFT, hFFT);
+   plan->Forward(pFFT);
 
    // Copy the data into the real and imaginary outputs
    for(i=1;i<NumSamples/2;i++) {
@@ -408,7 +410,6 @@ void PowerSpectrum(int NumSamples, float *In, float *Out)
    Out[0] = pFFT[0]*pFFT[0];
    Out[i] = pFFT[1]*pFFT[1];
    delete [] pFFT;
-   ReleaseFFT(hFFT);
 
 #else // EXPERIMENTAL_USE_REALFFTF
 
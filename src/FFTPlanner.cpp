@@ -0,0 +1,237 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FFTPlanner.cpp
+
+*******************************************************************//**
+
+\class FFTPlanner
+\brief Chooses, for each length of real FFT, the fastest of the
+transforms built in, and keeps the tables for it.
+
+Which of the radix-2 and radix-4 butterflies, the AVX2 radix-4 ones
+where the processor has AVX2 (and, with
+EXPERIMENTAL_EQ_SSE_THREADED, the table and bit-reversal variants of
+RealFFTf48x) is quickest depends on the length, the processor and its
+caches, so each is timed the first time a length is asked for.  The
+winner is remembered in the preferences, keyed by length, so later runs
+on the same machine skip the timing.
+
+*//****************************************************************//**
+
+\class FFTPlan
+\brief The tables and the chosen kernel for one length of FFT.
+
+*//*******************************************************************/
+
+#include "FFTPlanner.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+
+#include "Prefs.h"
+
+#ifdef EXPERIMENTAL_EQ_SSE_THREADED
+#include "RealFFTf48x.h"
+#endif
+
+static const FFTKernel sKernels[] = {
+   { wxT("Radix2"), RealFFTf, InverseRealFFTf, 30, SIMD_NONE },
+   { wxT("Radix4"), RealFFTfRadix4, InverseRealFFTfRadix4, 30, SIMD_NONE },
+#if defined(AUDACITY_X86_SIMD)
+   { wxT("Radix4AVX2"), RealFFTfRadix4AVX2, InverseRealFFTfRadix4AVX2, 30, SIMD_AVX2 },
+#endif
+#ifdef EXPERIMENTAL_EQ_SSE_THREADED
+   // Those using the shared sine table have 2^13 entries of it for a
+   // quarter turn; the others reverse 16 or 24 bits at most
+   { wxT("SinCosBRTable"), RealFFTf1xSinCosBRTable, InverseRealFFTf1xSinCosBRTable, 30, SIMD_NONE },
+   { wxT("SinCosTableVBR16"), RealFFTf1xSinCosTableVBR16, InverseRealFFTf1xSinCosTableVBR16, 14, SIMD_NONE },
+   { wxT("SinCosTableBR16"), RealFFTf1xSinCosTableBR16, InverseRealFFTf1xSinCosTableBR16, 14, SIMD_NONE },
+   { wxT("FastMathBR16"), RealFFTf1xFastMathBR16, InverseRealFFTf1xFastMathBR16, 16, SIMD_NONE },
+   { wxT("FastMathBR24"), RealFFTf1xFastMathBR24, InverseRealFFTf1xFastMathBR24, 24, SIMD_NONE },
+#endif
+};
+
+static const int sNumKernels = sizeof(sKernels) / sizeof(sKernels[0]);
+
+static int Log2(int fftlen)
+{
+   int bits = 0;
+   while ((1 << (bits + 1)) <= fftlen)
+      bits++;
+   return bits;
+}
+
+// Whether the kernel can do transforms of fftlen points on this machine
+static bool CanUse(const FFTKernel &kernel, int fftlen)
+{
+   return Log2(fftlen) <= kernel.maxBits && kernel.level <= GetSIMDLevel();
+}
+
+static wxString PrefKey(int fftlen)
+{
+   return wxString::Format(wxT("/FFT/Kernel/%d"), fftlen);
+}
+
+FFTPlan::FFTPlan(int fftlen, const FFTKernel *kernel)
+{
+   mFFT = InitializeFFT(fftlen);
+   mKernel = kernel;
+}
+
+FFTPlan::~FFTPlan()
+{
+   EndFFT(mFFT);
+}
+
+FFTPlanner *FFTPlanner::sInstance = NULL;
+ODLock FFTPlanner::sInstanceLock;
+
+FFTPlanner &FFTPlanner::Get()
+{
+   ODLocker locker(sInstanceLock);
+   if (!sInstance)
+      sInstance = new FFTPlanner;
+   return *sInstance;
+}
+
+void FFTPlanner::Deinit()
+{
+   ODLocker locker(sInstanceLock);
+   delete sInstance;
+   sInstance = NULL;
+}
+
+FFTPlanner::FFTPlanner()
+{
+}
+
+FFTPlanner::~FFTPlanner()
+{
+   std::map<int, FFTPlan *>::iterator it;
+   for (it = mPlans.begin(); it != mPlans.end(); ++it)
+      delete it->second;
+}
+
+const FFTPlan *FFTPlanner::GetPlan(int fftlen)
+{
+   bool isMain = wxThread::IsMain();
+
+   {
+      ODLocker locker(mLock);
+
+      if (isMain && !mUnsaved.empty())
+         SaveChoices();
+
+      std::map<int, FFTPlan *>::iterator it = mPlans.find(fftlen);
+      if (it != mPlans.end())
+         return it->second;
+   }
+
+   // Make the plan unlocked, as timing the kernels takes tens of
+   // milliseconds each, and requests for other lengths needn't wait
+   FFTPlan *plan = new FFTPlan(fftlen, NULL);
+
+   if (isMain) {
+      wxString name;
+      if (gPrefs->Read(PrefKey(fftlen), &name))
+         plan->mKernel = FindKernel(name, fftlen);
+   }
+
+   bool timed = false;
+   if (!plan->mKernel) {
+      plan->mKernel = ChooseKernel(plan->mFFT, fftlen);
+      timed = true;
+   }
+
+   ODLocker locker(mLock);
+
+   // Another thread may have made one meanwhile; the first made stays,
+   // as callers may already be using it
+   std::map<int, FFTPlan *>::iterator it = mPlans.find(fftlen);
+   if (it != mPlans.end()) {
+      delete plan;
+      return it->second;
+   }
+
+   mPlans[fftlen] = plan;
+   if (timed) {
+      mUnsaved.push_back(fftlen);
+      if (isMain)
+         SaveChoices();
+   }
+
+   return plan;
+}
+
+const FFTKernel *FFTPlanner::FindKernel(const wxString &name, int fftlen)
+{
+   for (int k = 0; k < sNumKernels; k++) {
+      if (name == sKernels[k].name && CanUse(sKernels[k], fftlen))
+         return &sKernels[k];
+   }
+
+   // Saved by a build with other kernels, or on another processor
+   return NULL;
+}
+
+const FFTKernel *FFTPlanner::ChooseKernel(HFFT h, int fftlen)
+{
+   std::vector<fft_type> signal(fftlen);
+   std::vector<fft_type> buffer(fftlen);
+   for (int i = 0; i < fftlen; i++)
+      signal[i] = (fft_type)sin(i * 0.1) + (fft_type)((i * 7919) % 1000) * 0.0001f;
+
+   const FFTKernel *best = &sKernels[0];
+   double bestTime = 0;
+
+   for (int k = 0; k < sNumKernels; k++) {
+      const FFTKernel *kernel = &sKernels[k];
+      if (!CanUse(*kernel, fftlen))
+         continue;
+
+      // Once to bring code and tables into cache
+      memcpy(&buffer[0], &signal[0], sizeof(fft_type) * fftlen);
+      kernel->forward(&buffer[0], h);
+      kernel->inverse(&buffer[0], h);
+
+      // The best of a few runs of at least 10 ms each, as a run can be
+      // slowed by other threads but never sped up
+      double time = 0;
+      for (int run = 0; run < 3; run++) {
+         int count = 0;
+         wxStopWatch watch;
+         do {
+            memcpy(&buffer[0], &signal[0], sizeof(fft_type) * fftlen);
+            kernel->forward(&buffer[0], h);
+            kernel->inverse(&buffer[0], h);
+            count++;
+         } while (watch.Time() < 10);
+
+         double runTime = watch.Time() / (double)count;
+         if (run == 0 || runTime < time)
+            time = runTime;
+      }
+
+      if (k == 0 || time < bestTime) {
+         best = kernel;
+         bestTime = time;
+      }
+   }
+
+   return best;
+}
+
+void FFTPlanner::SaveChoices()
+{
+   for (size_t i = 0; i < mUnsaved.size(); i++) {
+      int fftlen = mUnsaved[i];
+      gPrefs->Write(PrefKey(fftlen), wxString(mPlans[fftlen]->GetKernelName()));
+   }
+   gPrefs->Flush();
+   mUnsaved.clear();
+}
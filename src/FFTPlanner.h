@@ -0,0 +1,91 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FFTPlanner.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_FFT_PLANNER__
+#define __AUDACITY_FFT_PLANNER__
+
+#include <map>
+#include <vector>
+
+#include "Audacity.h"
+#include "CPUFeatures.h"
+#include "Experimental.h"
+#include "RealFFTf.h"
+#include "ondemand/ODTaskThread.h"
+
+/// One implementation of the transforms of RealFFTf.h.  All of them
+/// leave the spectrum in the same bit-reversed order, with the same
+/// scaling, so callers needn't know which one a plan uses.
+struct FFTKernel
+{
+   const wxChar *name;
+   void (*forward)(fft_type *buffer, HFFT h);
+   void (*inverse)(fft_type *buffer, HFFT h);
+   int maxBits;      // log2 of the longest transform it can do
+   SIMDLevel level;  // the instruction set it needs
+};
+
+/// The tables for one length of transform and the kernel that was
+/// fastest for it on this machine.  Plans never change once made, so
+/// any number of threads may use one at once.
+class AUDACITY_DLL_API FFTPlan
+{
+ public:
+   int GetLength() const { return mFFT->Points * 2; }
+   /// For BitReversed when reading the spectrum, and for ReorderToTime()
+   /// and ReorderToFreq()
+   HFFT GetTables() const { return mFFT; }
+   const wxChar *GetKernelName() const { return mKernel->name; }
+
+   /// Does what RealFFTf() does
+   void Forward(fft_type *buffer) const { mKernel->forward(buffer, mFFT); }
+   /// Does what InverseRealFFTf() does
+   void Inverse(fft_type *buffer) const { mKernel->inverse(buffer, mFFT); }
+
+ private:
+   friend class FFTPlanner;
+   FFTPlan(int fftlen, const FFTKernel *kernel);
+   ~FFTPlan();
+
+   HFFT mFFT;
+   const FFTKernel *mKernel;
+};
+
+class AUDACITY_DLL_API FFTPlanner
+{
+ public:
+   static FFTPlanner &Get();
+   /// Frees the plans; call once at exit, when nothing uses them
+   static void Deinit();
+
+   /// The plan for transforms of fftlen points, a power of two.  The
+   /// first request for a length times each kernel on it, unless the
+   /// winner was saved in the preferences by an earlier run.  Any thread
+   /// may ask, and the timing holds up no other; the plan lasts until
+   /// Deinit().
+   const FFTPlan *GetPlan(int fftlen);
+
+ private:
+   FFTPlanner();
+   ~FFTPlanner();
+
+   const FFTKernel *ChooseKernel(HFFT h, int fftlen);
+   const FFTKernel *FindKernel(const wxString &name, int fftlen);
+   void SaveChoices();
+
+   static FFTPlanner *sInstance;
+   static ODLock sInstanceLock;
+
+   ODLock mLock;   // for mPlans and mUnsaved, never held while timing
+   std::map<int, FFTPlan *> mPlans;
+   // Lengths timed off the main thread, where the preferences can't be
+   // touched; they are saved on the next request from the main thread
+   std::vector<int> mUnsaved;
+};
+
+#endif
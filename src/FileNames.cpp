@@ -175,6 +175,11 @@ wxString FileNames::PluginSettings()
    return wxFileName( DataDir(), wxT("pluginsettings.cfg") ).GetFullPath();
 }
 
+wxString FileNames::PluginScanCache()
+{
+   return wxFileName( DataDir(), wxT("pluginscans.cfg") ).GetFullPath();
+}
+
 wxString FileNames::BaseDir()
 {
    wxFileName baseDir;
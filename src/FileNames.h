@@ -42,6 +42,7 @@ public:
    static wxString NRPFile();
    static wxString PluginRegistry();
    static wxString PluginSettings();
+   static wxString PluginScanCache();
 
    static wxString BaseDir();
    static wxString ModulesDir();
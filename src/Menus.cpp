@@ -5302,14 +5302,10 @@ void AudacityProject::OnImport()
    selectedFiles.Sort(CompareNoCaseFileName);
    ODManager::Pause();
 
-   for (size_t ff = 0; ff < selectedFiles.GetCount(); ff++) {
-      wxString fileName = selectedFiles[ff];
-
-      wxString path = ::wxPathOnly(fileName);
-      gPrefs->Write(wxT("/DefaultOpenPath"), path);
+   wxString path = ::wxPathOnly(selectedFiles.Last());
+   gPrefs->Write(wxT("/DefaultOpenPath"), path);
 
-      Import(fileName);
-   }
+   ImportFiles(selectedFiles);
 
    gPrefs->Write(wxT("/LastOpenType"),wxT(""));
 
@@ -13,6 +13,12 @@
 \class Mixer
 \brief Functions for doing the mixdown of the tracks.
 
+Each call to Process() fetches, envelopes and resamples a buffer from
+every input track, then adds them, with their gains, into mTemp.  With
+SetParallel(true) the per-track part runs on the WorkerPool, each track
+into a scratch buffer of its own, and the sums are still formed one
+track at a time in track order, so the output is the same bit for bit.
+
 *//****************************************************************//**
 
 \class MixerSpec
@@ -40,6 +46,7 @@
 #include "Prefs.h"
 #include "Project.h"
 #include "Resample.h"
+#include "WorkerPool.h"
 #include "float_cast.h"
 
 //TODO-MB: wouldn't it make more sense to delete the time track after 'mix and render'?
@@ -165,6 +172,7 @@ bool MixAndRender(TrackList *tracks, TrackFactory *trackFactory,
                             Mixer::WarpOptions(tracks->GetTimeTrack()),
                             startTime, endTime, mono ? 1 : 2, maxBlockLen, false,
                             rate, format);
+   mixer->SetParallel(true);
 
    ::wxSafeYield();
    ProgressDialog *progress = new ProgressDialog(_("Mix and Render"),
@@ -278,6 +286,10 @@ Mixer::Mixer(int numInputTracks, WaveTrack **inputTracks,
    mSpeed = 1.0;
    mFormat = outFormat;
    mApplyTrackGains = true;
+   mParallel = false;
+   mTrackBuffers = NULL;
+   mTrackEnvValues = NULL;
+   mTrackLen = NULL;
    mGains = new float[mNumChannels];
    if( mixerSpec && mixerSpec->GetNumChannels() == mNumChannels &&
          mixerSpec->GetNumTracks() == mNumInputTracks )
@@ -300,7 +312,7 @@ Mixer::Mixer(int numInputTracks, WaveTrack **inputTracks,
       mBuffer[c] = NewSamples(mInterleavedBufferSize, mFormat);
       mTemp[c] = NewSamples(mInterleavedBufferSize, floatSample);
    }
-   mFloatBuffer = new float[mInterleavedBufferSize];
+   mFloatBuffer = (float *)NewSamples(mInterleavedBufferSize, floatSample);
 
    // This is the number of samples grabbed in one go from a track
    // and placed in a queue, when mixing with resampling.
@@ -341,15 +353,12 @@ Mixer::Mixer(int numInputTracks, WaveTrack **inputTracks,
       }
 
       mResample[i] = new Resample(mHighQuality, minFactor, maxFactor);
-      mSampleQueue[i] = new float[mQueueMaxLen];
+      mSampleQueue[i] = (float *)NewSamples(mQueueMaxLen, floatSample);
       mQueueStart[i] = 0;
       mQueueLen[i] = 0;
    }
 
-   int envLen = mInterleavedBufferSize;
-   if (mQueueMaxLen > envLen)
-      envLen = mQueueMaxLen;
-   mEnvValues = new double[envLen];
+   mEnvValues = new double[GetEnvValuesLen()];
 }
 
 Mixer::~Mixer()
@@ -364,18 +373,20 @@ Mixer::~Mixer()
    delete[] mTemp;
    delete[] mInputTrack;
    delete[] mEnvValues;
-   delete[] mFloatBuffer;
+   DeleteSamples((samplePtr)mFloatBuffer);
    delete[] mGains;
    delete[] mSamplePos;
 
    for(i=0; i<mNumInputTracks; i++) {
       delete mResample[i];
-      delete[] mSampleQueue[i];
+      DeleteSamples((samplePtr)mSampleQueue[i]);
    }
    delete[] mResample;
    delete[] mSampleQueue;
    delete[] mQueueStart;
    delete[] mQueueLen;
+
+   SetParallel(false);
 }
 
 void Mixer::ApplyTrackGains(bool apply)
@@ -383,6 +394,48 @@ void Mixer::ApplyTrackGains(bool apply)
    mApplyTrackGains = apply;
 }
 
+int Mixer::GetEnvValuesLen()
+{
+   return std::max(mInterleavedBufferSize, mQueueMaxLen);
+}
+
+void Mixer::SetParallel(bool parallel)
+{
+   // One track gains nothing from the pool
+   if (parallel && mNumInputTracks < 2)
+      parallel = false;
+
+   if (parallel == mParallel)
+      return;
+
+   mParallel = parallel;
+
+   if (mParallel) {
+      // Every track needs the scratch space that the serial mixer
+      // reuses for each of them in turn
+      mTrackBuffers = new float *[mNumInputTracks];
+      mTrackEnvValues = new double *[mNumInputTracks];
+      mTrackLen = new sampleCount[mNumInputTracks];
+      for (int i = 0; i < mNumInputTracks; i++) {
+         mTrackBuffers[i] = (float *)NewSamples(mInterleavedBufferSize, floatSample);
+         mTrackEnvValues[i] = new double[GetEnvValuesLen()];
+         mTrackLen[i] = 0;
+      }
+   }
+   else {
+      for (int i = 0; i < mNumInputTracks; i++) {
+         DeleteSamples((samplePtr)mTrackBuffers[i]);
+         delete[] mTrackEnvValues[i];
+      }
+      delete[] mTrackBuffers;
+      delete[] mTrackEnvValues;
+      delete[] mTrackLen;
+      mTrackBuffers = NULL;
+      mTrackEnvValues = NULL;
+      mTrackLen = NULL;
+   }
+}
+
 void Mixer::Clear()
 {
    for (int c = 0; c < mNumBuffers; c++) {
@@ -419,10 +472,11 @@ void MixBuffers(int numChannels, int *channelFlags, float *gains,
    }
 }
 
-sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
+sampleCount Mixer::MixVariableRates(WaveTrack *track,
                                     sampleCount *pos, float *queue,
                                     int *queueStart, int *queueLen,
-                                    Resample * pResample)
+                                    Resample * pResample,
+                                    float *floatBuffer, double *envValues)
 {
    const double trackRate = track->GetRate();
    const double initialWarp = mRate / mSpeed / trackRate;
@@ -471,7 +525,7 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
                           *pos - (getLen - 1),
                           getLen);
 
-               track->GetEnvelopeValues(mEnvValues,
+               track->GetEnvelopeValues(envValues,
                                         getLen,
                                         (*pos - (getLen- 1)) / trackRate,
                                         tstep);
@@ -482,9 +536,11 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
                track->Get((samplePtr)&queue[*queueLen],
                           floatSample,
                           *pos,
-                          getLen);
+                          getLen,
+                          fillZero,
+                          true);
 
-               track->GetEnvelopeValues(mEnvValues,
+               track->GetEnvelopeValues(envValues,
                                         getLen,
                                         (*pos) / trackRate,
                                         tstep);
@@ -493,7 +549,7 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
             }
 
             for (int i = 0; i < getLen; i++) {
-               queue[(*queueLen) + i] *= mEnvValues[i];
+               queue[(*queueLen) + i] *= envValues[i];
             }
 
             if (backwards)
@@ -532,7 +588,7 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
                                       thisProcessLen,
                                       last,
                                       &input_used,
-                                      &mFloatBuffer[out],
+                                      &floatBuffer[out],
                                       mMaxOut - out);
 
       if (outgen < 0) {
@@ -549,31 +605,13 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
       }
    }
 
-   for (int c = 0; c < mNumChannels; c++) {
-      if (mApplyTrackGains) {
-         mGains[c] = track->GetChannelGain(c);
-      }
-      else {
-         mGains[c] = 1.0;
-      }
-   }
-
-   MixBuffers(mNumChannels,
-              channelFlags,
-              mGains,
-              (samplePtr)mFloatBuffer,
-              mTemp,
-              out,
-              mInterleaved);
-
    return out;
 }
 
-sampleCount Mixer::MixSameRate(int *channelFlags, WaveTrack *track,
-                               sampleCount *pos)
+sampleCount Mixer::MixSameRate(WaveTrack *track, sampleCount *pos,
+                               float *floatBuffer, double *envValues)
 {
    int slen = mMaxOut;
-   int c;
    const double t = *pos / track->GetRate();
    const double trackEndTime = track->GetEndTime();
    const double trackStartTime = track->GetStartTime();
@@ -598,35 +636,109 @@ sampleCount Mixer::MixSameRate(int *channelFlags, WaveTrack *track,
       slen = mMaxOut;
 
    if (backwards) {
-      track->Get((samplePtr)mFloatBuffer, floatSample, *pos - (slen - 1), slen);
-      track->GetEnvelopeValues(mEnvValues, slen, t - (slen - 1) / mRate, 1.0 / mRate);
+      track->Get((samplePtr)floatBuffer, floatSample, *pos - (slen - 1), slen);
+      track->GetEnvelopeValues(envValues, slen, t - (slen - 1) / mRate, 1.0 / mRate);
       for(int i=0; i<slen; i++)
-         mFloatBuffer[i] *= mEnvValues[i]; // Track gain control will go here?
-      ReverseSamples((samplePtr)mFloatBuffer, floatSample, 0, slen);
+         floatBuffer[i] *= envValues[i]; // Track gain control will go here?
+      ReverseSamples((samplePtr)floatBuffer, floatSample, 0, slen);
 
       *pos -= slen;
    }
    else {
-      track->Get((samplePtr)mFloatBuffer, floatSample, *pos, slen);
-      track->GetEnvelopeValues(mEnvValues, slen, t, 1.0 / mRate);
+      track->Get((samplePtr)floatBuffer, floatSample, *pos, slen, fillZero, true);
+      track->GetEnvelopeValues(envValues, slen, t, 1.0 / mRate);
       for(int i=0; i<slen; i++)
-         mFloatBuffer[i] *= mEnvValues[i]; // Track gain control will go here?
+         floatBuffer[i] *= envValues[i]; // Track gain control will go here?
 
       *pos += slen;
    }
 
-   for(c=0; c<mNumChannels; c++)
+   return slen;
+}
+
+/// Fetch the next buffer of input track i, with its envelope applied
+/// and resampled if needed, into floatBuffer.  Touches nothing shared
+/// with the other tracks, so tracks may be fetched concurrently.
+sampleCount Mixer::FetchTrack(int i, float *floatBuffer, double *envValues)
+{
+   WaveTrack *track = mInputTrack[i];
+
+   if (mbVariableRates || track->GetRate() != mRate)
+      return MixVariableRates(track, &mSamplePos[i], mSampleQueue[i],
+                              &mQueueStart[i], &mQueueLen[i], mResample[i],
+                              floatBuffer, envValues);
+   else
+      return MixSameRate(track, &mSamplePos[i], floatBuffer, envValues);
+}
+
+/// Add len fetched samples of input track i into mTemp, on the output
+/// channels it belongs to, with its gains.
+void Mixer::MixTrack(int i, int *channelFlags, float *floatBuffer,
+                     sampleCount len)
+{
+   WaveTrack *track = mInputTrack[i];
+   int j;
+
+   for(j=0; j<mNumChannels; j++)
+      channelFlags[j] = 0;
+
+   if( mMixerSpec ) {
+      //ignore left and right when downmixing is not required
+      for( j = 0; j < mNumChannels; j++ )
+         channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+   }
+   else {
+      switch(track->GetChannel()) {
+      case Track::MonoChannel:
+      default:
+         for(j=0; j<mNumChannels; j++)
+            channelFlags[j] = 1;
+         break;
+      case Track::LeftChannel:
+         channelFlags[0] = 1;
+         break;
+      case Track::RightChannel:
+         if (mNumChannels >= 2)
+            channelFlags[1] = 1;
+         else
+            channelFlags[0] = 1;
+         break;
+      }
+   }
+
+   for(j=0; j<mNumChannels; j++)
       if (mApplyTrackGains)
-         mGains[c] = track->GetChannelGain(c);
+         mGains[j] = track->GetChannelGain(j);
       else
-         mGains[c] = 1.0;
+         mGains[j] = 1.0;
 
    MixBuffers(mNumChannels, channelFlags, mGains,
-              (samplePtr)mFloatBuffer, mTemp, slen, mInterleaved);
+              (samplePtr)floatBuffer, mTemp, len, mInterleaved);
 
-   return slen;
+   double t = (double)mSamplePos[i] / (double)track->GetRate();
+   if (mT0 > mT1)
+      mTime = std::max(t, mT1);
+   else
+      mTime = std::min(t, mT1);
 }
 
+/// Fetches each input track into its own scratch buffer
+class MixerFetchTask : public WorkerTask
+{
+ public:
+   MixerFetchTask(Mixer *mixer) : mMixer(mixer) {}
+
+   virtual void Run(int index)
+   {
+      mMixer->mTrackLen[index] =
+         mMixer->FetchTrack(index, mMixer->mTrackBuffers[index],
+                            mMixer->mTrackEnvValues[index]);
+   }
+
+ private:
+   Mixer *mMixer;
+};
+
 sampleCount Mixer::Process(sampleCount maxToProcess)
 {
    // MB: this is wrong! mT represented warped time, and mTime is too inaccurate to use
@@ -634,55 +746,29 @@ sampleCount Mixer::Process(sampleCount maxToProcess)
    //if (mT >= mT1)
    //   return 0;
 
-   int i, j;
+   int i;
    sampleCount maxOut = 0;
    int *channelFlags = new int[mNumChannels];
 
    mMaxOut = maxToProcess;
 
    Clear();
-   for(i=0; i<mNumInputTracks; i++) {
-      WaveTrack *track = mInputTrack[i];
-      for(j=0; j<mNumChannels; j++)
-         channelFlags[j] = 0;
-
-      if( mMixerSpec ) {
-         //ignore left and right when downmixing is not required
-         for( j = 0; j < mNumChannels; j++ )
-            channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+   if (mParallel) {
+      MixerFetchTask task(this);
+      WorkerPool::Get().Run(&task, mNumInputTracks);
+
+      // Sum in track order, exactly as the serial loop below does
+      for(i=0; i<mNumInputTracks; i++) {
+         maxOut = std::max(maxOut, mTrackLen[i]);
+         MixTrack(i, channelFlags, mTrackBuffers[i], mTrackLen[i]);
       }
-      else {
-         switch(track->GetChannel()) {
-         case Track::MonoChannel:
-         default:
-            for(j=0; j<mNumChannels; j++)
-               channelFlags[j] = 1;
-            break;
-         case Track::LeftChannel:
-            channelFlags[0] = 1;
-            break;
-         case Track::RightChannel:
-            if (mNumChannels >= 2)
-               channelFlags[1] = 1;
-            else
-               channelFlags[0] = 1;
-            break;
-         }
+   }
+   else {
+      for(i=0; i<mNumInputTracks; i++) {
+         sampleCount len = FetchTrack(i, mFloatBuffer, mEnvValues);
+         maxOut = std::max(maxOut, len);
+         MixTrack(i, channelFlags, mFloatBuffer, len);
       }
-      if (mbVariableRates || track->GetRate() != mRate)
-         maxOut = std::max(maxOut,
-         MixVariableRates(channelFlags, track,
-         &mSamplePos[i], mSampleQueue[i],
-         &mQueueStart[i], &mQueueLen[i], mResample[i]));
-      else
-         maxOut = std::max(maxOut,
-         MixSameRate(channelFlags, track, &mSamplePos[i]));
-
-      double t = (double)mSamplePos[i] / (double)track->GetRate();
-      if (mT0 > mT1)
-         mTime = std::max(t, mT1);
-      else
-         mTime = std::min(t, mT1);
    }
    if(mInterleaved) {
       for(int c=0; c<mNumChannels; c++) {
@@ -103,6 +103,10 @@ class AUDACITY_DLL_API Mixer {
 
    void ApplyTrackGains(bool apply = true); // True by default
 
+   /// Fetch, envelope and resample the input tracks concurrently on the
+   /// WorkerPool.  Uses more memory; the output is identical.
+   void SetParallel(bool parallel = true); // False by default
+
    //
    // Processing
    //
@@ -137,13 +141,21 @@ class AUDACITY_DLL_API Mixer {
  private:
 
    void Clear();
-   sampleCount MixSameRate(int *channelFlags, WaveTrack *src,
-                           sampleCount *pos);
+   int GetEnvValuesLen();
+   sampleCount MixSameRate(WaveTrack *src, sampleCount *pos,
+                           float *floatBuffer, double *envValues);
 
-   sampleCount MixVariableRates(int *channelFlags, WaveTrack *track,
+   sampleCount MixVariableRates(WaveTrack *track,
                                 sampleCount *pos, float *queue,
                                 int *queueStart, int *queueLen,
-                                Resample * pResample);
+                                Resample * pResample,
+                                float *floatBuffer, double *envValues);
+
+   sampleCount FetchTrack(int i, float *floatBuffer, double *envValues);
+   void MixTrack(int i, int *channelFlags, float *floatBuffer,
+                 sampleCount len);
+
+   friend class MixerFetchTask;
 
  private:
    // Input
@@ -166,6 +178,12 @@ class AUDACITY_DLL_API Mixer {
    int              mProcessLen;
    MixerSpec        *mMixerSpec;
 
+   // Scratch space of each track, when fetching them in parallel
+   bool             mParallel;
+   float          **mTrackBuffers;
+   double         **mTrackEnvValues;
+   sampleCount     *mTrackLen;
+
    // Output
    int              mMaxOut;
    int              mNumChannels;
@@ -0,0 +1,194 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolver.cpp
+
+*******************************************************************//**
+
+\class PartitionedConvolver
+\brief Convolves a channel with a long filter by uniformly partitioned
+overlap-save in the frequency domain.
+
+Each block of input is transformed once and its spectrum kept in a
+history as long as the filter has partitions.  The output for a block
+is the sum of each partition's spectrum times that of the input the
+same number of blocks back, transformed back to time, of which the
+second half is free of wrap-around.  Filters of tens of thousands of
+taps so cost little more per sample than short ones, and as the state
+is all in the convolver, channels can be filtered on different threads.
+
+*//****************************************************************//**
+
+\class PartitionedFilter
+\brief The partition spectra of an impulse response, shared by the
+PartitionedConvolvers that use it.
+
+*//*******************************************************************/
+
+#include "PartitionedConvolver.h"
+
+#include <string.h>
+
+#include <wx/debug.h>
+#include <wx/defs.h>
+
+// RealFFTf leaves the bins in bit-reversed order, but InverseRealFFTf
+// wants them in order; products are summed in the latter
+static void UnscrambleSpectrum(HFFT hFFT, const float *in, float *out)
+{
+   out[0] = in[0];
+   out[1] = in[1];
+   for (int i = 1; i < hFFT->Points; i++)
+   {
+      out[2 * i] = in[hFFT->BitReversed[i]];
+      out[2 * i + 1] = in[hFFT->BitReversed[i] + 1];
+   }
+}
+
+PartitionedFilter::PartitionedFilter(const float *taps, int numTaps, int blockSize)
+{
+   int fftLen = 2 * blockSize;
+
+   mBlockSize = blockSize;
+   mNumTaps = numTaps;
+   mNumPartitions = wxMax(1, (numTaps + blockSize - 1) / blockSize);
+   mPlan = FFTPlanner::Get().GetPlan(fftLen);
+   mSpectra.resize(mNumPartitions * fftLen);
+
+   std::vector<float> buffer(fftLen);
+   for (int p = 0; p < mNumPartitions; p++)
+   {
+      int first = p * blockSize;
+      int count = wxMin(blockSize, numTaps - first);
+
+      // Each partition is zero-padded to the transform length
+      for (int i = 0; i < fftLen; i++)
+      {
+         buffer[i] = (i < count ? taps[first + i] : 0.0f);
+      }
+
+      mPlan->Forward(&buffer[0]);
+      UnscrambleSpectrum(mPlan->GetTables(), &buffer[0], &mSpectra[p * fftLen]);
+   }
+}
+
+PartitionedConvolver::PartitionedConvolver(const PartitionedFilter *filter)
+{
+   mFilter = filter;
+   mBlockSize = filter->GetBlockSize();
+
+   mInput.resize(2 * mBlockSize);
+   mOutput.resize(mBlockSize);
+   mWork.resize(2 * mBlockSize);
+   mSum.resize(2 * mBlockSize);
+
+   mNumHistory = filter->GetNumPartitions();
+   mHistory.resize(mNumHistory * 2 * mBlockSize);
+
+   Reset();
+}
+
+void PartitionedConvolver::SetFilter(const PartitionedFilter *filter)
+{
+   wxASSERT(filter->GetBlockSize() == mBlockSize);
+
+   mFilter = filter;
+
+   int numHistory = filter->GetNumPartitions();
+   if (numHistory == mNumHistory)
+   {
+      return;
+   }
+
+   // Keep the newest spectra that the new filter has partitions for
+   int fftLen = 2 * mBlockSize;
+   std::vector<float> history(numHistory * fftLen, 0.0f);
+   for (int k = 0; k < wxMin(numHistory, mNumHistory); k++)
+   {
+      int from = (mNewest - k + mNumHistory) % mNumHistory;
+      int to = (numHistory - k) % numHistory;
+      memcpy(&history[to * fftLen], &mHistory[from * fftLen], sizeof(float) * fftLen);
+   }
+
+   mHistory.swap(history);
+   mNumHistory = numHistory;
+   mNewest = 0;
+}
+
+void PartitionedConvolver::Reset()
+{
+   memset(&mInput[0], 0, sizeof(float) * mInput.size());
+   memset(&mOutput[0], 0, sizeof(float) * mOutput.size());
+   memset(&mHistory[0], 0, sizeof(float) * mHistory.size());
+   mPos = 0;
+   mNewest = 0;
+}
+
+void PartitionedConvolver::Process(const float *in, float *out, int len)
+{
+   float *input = &mInput[mBlockSize];
+
+   int done = 0;
+   while (done < len)
+   {
+      int count = wxMin(len - done, mBlockSize - mPos);
+
+      // Take each output sample before its input, in case they share
+      for (int i = 0; i < count; i++)
+      {
+         float sample = in[done + i];
+         out[done + i] = mOutput[mPos + i];
+         input[mPos + i] = sample;
+      }
+
+      mPos += count;
+      done += count;
+
+      if (mPos == mBlockSize)
+      {
+         ProcessBlock();
+         mPos = 0;
+      }
+   }
+}
+
+void PartitionedConvolver::ProcessBlock()
+{
+   const FFTPlan *plan = mFilter->mPlan;
+   HFFT hFFT = plan->GetTables();
+   int fftLen = 2 * mBlockSize;
+
+   memcpy(&mWork[0], &mInput[0], sizeof(float) * fftLen);
+   plan->Forward(&mWork[0]);
+
+   mNewest = (mNewest + 1) % mNumHistory;
+   UnscrambleSpectrum(hFFT, &mWork[0], &mHistory[mNewest * fftLen]);
+
+   // Partition p meets the input from p blocks ago
+   float *sum = &mSum[0];
+   memset(sum, 0, sizeof(float) * fftLen);
+   for (int p = 0; p < mNumHistory; p++)
+   {
+      const float *x = &mHistory[((mNewest - p + mNumHistory) % mNumHistory) * fftLen];
+      const float *h = &mFilter->mSpectra[p * fftLen];
+
+      // DC and Nyquist are real
+      sum[0] += x[0] * h[0];
+      sum[1] += x[1] * h[1];
+      for (int k = 2; k < fftLen; k += 2)
+      {
+         sum[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+         sum[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+      }
+   }
+
+   plan->Inverse(sum);
+   ReorderToTime(hFFT, sum, &mWork[0]);
+
+   // The first half has wrapped around; the second is this block's output
+   memcpy(&mOutput[0], &mWork[mBlockSize], sizeof(float) * mBlockSize);
+
+   // This block becomes the previous one
+   memcpy(&mInput[0], &mInput[mBlockSize], sizeof(float) * mBlockSize);
+}
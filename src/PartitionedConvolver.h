@@ -0,0 +1,86 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolver.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PARTITIONED_CONVOLVER__
+#define __AUDACITY_PARTITIONED_CONVOLVER__
+
+#include <vector>
+
+#include "Audacity.h"
+#include "Experimental.h"
+#include "FFTPlanner.h"
+
+/// An impulse response cut into partitions of one block each, kept as
+/// their spectra.  It never changes once made, so any number of
+/// PartitionedConvolvers on any threads can share one.
+class AUDACITY_DLL_API PartitionedFilter
+{
+ public:
+   /// blockSize must be a power of two
+   PartitionedFilter(const float *taps, int numTaps, int blockSize);
+
+   int GetBlockSize() const { return mBlockSize; }
+   int GetNumTaps() const { return mNumTaps; }
+   int GetNumPartitions() const { return mNumPartitions; }
+
+ private:
+   friend class PartitionedConvolver;
+
+   int mBlockSize;
+   int mNumTaps;
+   int mNumPartitions;
+   const FFTPlan *mPlan;       // of twice the block size
+
+   // mNumPartitions spectra of 2 * mBlockSize floats each: DC and
+   // Nyquist, then the real and imaginary parts of the other bins
+   std::vector<float> mSpectra;
+};
+
+/// Convolves one channel with a PartitionedFilter.  The cost of a block
+/// is two FFTs and one multiply-add per partition, however long the
+/// filter, and the output lags the input by one block.
+class AUDACITY_DLL_API PartitionedConvolver
+{
+ public:
+   PartitionedConvolver(const PartitionedFilter *filter);
+
+   /// Uses filter from the next block on, keeping the input heard so
+   /// far.  It must have the same block size as the one it replaces.
+   void SetFilter(const PartitionedFilter *filter);
+   const PartitionedFilter *GetFilter() const { return mFilter; }
+
+   /// Forgets the input, as if just made
+   void Reset();
+
+   /// Samples by which the output lags the input
+   int GetLatency() const { return mBlockSize; }
+
+   /// Filters len samples of in into out, which may be the same buffer
+   void Process(const float *in, float *out, int len);
+
+ private:
+   void ProcessBlock();
+
+   const PartitionedFilter *mFilter;
+   int mBlockSize;
+
+   std::vector<float> mInput;    // the last two blocks of input
+   std::vector<float> mOutput;   // the output for the block being filled
+   int mPos;                     // samples of the current block so far
+
+   // Spectra of the latest input blocks, newest at mNewest, one for
+   // each partition of the filter
+   std::vector<float> mHistory;
+   int mNumHistory;
+   int mNewest;
+
+   std::vector<float> mWork;
+   std::vector<float> mSum;
+};
+
+#endif
@@ -14,6 +14,7 @@
 *//*******************************************************************/
 
 #include <algorithm>
+#include <set>
 
 #include "Audacity.h"
 
@@ -23,6 +24,7 @@
 #include <wx/dynarray.h>
 #include <wx/dynlib.h>
 #include <wx/hashmap.h>
+#include <wx/filefn.h>
 #include <wx/filename.h>
 #include <wx/list.h>
 #include <wx/listctrl.h>
@@ -1451,12 +1453,183 @@ void PluginManager::FindFilesInPathList(const wxString & pattern,
    for (size_t i = 0, cnt = paths.GetCount(); i < cnt; i++)
    {
       f = paths[i] + wxFILE_SEP_PATH + pattern;
-      wxDir::GetAllFiles(f.GetPath(), &files, f.GetFullName(), directories ? wxDIR_DEFAULT : wxDIR_FILES);
+      ScanPath(f.GetPath(), f.GetFullName(), directories, files);
    }
 
    return;
 }
 
+// The modification time and size of a directory, which change when
+// entries are added to or removed from it
+static wxString DirStamp(const wxString & dir)
+{
+   wxStructStat st;
+   if (wxStat(dir, &st) != 0)
+   {
+      return wxT("-");
+   }
+
+   return wxString::Format(wxT("%lld:%lld"), (long long) st.st_mtime, (long long) st.st_size);
+}
+
+static void ScanDirectory(const wxString & dir, const wxString & spec, bool recursive, PluginScan & scan)
+{
+   // Note even directories that don't exist, so that their appearance is seen
+   scan.dirs.Add(dir);
+   scan.stamps.Add(DirStamp(dir));
+
+   wxDir d(dir);
+   if (!d.IsOpened())
+   {
+      return;
+   }
+
+   // The same files and directories as wxDir::GetAllFiles() would give
+   wxString name;
+   int flags = recursive ? wxDIR_FILES | wxDIR_HIDDEN : wxDIR_FILES;
+   for (bool cont = d.GetFirst(&name, spec, flags); cont; cont = d.GetNext(&name))
+   {
+      scan.files.Add(dir + wxFILE_SEP_PATH + name);
+   }
+
+   if (recursive)
+   {
+      wxArrayString subdirs;
+      for (bool cont = d.GetFirst(&name, wxEmptyString, wxDIR_DIRS | wxDIR_HIDDEN); cont; cont = d.GetNext(&name))
+      {
+         subdirs.Add(dir + wxFILE_SEP_PATH + name);
+      }
+
+      for (size_t i = 0, cnt = subdirs.GetCount(); i < cnt; i++)
+      {
+         ScanDirectory(subdirs[i], spec, recursive, scan);
+      }
+   }
+}
+
+void PluginManager::ScanPath(const wxString & dir,
+                             const wxString & spec,
+                             bool recursive,
+                             wxArrayString & files)
+{
+   if (!mScansLoaded)
+   {
+      LoadScanCache();
+   }
+
+   wxString key = wxString::Format(wxT("%s|%s|%d"), dir.c_str(), spec.c_str(), (int) recursive);
+
+   // Reuse the last search if no directory in it has changed since.  A
+   // stat of each directory costs much less than listing them, with the
+   // hundreds of plug-ins some have installed.
+   PluginScanMap::iterator iter = mScans.find(key);
+   if (iter != mScans.end())
+   {
+      PluginScan & scan = iter->second;
+
+      bool current = !scan.dirs.IsEmpty();
+      for (size_t i = 0, cnt = scan.dirs.GetCount(); current && i < cnt; i++)
+      {
+         current = (DirStamp(scan.dirs[i]) == scan.stamps[i]);
+      }
+
+      if (current)
+      {
+         WX_APPEND_ARRAY(files, scan.files);
+         return;
+      }
+   }
+
+   PluginScan & scan = mScans[key];
+   scan.dirs.Clear();
+   scan.stamps.Clear();
+   scan.files.Clear();
+   ScanDirectory(dir, spec, recursive, scan);
+
+   WX_APPEND_ARRAY(files, scan.files);
+
+   mScansDirty = true;
+}
+
+static wxString JoinList(const wxArrayString & list)
+{
+   wxString value;
+   for (size_t i = 0, cnt = list.GetCount(); i < cnt; i++)
+   {
+      value += list[i] + wxT("\n");
+   }
+
+   return value;
+}
+
+static void SplitList(const wxString & value, wxArrayString & list)
+{
+   wxStringTokenizer tkr(value, wxT("\n"));
+   while (tkr.HasMoreTokens())
+   {
+      list.Add(tkr.GetNextToken());
+   }
+}
+
+void PluginManager::LoadScanCache()
+{
+   mScansLoaded = true;
+
+   wxFileConfig cache(wxEmptyString, wxEmptyString, FileNames::PluginScanCache());
+
+   wxString groupName;
+   long groupIndex;
+   wxString cfgPath = wxT("/Scans/");
+
+   cache.SetPath(cfgPath);
+   for (bool cont = cache.GetFirstGroup(groupName, groupIndex);
+        cont;
+        cache.SetPath(cfgPath),
+        cont = cache.GetNextGroup(groupName, groupIndex))
+   {
+      cache.SetPath(groupName);
+
+      PluginScan scan;
+      wxString key = cache.Read(wxT("Key"), wxEmptyString);
+      SplitList(cache.Read(wxT("Dirs"), wxEmptyString), scan.dirs);
+      SplitList(cache.Read(wxT("Stamps"), wxEmptyString), scan.stamps);
+      SplitList(cache.Read(wxT("Files"), wxEmptyString), scan.files);
+
+      // Bypass anything not written by SaveScanCache()
+      if (key.IsEmpty() || scan.dirs.GetCount() != scan.stamps.GetCount())
+      {
+         continue;
+      }
+
+      mScans[key] = scan;
+   }
+}
+
+void PluginManager::SaveScanCache()
+{
+   if (!mScansDirty)
+   {
+      return;
+   }
+
+   wxFileConfig cache(wxEmptyString, wxEmptyString, FileNames::PluginScanCache());
+   cache.DeleteAll();
+
+   int i = 0;
+   for (PluginScanMap::iterator iter = mScans.begin(); iter != mScans.end(); ++iter)
+   {
+      cache.SetPath(wxString::Format(wxT("/Scans/%d"), i++));
+      cache.Write(wxT("Key"), iter->first);
+      cache.Write(wxT("Dirs"), JoinList(iter->second.dirs));
+      cache.Write(wxT("Stamps"), JoinList(iter->second.stamps));
+      cache.Write(wxT("Files"), JoinList(iter->second.files));
+   }
+
+   cache.Flush();
+
+   mScansDirty = false;
+}
+
 bool PluginManager::HasSharedConfigGroup(const PluginID & ID, const wxString & group)
 {
    return HasGroup(SharedGroup(ID, group));
@@ -1657,6 +1830,9 @@ PluginManager *PluginManager::mInstance = NULL;
 PluginManager::PluginManager()
 {
    mSettings = NULL;
+   mScansLoaded = false;
+   mScansDirty = false;
+   mReadOnly = false;
 }
 
 PluginManager::~PluginManager()
@@ -1710,6 +1886,11 @@ void PluginManager::Initialize()
 #endif
 }
 
+void PluginManager::SetReadOnly(bool readOnly)
+{
+   mReadOnly = readOnly;
+}
+
 void PluginManager::Terminate()
 {
    // Get rid of all non-module plugins first
@@ -1744,7 +1925,8 @@ void PluginManager::Load()
    if (!mRegistry->HasGroup(REGROOT))
    {
       // Must start over
-      mRegistry->DeleteAll();
+      if (!mReadOnly)
+         mRegistry->DeleteAll();
       delete mRegistry;
       return;
    }
@@ -2003,6 +2185,11 @@ void PluginManager::LoadGroup(PluginType type)
 
 void PluginManager::Save()
 {
+   if (mReadOnly)
+   {
+      return;
+   }
+
    // Create/Open the registry
    mRegistry = new wxFileConfig(wxEmptyString, wxEmptyString, FileNames::PluginRegistry());
 
@@ -2029,6 +2216,9 @@ void PluginManager::Save()
    mRegistry->Flush();
 
    delete mRegistry;
+
+   // What the searches for plug-ins found, for the next start
+   SaveScanCache();
 }
 
 void PluginManager::SaveGroup(PluginType type)
@@ -2117,7 +2307,9 @@ void PluginManager::CheckForUpdates()
    // Get ModuleManager reference
    ModuleManager & mm = ModuleManager::Get();
 
-   wxArrayString pathIndex;
+   // With hundreds of plug-ins, a linear search of these for each path
+   // found takes noticeable time
+   std::set<wxString> pathIndex;
    for (PluginMap::iterator iter = mPlugins.begin(); iter != mPlugins.end(); ++iter)
    {
       PluginDescriptor & plug = iter->second;
@@ -2128,7 +2320,7 @@ void PluginManager::CheckForUpdates()
          continue;
       }
 
-      pathIndex.Add(plug.GetPath().BeforeFirst(wxT(';')));
+      pathIndex.insert(plug.GetPath().BeforeFirst(wxT(';')));
    }
 
    // Check all known plugins to ensure they are still valid and scan for new ones.
@@ -2169,7 +2361,7 @@ void PluginManager::CheckForUpdates()
             for (size_t i = 0, cnt = paths.GetCount(); i < cnt; i++)
             {
                wxString path = paths[i].BeforeFirst(wxT(';'));;
-               if (pathIndex.Index(path) == wxNOT_FOUND)
+               if (pathIndex.find(path) == pathIndex.end())
                {
                   PluginID ID = plugID + wxT("_") + path;
                   PluginDescriptor & plug = mPlugins[ID];  // This will create a new descriptor
@@ -2496,7 +2688,14 @@ wxFileConfig *PluginManager::GetSettings()
 {
    if (!mSettings)
    {
-      mSettings = new wxFileConfig(wxEmptyString, wxEmptyString, FileNames::PluginSettings());
+      if (mReadOnly)
+      {
+         mSettings = NewReadOnlyConfig(FileNames::PluginSettings());
+      }
+      else
+      {
+         mSettings = new wxFileConfig(wxEmptyString, wxEmptyString, FileNames::PluginSettings());
+      }
 
       // Check for a settings version that we can understand
       if (mSettings->HasEntry(SETVERKEY))
@@ -159,6 +159,18 @@ private:
 
 typedef std::map<PluginID, PluginDescriptor> PluginMap;
 
+// What a search of one directory for plug-in files found, with the
+// stamps (modification time and size) of the directories searched,
+// so that the search need not be repeated while they are unchanged
+struct PluginScan
+{
+   wxArrayString dirs;
+   wxArrayString stamps;
+   wxArrayString files;
+};
+
+typedef std::map<wxString, PluginScan> PluginScanMap;
+
 typedef wxArrayString PluginIDList;
 
 class ProviderMap;
@@ -228,6 +240,10 @@ public:
    void Initialize();
    void Terminate();
 
+   // Never write the registry, settings or scan cache, as when several
+   // copies of Audacity apply chains at once
+   void SetReadOnly(bool readOnly);
+
    static PluginManager & Get();
    static void Destroy();
 
@@ -272,6 +288,10 @@ private:
 
    PluginDescriptor & CreatePlugin(const PluginID & id, IdentInterface *ident, PluginType type);
 
+   void ScanPath(const wxString & dir, const wxString & spec, bool recursive, wxArrayString & files);
+   void LoadScanCache();
+   void SaveScanCache();
+
    wxFileConfig *GetSettings();
 
    bool HasGroup(const wxString & group);
@@ -317,6 +337,12 @@ private:
    PluginMap mPlugins;
    PluginMap::iterator mPluginsIter;
 
+   PluginScanMap mScans;
+   bool mScansLoaded;
+   bool mScansDirty;
+
+   bool mReadOnly;
+
    friend class PluginRegistrationDialog;
 };
 
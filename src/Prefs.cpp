@@ -60,6 +60,7 @@
 #include <wx/fileconf.h>
 #include <wx/filename.h>
 #include <wx/stdpaths.h>
+#include <wx/wfstream.h>
 
 #include "AudacityApp.h"
 #include "FileNames.h"
@@ -128,15 +129,31 @@ static void CopyEntriesRecursive(wxString path, wxConfigBase *src, wxConfigBase
    }
 }
 
-void InitPreferences()
+wxFileConfig *NewReadOnlyConfig(const wxString &path)
+{
+   // With no local file, wxFileConfig::Flush() has nowhere to write
+   if (wxFileExists(path)) {
+      wxFileInputStream in(path);
+      if (in.IsOk())
+         return new wxFileConfig(in);
+   }
+
+   return new wxFileConfig(wxEmptyString, wxEmptyString,
+                           wxEmptyString, wxEmptyString, 0);
+}
+
+void InitPreferences(bool readOnly)
 {
    wxString appName = wxTheApp->GetAppName();
 
    wxFileName configFileName(FileNames::DataDir(), wxT("audacity.cfg"));
 
-   gPrefs = new wxFileConfig(appName, wxEmptyString,
-                             configFileName.GetFullPath(),
-                             wxEmptyString, wxCONFIG_USE_LOCAL_FILE);
+   if (readOnly)
+      gPrefs = NewReadOnlyConfig(configFileName.GetFullPath());
+   else
+      gPrefs = new wxFileConfig(appName, wxEmptyString,
+                                configFileName.GetFullPath(),
+                                wxEmptyString, wxCONFIG_USE_LOCAL_FILE);
 
    wxConfigBase::Set(gPrefs);
 
@@ -34,9 +34,13 @@
 #include <wx/config.h>
 #include <wx/fileconf.h>
 
-void InitPreferences();
+void InitPreferences(bool readOnly = false);
 void FinishPreferences();
 
+/// A wxFileConfig holding what the file at path holds, which never writes
+/// it back, for copies of Audacity that may run beside each other
+wxFileConfig *NewReadOnlyConfig(const wxString &path);
+
 extern AUDACITY_DLL_API wxFileConfig *gPrefs;
 extern int gMenusDirty;
 
@@ -53,6 +53,7 @@ scroll information.  It also has some status flags.
 #include "Project.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 #include <wx/wxprec.h>
 #include <wx/apptrait.h>
@@ -105,6 +106,7 @@ scroll information.  It also has some status flags.
 #include "MixerBoard.h"
 #include "Internat.h"
 #include "import/Import.h"
+#include "import/ImportQueue.h"
 #include "LabelTrack.h"
 #include "Legacy.h"
 #include "Mix.h"
@@ -124,6 +126,7 @@ scroll information.  It also has some status flags.
 #include "widgets/Meter.h"
 #include "widgets/Ruler.h"
 #include "widgets/Warning.h"
+#include "xml/XMLBinaryFile.h"
 #include "xml/XMLFileReader.h"
 #include "PlatformCompatibility.h"
 #include "Experimental.h"
@@ -133,9 +136,15 @@ scroll information.  It also has some status flags.
 #include "ondemand/ODManager.h"
 #include "ondemand/ODTask.h"
 #include "ondemand/ODComputeSummaryTask.h"
-#ifdef EXPERIMENTAL_OD_FLAC
+#ifdef USE_LIBFLAC
 #include "ondemand/ODDecodeFlacTask.h"
 #endif
+#ifdef USE_LIBMAD
+#include "ondemand/ODDecodeMP3Task.h"
+#endif
+#ifdef USE_LIBVORBIS
+#include "ondemand/ODDecodeOggTask.h"
+#endif
 #include "ModuleManager.h"
 
 #include "Theme.h"
@@ -410,10 +419,7 @@ public:
       ODManager::Pause();
 
       sortednames.Sort(CompareNoCaseFileName);
-      for (unsigned int i = 0; i < sortednames.GetCount(); i++) {
-
-         mProject->Import(sortednames[i]);
-      }
+      mProject->ImportFiles(sortednames);
       mProject->HandleResize(); // Adjust scrollers for new track sizes.
 
       ODManager::Resume();
@@ -771,8 +777,10 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
      mKeyboardCaptured(NULL),
      mImportXMLTagHandler(NULL),
      mAutoSaving(false),
+     mAutoSaveJournal(new AutoSaveJournal),
      mIsRecovered(false),
      mRecordingRecoveryHandler(NULL),
+     mJournalRecoveryHandler(NULL),
      mImportedDependencies(false),
      mWantSaveCompressed(false),
      mLastEffect(wxEmptyString),
@@ -1052,6 +1060,8 @@ AudacityProject::~AudacityProject()
                      wxCommandEventHandler(AudacityProject::OnCapture),
                      NULL,
                      this);
+
+   delete mAutoSaveJournal;
 }
 
 AudioIOStartStreamOptions AudacityProject::GetDefaultPlayOptions()
@@ -2183,6 +2193,11 @@ void AudacityProject::OnCloseWindow(wxCloseEvent & event)
    // TODO: Is there a Mac issue here??
    // SetMenuBar(NULL);
 
+   // Keep the waveform summaries of a saved project with it, for the
+   // next time it is opened.  Temporary projects are deleted anyway.
+   if (mLastSavedTracks && !mFileName.IsEmpty())
+      mDirManager->SaveWaveformCache();
+
    // Lock all blocks in all tracks of the last saved version, so that
    // the blockfiles aren't deleted on disk when we delete the blockfiles
    // in memory.  After it's locked, delete the data structure so that
@@ -2596,6 +2611,9 @@ void AudacityProject::OpenFile(wxString fileName, bool addtohistory)
    ff->Close();
    delete ff;
 
+   // Its ident starts as XML does, so it is taken for a project below
+   bool isBinary = (strncmp(buf, XMLBinaryIdent, strlen(XMLBinaryIdent)) == 0);
+
    wxString temp = LAT1CTOWX(buf);
 
    if (temp == wxT("AudacityProject")) {
@@ -2648,9 +2666,18 @@ void AudacityProject::OpenFile(wxString fileName, bool addtohistory)
       }
    }
 
-   XMLFileReader xmlFile;
-
-   bool bParseSuccess = xmlFile.Parse(this, fileName);
+   bool bParseSuccess;
+   wxString parseError;
+   if (isBinary) {
+      XMLBinaryFileReader binaryFile;
+      bParseSuccess = binaryFile.Parse(this, fileName);
+      parseError = binaryFile.GetErrorStr();
+   }
+   else {
+      XMLFileReader xmlFile;
+      bParseSuccess = xmlFile.Parse(this, fileName);
+      parseError = xmlFile.GetErrorStr();
+   }
    if (bParseSuccess) {
       // By making a duplicate set of pointers to the existing blocks
       // on disk, we add one to their reference count, guaranteeing
@@ -2802,8 +2829,8 @@ void AudacityProject::OpenFile(wxString fileName, bool addtohistory)
       mFileName = wxT("");
       SetProjectTitle();
 
-      wxLogError(wxT("Could not parse file \"%s\". \nError: %s"), fileName.c_str(), xmlFile.GetErrorStr().c_str());
-      wxMessageBox(xmlFile.GetErrorStr(),
+      wxLogError(wxT("Could not parse file \"%s\". \nError: %s"), fileName.c_str(), parseError.c_str());
+      wxMessageBox(parseError,
                    _("Error Opening Project"),
                    wxOK | wxCENTRE, this);
    }
@@ -2815,6 +2842,12 @@ void AudacityProject::OpenFile(wxString fileName, bool addtohistory)
       mRecordingRecoveryHandler = NULL;
    }
 
+   if (mJournalRecoveryHandler)
+   {
+      delete mJournalRecoveryHandler;
+      mJournalRecoveryHandler = NULL;
+   }
+
    if (!bParseSuccess)
       return; // No need to do further processing if parse failed.
 
@@ -2851,12 +2884,26 @@ void AudacityProject::OpenFile(wxString fileName, bool addtohistory)
             while((odFlags|createdODTasks) != createdODTasks)
             {
                newTask=NULL;
-#ifdef EXPERIMENTAL_OD_FLAC
+#ifdef USE_LIBFLAC
                if(!(createdODTasks&ODTask::eODFLAC) && odFlags & ODTask::eODFLAC) {
                   newTask= new ODDecodeFlacTask;
                   createdODTasks= createdODTasks | ODTask::eODFLAC;
                }
                else
+#endif
+#ifdef USE_LIBMAD
+               if(!(createdODTasks&ODTask::eODMP3) && odFlags & ODTask::eODMP3) {
+                  newTask= new ODDecodeMP3Task;
+                  createdODTasks= createdODTasks | ODTask::eODMP3;
+               }
+               else
+#endif
+#ifdef USE_LIBVORBIS
+               if(!(createdODTasks&ODTask::eODOGG) && odFlags & ODTask::eODOGG) {
+                  newTask= new ODDecodeOggTask;
+                  createdODTasks= createdODTasks | ODTask::eODOGG;
+               }
+               else
 #endif
                if(!(createdODTasks&ODTask::eODPCMSummary) && odFlags & ODTask::eODPCMSummary) {
                   newTask=new ODComputeSummaryTask;
@@ -3143,6 +3190,12 @@ XMLTagHandler *AudacityProject::HandleXMLChild(const wxChar *tag)
       return mRecordingRecoveryHandler;
    }
 
+   if (!wxStrcmp(tag, wxT("journal"))) {
+      if (!mJournalRecoveryHandler)
+         mJournalRecoveryHandler = new JournalRecoveryHandler(this);
+      return mJournalRecoveryHandler;
+   }
+
    if (!wxStrcmp(tag, wxT("import"))) {
       if (mImportXMLTagHandler == NULL)
          mImportXMLTagHandler = new ImportXMLTagHandler(this);
@@ -3434,17 +3487,30 @@ bool AudacityProject::Save(bool overwrite /* = true */ ,
       }
    }
 
-   // Write the AUP file.
+   // Write the AUP file, as XML or, if asked for, in the binary format
+   // that large projects save and load faster in.
+   bool binary = (gPrefs->Read(wxT("/FileFormats/BinaryProjects"), 0L) != 0);
    XMLFileWriter saveFile;
+   XMLBinaryFileWriter binaryFile;
 
    try
    {
-      saveFile.Open(mFileName, wxT("wb"));
+      if (binary) {
+         binaryFile.Open(mFileName);
 
-      WriteXMLHeader(saveFile);
-      WriteXML(saveFile);
+         WriteXMLHeader(binaryFile);
+         WriteXML(binaryFile);
 
-      saveFile.Close();
+         binaryFile.Close();
+      }
+      else {
+         saveFile.Open(mFileName, wxT("wb"));
+
+         WriteXMLHeader(saveFile);
+         WriteXML(saveFile);
+
+         saveFile.Close();
+      }
    }
    catch (XMLFileWriterException* pException)
    {
@@ -3481,6 +3547,8 @@ bool AudacityProject::Save(bool overwrite /* = true */ ,
       // Now that we have saved the file, we can delete the auto-saved version
       DeleteCurrentAutoSaveFile();
 
+      mDirManager->SaveWaveformCache();
+
       if (mIsRecovered)
       {
          // This was a recovered file, that is, we have just overwritten the
@@ -3730,6 +3798,14 @@ bool AudacityProject::Import(wxString fileName, WaveTrackArray* pTrackArray /*=
    if (numTracks <= 0)
       return false;
 
+   return FinishImport(fileName, newTracks, numTracks, pTrackArray);
+}
+
+// Adds the tracks imported from fileName to the project, as Import() does.
+// Takes ownership of newTracks.
+bool AudacityProject::FinishImport(wxString fileName, Track **newTracks, int numTracks,
+                                   WaveTrackArray *pTrackArray /*= NULL*/)
+{
    wxGetApp().AddFileToHistory(fileName);
 
    // for LOF ("list of files") files, do not import the file as if it
@@ -3763,6 +3839,39 @@ bool AudacityProject::Import(wxString fileName, WaveTrackArray* pTrackArray /*=
    return true;
 }
 
+void AudacityProject::ImportFiles(const wxArrayString &fileNames)
+{
+   ImportQueue queue(mDirManager);
+   for (size_t i = 0; i < fileNames.GetCount(); i++)
+      queue.Add(fileNames[i]);
+
+   mbBusyImporting = true;
+   int result = queue.Import();
+   mbBusyImporting = false;
+
+   // Add the tracks in the order of the files, importing here those the
+   // queue left, unless the user gave up on the whole lot
+   for (size_t i = 0; i < fileNames.GetCount(); i++) {
+      if (!queue.WasHandled(i)) {
+         if (result == eProgressSuccess)
+            Import(fileNames[i]);
+         continue;
+      }
+
+      Track **newTracks;
+      int numTracks = queue.GetTracks(i, &newTracks);
+      if (numTracks <= 0)
+         continue;
+
+      wxString name, value;
+      Tags *tags = queue.GetTags(i);
+      for (bool more = tags->GetFirst(name, value); more; more = tags->GetNext(name, value))
+         mTags->SetTag(name, value);
+
+      FinishImport(fileNames[i], newTracks, numTracks);
+   }
+}
+
 bool AudacityProject::SaveAs(const wxString & newFileName, bool bWantSaveCompressed /*= false*/, bool addToHistory /*= true*/)
 {
    wxString oldFileName = mFileName;
@@ -4722,6 +4831,11 @@ void AudacityProject::AutoSave()
 {
    //    SonifyBeginAutoSave(); // part of RBD's r10680 stuff now backed out
 
+   // Usually only some tracks have changed since the last auto-save, and
+   // it is enough to append those to the file
+   if (mAutoSaveJournal->Append(this, mAutoSaveFileName))
+      return;
+
    // To minimize the possibility of race conditions, we first write to a
    // file with the extension ".tmp", then rename the file to .autosave
    wxString projName;
@@ -4733,6 +4847,7 @@ void AudacityProject::AutoSave()
 
    wxString fn = wxFileName(FileNames::AutoSaveDir(),
       projName + wxString(wxT(" - ")) + CreateUniqueName()).GetFullPath();
+   wxFileOffset fileSize = 0;
 
    try
    {
@@ -4745,6 +4860,7 @@ void AudacityProject::AutoSave()
       wxFFile saveFile;
       saveFile.Open(fn + wxT(".tmp"), wxT("wb"));
       buffer.Write(saveFile);
+      fileSize = saveFile.Length();
       saveFile.Close();
    }
    catch (XMLFileWriterException* pException)
@@ -4773,6 +4889,7 @@ void AudacityProject::AutoSave()
    }
 
    mAutoSaveFileName += fn + wxT(".autosave");
+   mAutoSaveJournal->Checkpoint(this, fileSize);
    // no-op cruft that's not #ifdefed for NoteTrack
    // See above for further comments.
    //   SonifyEndAutoSave();
@@ -4780,6 +4897,8 @@ void AudacityProject::AutoSave()
 
 void AudacityProject::DeleteCurrentAutoSaveFile()
 {
+   mAutoSaveJournal->Reset();
+
    if (!mAutoSaveFileName.IsEmpty())
    {
       if (wxFileExists(mAutoSaveFileName))
@@ -4868,6 +4987,10 @@ void AudacityProject::OnAudioIONewBlockFiles(const AutoSaveFile & blockFileLog)
          return; // Keep recording going, there's not much we can do here
       blockFileLog.Append(f);
       f.Close();
+
+      // Recovery must replay these before any later changes to the
+      // tracks, so write the whole file at the next auto-save
+      mAutoSaveJournal->Reset();
    }
 }
 
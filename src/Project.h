@@ -52,7 +52,9 @@ class wxPanel;
 
 class AudacityProject;
 class AutoSaveFile;
+class AutoSaveJournal;
 class Importer;
+class JournalRecoveryHandler;
 class ODLock;
 class RecordingRecoveryHandler;
 class TrackList;
@@ -215,9 +217,14 @@ class AUDACITY_DLL_API AudacityProject:  public wxFrame,
 
    // If pNewTrackList is passed in non-NULL, it gets filled with the pointers to new tracks.
    bool Import(wxString fileName, WaveTrackArray *pTrackArray = NULL);
+   // Imports the files in the given order, several at once where their
+   // importers allow it.
+   void ImportFiles(const wxArrayString &fileNames);
 
    void AddImportedTracks(wxString fileName,
                           Track **newTracks, int numTracks);
+   bool FinishImport(wxString fileName, Track **newTracks, int numTracks,
+                     WaveTrackArray *pTrackArray = NULL);
    void LockAllBlocks();
    void UnlockAllBlocks();
    bool Save(bool overwrite = true, bool fromSaveAs = false, bool bWantSaveCompressed = false);
@@ -606,6 +613,9 @@ class AUDACITY_DLL_API AudacityProject:  public wxFrame,
    // Are we currently auto-saving or not?
    bool mAutoSaving;
 
+   // The tracks in the auto-save file, to append changes to them
+   AutoSaveJournal* mAutoSaveJournal;
+
    // Has this project been recovered from an auto-saved version
    bool mIsRecovered;
 
@@ -615,6 +625,9 @@ class AUDACITY_DLL_API AudacityProject:  public wxFrame,
    // The handler that handles recovery of <recordingrecovery> tags
    RecordingRecoveryHandler* mRecordingRecoveryHandler;
 
+   // The handler that handles recovery of <journal> tags
+   JournalRecoveryHandler* mJournalRecoveryHandler;
+
    // Dependencies have been imported and a warning should be shown on save
    bool mImportedDependencies;
 
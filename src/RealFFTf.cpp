@@ -193,8 +193,6 @@ void RealFFTf(fft_type *buffer,HFFT h)
    fft_type *A,*B;
    fft_type *sptr;
    fft_type *endptr1,*endptr2;
-   int *br1,*br2;
-   fft_type HRplus,HRminus,HIplus,HIminus;
    fft_type v1,v2,sin,cos;
 
    int ButterfliesPerGroup=h->Points/2;
@@ -235,6 +233,21 @@ void RealFFTf(fft_type *buffer,HFFT h)
       }
       ButterfliesPerGroup >>= 1;
    }
+
+   RealFromComplexSpectrum(buffer, h);
+}
+
+/*
+*  Turns the complex transform of the even and odd samples, as left by
+*  the butterflies, into the first half of the spectrum of the real input
+*/
+void RealFromComplexSpectrum(fft_type *buffer, HFFT h)
+{
+   fft_type *A,*B;
+   int *br1,*br2;
+   fft_type HRplus,HRminus,HIplus,HIminus;
+   fft_type v1,v2,sin,cos;
+
    /* Massage output to get the output for a real input sequence. */
    br1=h->BitReversed+1;
    br2=h->BitReversed+h->Points-1;
@@ -295,12 +308,60 @@ void InverseRealFFTf(fft_type *buffer,HFFT h)
    fft_type *A,*B;
    fft_type *sptr;
    fft_type *endptr1,*endptr2;
-   int *br1;
-   fft_type HRplus,HRminus,HIplus,HIminus;
    fft_type v1,v2,sin,cos;
 
    int ButterfliesPerGroup=h->Points/2;
 
+   ComplexFromRealSpectrum(buffer, h);
+
+   /*
+   *  Butterfly:
+   *     Ain-----Aout
+   *         \ /
+   *         / \
+   *     Bin-----Bout
+   */
+
+   endptr1=buffer+h->Points*2;
+
+   while(ButterfliesPerGroup>0)
+   {
+      A=buffer;
+      B=buffer+ButterfliesPerGroup*2;
+      sptr=h->SinTable;
+
+      while(A<endptr1)
+      {
+         sin=*(sptr++);
+         cos=*(sptr++);
+         endptr2=B;
+         while(A<endptr2)
+         {
+            v1=*B*cos - *(B+1)*sin;
+            v2=*B*sin + *(B+1)*cos;
+            *B=(*A+v1)*(fft_type)0.5;
+            *(A++)=*(B++)-v1;
+            *B=(*A+v2)*(fft_type)0.5;
+            *(A++)=*(B++)-v2;
+         }
+         A=B;
+         B+=ButterfliesPerGroup*2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+}
+
+/*
+*  The reverse of RealFromComplexSpectrum: makes the input for the
+*  butterflies from the first half of the spectrum of a real sequence
+*/
+void ComplexFromRealSpectrum(fft_type *buffer, HFFT h)
+{
+   fft_type *A,*B;
+   int *br1;
+   fft_type HRplus,HRminus,HIplus,HIminus;
+   fft_type v1,v2,sin,cos;
+
    /* Massage input to get the input for a real output sequence. */
    A=buffer+2;
    B=buffer+h->Points*2-2;
@@ -335,41 +396,164 @@ void InverseRealFFTf(fft_type *buffer,HFFT h)
    v2=0.5f*(buffer[0]-buffer[1]);
    buffer[0]=v1;
    buffer[1]=v2;
+}
 
-   /*
-   *  Butterfly:
-   *     Ain-----Aout
-   *         \ /
-   *         / \
-   *     Bin-----Bout
-   */
+/*
+*  Radix-4 versions of RealFFTf and InverseRealFFTf.
+*
+*  These do two of the butterfly stages above in each pass over the
+*  buffer, so a large transform is read from and written to memory half
+*  as many times, with the four values of each pair of stages held in
+*  registers.  The tables, the bit-reversed order of the output and the
+*  scaling are the same, so the results can be used interchangeably.
+*/
+void RealFFTfRadix4(fft_type *buffer,HFFT h)
+{
+   int half=h->Points/2;
+   fft_type *endptr=buffer+h->Points*2;
+   const fft_type *table=h->SinTable;
+
+   // An odd number of stages leaves one to do alone
+   int stages=0;
+   for(int n=h->Points; n>1; n>>=1)
+      stages++;
+   if(stages&1)
+   {
+      const fft_type *sptr=table;
+      for(fft_type *A=buffer; A<endptr; A+=half*4, sptr+=2)
+      {
+         fft_type sin=sptr[0], cos=sptr[1];
+         fft_type *B=A+half*2;
+         for(int j=0; j<half*2; j+=2)
+         {
+            fft_type v1=B[j]*cos + B[j+1]*sin;
+            fft_type v2=B[j]*sin - B[j+1]*cos;
+            fft_type ar=A[j], ai=A[j+1];
+            B[j]=ar+v1;
+            A[j]=ar-v1;
+            B[j+1]=ai-v2;
+            A[j+1]=ai+v2;
+         }
+      }
+      half>>=1;
+   }
 
-   endptr1=buffer+h->Points*2;
+   // Then each pass does the stages of half and of half/2 butterflies
+   // per group; group g of the first uses twiddle g, and its two halves
+   // are groups 2g and 2g+1 of the second
+   for(; half>1; half>>=2)
+   {
+      int quarter=half/2;
+      int g=0;
+      for(fft_type *A=buffer; A<endptr; A+=half*4, g++)
+      {
+         fft_type s0=table[2*g], c0=table[2*g+1];
+         fft_type s1=table[4*g], c1=table[4*g+1];
+         fft_type s2=table[4*g+2], c2=table[4*g+3];
+         fft_type *P1=A+quarter*2, *P2=A+half*2, *P3=P2+quarter*2;
+         for(int j=0; j<quarter*2; j+=2)
+         {
+            fft_type x0r=A[j], x0i=A[j+1];
+            fft_type x1r=P1[j], x1i=P1[j+1];
+            fft_type x2r=P2[j], x2i=P2[j+1];
+            fft_type x3r=P3[j], x3i=P3[j+1];
+            fft_type v1, v2;
+
+            // First stage: 0 with 2 and 1 with 3
+            v1=x2r*c0 + x2i*s0;
+            v2=x2r*s0 - x2i*c0;
+            x2r=x0r+v1; x0r-=v1;
+            x2i=x0i-v2; x0i+=v2;
+            v1=x3r*c0 + x3i*s0;
+            v2=x3r*s0 - x3i*c0;
+            x3r=x1r+v1; x1r-=v1;
+            x3i=x1i-v2; x1i+=v2;
+
+            // Second stage: 0 with 1 and 2 with 3
+            v1=x1r*c1 + x1i*s1;
+            v2=x1r*s1 - x1i*c1;
+            P1[j]=x0r+v1; A[j]=x0r-v1;
+            P1[j+1]=x0i-v2; A[j+1]=x0i+v2;
+            v1=x3r*c2 + x3i*s2;
+            v2=x3r*s2 - x3i*c2;
+            P3[j]=x2r+v1; P2[j]=x2r-v1;
+            P3[j+1]=x2i-v2; P2[j+1]=x2i+v2;
+         }
+      }
+   }
 
-   while(ButterfliesPerGroup>0)
+   RealFromComplexSpectrum(buffer, h);
+}
+
+void InverseRealFFTfRadix4(fft_type *buffer,HFFT h)
+{
+   int half=h->Points/2;
+   fft_type *endptr=buffer+h->Points*2;
+   const fft_type *table=h->SinTable;
+
+   ComplexFromRealSpectrum(buffer, h);
+
+   int stages=0;
+   for(int n=h->Points; n>1; n>>=1)
+      stages++;
+   if(stages&1)
    {
-      A=buffer;
-      B=buffer+ButterfliesPerGroup*2;
-      sptr=h->SinTable;
+      const fft_type *sptr=table;
+      for(fft_type *A=buffer; A<endptr; A+=half*4, sptr+=2)
+      {
+         fft_type sin=sptr[0], cos=sptr[1];
+         fft_type *B=A+half*2;
+         for(int j=0; j<half*2; j+=2)
+         {
+            fft_type v1=B[j]*cos - B[j+1]*sin;
+            fft_type v2=B[j]*sin + B[j+1]*cos;
+            fft_type ar=A[j], ai=A[j+1];
+            B[j]=(ar+v1)*(fft_type)0.5;
+            A[j]=(ar-v1)*(fft_type)0.5;
+            B[j+1]=(ai+v2)*(fft_type)0.5;
+            A[j+1]=(ai-v2)*(fft_type)0.5;
+         }
+      }
+      half>>=1;
+   }
 
-      while(A<endptr1)
+   for(; half>1; half>>=2)
+   {
+      int quarter=half/2;
+      int g=0;
+      for(fft_type *A=buffer; A<endptr; A+=half*4, g++)
       {
-         sin=*(sptr++);
-         cos=*(sptr++);
-         endptr2=B;
-         while(A<endptr2)
+         fft_type s0=table[2*g], c0=table[2*g+1];
+         fft_type s1=table[4*g], c1=table[4*g+1];
+         fft_type s2=table[4*g+2], c2=table[4*g+3];
+         fft_type *P1=A+quarter*2, *P2=A+half*2, *P3=P2+quarter*2;
+         for(int j=0; j<quarter*2; j+=2)
          {
-            v1=*B*cos - *(B+1)*sin;
-            v2=*B*sin + *(B+1)*cos;
-            *B=(*A+v1)*(fft_type)0.5;
-            *(A++)=*(B++)-v1;
-            *B=(*A+v2)*(fft_type)0.5;
-            *(A++)=*(B++)-v2;
+            fft_type x0r=A[j], x0i=A[j+1];
+            fft_type x1r=P1[j], x1i=P1[j+1];
+            fft_type x2r=P2[j], x2i=P2[j+1];
+            fft_type x3r=P3[j], x3i=P3[j+1];
+            fft_type v1, v2;
+
+            v1=x2r*c0 - x2i*s0;
+            v2=x2r*s0 + x2i*c0;
+            x2r=(x0r+v1)*(fft_type)0.5; x0r=(x0r-v1)*(fft_type)0.5;
+            x2i=(x0i+v2)*(fft_type)0.5; x0i=(x0i-v2)*(fft_type)0.5;
+            v1=x3r*c0 - x3i*s0;
+            v2=x3r*s0 + x3i*c0;
+            x3r=(x1r+v1)*(fft_type)0.5; x1r=(x1r-v1)*(fft_type)0.5;
+            x3i=(x1i+v2)*(fft_type)0.5; x1i=(x1i-v2)*(fft_type)0.5;
+
+            v1=x1r*c1 - x1i*s1;
+            v2=x1r*s1 + x1i*c1;
+            P1[j]=(x0r+v1)*(fft_type)0.5; A[j]=(x0r-v1)*(fft_type)0.5;
+            P1[j+1]=(x0i+v2)*(fft_type)0.5; A[j+1]=(x0i-v2)*(fft_type)0.5;
+            v1=x3r*c2 - x3i*s2;
+            v2=x3r*s2 + x3i*c2;
+            P3[j]=(x2r+v1)*(fft_type)0.5; P2[j]=(x2r-v1)*(fft_type)0.5;
+            P3[j+1]=(x2i+v2)*(fft_type)0.5; P2[j+1]=(x2i-v2)*(fft_type)0.5;
          }
-         A=B;
-         B+=ButterfliesPerGroup*2;
       }
-      ButterfliesPerGroup >>= 1;
    }
 }
 
@@ -19,6 +19,14 @@ void ReleaseFFT(HFFT);
 void CleanupFFT();
 void RealFFTf(fft_type *,HFFT);
 void InverseRealFFTf(fft_type *,HFFT);
+void RealFFTfRadix4(fft_type *,HFFT);
+void InverseRealFFTfRadix4(fft_type *,HFFT);
+/* The same, eight floats at a time; only where GetSIMDLevel() is SIMD_AVX2 */
+void RealFFTfRadix4AVX2(fft_type *,HFFT);
+void InverseRealFFTfRadix4AVX2(fft_type *,HFFT);
+/* The steps around the butterflies, for other versions of them */
+void RealFromComplexSpectrum(fft_type *,HFFT);
+void ComplexFromRealSpectrum(fft_type *,HFFT);
 void ReorderToTime(HFFT hFFT, fft_type *buffer, fft_type *TimeOut);
 void ReorderToFreq(HFFT hFFT, fft_type *buffer, fft_type *RealOut, fft_type *ImagOut);
 
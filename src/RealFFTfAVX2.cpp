@@ -0,0 +1,280 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  RealFFTfAVX2.cpp
+
+*******************************************************************//*!
+
+\file RealFFTfAVX2.cpp
+\brief AVX2 versions of RealFFTfRadix4() and InverseRealFFTfRadix4().
+
+  The butterflies of one group share their twiddle factor, so four of
+  them, which are eight interleaved floats, are done at once.  With the
+  complex values x = (r, i) and the twiddle (c, s), a forward butterfly
+  needs w = (r*c + i*s, -(r*s - i*c)): the products x*c, and x with its
+  halves swapped times s, added in the even lanes and subtracted in the
+  odd ones.  The inverse one needs (r*c - i*s, r*s + i*c), the other way
+  round, which is just what addsub does.  Passes with fewer than four
+  butterflies in a group, at the end of the transform, are done as in
+  RealFFTf.cpp.  The arithmetic is the same, in the same order, so the
+  results match the plain versions but for the rounding of fused
+  multiply-adds, which are not used.
+
+*//*******************************************************************/
+
+#include "CPUFeatures.h"
+#include "RealFFTf.h"
+
+#if defined(AUDACITY_X86_SIMD)
+
+//////////////////////////////////////////////////////////////////////////
+// One butterfly, as in RealFFTf.cpp, for groups too small for vectors
+
+static inline void Forward1(fft_type *A, fft_type *B, fft_type sin, fft_type cos)
+{
+   fft_type v1=B[0]*cos + B[1]*sin;
+   fft_type v2=B[0]*sin - B[1]*cos;
+   fft_type ar=A[0], ai=A[1];
+   B[0]=ar+v1;
+   A[0]=ar-v1;
+   B[1]=ai-v2;
+   A[1]=ai+v2;
+}
+
+static inline void Inverse1(fft_type *A, fft_type *B, fft_type sin, fft_type cos)
+{
+   fft_type v1=B[0]*cos - B[1]*sin;
+   fft_type v2=B[0]*sin + B[1]*cos;
+   fft_type ar=A[0], ai=A[1];
+   B[0]=(ar+v1)*(fft_type)0.5;
+   A[0]=(ar-v1)*(fft_type)0.5;
+   B[1]=(ai+v2)*(fft_type)0.5;
+   A[1]=(ai-v2)*(fft_type)0.5;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Four butterflies
+
+// (r*c + i*s, i*c - r*s) for each of the four complex values of x
+SIMD_TARGET("avx2")
+static inline __m256 ForwardTwiddle(__m256 x, __m256 c, __m256 negS)
+{
+   __m256 swapped = _mm256_permute_ps(x, 0xB1);
+   return _mm256_addsub_ps(_mm256_mul_ps(x, c), _mm256_mul_ps(swapped, negS));
+}
+
+// (r*c - i*s, i*c + r*s) for each of the four complex values of x
+SIMD_TARGET("avx2")
+static inline __m256 InverseTwiddle(__m256 x, __m256 c, __m256 s)
+{
+   __m256 swapped = _mm256_permute_ps(x, 0xB1);
+   return _mm256_addsub_ps(_mm256_mul_ps(x, c), _mm256_mul_ps(swapped, s));
+}
+
+// Butterflies of one group of count (a multiple of four) in one stage
+SIMD_TARGET("avx2")
+static void ForwardStage(fft_type *A, fft_type *B, int count,
+                         fft_type sin, fft_type cos)
+{
+   __m256 c = _mm256_set1_ps(cos);
+   __m256 negS = _mm256_set1_ps(-sin);
+   for (int j = 0; j < count * 2; j += 8) {
+      __m256 a = _mm256_loadu_ps(A + j);
+      __m256 w = ForwardTwiddle(_mm256_loadu_ps(B + j), c, negS);
+      _mm256_storeu_ps(B + j, _mm256_add_ps(a, w));
+      _mm256_storeu_ps(A + j, _mm256_sub_ps(a, w));
+   }
+}
+
+SIMD_TARGET("avx2")
+static void InverseStage(fft_type *A, fft_type *B, int count,
+                         fft_type sin, fft_type cos)
+{
+   __m256 c = _mm256_set1_ps(cos);
+   __m256 s = _mm256_set1_ps(sin);
+   __m256 half = _mm256_set1_ps(0.5f);
+   for (int j = 0; j < count * 2; j += 8) {
+      __m256 a = _mm256_loadu_ps(A + j);
+      __m256 w = InverseTwiddle(_mm256_loadu_ps(B + j), c, s);
+      _mm256_storeu_ps(B + j, _mm256_mul_ps(_mm256_add_ps(a, w), half));
+      _mm256_storeu_ps(A + j, _mm256_mul_ps(_mm256_sub_ps(a, w), half));
+   }
+}
+
+// The two stages of one radix-4 group of quarter (a multiple of four)
+// butterflies each, as in RealFFTfRadix4()
+SIMD_TARGET("avx2")
+static void ForwardRadix4Group(fft_type *A, int quarter, const fft_type *tw)
+{
+   __m256 c0 = _mm256_set1_ps(tw[1]), negS0 = _mm256_set1_ps(-tw[0]);
+   __m256 c1 = _mm256_set1_ps(tw[3]), negS1 = _mm256_set1_ps(-tw[2]);
+   __m256 c2 = _mm256_set1_ps(tw[5]), negS2 = _mm256_set1_ps(-tw[4]);
+   fft_type *P1 = A + quarter * 2, *P2 = A + quarter * 4, *P3 = A + quarter * 6;
+
+   for (int j = 0; j < quarter * 2; j += 8) {
+      __m256 x0 = _mm256_loadu_ps(A + j);
+      __m256 x1 = _mm256_loadu_ps(P1 + j);
+      __m256 x2 = _mm256_loadu_ps(P2 + j);
+      __m256 x3 = _mm256_loadu_ps(P3 + j);
+      __m256 w;
+
+      // First stage: 0 with 2 and 1 with 3
+      w = ForwardTwiddle(x2, c0, negS0);
+      x2 = _mm256_add_ps(x0, w);
+      x0 = _mm256_sub_ps(x0, w);
+      w = ForwardTwiddle(x3, c0, negS0);
+      x3 = _mm256_add_ps(x1, w);
+      x1 = _mm256_sub_ps(x1, w);
+
+      // Second stage: 0 with 1 and 2 with 3
+      w = ForwardTwiddle(x1, c1, negS1);
+      _mm256_storeu_ps(P1 + j, _mm256_add_ps(x0, w));
+      _mm256_storeu_ps(A + j, _mm256_sub_ps(x0, w));
+      w = ForwardTwiddle(x3, c2, negS2);
+      _mm256_storeu_ps(P3 + j, _mm256_add_ps(x2, w));
+      _mm256_storeu_ps(P2 + j, _mm256_sub_ps(x2, w));
+   }
+}
+
+SIMD_TARGET("avx2")
+static void InverseRadix4Group(fft_type *A, int quarter, const fft_type *tw)
+{
+   __m256 c0 = _mm256_set1_ps(tw[1]), s0 = _mm256_set1_ps(tw[0]);
+   __m256 c1 = _mm256_set1_ps(tw[3]), s1 = _mm256_set1_ps(tw[2]);
+   __m256 c2 = _mm256_set1_ps(tw[5]), s2 = _mm256_set1_ps(tw[4]);
+   __m256 half = _mm256_set1_ps(0.5f);
+   fft_type *P1 = A + quarter * 2, *P2 = A + quarter * 4, *P3 = A + quarter * 6;
+
+   for (int j = 0; j < quarter * 2; j += 8) {
+      __m256 x0 = _mm256_loadu_ps(A + j);
+      __m256 x1 = _mm256_loadu_ps(P1 + j);
+      __m256 x2 = _mm256_loadu_ps(P2 + j);
+      __m256 x3 = _mm256_loadu_ps(P3 + j);
+      __m256 w;
+
+      w = InverseTwiddle(x2, c0, s0);
+      x2 = _mm256_mul_ps(_mm256_add_ps(x0, w), half);
+      x0 = _mm256_mul_ps(_mm256_sub_ps(x0, w), half);
+      w = InverseTwiddle(x3, c0, s0);
+      x3 = _mm256_mul_ps(_mm256_add_ps(x1, w), half);
+      x1 = _mm256_mul_ps(_mm256_sub_ps(x1, w), half);
+
+      w = InverseTwiddle(x1, c1, s1);
+      _mm256_storeu_ps(P1 + j, _mm256_mul_ps(_mm256_add_ps(x0, w), half));
+      _mm256_storeu_ps(A + j, _mm256_mul_ps(_mm256_sub_ps(x0, w), half));
+      w = InverseTwiddle(x3, c2, s2);
+      _mm256_storeu_ps(P3 + j, _mm256_mul_ps(_mm256_add_ps(x2, w), half));
+      _mm256_storeu_ps(P2 + j, _mm256_mul_ps(_mm256_sub_ps(x2, w), half));
+   }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Whole transforms, in the order of RealFFTfRadix4()
+
+// Twiddles of radix-4 group g: that of the first stage, then those of
+// the two groups it becomes in the second
+static inline void GroupTwiddles(const fft_type *table, int g, fft_type tw[6])
+{
+   tw[0] = table[2*g];   tw[1] = table[2*g+1];
+   tw[2] = table[4*g];   tw[3] = table[4*g+1];
+   tw[4] = table[4*g+2]; tw[5] = table[4*g+3];
+}
+
+static int CountStages(HFFT h)
+{
+   int stages = 0;
+   for (int n = h->Points; n > 1; n >>= 1)
+      stages++;
+   return stages;
+}
+
+void RealFFTfRadix4AVX2(fft_type *buffer, HFFT h)
+{
+   int half = h->Points / 2;
+   fft_type *endptr = buffer + h->Points * 2;
+   const fft_type *table = h->SinTable;
+
+   // An odd number of stages leaves one to do alone
+   if (CountStages(h) & 1) {
+      const fft_type *sptr = table;
+      for (fft_type *A = buffer; A < endptr; A += half * 4, sptr += 2) {
+         if (half >= 4)
+            ForwardStage(A, A + half * 2, half, sptr[0], sptr[1]);
+         else
+            for (int j = 0; j < half * 2; j += 2)
+               Forward1(A + j, A + half * 2 + j, sptr[0], sptr[1]);
+      }
+      half >>= 1;
+   }
+
+   for (; half > 1; half >>= 2) {
+      int quarter = half / 2;
+      int g = 0;
+      for (fft_type *A = buffer; A < endptr; A += half * 4, g++) {
+         fft_type tw[6];
+         GroupTwiddles(table, g, tw);
+
+         if (quarter >= 4) {
+            ForwardRadix4Group(A, quarter, tw);
+            continue;
+         }
+
+         // Too few for vectors: the two stages one after the other
+         fft_type *P1 = A + quarter * 2, *P2 = A + half * 2, *P3 = P2 + quarter * 2;
+         for (int j = 0; j < quarter * 2; j += 2) {
+            Forward1(A + j, P2 + j, tw[0], tw[1]);
+            Forward1(P1 + j, P3 + j, tw[0], tw[1]);
+            Forward1(A + j, P1 + j, tw[2], tw[3]);
+            Forward1(P2 + j, P3 + j, tw[4], tw[5]);
+         }
+      }
+   }
+
+   RealFromComplexSpectrum(buffer, h);
+}
+
+void InverseRealFFTfRadix4AVX2(fft_type *buffer, HFFT h)
+{
+   int half = h->Points / 2;
+   fft_type *endptr = buffer + h->Points * 2;
+   const fft_type *table = h->SinTable;
+
+   ComplexFromRealSpectrum(buffer, h);
+
+   if (CountStages(h) & 1) {
+      const fft_type *sptr = table;
+      for (fft_type *A = buffer; A < endptr; A += half * 4, sptr += 2) {
+         if (half >= 4)
+            InverseStage(A, A + half * 2, half, sptr[0], sptr[1]);
+         else
+            for (int j = 0; j < half * 2; j += 2)
+               Inverse1(A + j, A + half * 2 + j, sptr[0], sptr[1]);
+      }
+      half >>= 1;
+   }
+
+   for (; half > 1; half >>= 2) {
+      int quarter = half / 2;
+      int g = 0;
+      for (fft_type *A = buffer; A < endptr; A += half * 4, g++) {
+         fft_type tw[6];
+         GroupTwiddles(table, g, tw);
+
+         if (quarter >= 4) {
+            InverseRadix4Group(A, quarter, tw);
+            continue;
+         }
+
+         fft_type *P1 = A + quarter * 2, *P2 = A + half * 2, *P3 = P2 + quarter * 2;
+         for (int j = 0; j < quarter * 2; j += 2) {
+            Inverse1(A + j, P2 + j, tw[0], tw[1]);
+            Inverse1(P1 + j, P3 + j, tw[0], tw[1]);
+            Inverse1(A + j, P1 + j, tw[2], tw[3]);
+            Inverse1(P2 + j, P3 + j, tw[4], tw[5]);
+         }
+      }
+   }
+}
+
+#endif
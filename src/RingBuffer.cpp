@@ -16,6 +16,16 @@
   need to read, or both need to write, they need to lock this
   class from outside using their own mutex.
 
+  No locks are taken.  The writer publishes new frames by advancing
+  mEnd only after a write barrier, and the reader returns space by
+  advancing mStart only after a full barrier, so neither ever sees
+  the other's position before the samples it covers are in place.
+
+  A buffer can hold several channels as interleaved frames, so that
+  all the channels of a device are converted and moved in one call,
+  and PeekPut() and PeekGet() let the caller work on the buffer memory
+  directly instead of through an intermediate buffer.
+
   AvailForPut and AvailForGet may underestimate but will never
   overestimate.
 
@@ -24,13 +34,24 @@
 
 #include "RingBuffer.h"
 
-RingBuffer::RingBuffer(sampleFormat format, int size)
+#include "../lib-src/portaudio-v19/src/common/pa_memorybarrier.h"
+
+RingBuffer::RingBuffer(sampleFormat format, int size, int channels)
 {
    mFormat = format;
-   mBufferSize = (size > 64? size: 64);
+   mChannels = (channels > 1 ? channels : 1);
+   mFrameBytes = mChannels * SAMPLE_SIZE(mFormat);
+
+   // A power of two lets the free running positions be masked, rather
+   // than reduced modulo the size, and still wrap around correctly
+   mBufferSize = 64;
+   while (mBufferSize < size)
+      mBufferSize *= 2;
+   mMask = mBufferSize - 1;
+
    mStart = 0;
    mEnd = 0;
-   mBuffer = NewSamples(mBufferSize, mFormat);
+   mBuffer = NewSamples(mBufferSize * mChannels, mFormat);
 }
 
 RingBuffer::~RingBuffer()
@@ -40,7 +61,7 @@ RingBuffer::~RingBuffer()
 
 int RingBuffer::Len()
 {
-   return (mEnd + mBufferSize - mStart) % mBufferSize;
+   return (int)(mEnd - mStart);
 }
 
 //
@@ -49,41 +70,58 @@ int RingBuffer::Len()
 
 int RingBuffer::AvailForPut()
 {
-   return (mBufferSize-4) - Len();
+   return mBufferSize - Len();
 }
 
-int RingBuffer::Put(samplePtr buffer, sampleFormat format,
-                    int samplesToCopy)
+int RingBuffer::PeekPut(int frames,
+                        samplePtr *region1, int *frames1,
+                        samplePtr *region2, int *frames2)
 {
-   samplePtr src;
-   int block;
-   int copied;
-   int pos;
-   int len = Len();
+   int avail = AvailForPut();
+   if (frames > avail)
+      frames = avail;
+
+   unsigned int pos = mEnd;
+   int block = mBufferSize - (int)(pos & mMask);
+
+   *region1 = FramePtr(pos);
+   if (frames > block) {
+      *frames1 = block;
+      *region2 = mBuffer;
+      *frames2 = frames - block;
+   }
+   else {
+      *frames1 = frames;
+      *region2 = NULL;
+      *frames2 = 0;
+   }
 
-   if (samplesToCopy > (mBufferSize-4) - len)
-      samplesToCopy = (mBufferSize-4) - len;
+   return frames;
+}
 
-   src = buffer;
-   copied = 0;
-   pos = mEnd;
+void RingBuffer::CommitPut(int frames)
+{
+   // The samples must be in memory before the reader can see them
+   PaUtil_WriteMemoryBarrier();
+   mEnd = mEnd + frames;
+}
 
-   while(samplesToCopy) {
-      block = samplesToCopy;
-      if (block > mBufferSize - pos)
-         block = mBufferSize - pos;
+int RingBuffer::Put(samplePtr buffer, sampleFormat format,
+                    int framesToCopy)
+{
+   samplePtr region[2];
+   int frames[2];
 
-      CopySamples(src, format,
-                  mBuffer + pos * SAMPLE_SIZE(mFormat), mFormat,
-                  block);
+   int copied = PeekPut(framesToCopy,
+                        &region[0], &frames[0], &region[1], &frames[1]);
 
-      src += block * SAMPLE_SIZE(format);
-      pos = (pos + block) % mBufferSize;
-      samplesToCopy -= block;
-      copied += block;
+   samplePtr src = buffer;
+   for (int i = 0; i < 2 && frames[i] > 0; i++) {
+      CopySamples(src, format, region[i], mFormat, frames[i] * mChannels);
+      src += frames[i] * mChannels * SAMPLE_SIZE(format);
    }
 
-   mEnd = pos;
+   CommitPut(copied);
 
    return copied;
 }
@@ -97,46 +135,65 @@ int RingBuffer::AvailForGet()
    return Len();
 }
 
-int RingBuffer::Get(samplePtr buffer, sampleFormat format,
-                    int samplesToCopy)
+int RingBuffer::PeekGet(int frames,
+                        samplePtr *region1, int *frames1,
+                        samplePtr *region2, int *frames2)
 {
-   samplePtr dest;
-   int block;
-   int copied;
-   int len = Len();
+   int avail = Len();
+   if (frames > avail)
+      frames = avail;
+
+   // Don't read samples older than the position we just saw
+   PaUtil_ReadMemoryBarrier();
+
+   unsigned int pos = mStart;
+   int block = mBufferSize - (int)(pos & mMask);
 
-   if (samplesToCopy > len)
-      samplesToCopy = len;
+   *region1 = FramePtr(pos);
+   if (frames > block) {
+      *frames1 = block;
+      *region2 = mBuffer;
+      *frames2 = frames - block;
+   }
+   else {
+      *frames1 = frames;
+      *region2 = NULL;
+      *frames2 = 0;
+   }
 
-   dest = buffer;
-   copied = 0;
+   return frames;
+}
 
-   while(samplesToCopy) {
-      block = samplesToCopy;
-      if (block > mBufferSize - mStart)
-         block = mBufferSize - mStart;
+int RingBuffer::Get(samplePtr buffer, sampleFormat format,
+                    int framesToCopy)
+{
+   samplePtr region[2];
+   int frames[2];
 
-      CopySamples(mBuffer + mStart * SAMPLE_SIZE(mFormat), mFormat,
-                  dest, format,
-                  block);
+   int copied = PeekGet(framesToCopy,
+                        &region[0], &frames[0], &region[1], &frames[1]);
 
-      dest += block * SAMPLE_SIZE(format);
-      mStart = (mStart + block) % mBufferSize;
-      samplesToCopy -= block;
-      copied += block;
+   samplePtr dest = buffer;
+   for (int i = 0; i < 2 && frames[i] > 0; i++) {
+      CopySamples(region[i], mFormat, dest, format, frames[i] * mChannels);
+      dest += frames[i] * mChannels * SAMPLE_SIZE(format);
    }
 
+   Discard(copied);
+
    return copied;
 }
 
-int RingBuffer::Discard(int samplesToDiscard)
+int RingBuffer::Discard(int framesToDiscard)
 {
    int len = Len();
 
-   if (samplesToDiscard > len)
-      samplesToDiscard = len;
+   if (framesToDiscard > len)
+      framesToDiscard = len;
 
-   mStart = (mStart + samplesToDiscard) % mBufferSize;
+   // Finish reading the samples before the writer may overwrite them
+   PaUtil_FullMemoryBarrier();
+   mStart = mStart + framesToDiscard;
 
-   return samplesToDiscard;
+   return framesToDiscard;
 }
@@ -15,32 +15,71 @@
 
 class RingBuffer {
  public:
-   RingBuffer(sampleFormat format, int size);
+   /// A buffer of at least size frames; the size is rounded up to a
+   /// power of two.  Each frame holds one sample for each of the
+   /// channels, interleaved.
+   RingBuffer(sampleFormat format, int size, int channels = 1);
    ~RingBuffer();
 
+   sampleFormat GetFormat() const { return mFormat; }
+   int GetChannels() const { return mChannels; }
+
    //
    // For the writer only:
    //
 
    int AvailForPut();
-   int Put(samplePtr buffer, sampleFormat format, int samples);
+   /// Copies whole interleaved frames in, converting from format
+   int Put(samplePtr buffer, sampleFormat format, int frames);
+
+   /// Gives direct access to up to frames of free space, in at most two
+   /// pieces because of wrap-around, for the caller to write into.
+   /// Returns the number of frames available; make them visible to the
+   /// reader with CommitPut().
+   int PeekPut(int frames,
+               samplePtr *region1, int *frames1,
+               samplePtr *region2, int *frames2);
+   void CommitPut(int frames);
 
    //
    // For the reader only:
    //
 
    int AvailForGet();
-   int Get(samplePtr buffer, sampleFormat format, int samples);
-   int Discard(int samples);
+   /// Copies whole interleaved frames out, converting to format
+   int Get(samplePtr buffer, sampleFormat format, int frames);
+   int Discard(int frames);
+
+   /// Gives direct access to up to frames of stored frames, in at most
+   /// two pieces.  Returns the number of frames available; release them
+   /// to the writer with Discard().
+   int PeekGet(int frames,
+               samplePtr *region1, int *frames1,
+               samplePtr *region2, int *frames2);
 
  private:
    int Len();
+   samplePtr FramePtr(unsigned int pos)
+   { return mBuffer + (pos & mMask) * mFrameBytes; }
 
+   enum { CacheLineSize = 64 };
+
+   // Fixed at construction, shared read-only by both threads
    sampleFormat  mFormat;
-   int           mStart;
-   int           mEnd;
-   int           mBufferSize;
+   int           mChannels;
+   int           mFrameBytes;
+   int           mBufferSize;   // in frames, a power of two
+   unsigned int  mMask;
    samplePtr     mBuffer;
+   char          mPad0[CacheLineSize];
+
+   // The positions count frames ever written and read, and are masked
+   // to index the buffer.  Each is only modified by one thread, and each
+   // gets its own cache line so the two threads don't contend for it.
+   volatile unsigned int mEnd;     // written by the writer
+   char          mPad1[CacheLineSize - sizeof(unsigned int)];
+   volatile unsigned int mStart;   // written by the reader
+   char          mPad2[CacheLineSize - sizeof(unsigned int)];
 };
 
 #endif /*  __AUDACITY_RING_BUFFER__ */
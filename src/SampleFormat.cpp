@@ -43,6 +43,7 @@
 #include "SampleFormat.h"
 #include "Prefs.h"
 #include "Dither.h"
+#include "ondemand/ODTaskThread.h"
 
 static Dither::DitherType gLowQualityDither = Dither::none;
 static Dither::DitherType gHighQualityDither = Dither::none;
@@ -74,14 +75,120 @@ const wxChar *GetSampleFormatStr(sampleFormat format)
    return wxT("Unknown format"); // compiler food
 }
 
+//
+// The sample buffer pool
+//
+// Editing a block, applying an effect or mixing takes scratch buffers of
+// a few sizes over and over, so deleted buffers are kept, up to a limit,
+// and handed out again.  Each buffer has a header just before it, giving
+// its size and class and where its allocation starts.
+
+struct SampleBufferHeader {
+   char *raw;
+   size_t bytes;
+   int sizeClass;                  // or -1 if too large to pool
+   SampleBufferHeader *next;       // in the free list
+};
+
+static const size_t sBufferAlignment = 32;
+static const int sMinClassBits = 8;      // 256 bytes
+static const int sMaxClassBits = 22;     // 4 MB
+static const int sNumClasses = sMaxClassBits - sMinClassBits + 1;
+// Free buffers beyond this many bytes go back to the system
+static const size_t sMaxPooledBytes = 32 * 1048576;
+
+// All guarded by sBufferPoolLock
+static ODLock sBufferPoolLock;
+static SampleBufferHeader *sFreeBuffers[sNumClasses];
+static SampleBufferStats sBufferStats;
+
+static int SizeClassFor(size_t bytes)
+{
+   int sizeClass = 0;
+   while (((size_t)1 << (sizeClass + sMinClassBits)) < bytes) {
+      if (++sizeClass == sNumClasses)
+         return -1;
+   }
+   return sizeClass;
+}
+
+static size_t ClassBytes(int sizeClass)
+{
+   return (size_t)1 << (sizeClass + sMinClassBits);
+}
+
 AUDACITY_DLL_API samplePtr NewSamples(int count, sampleFormat format)
 {
-   return (samplePtr)malloc(count * SAMPLE_SIZE(format));
+   size_t bytes = (size_t)count * SAMPLE_SIZE(format);
+   int sizeClass = SizeClassFor(bytes);
+   if (sizeClass >= 0)
+      bytes = ClassBytes(sizeClass);
+
+   {
+      ODLocker locker(sBufferPoolLock);
+
+      sBufferStats.inUse += bytes;
+      if (sBufferStats.inUse > sBufferStats.peakInUse)
+         sBufferStats.peakInUse = sBufferStats.inUse;
+
+      if (sizeClass >= 0 && sFreeBuffers[sizeClass]) {
+         SampleBufferHeader *header = sFreeBuffers[sizeClass];
+         sFreeBuffers[sizeClass] = header->next;
+         sBufferStats.pooled -= bytes;
+         sBufferStats.hits++;
+         return (samplePtr)(header + 1);
+      }
+
+      sBufferStats.misses++;
+   }
+
+   // Room for the header, then up to the next aligned address
+   char *raw = (char *)malloc(bytes + sizeof(SampleBufferHeader) + sBufferAlignment);
+   if (!raw) {
+      ODLocker locker(sBufferPoolLock);
+      sBufferStats.inUse -= bytes;
+      return NULL;
+   }
+
+   wxUIntPtr start = (wxUIntPtr)(raw + sizeof(SampleBufferHeader));
+   start = (start + sBufferAlignment - 1) & ~(wxUIntPtr)(sBufferAlignment - 1);
+
+   SampleBufferHeader *header = (SampleBufferHeader *)start - 1;
+   header->raw = raw;
+   header->bytes = bytes;
+   header->sizeClass = sizeClass;
+   header->next = NULL;
+
+   return (samplePtr)start;
 }
 
 AUDACITY_DLL_API void DeleteSamples(samplePtr p)
 {
-   free(p);
+   if (!p)
+      return;
+
+   SampleBufferHeader *header = (SampleBufferHeader *)p - 1;
+
+   {
+      ODLocker locker(sBufferPoolLock);
+
+      sBufferStats.inUse -= header->bytes;
+      if (header->sizeClass >= 0 &&
+          sBufferStats.pooled + header->bytes <= sMaxPooledBytes) {
+         header->next = sFreeBuffers[header->sizeClass];
+         sFreeBuffers[header->sizeClass] = header;
+         sBufferStats.pooled += header->bytes;
+         return;
+      }
+   }
+
+   free(header->raw);
+}
+
+AUDACITY_DLL_API void GetSampleBufferStats(SampleBufferStats *stats)
+{
+   ODLocker locker(sBufferPoolLock);
+   *stats = sBufferStats;
 }
 
 // TODO: Risky?  Assumes 0.0f is represented by 0x00000000;
@@ -48,9 +48,21 @@ const wxChar *GetSampleFormatStr(sampleFormat format);
 // Allocating/Freeing Samples
 //
 
+// Buffers come from a pool shared by all threads, in classes of powers
+// of two, and are aligned for SSE and AVX
 AUDACITY_DLL_API samplePtr NewSamples(int count, sampleFormat format);
 AUDACITY_DLL_API void DeleteSamples(samplePtr p);
 
+struct SampleBufferStats {
+   long hits;          // buffers reused from the pool
+   long misses;        // buffers that had to be allocated
+   size_t inUse;       // bytes handed out and not yet deleted
+   size_t peakInUse;
+   size_t pooled;      // bytes kept for reuse
+};
+
+AUDACITY_DLL_API void GetSampleBufferStats(SampleBufferStats *stats);
+
 // RAII version of above
 class SampleBuffer {
 
@@ -32,6 +32,7 @@
 
 #include <algorithm>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 
 #include <wx/dynarray.h>
@@ -43,6 +44,7 @@
 #include "Sequence.h"
 
 #include "BlockFile.h"
+#include "BlockPrefetcher.h"
 #include "blockfile/ODDecodeBlockFile.h"
 #include "DirManager.h"
 
@@ -51,6 +53,12 @@
 
 int Sequence::sMaxDiskBlockSize = 1048576;
 
+// Guards the share counts of all block arrays
+static ODLock sBlockShareLock;
+
+// How many blocks Get() asks the prefetcher for beyond those it reads
+static const int sReadAheadBlocks = 4;
+
 // Sequence methods
 Sequence::Sequence(DirManager * projDirManager, sampleFormat format)
 {
@@ -59,10 +67,15 @@ Sequence::Sequence(DirManager * projDirManager, sampleFormat format)
    mNumSamples = 0;
    mSampleFormat = format;
    mBlock = new BlockArray();
+   mBlockShareCount = new int(1);
 
    mMinSamples = sMaxDiskBlockSize / SAMPLE_SIZE(mSampleFormat) / 2;
    mMaxSamples = mMinSamples * 2;
    mErrorOpening = false;
+
+   mBlockPyramidFactor = 0;
+   mBlockPyramidValid = 0;
+   mChangeCount = 0;
 }
 
 Sequence::Sequence(const Sequence &orig, DirManager *projDirManager)
@@ -79,7 +92,30 @@ Sequence::Sequence(const Sequence &orig, DirManager *projDirManager)
    mMinSamples = orig.mMinSamples;
    mErrorOpening = false;
 
+   mBlockPyramidFactor = 0;
+   mBlockPyramidValid = 0;
+   mChangeCount = 0;
+
+   if (projDirManager == orig.mDirManager) {
+      // Within a project, share the blocks until one of us changes them,
+      // so that copies such as undo states cost nothing per block
+      ODLocker locker(sBlockShareLock);
+      mBlock = orig.mBlock;
+      mBlockShareCount = orig.mBlockShareCount;
+      (*mBlockShareCount)++;
+      mNumSamples = orig.mNumSamples;
+
+      // The same blocks have the same summaries
+      ODLocker pyramidLocker(orig.mBlockPyramidLock);
+      mBlockPyramid = orig.mBlockPyramid;
+      mBlockPyramidFactor = orig.mBlockPyramidFactor;
+      mBlockPyramidValid = orig.mBlockPyramidValid;
+      mChangedBlocks = orig.mChangedBlocks;
+      return;
+   }
+
    mBlock = new BlockArray();
+   mBlockShareCount = new int(1);
 
    bool bResult = Paste(0, &orig);
    wxASSERT(bResult); // TO DO: Actually handle this.
@@ -88,16 +124,60 @@ Sequence::Sequence(const Sequence &orig, DirManager *projDirManager)
 
 Sequence::~Sequence()
 {
-   for (unsigned int i = 0; i < mBlock->GetCount(); i++) {
-      if (mBlock->Item(i)->f)
-         mDirManager->Deref(mBlock->Item(i)->f);
-      delete mBlock->Item(i);
+   bool last;
+   {
+      ODLocker locker(sBlockShareLock);
+      last = (--(*mBlockShareCount) == 0);
+   }
+
+   if (last) {
+      for (unsigned int i = 0; i < mBlock->GetCount(); i++) {
+         if (mBlock->Item(i)->f)
+            mDirManager->Deref(mBlock->Item(i)->f);
+         delete mBlock->Item(i);
+      }
+
+      delete mBlock;
+      delete mBlockShareCount;
    }
 
-   delete mBlock;
    mDirManager->Deref();
 }
 
+/// Gives this sequence blocks of its own, if it shares them with copies,
+/// before it changes them.  The copies keep the old ones.
+void Sequence::UnshareBlocks()
+{
+   {
+      ODLocker locker(sBlockShareLock);
+      if (*mBlockShareCount == 1)
+         return;
+   }
+
+   // Our share keeps the old array alive while we copy it
+   BlockArray *own = new BlockArray();
+   own->Alloc(mBlock->GetCount());
+   for (unsigned int i = 0; i < mBlock->GetCount(); i++) {
+      SeqBlock *b = new SeqBlock(*mBlock->Item(i));
+      mDirManager->Ref(b->f);
+      own->Add(b);
+   }
+
+   {
+      ODLocker locker(sBlockShareLock);
+      (*mBlockShareCount)--;
+   }
+
+   mBlock = own;
+   mBlockShareCount = new int(1);
+}
+
+BlockArray *Sequence::GetUnsharedBlockArray()
+{
+   UnshareBlocks();
+   return mBlock;
+}
+
 sampleCount Sequence::GetMaxBlockSize() const
 {
    return mMaxSamples;
@@ -148,6 +228,8 @@ bool Sequence::SetSampleFormat(sampleFormat format)
 
 bool Sequence::ConvertToSampleFormat(sampleFormat format, bool* pbChanged)
 {
+   BlocksChanged();
+
    wxASSERT(pbChanged);
    *pbChanged = false;
 
@@ -155,6 +237,8 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format, bool* pbChanged)
    if (format == mSampleFormat)
       return true;
 
+   UnshareBlocks();
+
    if (mBlock->GetCount() == 0)
    {
       mSampleFormat = format;
@@ -274,18 +358,26 @@ bool Sequence::GetMinMax(sampleCount start, sampleCount len,
    sampleCount s0, l0, maxl0;
 
    // First calculate the min/max of the blocks in the middle of this region;
-   // this is very fast because we have the min/max of every entire block
-   // already in memory.
-   unsigned int b;
-
-   for (b = block0 + 1; b < block1; b++) {
-      float blockMin, blockMax, blockRMS;
-      mBlock->Item(b)->f->GetMinMax(&blockMin, &blockMax, &blockRMS);
-
-      if (blockMin < min)
-         min = blockMin;
-      if (blockMax > max)
-         max = blockMax;
+   // the block pyramid has it in a few entries however many blocks there
+   // are.  Blocks still waiting for summaries are asked one by one, as
+   // before.
+   BlockSummary middle;
+   GetBlockRangeSummary(block0 + 1, std::max(block0 + 1, block1), &middle);
+
+   if (middle.unavailable == 0) {
+      min = middle.min;
+      max = middle.max;
+   }
+   else {
+      for (unsigned int b = block0 + 1; b < block1; b++) {
+         float blockMin, blockMax, blockRMS;
+         mBlock->Item(b)->f->GetMinMax(&blockMin, &blockMax, &blockRMS);
+
+         if (blockMin < min)
+            min = blockMin;
+         if (blockMax > max)
+            max = blockMax;
+      }
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -355,17 +447,24 @@ bool Sequence::GetRMS(sampleCount start, sampleCount len,
 
    sampleCount s0, l0, maxl0;
 
-   // First calculate the rms of the blocks in the middle of this region;
-   // this is very fast because we have the rms of every entire block
-   // already in memory.
-   unsigned int b;
+   // First calculate the rms of the blocks in the middle of this region,
+   // from the block pyramid as for GetMinMax.
+   BlockSummary middle;
+   GetBlockRangeSummary(block0 + 1, std::max(block0 + 1, block1), &middle);
 
-   for (b = block0 + 1; b < block1; b++) {
-      float blockMin, blockMax, blockRMS;
-      mBlock->Item(b)->f->GetMinMax(&blockMin, &blockMax, &blockRMS);
+   if (middle.unavailable == 0) {
+      sumsq = middle.sumsq;
+      length = middle.count;
+   }
+   else {
+      for (unsigned int b = block0 + 1; b < block1; b++) {
+         float blockMin, blockMax, blockRMS;
+         mBlock->Item(b)->f->GetMinMax(&blockMin, &blockMax, &blockRMS);
 
-      sumsq += blockRMS * blockRMS * mBlock->Item(block0)->f->GetLength();
-      length += mBlock->Item(block0)->f->GetLength();
+         sampleCount blockLen = mBlock->Item(b)->f->GetLength();
+         sumsq += (double)blockRMS * blockRMS * blockLen;
+         length += blockLen;
+      }
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -454,6 +553,9 @@ bool Sequence::Copy(sampleCount s0, sampleCount s1, Sequence **dest)
 
 bool Sequence::Paste(sampleCount s, const Sequence *src)
 {
+   BlocksChanged(FirstBlockAffectedBy(s));
+   UnshareBlocks();
+
    if ((s < 0) || (s > mNumSamples))
    {
       wxLogError(
@@ -725,6 +827,9 @@ bool Sequence::AppendAlias(wxString fullPath,
                            sampleCount start,
                            sampleCount len, int channel,bool useOD)
 {
+   BlocksChanged(mBlock->GetCount());
+   UnshareBlocks();
+
    // Quick check to make sure that it doesn't overflow
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
@@ -744,6 +849,9 @@ bool Sequence::AppendAlias(wxString fullPath,
 bool Sequence::AppendCoded(wxString fName, sampleCount start,
                             sampleCount len, int channel, int decodeType)
 {
+   BlocksChanged(mBlock->GetCount());
+   UnshareBlocks();
+
    // Quick check to make sure that it doesn't overflow
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
@@ -760,6 +868,9 @@ bool Sequence::AppendCoded(wxString fName, sampleCount start,
 
 bool Sequence::AppendBlock(SeqBlock * b)
 {
+   BlocksChanged(mBlock->GetCount());
+   UnshareBlocks();
+
    // Quick check to make sure that it doesn't overflow
    if (((double)mNumSamples) + ((double)b->f->GetLength()) > wxLL(9223372036854775807))
       return false;
@@ -829,6 +940,9 @@ sampleCount Sequence::GetBestBlockSize(sampleCount start) const
 
 bool Sequence::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
 {
+   BlocksChanged();
+   UnshareBlocks();
+
    sampleCount nValue;
 
    /* handle waveblock tag and it's attributes */
@@ -985,6 +1099,7 @@ void Sequence::HandleXMLEndTag(const wxChar *tag)
             len = mMaxSamples;
          }
          mBlock->Item(b)->f = new SilentBlockFile(len);
+         BlockChanged(b);
          wxLogWarning(
             wxT("Gap detected in project file. Replacing missing block file with silence."));
          mErrorOpening = true;
@@ -1135,6 +1250,9 @@ bool Sequence::Read(samplePtr buffer, sampleFormat format,
 bool Sequence::CopyWrite(samplePtr buffer, SeqBlock *b,
                          sampleCount start, sampleCount len)
 {
+   // b is one of our blocks, so the caller has unshared them already,
+   // and will report the change
+
    // We don't ever write to an existing block; to support Undo,
    // we copy the old block entirely into memory, dereference it,
    // make the change, and then write the new block to disk.
@@ -1161,21 +1279,24 @@ bool Sequence::CopyWrite(samplePtr buffer, SeqBlock *b,
 }
 
 bool Sequence::Get(samplePtr buffer, sampleFormat format,
-                   sampleCount start, sampleCount len) const
+                   sampleCount start, sampleCount len, bool readAhead) const
 {
    if (start < 0 || start > mNumSamples ||
        start+len > mNumSamples)
       return false;
    int b = FindBlock(start);
 
+   BlockPrefetcher *prefetcher = mDirManager->GetPrefetcher();
+
    while (len) {
-      sampleCount blen =
-          mBlock->Item(b)->start + mBlock->Item(b)->f->GetLength() - start;
+      SeqBlock *block = mBlock->Item(b);
+      sampleCount blen = block->start + block->f->GetLength() - start;
       if (blen > len)
          blen = len;
-      sampleCount bstart = (start - (mBlock->Item(b)->start));
+      sampleCount bstart = (start - (block->start));
 
-      Read(buffer, format, mBlock->Item(b), bstart, blen);
+      if (!prefetcher->Read(block->f, buffer, format, bstart, blen))
+         Read(buffer, format, block, bstart, blen);
 
       len -= blen;
       buffer += (blen * SAMPLE_SIZE(format));
@@ -1183,6 +1304,12 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
       start += blen;
    }
 
+   if (readAhead) {
+      int end = std::min((int)mBlock->GetCount(), b + sReadAheadBlocks);
+      for (; b < end; b++)
+         prefetcher->Prefetch(mBlock->Item(b)->f, mSampleFormat);
+   }
+
    return true;
 }
 
@@ -1190,6 +1317,8 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
 bool Sequence::Set(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len)
 {
+   UnshareBlocks();
+
    if (start < 0 || start > mNumSamples ||
        start+len > mNumSamples)
       return false;
@@ -1240,6 +1369,8 @@ bool Sequence::Set(samplePtr buffer, sampleFormat format,
          }
       }
 
+      BlockChanged(b);
+
       len -= blen;
       start += blen;
       b++;
@@ -1263,9 +1394,7 @@ struct MinMaxSumsq
       min = FLT_MAX, max = -FLT_MAX, sumsq = 0.0f;
       while (count--) {
          float v;
-         switch (divisor) {
-         default:
-         case 1:
+         if (divisor == 1) {
             // array holds samples
             v = *pv++;
             if (v < min)
@@ -1273,9 +1402,8 @@ struct MinMaxSumsq
             if (v > max)
                max = v;
             sumsq += v * v;
-            break;
-         case 256:
-         case 65536:
+         }
+         else {
             // array holds triples of min, max, and rms values
             v = *pv++;
             if (v < min)
@@ -1285,7 +1413,6 @@ struct MinMaxSumsq
                max = v;
             v = *pv++;
             sumsq += v * v;
-            break;
          }
       }
    }
@@ -1297,6 +1424,183 @@ struct MinMaxSumsq
 
 }
 
+void Sequence::AddBlockSummary(BlockSummary *sum, const BlockSummary &more)
+{
+   if (more.min < sum->min)
+      sum->min = more.min;
+   if (more.max > sum->max)
+      sum->max = more.max;
+   sum->sumsq += more.sumsq;
+   sum->count += more.count;
+   sum->unavailable += more.unavailable;
+}
+
+void Sequence::BlocksChanged(unsigned int from)
+{
+   ODLocker locker(mBlockPyramidLock);
+   if (from < mBlockPyramidValid)
+      mBlockPyramidValid = from;
+   mChangeCount++;
+}
+
+void Sequence::BlockChanged(unsigned int b)
+{
+   ODLocker locker(mBlockPyramidLock);
+   if (b < mBlockPyramidValid)
+      mChangedBlocks.push_back(b);
+   mChangeCount++;
+}
+
+unsigned int Sequence::FirstBlockAffectedBy(sampleCount s) const
+{
+   // Edits may merge what they add with the block before
+   if (s <= 0 || mBlock->GetCount() == 0)
+      return 0;
+   int b = FindBlock(std::min(s, mNumSamples));
+   return b > 0 ? b - 1 : 0;
+}
+
+void Sequence::SummarizeBlock(unsigned int b, BlockSummary *s) const
+{
+   BlockFile *f = mBlock->Item(b)->f;
+   if (f->IsSummaryAvailable()) {
+      float rms;
+      f->GetMinMax(&s->min, &s->max, &rms);
+      s->count = f->GetLength();
+      s->sumsq = (double)rms * rms * s->count;
+      s->unavailable = 0;
+   }
+   else {
+      s->min = FLT_MAX;
+      s->max = -FLT_MAX;
+      s->sumsq = 0;
+      s->count = 0;
+      s->unavailable = 1;
+   }
+}
+
+// Entry i of the level above below
+void Sequence::SummarizeEntries(const std::vector<BlockSummary> &below,
+                                size_t i, size_t factor, BlockSummary *s)
+{
+   *s = below[i * factor];
+   size_t end = std::min(below.size(), (i + 1) * factor);
+   for (size_t j = i * factor + 1; j < end; j++)
+      AddBlockSummary(s, below[j]);
+}
+
+void Sequence::UpdateBlockPyramid() const
+{
+   const int factor = BlockFile::GetSummaryLevelFactor();
+   const unsigned int numBlocks = mBlock->GetCount();
+
+   if (mBlockPyramidFactor != factor) {
+      mBlockPyramidFactor = factor;
+      mBlockPyramidValid = 0;
+   }
+
+   if (numBlocks == 0) {
+      mBlockPyramid.clear();
+      mBlockPyramidValid = 0;
+      mChangedBlocks.clear();
+      return;
+   }
+
+   // Blocks still waiting for their summaries will change under us, so
+   // look at them again each time until they have them
+   const unsigned int from = std::min(mBlockPyramidValid, numBlocks);
+   if (!mBlockPyramid.empty() && mBlockPyramid.back()[0].unavailable > 0) {
+      const std::vector<BlockSummary> &leaves = mBlockPyramid[0];
+      for (unsigned int b = 0; b < from && b < leaves.size(); b++)
+         if (leaves[b].unavailable)
+            mChangedBlocks.push_back(b);
+   }
+
+   if (from == numBlocks && mChangedBlocks.empty())
+      return;
+
+   // Entries before from that changed, without repeats; the rest are
+   // all done anyway
+   std::vector<unsigned int> &changed = mChangedBlocks;
+   std::sort(changed.begin(), changed.end());
+   changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+   changed.erase(std::lower_bound(changed.begin(), changed.end(), from),
+                 changed.end());
+
+   if (mBlockPyramid.empty())
+      mBlockPyramid.push_back(std::vector<BlockSummary>());
+
+   std::vector<BlockSummary> &leaves = mBlockPyramid[0];
+   leaves.resize(numBlocks);
+   for (size_t i = 0; i < changed.size(); i++)
+      SummarizeBlock(changed[i], &leaves[changed[i]]);
+   for (unsigned int b = from; b < numBlocks; b++)
+      SummarizeBlock(b, &leaves[b]);
+
+   // Then each entry above a changed one, level by level
+   size_t level = 0;
+   size_t levelFrom = from;
+   while (mBlockPyramid[level].size() > 1) {
+      if (mBlockPyramid.size() == level + 1)
+         mBlockPyramid.push_back(std::vector<BlockSummary>());
+      const std::vector<BlockSummary> &below = mBlockPyramid[level];
+      std::vector<BlockSummary> &above = mBlockPyramid[level + 1];
+      above.resize((below.size() + factor - 1) / factor);
+
+      for (size_t i = 0; i < changed.size(); i++)
+         changed[i] /= factor;
+      changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+      levelFrom /= factor;
+
+      for (size_t i = 0; i < changed.size(); i++)
+         SummarizeEntries(below, changed[i], factor, &above[changed[i]]);
+      for (size_t i = levelFrom; i < above.size(); i++)
+         SummarizeEntries(below, i, factor, &above[i]);
+
+      level++;
+   }
+
+   // Fewer blocks may need fewer levels
+   mBlockPyramid.resize(level + 1);
+
+   mBlockPyramidValid = numBlocks;
+   mChangedBlocks.clear();
+}
+
+/// Summarizes blocks b0 up to but excluding b1, taking the largest runs
+/// the pyramid has, so the cost is logarithmic in the number of blocks.
+void Sequence::GetBlockRangeSummary(unsigned int b0, unsigned int b1,
+                                    BlockSummary *out) const
+{
+   ODLocker locker(mBlockPyramidLock);
+   UpdateBlockPyramid();
+
+   out->min = FLT_MAX;
+   out->max = -FLT_MAX;
+   out->sumsq = 0;
+   out->count = 0;
+   out->unavailable = 0;
+
+   const unsigned int factor = mBlockPyramidFactor;
+   for (size_t level = 0; level < mBlockPyramid.size() && b0 < b1; level++) {
+      const std::vector<BlockSummary> &entries = mBlockPyramid[level];
+      if (level + 1 == mBlockPyramid.size()) {
+         while (b0 < b1)
+            AddBlockSummary(out, entries[b0++]);
+         break;
+      }
+
+      // Take the ragged ends at this level, and the aligned middle
+      // from the levels above
+      while (b0 < b1 && b0 % factor)
+         AddBlockSummary(out, entries[b0++]);
+      while (b1 > b0 && b1 % factor)
+         AddBlockSummary(out, entries[--b1]);
+      b0 /= factor;
+      b1 /= factor;
+   }
+}
+
 bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                               int len, const sampleCount *where)
 {
@@ -1353,25 +1657,61 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                 (whereNext = std::min(s1 - 1, where[nextPixel])) < nextSrcX)
             ++nextPixel;
       }
-      if (nextPixel == pixel)
+      if (nextPixel == pixel) {
          // The entire block's samples fall within one pixel column.
          // Either it's a rare odd block at the end, or else,
          // we must be really zoomed out!
-         // Omit the entire block's contents from min/max/rms
-         // calculation, which is not correct, but correctness might not
-         // be worth the compute time if this happens every pixel
-         // column. -- PRL
+         if (b == block0 || nextSrcX >= s1)
+            // Omit the odd partial block at either end
+            continue;
+
+         // This block, and the following ones up to the one where the
+         // next column starts, all belong to the previous column; fold
+         // them into it at once from the block summary pyramid
+         const sampleCount target =
+            (pixel < len) ? std::min(s1 - 1, where[pixel]) : s1 - 1;
+         const unsigned int bEnd = FindBlock(target);
+         BlockSummary run;
+         GetBlockRangeSummary(b, bEnd, &run);
+
+         const int lastPixel = pixel - 1;
+         if (run.count > 0) {
+            min[lastPixel] = std::min(min[lastPixel], run.min);
+            max[lastPixel] = std::max(max[lastPixel], run.max);
+            double lastNumSamples = (double)lastRmsDenom * lastDivisor;
+            rms[lastPixel] = (float)sqrt(
+               (rms[lastPixel] * rms[lastPixel] * lastNumSamples + run.sumsq) /
+               (lastNumSamples + run.count));
+            lastDivisor = 1;
+            lastRmsDenom = (int)std::min(sampleCount(INT_MAX),
+                                         (sampleCount)lastNumSamples + run.count);
+         }
+         if (run.unavailable > 0)
+            bl[lastPixel] = -1 - b;
+
+         b = bEnd - 1;
+         nextSrcX = mBlock->Item(bEnd)->start;
          continue;
+      }
       if (nextPixel == len)
          whereNext = s1;
 
-      // Decide the summary level
+      // Decide the summary level: the coarsest one with no more than a
+      // column's worth of samples in a frame, and no more than a block's
       const double samplesPerPixel =
          double(whereNext - whereNow) / (nextPixel - pixel);
-      const int divisor =
-           (samplesPerPixel >= 65536) ? 65536
-         : (samplesPerPixel >= 256) ? 256
-         : 1;
+      int level = -1;
+      int divisor = 1;
+      if (samplesPerPixel >= 256) {
+         const int factor = BlockFile::GetSummaryLevelFactor();
+         level = 0;
+         divisor = 256;
+         while (double(divisor) * factor <= samplesPerPixel &&
+                sampleCount(divisor) * factor <= mMaxSamples) {
+            ++level;
+            divisor *= factor;
+         }
+      }
 
       int blockStatus = b;
 
@@ -1379,7 +1719,8 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
       const sampleCount startPosition =
          std::max(sampleCount(0), (srcX - start) / divisor);
       const sampleCount inclusiveEndPosition =
-         std::min((mMaxSamples / divisor) - 1, (nextSrcX - 1 - start) / divisor);
+         std::min((pSeqBlock->f->GetLength() - 1) / divisor,
+                  (nextSrcX - 1 - start) / divisor);
       const sampleCount num = 1 + inclusiveEndPosition - startPosition;
       if (num <= 0) {
          // What?  There was a zero length block file?
@@ -1394,31 +1735,15 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
       }
 
       // Read from the block file or its summary
-      switch (divisor) {
-      default:
-      case 1:
+      if (level < 0)
          // Read samples
          Read((samplePtr)temp, floatSample, pSeqBlock, startPosition, num);
-         break;
-      case 256:
-         // Read triples
-         //check to see if summary data has been computed
-         if (pSeqBlock->f->IsSummaryAvailable())
-            pSeqBlock->f->Read256(temp, startPosition, num);
-         else
-            //otherwise, mark the display as not yet computed
-            blockStatus = -1 - b;
-         break;
-      case 65536:
+      else if (pSeqBlock->f->IsSummaryAvailable())
          // Read triples
-         //check to see if summary data has been computed
-         if (pSeqBlock->f->IsSummaryAvailable())
-             pSeqBlock->f->Read64K(temp, startPosition, num);
-         else
-            //otherwise, mark the display as not yet computed
-            blockStatus = -1 - b;
-         break;
-      }
+         pSeqBlock->f->ReadSummaryLevel(level, temp, startPosition, num);
+      else
+         //otherwise, mark the display as not yet computed
+         blockStatus = -1 - b;
       
       sampleCount filePosition = startPosition;
 
@@ -1512,6 +1837,10 @@ sampleCount Sequence::GetIdealAppendLen()
 bool Sequence::Append(samplePtr buffer, sampleFormat format,
                       sampleCount len, XMLWriter* blockFileLog /*=NULL*/)
 {
+   // The last block may be filled up
+   BlocksChanged(FirstBlockAffectedBy(mNumSamples));
+   UnshareBlocks();
+
    // Quick check to make sure that it doesn't overflow
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
@@ -1637,7 +1966,8 @@ BlockArray *Sequence::Blockify(samplePtr buffer, sampleCount len)
 
 bool Sequence::Delete(sampleCount start, sampleCount len)
 {
-
+   BlocksChanged(FirstBlockAffectedBy(start));
+   UnshareBlocks();
 
    if (len == 0)
       return true;
@@ -1932,6 +2262,9 @@ int Sequence::GetMaxDiskBlockSize()
 
 void Sequence::AppendBlockFile(BlockFile* blockFile)
 {
+   BlocksChanged(mBlock->GetCount());
+   UnshareBlocks();
+
    SeqBlock *w = new SeqBlock();
    w->start = mNumSamples;
    w->f = blockFile;
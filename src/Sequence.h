@@ -11,6 +11,8 @@
 #ifndef __AUDACITY_SEQUENCE__
 #define __AUDACITY_SEQUENCE__
 
+#include <vector>
+
 #include <wx/string.h>
 #include <wx/dynarray.h>
 
@@ -74,8 +76,15 @@ class Sequence: public XMLTagHandler {
 
    sampleCount GetNumSamples() const { return mNumSamples; }
 
+   /// Goes up with every change to the blocks, so that others can tell
+   /// whether the sequence changed without looking at them
+   int GetChangeCount() const { return mChangeCount; }
+
+   /// With readAhead, the caller means to read straight on from here, as
+   /// playback, export and effects do, so the blocks after these are
+   /// queued for the DirManager's BlockPrefetcher.
    bool Get(samplePtr buffer, sampleFormat format,
-            sampleCount start, sampleCount len) const;
+            sampleCount start, sampleCount len, bool readAhead = false) const;
    bool Set(samplePtr buffer, sampleFormat format,
             sampleCount start, sampleCount len);
 
@@ -174,6 +183,10 @@ class Sequence: public XMLTagHandler {
 
    BlockArray *GetBlockArray() {return mBlock;}
 
+   // The blocks may be shared with copies of this sequence, such as
+   // undo states; use this one to change them.
+   BlockArray *GetUnsharedBlockArray();
+
    ///
    void LockDeleteUpdateMutex(){mDeleteUpdateMutex.Lock();}
    void UnlockDeleteUpdateMutex(){mDeleteUpdateMutex.Unlock();}
@@ -192,7 +205,10 @@ class Sequence: public XMLTagHandler {
 
    DirManager   *mDirManager;
 
+   // Copies in the same project share the array and its blocks until
+   // one of them changes them.  The count of sharers goes with the array.
    BlockArray   *mBlock;
+   int          *mBlockShareCount;
    sampleFormat  mSampleFormat;
    sampleCount   mNumSamples;
 
@@ -204,12 +220,56 @@ class Sequence: public XMLTagHandler {
    ///To block the Delete() method against the ODCalcSummaryTask::Update() method
    ODLock   mDeleteUpdateMutex;
 
+   // Summary of the samples of a run of whole blocks
+   struct BlockSummary {
+      float min;
+      float max;
+      double sumsq;        // of the samples
+      sampleCount count;   // samples whose blocks have summaries
+      int unavailable;     // blocks whose summaries are still to come
+   };
+
+   // Level 0 summarizes each block, and each level above it runs of
+   // BlockFile::GetSummaryLevelFactor() entries of the level below.
+   // Edits only note which blocks they changed; the next query brings
+   // those entries and the ones above them up to date.  Display, the
+   // spectrogram workers and on-demand updates may all query at once, so
+   // the members down to mChangedBlocks are used only under this lock.
+   mutable ODLock mBlockPyramidLock;
+   mutable std::vector< std::vector<BlockSummary> > mBlockPyramid;
+   mutable int   mBlockPyramidFactor;
+   // Blocks from this one on are to be summarized again
+   mutable unsigned int mBlockPyramidValid;
+   // Blocks before those that changed in place
+   mutable std::vector<unsigned int> mChangedBlocks;
+
+   int           mChangeCount;
+
    //
    // Private methods
    //
 
    void CalcSummaryInfo();
 
+   void UnshareBlocks();
+
+   // Called after any change to the blocks from index from on, such as
+   // their insertion, removal or replacement
+   void BlocksChanged(unsigned int from = 0);
+   // Called after block b alone was replaced
+   void BlockChanged(unsigned int b);
+   // The first block that an edit at s might replace
+   unsigned int FirstBlockAffectedBy(sampleCount s) const;
+
+   static void AddBlockSummary(BlockSummary *sum, const BlockSummary &more);
+   void SummarizeBlock(unsigned int b, BlockSummary *s) const;
+   static void SummarizeEntries(const std::vector<BlockSummary> &below,
+                                size_t i, size_t factor, BlockSummary *s);
+   // With mBlockPyramidLock held
+   void UpdateBlockPyramid() const;
+   void GetBlockRangeSummary(unsigned int b0, unsigned int b1,
+                             BlockSummary *out) const;
+
    int FindBlock(sampleCount pos) const;
    int FindBlock(sampleCount pos, sampleCount lo,
                  sampleCount guess, sampleCount hi) const;
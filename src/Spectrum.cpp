@@ -17,6 +17,9 @@
 
 #include "Spectrum.h"
 #include "FFT.h"
+#ifdef EXPERIMENTAL_USE_REALFFTF
+#include "FFTPlanner.h"
+#endif
 
 bool ComputeSpectrum(const float * data, int width,
                      int windowSize,
@@ -40,6 +43,11 @@ bool ComputeSpectrum(const float * data, int width,
    float *out = new float[windowSize];
    float *out2 = new float[windowSize];
 
+#ifdef EXPERIMENTAL_USE_REALFFTF
+   const FFTPlan *plan = FFTPlanner::Get().GetPlan(windowSize);
+   const int *bitReversed = plan->GetTables()->BitReversed;
+#endif
+
    int start = 0;
    int windows = 0;
    while (start + windowSize <= width) {
@@ -73,8 +81,19 @@ bool ComputeSpectrum(const float * data, int width,
 #endif
 
       }
-      else
+      else {
+#ifdef EXPERIMENTAL_USE_REALFFTF
+         // In place, saving the copy that PowerSpectrum() makes
+         plan->Forward(in);
+         out[0] = in[0] * in[0];
+         for (i = 1; i < half; i++) {
+            const float re = in[bitReversed[i]], im = in[bitReversed[i] + 1];
+            out[i] = re * re + im * im;
+         }
+#else
          PowerSpectrum(windowSize, in, out);
+#endif
+      }
 
       // Take real part of result
       for (i = 0; i < half; i++)
@@ -452,6 +452,7 @@ class AUDACITY_DLL_API TrackFactory
    DirManager *mDirManager;
    friend class AudacityProject;
    friend class BenchmarkDialog;
+   friend class ImportQueue;
 
  public:
    // These methods are defined in WaveTrack.cpp, NoteTrack.cpp,
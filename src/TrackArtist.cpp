@@ -267,6 +267,7 @@ TrackArtist::TrackArtist()
 
    mdBrange = ENV_DB_RANGE;
    mShowClipping = false;
+   mSpectrumIncomplete = false;
    UpdatePrefs();
 
    SetColours();
@@ -352,6 +353,8 @@ void TrackArtist::DrawTracks(TrackList * tracks,
 
    gPrefs->Read(wxT("/GUI/ShowTrackNameInWaveform"), &mbShowTrackNameInWaveform, false);
 
+   mSpectrumIncomplete = false;
+
    t = iter.StartWith(start);
    while (t) {
       trackRect.y = t->GetY() - viewInfo->vpos;
@@ -1961,8 +1964,11 @@ void TrackArtist::DrawClipSpectrum(WaveTrackCache &cache,
    const float *freq = 0;
    const sampleCount *where = 0;
 
+   bool incomplete = false;
    bool updated = clip->GetSpectrogram(cache, freq, where, mid.width,
-                              t0, pps, autocorrelation);
+                              t0, pps, autocorrelation, incomplete);
+   if (incomplete)
+      mSpectrumIncomplete = true;
 
 #ifdef EXPERIMENTAL_FFT_SKIP_POINTS
    int fftSkipPoints = SpectrogramSettings::defaults().fftSkipPoints;
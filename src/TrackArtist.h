@@ -93,6 +93,10 @@ class AUDACITY_DLL_API TrackArtist {
      this->selectedPen = selectedPen;
    }
 
+   // Whether the last DrawTracks() left spectrogram columns blank, to be
+   // filled in by drawing again
+   bool IsSpectrumIncomplete() const { return mSpectrumIncomplete; }
+
    // Helper: draws the "sync-locked" watermark tiled to a rectangle
    static void DrawSyncLockTiles(wxDC *dc, wxRect r);
 
@@ -175,6 +179,8 @@ class AUDACITY_DLL_API TrackArtist {
    long mShowClipping;        // "/GUI/ShowClipping"
    bool mbShowTrackNameInWaveform;  // "/GUI/ShowTrackNameInWaveform"
 
+   bool mSpectrumIncomplete;
+
    int mInsetLeft;
    int mInsetTop;
    int mInsetRight;
@@ -1147,6 +1147,13 @@ void TrackPanel::OnTimer()
          }
       }
    }
+
+   // Go on with spectrograms that the last paint couldn't finish
+   if (mTrackArtist->IsSpectrumIncomplete()) {
+      mRefreshBacking = true;
+      Refresh( false );
+   }
+
    if(mTimeCount > 1000)
       mTimeCount = 0;
 }
@@ -22,6 +22,8 @@ UndoManager
 
 #include "Audacity.h"
 
+#include <vector>
+
 #include <wx/hashset.h>
 
 #include "BlockFile.h"
@@ -36,6 +38,7 @@ UndoManager
 #include "UndoManager.h"
 
 WX_DECLARE_HASH_SET(BlockFile *, wxPointerHash, wxPointerEqual, Set );
+WX_DECLARE_HASH_SET(BlockArray *, wxPointerHash, wxPointerEqual, BlockArraySet );
 
 UndoManager::UndoManager()
 {
@@ -50,61 +53,101 @@ UndoManager::~UndoManager()
    ClearStates();
 }
 
-void UndoManager::CalculateSpaceUsage()
+// Appends the block arrays of all the wave clips in tracks
+static void GetBlockArrays(TrackList *tracks, std::vector<BlockArray *> &arrays)
 {
-   TIMER_START( "CalculateSpaceUsage", space_calc );
    TrackListOfKindIterator iter(Track::Wave);
+   WaveTrack *wt = (WaveTrack *) iter.First(tracks);
+   while (wt)
+   {
+      WaveClipList::compatibility_iterator it = wt->GetClipIterator();
+      while (it)
+      {
+         arrays.push_back(it->GetData()->GetSequenceBlockArray());
+         it = it->GetNext();
+      }
 
-   space.Clear();
-   space.Add(0, stack.GetCount());
-
-   Set *prev = new Set;
-   Set *cur = new Set;
+      wt = (WaveTrack *) iter.Next();
+   }
+}
 
-   for (size_t i = 0, cnt = stack.GetCount(); i < cnt; i++)
+// Space used by the files of state n that aren't in state n - 1.
+// Unchanged clips of the two states share their block arrays, so
+// only the arrays of changed clips need to be looked into.
+wxLongLong_t UndoManager::CalculateSpaceUsage(unsigned int n)
+{
+   std::vector<BlockArray *> cur;
+   std::vector<BlockArray *> prev;
+   GetBlockArrays(stack[n]->tracks, cur);
+   if (n > 0)
+      GetBlockArrays(stack[n - 1]->tracks, prev);
+
+   BlockArraySet curArrays(cur.begin(), cur.end());
+   BlockArraySet prevArrays(prev.begin(), prev.end());
+
+   // Files of arrays that the state below doesn't have
+   Set files;
+   size_t i, b;
+   for (i = 0; i < cur.size(); i++)
    {
-      // Swap map pointers
-      Set *swap = prev;
-      prev = cur;
-      cur = swap;
+      if (prevArrays.count(cur[i]))
+         continue;
+      for (b = 0; b < cur[i]->GetCount(); b++)
+         files.insert(cur[i]->Item(b)->f);
+   }
 
-      // And clean out the new current map
-      cur->clear();
+   // Those made since the state below was copied can't be in it.  Look
+   // for the others, first where that state differs, then where not.
+   Set doubtful;
+   if (n > 0)
+   {
+      wxLongLong_t serial = stack[n - 1]->nextBlockFileSerial;
+      for (Set::iterator it = files.begin(); it != files.end(); ++it)
+         if ((*it)->GetSerial() < serial)
+            doubtful.insert(*it);
+   }
 
-      // Scan all tracks at current level
-      WaveTrack *wt = (WaveTrack *) iter.First(stack[i]->tracks);
-      while (wt)
+   for (int pass = 0; pass < 2 && !doubtful.empty(); pass++)
+   {
+      for (i = 0; i < prev.size() && !doubtful.empty(); i++)
       {
-         // Scan all clips within current track
-         WaveClipList::compatibility_iterator it = wt->GetClipIterator();
-         while (it)
+         if ((curArrays.count(prev[i]) != 0) != (pass == 1))
+            continue;
+         for (b = 0; b < prev[i]->GetCount(); b++)
          {
-            // Scan all blockfiles within current clip
-            BlockArray *blocks = it->GetData()->GetSequenceBlockArray();
-            for (size_t b = 0, cnt = blocks->GetCount(); b < cnt; b++)
-            {
-               BlockFile *file = blocks->Item(b)->f;
-
-               // Accumulate space used by the file if the file didn't exist
-               // in the previous level
-               if (prev->count(file) == 0 && cur->count(file) == 0)
-               {
-                  space[i] += file->GetSpaceUsage().GetValue();
-               }
-               
-               // Add file to current set
-               cur->insert(file);
-            }
-            
-            it = it->GetNext();
+            BlockFile *file = prev[i]->Item(b)->f;
+            if (doubtful.erase(file))
+               files.erase(file);
          }
+      }
+   }
+
+   wxLongLong_t space = 0;
+   for (Set::iterator it = files.begin(); it != files.end(); ++it)
+      space += (*it)->GetSpaceUsage().GetValue();
+
+   return space;
+}
 
-         wt = (WaveTrack *) iter.Next();
+void UndoManager::InvalidateSpaceUsage(unsigned int n)
+{
+   if (n < stack.Count())
+      stack[n]->spaceUsageValid = false;
+}
+
+void UndoManager::CalculateSpaceUsage()
+{
+   TIMER_START( "CalculateSpaceUsage", space_calc );
+
+   for (size_t i = 0, cnt = stack.GetCount(); i < cnt; i++)
+   {
+      if (!stack[i]->spaceUsageValid)
+      {
+         stack[i]->spaceUsage = CalculateSpaceUsage(i);
+         stack[i]->spaceUsageValid = true;
       }
    }
 
-   delete cur;
-   delete prev;
    TIMER_STOP( space_calc );
 }
 
@@ -114,13 +157,13 @@ wxLongLong_t UndoManager::GetLongDescription(unsigned int n, wxString *desc,
    n -= 1; // 1 based to zero based
 
    wxASSERT(n < stack.Count());
-   wxASSERT(space.Count() == stack.Count());
+   wxASSERT(stack[n]->spaceUsageValid);
 
    *desc = stack[n]->description;
 
-   *size = Internat::FormatSize(space[n]);
+   *size = Internat::FormatSize(stack[n]->spaceUsage);
 
-   return space[n];
+   return stack[n]->spaceUsage;
 }
 
 void UndoManager::GetShortDescription(unsigned int n, wxString *desc)
@@ -149,6 +192,9 @@ void UndoManager::RemoveStateAt(int n)
    UndoStackElem *tmpStackElem = stack[n];
    stack.RemoveAt(n);
    delete tmpStackElem;
+
+   // The state above now has another below it
+   InvalidateSpaceUsage(n);
 }
 
 
@@ -211,6 +257,9 @@ void UndoManager::ModifyState(TrackList * l,
    // Replace
    stack[current]->tracks = tracksCopy;
    stack[current]->selectedRegion = selectedRegion;
+   stack[current]->nextBlockFileSerial = BlockFile::GetNextSerial();
+   InvalidateSpaceUsage(current);
+   InvalidateSpaceUsage(current + 1);
    SonifyEndModifyState();
 }
 
@@ -255,6 +304,9 @@ void UndoManager::PushState(TrackList * l,
    push->selectedRegion = selectedRegion;
    push->description = longDescription;
    push->shortDescription = shortDescription;
+   push->spaceUsage = 0;
+   push->spaceUsageValid = false;
+   push->nextBlockFileSerial = BlockFile::GetNextSerial();
 
    stack.Add(push);
    current++;
@@ -10,7 +10,10 @@
   the entire track hierarchy.  The UndoManager makes a duplicate
   of every single track using its Duplicate method, which should
   increment reference counts.  If we were not at the top of
-  the stack when this is called, delete above first.
+  the stack when this is called, delete above first.  A copied
+  Sequence shares its blocks with the original until either
+  one is changed, so a state costs only the track structure
+  and the blocks that the edit before it replaced.
 
   If a minor change is made, for example changing the visual
   display of a track or changing the selection, you can call
@@ -61,12 +64,16 @@ struct UndoStackElem {
    wxString description;
    wxString shortDescription;
    SelectedRegion selectedRegion;
+
+   // Space taken by the block files of this state that the one below
+   // it doesn't have; recalculated only after either of them changes.
+   wxLongLong_t spaceUsage;
+   bool spaceUsageValid;
+   // BlockFile::GetNextSerial() once the tracks were copied
+   wxLongLong_t nextBlockFileSerial;
 };
 
 WX_DEFINE_USER_EXPORTED_ARRAY(UndoStackElem *, UndoStack, class AUDACITY_DLL_API);
-// wxWidgets arrays have a base size and to use wxLongLong_t we need to use DOUBLE
-// to ensure we get a size big enough to hold a wxLongLong_t.
-WX_DEFINE_USER_EXPORTED_ARRAY_DOUBLE(wxLongLong_t, SpaceArray, class AUDACITY_DLL_API);
 
 // These flags control what extra to do on a PushState
 // Default is PUSH_AUTOSAVE
@@ -106,6 +113,7 @@ class AUDACITY_DLL_API UndoManager {
    bool UnsavedChanges();
    void StateSaved();
 
+   // Brings the space usage of every state up to date
    void CalculateSpaceUsage();
 
    // void Debug(); // currently unused
@@ -116,6 +124,9 @@ class AUDACITY_DLL_API UndoManager {
    void ResetODChangesFlag();
 
  private:
+   wxLongLong_t CalculateSpaceUsage(unsigned int n);
+   void InvalidateSpaceUsage(unsigned int n);
+
    int current;
    int saved;
    UndoStack stack;
@@ -123,8 +134,6 @@ class AUDACITY_DLL_API UndoManager {
    wxString lastAction;
    int consolidationCount;
 
-   SpaceArray space;
-
    bool mODChanges;
    ODLock mODChangesMutex;//mODChanges is accessed from many threads.
 
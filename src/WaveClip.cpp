@@ -23,20 +23,37 @@
 \brief Cache used with WaveClip to cache spectrum information (for
 drawing).  Cache's the Spectrogram frequency samples.
 
+*//****************************************************************//**
+
+\class SpecTileCache
+\brief The spectrogram columns that a WaveClip has computed, by zoom.
+
+At each zoom the columns lie on a grid fixed to the clip, and are kept
+in tiles of a few dozen, so scrolling and zooming back reuse those
+already done.  Missing tiles are computed on the WorkerPool, as many as
+fit in one paint; the rest are left blank and done by later paints, so
+scrolling a long spectrogram never stalls.  Appending and on-demand
+loading only drop the tiles over the samples they change.
+
 *//*******************************************************************/
 
 #include "WaveClip.h"
 
 #include <math.h>
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <memory>
 #include <functional>
 #include <vector>
 #include <wx/log.h>
+#include <wx/stopwatch.h>
 
 #include "Spectrum.h"
 #include "Prefs.h"
 #include "Envelope.h"
 #include "Resample.h"
+#include "WorkerPool.h"
 #include "Project.h"
 
 #include "prefs/SpectrumPrefs.h"
@@ -284,6 +301,7 @@ public:
       , where(NULL)
 
       , dirty(-1)
+      , missing(0)
    {
    }
 
@@ -316,6 +334,7 @@ public:
       , where(len + 1)
 
       , dirty(-1)
+      , missing(0)
    {
       where[0] = 0;
    }
@@ -327,21 +346,6 @@ public:
    bool Matches(int dirty_, bool autocorrelation, double pixelsPerSecond,
       const SpectrogramSettings &settings, double rate) const;
 
-   void CalculateOneSpectrum
-      (const SpectrogramSettings &settings,
-       WaveTrackCache &waveTrackCache,
-       int xx, sampleCount numSamples,
-       double offset, double rate,
-       bool autocorrelation, const std::vector<float> &gainFactors,
-       float *scratch);
-
-   void Populate
-      (const SpectrogramSettings &settings, WaveTrackCache &waveTrackCache,
-       int copyBegin, int copyEnd, int numPixels,
-       sampleCount numSamples,
-       double offset, double rate,
-       bool autocorrelation);
-
    const int          len; // counts pixels, not samples
    const bool         ac;
    const double       pps;
@@ -357,12 +361,90 @@ public:
    std::vector<sampleCount> where;
 
    int          dirty;
+   int          missing; // columns left blank, to compute on the next call
+};
+
+enum {
+   specTileColumns = 64,
+   specLevelCount = 4,                       // zooms kept
+   specTileBudget = 4 * 1024 * 1024,         // floats kept, per clip
+   specPaintBudget = 60,                     // ms of computing per call
+};
+
+struct SpecTile {
+   std::vector<float> freq;   // specTileColumns columns, as in SpecCache
+   int lastUsed;
+};
+
+// The tiles for one zoom and one choice of settings.  Column k is
+// centered on sample floor(1 + k * samplesPerPixel) of the clip, and
+// tile t holds columns t * specTileColumns on.
+class SpecTileLevel {
+public:
+   SpecTileLevel(bool autocorrelation, double samplesPerPixel, int rate,
+                 const SpectrogramSettings &settings, int zeroPaddingFactor_);
+   ~SpecTileLevel();
+
+   bool Matches(bool autocorrelation, double samplesPerPixel, int rate,
+                const SpectrogramSettings &settings, int zeroPaddingFactor_,
+                sampleCount numSamples) const;
+
+   sampleCount ColumnCenter(sampleCount k) const
+   {
+      return sampleCount(floor(1.0 + double(k) * spp));
+   }
+
+   // Drops the tiles whose columns read any of samples [s0, s1), and
+   // returns how many
+   int Invalidate(sampleCount s0, sampleCount s1);
+
+   const bool         ac;
+   const double       spp;
+   const int          rate;
+   const int          windowType;
+   const int          windowSize;
+   const int          zeroPaddingFactor;
+   const int          frequencyGain;
+#ifdef EXPERIMENTAL_FFT_SKIP_POINTS
+   const int          fftSkipPoints;
+#endif //EXPERIMENTAL_FFT_SKIP_POINTS
+   const int          half;
+
+   typedef std::map<sampleCount, SpecTile *> TileMap;
+   TileMap tiles;
+};
+
+class SpecTileCache {
+public:
+   SpecTileCache() : mUseCount(0) {}
+   ~SpecTileCache() { Clear(); }
+
+   void Clear();
+
+   // Finds the level for these settings, or makes it, forgetting the
+   // least recently used if there are too many
+   SpecTileLevel *GetLevel(bool autocorrelation, double samplesPerPixel, int rate,
+                           const SpectrogramSettings &settings, int zeroPaddingFactor,
+                           sampleCount numSamples);
+
+   bool Invalidate(sampleCount s0, sampleCount s1);
+
+   // Stamp for the tiles used by this call, which Trim() keeps
+   int NextUse() { return ++mUseCount; }
+   // Drops the tiles least recently used, beyond the budget
+   void Trim();
+
+private:
+   std::vector<SpecTileLevel *> mLevels;   // most recently used first
+   int mUseCount;
 };
 
 #ifdef EXPERIMENTAL_USE_REALFFTF
 #include "FFT.h"
-static void ComputeSpectrumUsingRealFFTf(float *buffer, HFFT hFFT, const float *window, int len, float *out)
+#include "FFTPlanner.h"
+static void ComputeSpectrumUsingRealFFTf(float *buffer, const FFTPlan *plan, const float *window, int len, float *out)
 {
+   HFFT hFFT = plan->GetTables();
    int i;
    if(len > hFFT->Points*2)
       len = hFFT->Points*2;
@@ -370,7 +452,7 @@ static void ComputeSpectrumUsingRealFFTf(float *buffer, HFFT hFFT, const float *
       buffer[i] *= window[i];
    for( ; i<(hFFT->Points*2); i++)
       buffer[i]=0; // zero pad as needed
-   RealFFTf(buffer, hFFT);
+   plan->Forward(buffer);
    // Handle the (real-only) DC
    float power = buffer[0]*buffer[0];
    if(power <= 0)
@@ -397,6 +479,8 @@ WaveClip::WaveClip(DirManager *projDirManager, sampleFormat format, int rate)
    mEnvelope = new Envelope();
    mWaveCache = new WaveCache();
    mSpecCache = new SpecCache();
+   mSpecTiles = new SpecTileCache();
+   mSpecTilesStale = false;
    mSpecPxCache = new SpecPxCache(1);
    mAppendBuffer = NULL;
    mAppendBufferLen = 0;
@@ -419,6 +503,8 @@ WaveClip::WaveClip(const WaveClip& orig, DirManager *projDirManager)
    mEnvelope->SetTrackLen(((double)orig.mSequence->GetNumSamples()) / orig.mRate);
    mWaveCache = new WaveCache();
    mSpecCache = new SpecCache();
+   mSpecTiles = new SpecTileCache();
+   mSpecTilesStale = false;
    mSpecPxCache = new SpecPxCache(1);
 
    for (WaveClipList::compatibility_iterator it=orig.mCutLines.GetFirst(); it; it=it->GetNext())
@@ -439,6 +525,7 @@ WaveClip::~WaveClip()
 
    delete mWaveCache;
    delete mSpecCache;
+   delete mSpecTiles;
    delete mSpecPxCache;
 
    if (mAppendBuffer)
@@ -455,9 +542,9 @@ void WaveClip::SetOffset(double offset)
 }
 
 bool WaveClip::GetSamples(samplePtr buffer, sampleFormat format,
-                   sampleCount start, sampleCount len) const
+                   sampleCount start, sampleCount len, bool readAhead) const
 {
-   return mSequence->Get(buffer, format, start, len);
+   return mSequence->Get(buffer, format, start, len, readAhead);
 }
 
 bool WaveClip::SetSamples(samplePtr buffer, sampleFormat format,
@@ -525,9 +612,55 @@ void WaveClip::DeleteWaveCache()
 ///Adds an invalid region to the wavecache so it redraws that portion only.
 void WaveClip::AddInvalidRegion(long startSample, long endSample)
 {
-   ODLocker locker(mWaveCacheMutex);
-   if(mWaveCache!=NULL)
-      mWaveCache->AddInvalidRegion(startSample,endSample);
+   {
+      ODLocker locker(mWaveCacheMutex);
+      if(mWaveCache!=NULL)
+         mWaveCache->AddInvalidRegion(startSample,endSample);
+   }
+
+   ODLocker locker(mSpecInvalidMutex);
+   mSpecInvalidRegions.push_back(std::make_pair(sampleCount(startSample),
+                                                sampleCount(endSample)));
+   if (mSpecInvalidRegions.size() >= 64) {
+      // Keep the list short; the tiles over the union will do
+      std::pair<sampleCount, sampleCount> all = mSpecInvalidRegions[0];
+      for (size_t i = 1; i < mSpecInvalidRegions.size(); i++) {
+         all.first = std::min(all.first, mSpecInvalidRegions[i].first);
+         all.second = std::max(all.second, mSpecInvalidRegions[i].second);
+      }
+      mSpecInvalidRegions.assign(1, all);
+   }
+}
+
+void WaveClip::MarkAppended(sampleCount from)
+{
+   mDirty++;
+
+   // Columns near the old end read the new samples, or were blank
+   ODLocker locker(mSpecInvalidMutex);
+   mSpecInvalidRegions.push_back(
+      std::make_pair(from, std::numeric_limits<sampleCount>::max()));
+}
+
+bool WaveClip::SyncSpecTiles()
+{
+   std::vector< std::pair<sampleCount, sampleCount> > regions;
+   {
+      ODLocker locker(mSpecInvalidMutex);
+      regions.swap(mSpecInvalidRegions);
+   }
+
+   if (mSpecTilesStale) {
+      mSpecTilesStale = false;
+      mSpecTiles->Clear();
+      return true;
+   }
+
+   bool dropped = false;
+   for (size_t i = 0; i < regions.size(); i++)
+      if (mSpecTiles->Invalidate(regions[i].first, regions[i].second))
+         dropped = true;
+   return dropped;
 }
 
 namespace {
@@ -839,13 +972,16 @@ bool SpecCache::Matches
       ac == autocorrelation;
 }
 
-void SpecCache::CalculateOneSpectrum
+namespace {
+
+// Computes the column centered on sample center of the clip into results
+void CalculateOneSpectrum
    (const SpectrogramSettings &settings,
     WaveTrackCache &waveTrackCache,
-    int xx, sampleCount numSamples,
+    sampleCount center, sampleCount numSamples,
     double offset, double rate,
     bool autocorrelation, const std::vector<float> &gainFactors,
-    float *scratch)
+    float *scratch, float *results)
 {
 #ifdef EXPERIMENTAL_FFT_SKIP_POINTS
    int fftSkipPoints = settings.fftSkipPoints;
@@ -853,12 +989,11 @@ void SpecCache::CalculateOneSpectrum
 #endif //EXPERIMENTAL_FFT_SKIP_POINTS
 
    const int windowSize = settings.windowSize;
-   sampleCount start = where[xx];
+   sampleCount start = center;
    const int zeroPaddingFactor = (autocorrelation ? 1 : settings.zeroPaddingFactor);
    const int padding = (windowSize * (zeroPaddingFactor - 1)) / 2;
    const int fftLen = windowSize * zeroPaddingFactor;
    const int half = fftLen / 2;
-   float *const results = &freq[half * xx];
 
    sampleCount len = windowSize;
 
@@ -936,7 +1071,7 @@ void SpecCache::CalculateOneSpectrum
          // when there is padding.  Therefore we did not need to reinitialize
          // the part of scratch in the padding zones.
          ComputeSpectrumUsingRealFFTf
-            (useBuffer, settings.hFFT, settings.window, fftLen, results);
+            (useBuffer, settings.fftPlan, settings.window, fftLen, results);
 #else  // EXPERIMENTAL_USE_REALFFTF
       ComputeSpectrum(buffer, windowSize, windowSize,
          rate, results,
@@ -950,54 +1085,204 @@ void SpecCache::CalculateOneSpectrum
    }
 }
 
-void SpecCache::Populate
-   (const SpectrogramSettings &settings, WaveTrackCache &waveTrackCache,
-    int copyBegin, int copyEnd, int numPixels,
-    sampleCount numSamples,
-    double offset, double rate,
-    bool autocorrelation)
+// The tile holding column k, rounding down for columns left of the clip
+sampleCount TileOfColumn(sampleCount k)
 {
-#ifdef EXPERIMENTAL_USE_REALFFTF
-   settings.CacheWindows();
-#endif
+   return k >= 0
+      ? k / specTileColumns
+      : -((-k + specTileColumns - 1) / specTileColumns);
+}
+
+// Fills tiles of one level on the worker threads, each with its own
+// WaveTrackCache and scratch buffer.  The settings have their windows
+// made beforehand, on the calling thread.
+class SpecTileTask : public WorkerTask
+{
+public:
+   SpecTileTask(const SpectrogramSettings &settings, const SpecTileLevel &level,
+                const WaveTrack *track, sampleCount numSamples, double offset,
+                const std::vector<float> &gainFactors)
+      : mSettings(settings), mLevel(level), mTrack(track)
+      , mNumSamples(numSamples), mOffset(offset), mGainFactors(gainFactors)
+   {
+   }
 
+   void Run(int index)
+   {
+      WaveTrackCache cache(mTrack);
+      std::vector<float> scratch(
 #ifdef EXPERIMENTAL_FFT_SKIP_POINTS
-   int fftSkipPoints = settings.fftSkipPoints;
-   int fftSkipPoints1 = fftSkipPoints + 1;
+         mLevel.windowSize * mLevel.zeroPaddingFactor * (mLevel.fftSkipPoints + 1)
+#else //!EXPERIMENTAL_FFT_SKIP_POINTS
+         mLevel.windowSize * mLevel.zeroPaddingFactor
 #endif //EXPERIMENTAL_FFT_SKIP_POINTS
+      );
 
-   const int &frequencyGain = settings.frequencyGain;
-   const int &windowSize = settings.windowSize;
-#ifdef EXPERIMENTAL_ZERO_PADDED_SPECTROGRAMS
-   const int &zeroPaddingFactor = autocorrelation ? 1 : settings.zeroPaddingFactor;
-#else
-   const int zeroPaddingFactor = 1;
-#endif
+      SpecTile *tile = tiles[index];
+      const sampleCount k0 = indices[index] * specTileColumns;
+      for (int col = 0; col < specTileColumns; col++)
+         CalculateOneSpectrum(mSettings, cache,
+            mLevel.ColumnCenter(k0 + col), mNumSamples, mOffset, mLevel.rate,
+            mLevel.ac, mGainFactors, &scratch[0],
+            &tile->freq[mLevel.half * col]);
+   }
 
-   // FFT length may be longer than the window of samples that affect results
-   // because of zero padding done for increased frequency resolution
-   const int fftLen = windowSize * zeroPaddingFactor;
+   std::vector<sampleCount> indices;
+   std::vector<SpecTile *> tiles;
+
+private:
+   const SpectrogramSettings &mSettings;
+   const SpecTileLevel &mLevel;
+   const WaveTrack *mTrack;
+   const sampleCount mNumSamples;
+   const double mOffset;
+   const std::vector<float> &mGainFactors;
+};
+
+}
+
+SpecTileLevel::SpecTileLevel
+   (bool autocorrelation, double samplesPerPixel, int rate_,
+    const SpectrogramSettings &settings, int zeroPaddingFactor_)
+   : ac(autocorrelation)
+   , spp(samplesPerPixel)
+   , rate(rate_)
+   , windowType(settings.windowType)
+   , windowSize(settings.windowSize)
+   , zeroPaddingFactor(zeroPaddingFactor_)
+   , frequencyGain(settings.frequencyGain)
+#ifdef EXPERIMENTAL_FFT_SKIP_POINTS
+   , fftSkipPoints(settings.fftSkipPoints)
+#endif //EXPERIMENTAL_FFT_SKIP_POINTS
+   , half((settings.windowSize * zeroPaddingFactor_) / 2)
+{
+}
+
+SpecTileLevel::~SpecTileLevel()
+{
+   for (TileMap::iterator it = tiles.begin(); it != tiles.end(); ++it)
+      delete it->second;
+}
+
+bool SpecTileLevel::Matches
+   (bool autocorrelation, double samplesPerPixel, int rate_,
+    const SpectrogramSettings &settings, int zeroPaddingFactor_,
+    sampleCount numSamples) const
+{
+   // As in SpecCache::Matches, but the columns must line up to the end
+   // of the clip, not just across the screen
+   const bool sppMatch =
+      (fabs(samplesPerPixel - spp) * (numSamples / spp + 1) < 0.5);
+
+   return
+      sppMatch &&
+      rate == rate_ &&
+      windowType == settings.windowType &&
+      windowSize == settings.windowSize &&
+      zeroPaddingFactor == zeroPaddingFactor_ &&
+      frequencyGain == settings.frequencyGain &&
+#ifdef EXPERIMENTAL_FFT_SKIP_POINTS
+      fftSkipPoints == settings.fftSkipPoints &&
+#endif //EXPERIMENTAL_FFT_SKIP_POINTS
+      ac == autocorrelation;
+}
 
-   std::vector<float> buffer(
+int SpecTileLevel::Invalidate(sampleCount s0, sampleCount s1)
+{
 #ifdef EXPERIMENTAL_FFT_SKIP_POINTS
-      fftLen*fftSkipPoints1
+   const sampleCount span = windowSize * (fftSkipPoints + 1);
 #else //!EXPERIMENTAL_FFT_SKIP_POINTS
-      fftLen
+   const sampleCount span = windowSize;
 #endif //EXPERIMENTAL_FFT_SKIP_POINTS
-   );
 
-   std::vector<float> gainFactors;
-   ComputeSpectrogramGainFactors(fftLen, rate, frequencyGain, gainFactors);
-
-   // Loop over the ranges before and after the copied portion and compute anew.
-   // One of the ranges may be empty.
-   for (int jj = 0; jj < 2; ++jj) {
-      const int lowerBoundX = jj == 0 ? 0 : copyEnd;
-      const int upperBoundX = jj == 0 ? copyBegin : numPixels;
-      for (sampleCount xx = lowerBoundX; xx < upperBoundX; ++xx)
-         CalculateOneSpectrum(
-         settings, waveTrackCache, xx, numSamples,
-         offset, rate, autocorrelation, gainFactors, &buffer[0]);
+   int dropped = 0;
+   for (TileMap::iterator it = tiles.begin(); it != tiles.end();) {
+      const sampleCount k0 = it->first * specTileColumns;
+      // The samples read by the first and last columns, and all between
+      const sampleCount first = ColumnCenter(k0) - windowSize / 2;
+      const sampleCount last =
+         ColumnCenter(k0 + specTileColumns - 1) - windowSize / 2 + span;
+      if (first < s1 && s0 < last) {
+         delete it->second;
+         tiles.erase(it++);
+         dropped++;
+      }
+      else
+         ++it;
+   }
+   return dropped;
+}
+
+void SpecTileCache::Clear()
+{
+   for (size_t i = 0; i < mLevels.size(); i++)
+      delete mLevels[i];
+   mLevels.clear();
+}
+
+SpecTileLevel *SpecTileCache::GetLevel
+   (bool autocorrelation, double samplesPerPixel, int rate,
+    const SpectrogramSettings &settings, int zeroPaddingFactor,
+    sampleCount numSamples)
+{
+   for (size_t i = 0; i < mLevels.size(); i++) {
+      SpecTileLevel *level = mLevels[i];
+      if (level->Matches(autocorrelation, samplesPerPixel, rate,
+                         settings, zeroPaddingFactor, numSamples)) {
+         mLevels.erase(mLevels.begin() + i);
+         mLevels.insert(mLevels.begin(), level);
+         return level;
+      }
+   }
+
+   if ((int)mLevels.size() >= specLevelCount) {
+      delete mLevels.back();
+      mLevels.pop_back();
+   }
+
+   SpecTileLevel *level = new SpecTileLevel(autocorrelation, samplesPerPixel,
+                                            rate, settings, zeroPaddingFactor);
+   mLevels.insert(mLevels.begin(), level);
+   return level;
+}
+
+bool SpecTileCache::Invalidate(sampleCount s0, sampleCount s1)
+{
+   bool dropped = false;
+   for (size_t i = 0; i < mLevels.size(); i++)
+      if (mLevels[i]->Invalidate(s0, s1) > 0)
+         dropped = true;
+   return dropped;
+}
+
+void SpecTileCache::Trim()
+{
+   size_t total = 0;
+   std::vector<int> stamps;
+   for (size_t i = 0; i < mLevels.size(); i++) {
+      SpecTileLevel::TileMap &tiles = mLevels[i]->tiles;
+      for (SpecTileLevel::TileMap::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+         total += it->second->freq.size();
+         stamps.push_back(it->second->lastUsed);
+      }
+   }
+   if (total <= (size_t)specTileBudget)
+      return;
+
+   // Drop about the oldest quarter, but never what the latest call used,
+   // which the view is made of
+   std::sort(stamps.begin(), stamps.end());
+   const int oldest = std::min(stamps[stamps.size() / 4], mUseCount - 1);
+   for (size_t i = 0; i < mLevels.size(); i++) {
+      SpecTileLevel::TileMap &tiles = mLevels[i]->tiles;
+      for (SpecTileLevel::TileMap::iterator it = tiles.begin(); it != tiles.end();) {
+         if (it->second->lastUsed <= oldest) {
+            delete it->second;
+            tiles.erase(it++);
+         }
+         else
+            ++it;
+      }
    }
 }
 
@@ -1005,7 +1290,7 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
                               const float *& spectrogram, const sampleCount *& where,
                               int numPixels,
                               double t0, double pixelsPerSecond,
-                              bool autocorrelation)
+                              bool autocorrelation, bool &isIncomplete)
 {
    const SpectrogramSettings &settings = SpectrogramSettings::defaults();
 
@@ -1027,6 +1312,12 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
    const int fftLen = windowSize * zeroPaddingFactor;
    const int half = fftLen / 2;
 
+   if (SyncSpecTiles()) {
+      // Some of the view is out of date, though mDirty may not say so
+      delete mSpecCache;
+      mSpecCache = new SpecCache();
+   }
+
    const bool match =
       mSpecCache &&
       mSpecCache->len > 0 &&
@@ -1035,38 +1326,24 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
 
    if (match &&
        mSpecCache->start == t0 &&
-       mSpecCache->len >= numPixels) {
+       mSpecCache->len >= numPixels &&
+       mSpecCache->missing == 0) {
       spectrogram = &mSpecCache->freq[0];
       where = &mSpecCache->where[0];
+      isIncomplete = false;
       return false;  //hit cache completely
    }
 
-   std::auto_ptr<SpecCache> oldCache(mSpecCache);
-   mSpecCache = 0;
-
    const double tstep = 1.0 / pixelsPerSecond;
    const double samplesPerPixel = mRate * tstep;
+   const sampleCount numSamples = mSequence->GetNumSamples();
 
-   int oldX0 = 0;
-   double correction = 0.0;
-
-   int copyBegin = 0, copyEnd = 0;
-   if (match) {
-      findCorrection(oldCache->where, oldCache->len, numPixels,
-         t0, mRate, samplesPerPixel,
-         oldX0, correction);
-      // Remember our first pixel maps to oldX0 in the old cache,
-      // possibly out of bounds.
-      // For what range of pixels can data be copied?
-      copyBegin = std::min(numPixels, std::max(0, -oldX0));
-      copyEnd = std::min(numPixels,
-         copyBegin + oldCache->len - std::max(0, oldX0)
-      );
-   }
-
-   if (!(copyEnd > copyBegin))
-      oldCache.reset(0);
+   SpecTileLevel *level = mSpecTiles->GetLevel
+      (autocorrelation, samplesPerPixel, mRate, settings, zeroPaddingFactor,
+       numSamples);
+   const int useStamp = mSpecTiles->NextUse();
 
+   delete mSpecCache;
    mSpecCache = new SpecCache(
       numPixels, autocorrelation, pixelsPerSecond, t0,
       windowType, windowSize, zeroPaddingFactor, frequencyGain
@@ -1075,25 +1352,91 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
 #endif
    );
 
-   fillWhere(mSpecCache->where, numPixels, 0.5, correction,
-      t0, mRate, samplesPerPixel);
+   // The columns are those of the level's grid nearest the pixels, so
+   // that scrolling finds them again
+   const sampleCount k0 = sampleCount(floor(0.5 + t0 * mRate / level->spp));
+   std::vector<sampleCount> &cacheWhere = mSpecCache->where;
+   for (int x = 0; x < numPixels + 1; x++)
+      cacheWhere[x] = level->ColumnCenter(k0 + x);
+   // Be careful to make the first value non-negative
+   cacheWhere[0] = std::max(sampleCount(0), cacheWhere[0]);
+
+   std::vector<sampleCount> missingTiles;
+   if (numPixels > 0) {
+      const sampleCount tLast = TileOfColumn(k0 + numPixels - 1);
+      for (sampleCount t = TileOfColumn(k0); t <= tLast; t++) {
+         SpecTileLevel::TileMap::iterator it = level->tiles.find(t);
+         if (it == level->tiles.end())
+            missingTiles.push_back(t);
+         else
+            it->second->lastUsed = useStamp;
+      }
+   }
 
-   // Optimization: if the old cache is good and overlaps
-   // with the current one, re-use as much of the cache as
-   // possible
-   if (oldCache.get()) {
-      memcpy(&mSpecCache->freq[half * copyBegin],
-         &oldCache->freq[half * (copyBegin + oldX0)],
-         half * (copyEnd - copyBegin) * sizeof(float));
+   if (!missingTiles.empty()) {
+#ifdef EXPERIMENTAL_USE_REALFFTF
+      settings.CacheWindows();
+#endif
+
+      std::vector<float> gainFactors;
+      ComputeSpectrogramGainFactors(fftLen, mRate, frequencyGain, gainFactors);
+
+      SpecTileTask task(settings, *level, waveTrackCache.GetTrack(),
+                        numSamples, mOffset, gainFactors);
+      WorkerPool &pool = WorkerPool::Get();
+      const size_t perRound = 2 * pool.GetThreadCount();
+
+      // Rounds of a few tiles for each thread until the time for this
+      // call is spent; there is always one, so every paint gets further
+      wxStopWatch watch;
+      size_t done = 0;
+      do {
+         const size_t count = std::min(perRound, missingTiles.size() - done);
+         task.indices.assign(missingTiles.begin() + done,
+                             missingTiles.begin() + done + count);
+         task.tiles.clear();
+         for (size_t i = 0; i < count; i++) {
+            SpecTile *tile = new SpecTile;
+            tile->freq.resize(half * specTileColumns);
+            tile->lastUsed = useStamp;
+            task.tiles.push_back(tile);
+         }
+
+         pool.Run(&task, count);
+
+         for (size_t i = 0; i < count; i++)
+            level->tiles[task.indices[i]] = task.tiles[i];
+         done += count;
+      } while (done < missingTiles.size() && watch.Time() < specPaintBudget);
    }
 
-   mSpecCache->Populate
-      (settings, waveTrackCache, copyBegin, copyEnd, numPixels,
-       mSequence->GetNumSamples(), mOffset, mRate, autocorrelation);
+   // Copy the view out of the tiles, blanking the columns still missing
+   const float blank = autocorrelation ? 0.0f : -160.0f;
+   int missing = 0;
+   for (int x = 0; x < numPixels;) {
+      const sampleCount k = k0 + x;
+      const sampleCount t = TileOfColumn(k);
+      const int col = int(k - t * specTileColumns);
+      const int count = std::min(numPixels - x, specTileColumns - col);
+      float *const dest = &mSpecCache->freq[half * x];
+
+      SpecTileLevel::TileMap::iterator it = level->tiles.find(t);
+      if (it != level->tiles.end())
+         memcpy(dest, &it->second->freq[half * col], half * count * sizeof(float));
+      else {
+         std::fill(dest, dest + half * count, blank);
+         missing += count;
+      }
+      x += count;
+   }
+
+   mSpecTiles->Trim();
 
+   mSpecCache->missing = missing;
    mSpecCache->dirty = mDirty;
    spectrogram = &mSpecCache->freq[0];
    where = &mSpecCache->where[0];
+   isIncomplete = missing > 0;
    return true;
 }
 
@@ -1182,6 +1525,7 @@ bool WaveClip::Append(samplePtr buffer, sampleFormat format,
 {
    //wxLogDebug(wxT("Append: len=%lli"), (long long) len);
 
+   const sampleCount from = mSequence->GetNumSamples();
    sampleCount maxBlockSize = mSequence->GetMaxBlockSize();
    sampleCount blockSize = mSequence->GetIdealAppendLen();
    sampleFormat seqFormat = mSequence->GetSampleFormat();
@@ -1223,7 +1567,7 @@ bool WaveClip::Append(samplePtr buffer, sampleFormat format,
    }
 
    UpdateEnvelopeTrackLen();
-   MarkChanged();
+   MarkAppended(from);
 
    return true;
 }
@@ -1231,11 +1575,12 @@ bool WaveClip::Append(samplePtr buffer, sampleFormat format,
 bool WaveClip::AppendAlias(wxString fName, sampleCount start,
                             sampleCount len, int channel,bool useOD)
 {
+   const sampleCount from = mSequence->GetNumSamples();
    bool result = mSequence->AppendAlias(fName, start, len, channel,useOD);
    if (result)
    {
       UpdateEnvelopeTrackLen();
-      MarkChanged();
+      MarkAppended(from);
    }
    return result;
 }
@@ -1243,11 +1588,12 @@ bool WaveClip::AppendAlias(wxString fName, sampleCount start,
 bool WaveClip::AppendCoded(wxString fName, sampleCount start,
                             sampleCount len, int channel, int decodeType)
 {
+   const sampleCount from = mSequence->GetNumSamples();
    bool result = mSequence->AppendCoded(fName, start, len, channel, decodeType);
    if (result)
    {
       UpdateEnvelopeTrackLen();
-      MarkChanged();
+      MarkAppended(from);
    }
    return result;
 }
@@ -1260,11 +1606,12 @@ bool WaveClip::Flush()
 
    bool success = true;
    if (mAppendBufferLen > 0) {
+      const sampleCount from = mSequence->GetNumSamples();
       success = mSequence->Append(mAppendBuffer, mSequence->GetSampleFormat(), mAppendBufferLen);
       if (success) {
          mAppendBufferLen = 0;
          UpdateEnvelopeTrackLen();
-         MarkChanged();
+         MarkAppended(from);
       }
    }
 
@@ -1748,6 +2095,7 @@ bool WaveClip::Resample(int rate, ProgressDialog *progress)
       if (mSpecCache)
          delete mSpecCache;
       mSpecCache = new SpecCache();
+      mSpecTilesStale = true;
    }
 
    return !error;
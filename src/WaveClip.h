@@ -29,12 +29,14 @@
 #include <wx/list.h>
 #include <wx/msgdlg.h>
 
+#include <utility>
 #include <vector>
 
 class Envelope;
 class WaveCache;
 class WaveTrackCache;
 class SpecCache;
+class SpecTileCache;
 
 class SpecPxCache {
 public:
@@ -144,7 +146,7 @@ public:
    bool AfterClip(double t) const;
 
    bool GetSamples(samplePtr buffer, sampleFormat format,
-                   sampleCount start, sampleCount len) const;
+                   sampleCount start, sampleCount len, bool readAhead = false) const;
    bool SetSamples(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len);
 
@@ -159,7 +161,8 @@ public:
    /** WaveTrack calls this whenever data in the wave clip changes. It is
     * called automatically when WaveClip has a chance to know that something
     * has changed, like when member functions SetSamples() etc. are called. */
-   void MarkChanged() { mDirty++; }
+   void MarkChanged() { mDirty++; mSpecTilesStale = true; }
+   int GetDirty() const { return mDirty; }
 
    /// Create clip from copy, discarding previous information in the clip
    bool CreateFromCopy(double t0, double t1, WaveClip* other);
@@ -168,11 +171,14 @@ public:
     * calculations and Contrast */
    bool GetWaveDisplay(WaveDisplay &display,
                        double t0, double pixelsPerSecond, bool &isLoadingOD);
+   /// Columns not computed yet, left blank so that a paint takes a
+   /// bounded time, are counted in isIncomplete; the next call goes on
+   /// with them
    bool GetSpectrogram(WaveTrackCache &cache,
                        const float *& spectrogram, const sampleCount *& where,
                        int numPixels,
                        double t0, double pixelsPerSecond,
-                       bool autocorrelation);
+                       bool autocorrelation, bool &isIncomplete);
    bool GetMinMax(float *min, float *max, double t0, double t1);
    bool GetRMS(float *rms, double t0, double t1);
 
@@ -246,6 +252,7 @@ public:
    void DeleteWaveCache();
 
    ///Adds an invalid region to the wavecache so it redraws that portion only.
+   ///Also recomputes the spectrogram tiles over it.  Thread-safe
    void AddInvalidRegion(long startSample, long endSample);
 
    //
@@ -265,6 +272,13 @@ public:
    void SetIsPlaceholder(bool val) { mIsPlaceholder = val; }
 
 protected:
+   /// As MarkChanged(), for samples added from sample number from on,
+   /// which leaves the spectrogram tiles before them good
+   void MarkAppended(sampleCount from);
+   /// Drops the spectrogram tiles made stale by changes since the last
+   /// call; returns whether there were any
+   bool SyncSpecTiles();
+
    wxRect mDisplayRect;
 
    double mOffset;
@@ -277,6 +291,13 @@ protected:
    WaveCache    *mWaveCache;
    ODLock       mWaveCacheMutex;
    SpecCache    *mSpecCache;
+   SpecTileCache *mSpecTiles;
+   // Sample ranges changed since the spectrogram tiles were last used,
+   // noted by appends and by on-demand loading, maybe on other threads
+   ODLock       mSpecInvalidMutex;
+   std::vector< std::pair<sampleCount, sampleCount> > mSpecInvalidRegions;
+   // Set by other changes, after which no tile can be kept
+   bool         mSpecTilesStale;
    samplePtr     mAppendBuffer;
    sampleCount   mAppendBufferLen;
 
@@ -31,6 +31,7 @@ Track classes.
 #include <wx/defs.h>
 #include <wx/intl.h>
 #include <wx/debug.h>
+#include <wx/thread.h>
 
 #include <float.h>
 #include <math.h>
@@ -67,6 +68,16 @@ WaveTrack* TrackFactory::DuplicateWaveTrack(WaveTrack &orig)
 }
 
 
+int WaveTrack::sDefaultDisplay = WaveTrack::WaveformDisplay;
+
+// wxFileConfig moves its current group even to read, so no other thread
+// may use gPrefs; the ImportQueue makes tracks on the WorkerPool
+void WaveTrack::UpdateDefaultDisplay()
+{
+   wxASSERT(wxThread::IsMain());
+   gPrefs->Read(wxT("/GUI/DefaultViewMode"), &sDefaultDisplay, 0);
+}
+
 WaveTrack *TrackFactory::NewWaveTrack(sampleFormat format, double rate)
 {
    return new WaveTrack(mDirManager, format, rate);
@@ -84,7 +95,9 @@ WaveTrack::WaveTrack(DirManager *projDirManager, sampleFormat format, double rat
       rate = GetActiveProject()->GetRate();
    }
 
-   gPrefs->Read(wxT("/GUI/DefaultViewMode"), &mDisplay, 0);
+   if (wxThread::IsMain())
+      UpdateDefaultDisplay();
+   mDisplay = sDefaultDisplay;
 
    mLegacyProjectFileOffset = 0;
 
@@ -106,7 +119,9 @@ WaveTrack::WaveTrack(DirManager *projDirManager, sampleFormat format, double rat
 WaveTrack::WaveTrack(WaveTrack &orig):
    Track(orig)
 {
-   gPrefs->Read(wxT("/GUI/DefaultViewMode"), &mDisplay, 0);
+   if (wxThread::IsMain())
+      UpdateDefaultDisplay();
+   mDisplay = sDefaultDisplay;
    mLastDisplay=-1;
 
    mLegacyProjectFileOffset = 0;
@@ -1767,7 +1782,8 @@ bool WaveTrack::GetRMS(float *rms, double t0, double t1)
 }
 
 bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
-                    sampleCount start, sampleCount len, fillFormat fill ) const
+                    sampleCount start, sampleCount len, fillFormat fill,
+                    bool readAhead) const
 {
    // Simple optimization: When this buffer is completely contained within one clip,
    // don't clear anything (because we won't have to). Otherwise, just clear
@@ -1826,7 +1842,7 @@ bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
          }
 
          if (!clip->GetSamples((samplePtr)(((char*)buffer)+startDelta*SAMPLE_SIZE(format)),
-                               format, inclipDelta, samplesToCopy))
+                               format, inclipDelta, samplesToCopy, readAhead))
          {
             wxASSERT(false); // should always work
             return false;
@@ -2428,8 +2444,8 @@ void WaveTrackCache::SetTrack(const WaveTrack *pTrack)
          if (!mPTrack ||
              mPTrack->GetMaxBlockSize() != mBufferSize) {
             Free();
-            mBuffers[0].data = new float[mBufferSize];
-            mBuffers[1].data = new float[mBufferSize];
+            mBuffers[0].data = (float *)NewSamples(mBufferSize, floatSample);
+            mBuffers[1].data = (float *)NewSamples(mBufferSize, floatSample);
          }
       }
       else
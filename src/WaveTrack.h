@@ -230,8 +230,12 @@ class AUDACITY_DLL_API WaveTrack: public Track {
    /// same value for "start" in both calls to "Set" and "Get" it is
    /// guaranteed that the same samples are affected.
    ///
+   /// Callers reading straight on, as playback does, pass readAhead so
+   /// that the blocks after these are read ahead; see Sequence::Get().
+   ///
    bool Get(samplePtr buffer, sampleFormat format,
-                   sampleCount start, sampleCount len, fillFormat fill=fillZero) const;
+                   sampleCount start, sampleCount len, fillFormat fill=fillZero,
+                   bool readAhead = false) const;
    bool Set(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len);
    void GetEnvelopeValues(double *buffer, int bufferLen,
@@ -427,6 +431,11 @@ class AUDACITY_DLL_API WaveTrack: public Track {
    int GetDisplay() const {return mDisplay;}
    int GetLastDisplay() {return mLastDisplay;}
 
+   /// Reads the view mode new tracks start in, on the main thread only.
+   /// Tracks made on other threads use the mode read last, so call this
+   /// before handing them work that makes tracks.
+   static void UpdateDefaultDisplay();
+
    void GetDisplayBounds(float *min, float *max);
    void SetDisplayBounds(float min, float max);
 
@@ -452,6 +461,7 @@ class AUDACITY_DLL_API WaveTrack: public Track {
    float         mDisplayMax;
    int           mDisplay; // type of display, from WaveTrackDisplay enum
    int           mLastDisplay; // last display mode
+   static int    sDefaultDisplay; // as last read by UpdateDefaultDisplay()
    int           mDisplayNumLocations;
    int           mDisplayNumLocationsAllocated;
    Location*       mDisplayLocations;
@@ -506,7 +516,7 @@ private:
       sampleCount len;
 
       Buffer() : data(0), start(0), len(0) {}
-      void Free() { delete[] data; data = 0; start = 0; len = 0; }
+      void Free() { DeleteSamples((samplePtr)data); data = 0; start = 0; len = 0; }
       sampleCount end() const { return start + len; }
    };
 
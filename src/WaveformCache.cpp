@@ -0,0 +1,323 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WaveformCache.cpp
+
+*******************************************************************//**
+
+\class WaveformCache
+\brief Keeps the coarse levels of BlockFile summary pyramids, within a
+memory budget, and from one session to the next.
+
+Drawing a long track zoomed out needs the summary of every block in
+it.  Block samples never change once written, so what is computed
+from them can be kept for as long as the block exists, under a key
+naming the block and its contents.  A project's entries are saved in
+its data directory and read back when it is opened, so the first
+paint of a big project needs no summary reads at all, and an edit
+costs only the blocks it creates.
+
+*//****************************************************************//**
+
+\class WaveformCacheKey
+\brief Identifies the samples of a block for WaveformCache.
+
+*//*******************************************************************/
+
+#include "WaveformCache.h"
+
+#include <set>
+#include <string.h>
+
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/log.h>
+
+static const char sCacheFileTag[] = "AudacityWaveformCache1";
+static const wxUint32 sByteOrderMark = 0x01020304;
+
+WaveformCacheKey::WaveformCacheKey()
+   : factor(0), len(0), min(0), max(0), rms(0)
+{
+}
+
+bool WaveformCacheKey::operator<(const WaveformCacheKey &other) const
+{
+   int cmp = name.Cmp(other.name);
+   if (cmp != 0)
+      return cmp < 0;
+   if (factor != other.factor)
+      return factor < other.factor;
+   if (len != other.len)
+      return len < other.len;
+   if (min != other.min)
+      return min < other.min;
+   if (max != other.max)
+      return max < other.max;
+   return rms < other.rms;
+}
+
+WaveformCache *WaveformCache::sInstance = NULL;
+ODLock WaveformCache::sInstanceLock;
+
+WaveformCache &WaveformCache::Get()
+{
+   ODLocker locker(sInstanceLock);
+   if (!sInstance)
+      sInstance = new WaveformCache;
+   return *sInstance;
+}
+
+WaveformCache::WaveformCache()
+{
+   mBudget = 64 * 1048576;
+   mUsage = 0;
+}
+
+void WaveformCache::SetBudget(size_t bytes)
+{
+   ODLocker locker(mLock);
+   mBudget = bytes;
+   Trim();
+}
+
+size_t WaveformCache::GetBudget()
+{
+   ODLocker locker(mLock);
+   return mBudget;
+}
+
+size_t WaveformCache::GetUsage()
+{
+   ODLocker locker(mLock);
+   return mUsage;
+}
+
+size_t WaveformCache::EntrySize(const Entry &entry)
+{
+   // Roughly what the key and the bookkeeping take, besides the data
+   return entry.data.size() * sizeof(float) + 128;
+}
+
+bool WaveformCache::Read(const WaveformCacheKey &key,
+                         size_t offset, size_t count, float *buffer)
+{
+   ODLocker locker(mLock);
+
+   EntryMap::iterator it = mEntries.find(key);
+   if (it == mEntries.end() || offset + count > it->second.data.size())
+      return false;
+
+   memcpy(buffer, &it->second.data[offset], count * sizeof(float));
+
+   // Now the most recently used
+   mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+
+   return true;
+}
+
+void WaveformCache::Store(const WaveformCacheKey &key,
+                          const std::vector<float> &data)
+{
+   ODLocker locker(mLock);
+   Insert(key, data);
+   Trim();
+}
+
+// Call with mLock held
+void WaveformCache::Insert(const WaveformCacheKey &key,
+                           const std::vector<float> &data)
+{
+   EntryMap::iterator it = mEntries.find(key);
+   if (it != mEntries.end()) {
+      mUsage -= EntrySize(it->second);
+      mLRU.erase(it->second.lru);
+      mEntries.erase(it);
+   }
+
+   Entry &entry = mEntries[key];
+   entry.data = data;
+   mLRU.push_front(key);
+   entry.lru = mLRU.begin();
+   mUsage += EntrySize(entry);
+}
+
+// Call with mLock held
+void WaveformCache::Trim()
+{
+   while (mUsage > mBudget && !mLRU.empty()) {
+      EntryMap::iterator it = mEntries.find(mLRU.back());
+      mLRU.pop_back();
+      if (it != mEntries.end()) {
+         mUsage -= EntrySize(it->second);
+         mEntries.erase(it);
+      }
+   }
+}
+
+//
+// Cache files hold the tag, a byte order mark, and then one record per
+// entry: the name as UTF-8 preceded by its length, the rest of the key,
+// and the data preceded by their count.  They are only ever read on the
+// machine that wrote them, so numbers are in its byte order.
+//
+
+static bool WriteRecord(wxFFile &file, const WaveformCacheKey &key,
+                        const std::vector<float> &data)
+{
+   wxCharBuffer name = key.name.ToUTF8();
+   wxUint32 nameLen = strlen(name.data());
+   wxInt32 factor = key.factor;
+   wxInt64 len = key.len;
+   float stats[3] = { key.min, key.max, key.rms };
+   wxUint32 count = data.size();
+
+   return
+      file.Write(&nameLen, sizeof(nameLen)) == sizeof(nameLen) &&
+      file.Write(name.data(), nameLen) == nameLen &&
+      file.Write(&factor, sizeof(factor)) == sizeof(factor) &&
+      file.Write(&len, sizeof(len)) == sizeof(len) &&
+      file.Write(stats, sizeof(stats)) == sizeof(stats) &&
+      file.Write(&count, sizeof(count)) == sizeof(count) &&
+      (count == 0 ||
+       file.Write(&data[0], count * sizeof(float)) == count * sizeof(float));
+}
+
+static bool ReadRecord(wxFFile &file, WaveformCacheKey &key,
+                       std::vector<float> &data)
+{
+   wxUint32 nameLen;
+   if (file.Read(&nameLen, sizeof(nameLen)) != sizeof(nameLen) ||
+       nameLen == 0 || nameLen > 1024)
+      return false;
+
+   std::vector<char> name(nameLen + 1);
+   if (file.Read(&name[0], nameLen) != nameLen)
+      return false;
+   name[nameLen] = 0;
+   key.name = wxString::FromUTF8(&name[0]);
+
+   wxInt32 factor;
+   wxInt64 len;
+   float stats[3];
+   wxUint32 count;
+   if (file.Read(&factor, sizeof(factor)) != sizeof(factor) ||
+       file.Read(&len, sizeof(len)) != sizeof(len) ||
+       file.Read(stats, sizeof(stats)) != sizeof(stats) ||
+       file.Read(&count, sizeof(count)) != sizeof(count) ||
+       count > (1 << 24))
+      return false;
+
+   key.factor = factor;
+   key.len = len;
+   key.min = stats[0];
+   key.max = stats[1];
+   key.rms = stats[2];
+
+   data.resize(count);
+   return count == 0 ||
+      file.Read(&data[0], count * sizeof(float)) == count * sizeof(float);
+}
+
+static bool ReadHeader(wxFFile &file)
+{
+   char tag[sizeof(sCacheFileTag)];
+   wxUint32 mark;
+   return
+      file.Read(tag, sizeof(tag)) == sizeof(tag) &&
+      !memcmp(tag, sCacheFileTag, sizeof(tag)) &&
+      file.Read(&mark, sizeof(mark)) == sizeof(mark) &&
+      mark == sByteOrderMark;
+}
+
+static bool WriteHeader(wxFFile &file)
+{
+   return
+      file.Write(sCacheFileTag, sizeof(sCacheFileTag)) ==
+         sizeof(sCacheFileTag) &&
+      file.Write(&sByteOrderMark, sizeof(sByteOrderMark)) ==
+         sizeof(sByteOrderMark);
+}
+
+bool WaveformCache::Load(const wxString &fileName)
+{
+   if (!wxFileExists(fileName))
+      return false;
+
+   // The cache is only an optimization; don't bother the user about it
+   wxLogNull logNo;
+
+   wxFFile file(fileName, wxT("rb"));
+   if (!file.IsOpened() || !ReadHeader(file))
+      return false;
+
+   WaveformCacheKey key;
+   std::vector<float> data;
+   while (ReadRecord(file, key, data)) {
+      ODLocker locker(mLock);
+      // Don't replace what this session has computed, and put what is
+      // read behind everything this session has used, to go first
+      if (mEntries.find(key) == mEntries.end()) {
+         Insert(key, data);
+         mLRU.splice(mLRU.end(), mLRU, mEntries[key].lru);
+      }
+      Trim();
+   }
+
+   return true;
+}
+
+bool WaveformCache::Save(const wxString &fileName,
+                         const std::vector<WaveformCacheKey> &keys)
+{
+   wxLogNull logNo;
+
+   std::set<WaveformCacheKey> wanted(keys.begin(), keys.end());
+   std::set<WaveformCacheKey> written;
+
+   wxString tempName = fileName + wxT(".tmp");
+   wxFFile out(tempName, wxT("wb"));
+   if (!out.IsOpened())
+      return false;
+
+   bool ok = WriteHeader(out);
+
+   {
+      ODLocker locker(mLock);
+      std::set<WaveformCacheKey>::const_iterator it;
+      for (it = wanted.begin(); ok && it != wanted.end(); ++it) {
+         EntryMap::const_iterator entry = mEntries.find(*it);
+         if (entry != mEntries.end()) {
+            ok = WriteRecord(out, *it, entry->second.data);
+            written.insert(*it);
+         }
+      }
+   }
+
+   // Keep what the old file has for blocks whose entries were dropped
+   if (ok && wxFileExists(fileName)) {
+      wxFFile in(fileName, wxT("rb"));
+      if (in.IsOpened() && ReadHeader(in)) {
+         WaveformCacheKey key;
+         std::vector<float> data;
+         while (ok && ReadRecord(in, key, data)) {
+            if (wanted.count(key) && !written.count(key)) {
+               ok = WriteRecord(out, key, data);
+               written.insert(key);
+            }
+         }
+      }
+   }
+
+   ok = out.Close() && ok;
+
+   if (!ok || written.empty()) {
+      wxRemoveFile(tempName);
+      if (ok)
+         wxRemoveFile(fileName);
+      return ok;
+   }
+
+   return wxRenameFile(tempName, fileName, true);
+}
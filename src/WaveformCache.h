@@ -0,0 +1,92 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WaveformCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WAVEFORM_CACHE__
+#define __AUDACITY_WAVEFORM_CACHE__
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "Audacity.h"
+#include "audacity/Types.h"
+#include "ondemand/ODTaskThread.h"
+
+/// Identifies the samples of a block: the name of its file, with its
+/// length and overall min, max and RMS to tell apart different samples
+/// that come to have the same name, as block names get reused.
+class AUDACITY_DLL_API WaveformCacheKey
+{
+ public:
+   WaveformCacheKey();
+
+   bool operator<(const WaveformCacheKey &other) const;
+
+   wxString name;
+   int factor;       // of the summary pyramid the data are for
+   sampleCount len;
+   float min;
+   float max;
+   float rms;
+};
+
+class AUDACITY_DLL_API WaveformCache
+{
+ public:
+   /// The cache shared by all projects
+   static WaveformCache &Get();
+
+   /// Memory the cache may use; the least recently used entries are
+   /// dropped to stay within it
+   void SetBudget(size_t bytes);
+   size_t GetBudget();
+   size_t GetUsage();
+
+   /// Copies count floats from offset in the data stored for key.
+   /// Returns false if there are none.
+   bool Read(const WaveformCacheKey &key, size_t offset, size_t count,
+             float *buffer);
+   /// Stores data for key, replacing any already there
+   void Store(const WaveformCacheKey &key, const std::vector<float> &data);
+
+   /// Adds the entries of a cache file written by Save() to those in
+   /// memory.  A missing or unreadable file is not an error; the cache
+   /// just starts empty.
+   bool Load(const wxString &fileName);
+   /// Writes the entries for the given keys to a cache file, taking those
+   /// dropped from memory since the file was loaded from the old file
+   bool Save(const wxString &fileName,
+             const std::vector<WaveformCacheKey> &keys);
+
+ private:
+   WaveformCache();
+
+   struct Entry {
+      std::vector<float> data;
+      std::list<WaveformCacheKey>::iterator lru;
+   };
+   typedef std::map<WaveformCacheKey, Entry> EntryMap;
+
+   static size_t EntrySize(const Entry &entry);
+   void Insert(const WaveformCacheKey &key, const std::vector<float> &data);
+   void Trim();
+
+   static WaveformCache *sInstance;
+   static ODLock sInstanceLock;
+
+   // Everything below is guarded by mLock
+   ODLock mLock;
+   EntryMap mEntries;
+   std::list<WaveformCacheKey> mLRU;   // most recently used first
+   size_t mBudget;
+   size_t mUsage;
+};
+
+#endif
@@ -0,0 +1,163 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WorkerPool.cpp
+
+*******************************************************************//**
+
+\class WorkerPool
+\brief A fixed set of threads, one per processor, that share out the
+parts of a WorkerTask.
+
+Run() hands the parts out one at a time to whichever thread asks next,
+including the calling thread, and blocks until they are all done.  Only
+one task runs at a time; a Run() that finds the pool busy simply does
+all the parts itself, so nested or concurrent use can't deadlock.
+
+*//****************************************************************//**
+
+\class WorkerTask
+\brief Interface for work that WorkerPool can split across threads.
+
+*//****************************************************************//**
+
+\class WorkerThread
+\brief One of the threads of WorkerPool.
+
+*//*******************************************************************/
+
+#include "WorkerPool.h"
+
+#include <wx/thread.h>
+
+class WorkerThread : public wxThread
+{
+ public:
+   WorkerThread(WorkerPool *pool)
+      : wxThread(wxTHREAD_JOINABLE), mPool(pool) {}
+
+   virtual ExitCode Entry()
+   {
+      mPool->WorkerLoop();
+      return 0;
+   }
+
+ private:
+   WorkerPool *mPool;
+};
+
+WorkerPool *WorkerPool::sInstance = NULL;
+ODLock WorkerPool::sInstanceLock;
+
+WorkerPool &WorkerPool::Get()
+{
+   ODLocker locker(sInstanceLock);
+   if (!sInstance)
+      // The thread calling Run() is one of the workers
+      sInstance = new WorkerPool(wxThread::GetCPUCount() - 1);
+   return *sInstance;
+}
+
+void WorkerPool::Quit()
+{
+   ODLocker locker(sInstanceLock);
+   delete sInstance;
+   sInstance = NULL;
+}
+
+WorkerPool::WorkerPool(int threads)
+{
+   mWorkAvailable = new ODCondition(&mLock);
+   mWorkDone = new ODCondition(&mLock);
+
+   mTask = NULL;
+   mCount = 0;
+   mNext = 0;
+   mPending = 0;
+   mQuit = false;
+
+   for (int i = 0; i < threads; i++) {
+      WorkerThread *thread = new WorkerThread(this);
+      if (thread->Create() != wxTHREAD_NO_ERROR) {
+         delete thread;
+         break;
+      }
+      thread->Run();
+      mThreads.push_back(thread);
+   }
+}
+
+WorkerPool::~WorkerPool()
+{
+   mLock.Lock();
+   mQuit = true;
+   mWorkAvailable->Broadcast();
+   mLock.Unlock();
+
+   for (size_t i = 0; i < mThreads.size(); i++) {
+      mThreads[i]->Wait();
+      delete mThreads[i];
+   }
+
+   delete mWorkAvailable;
+   delete mWorkDone;
+}
+
+int WorkerPool::GetThreadCount()
+{
+   return (int)mThreads.size() + 1;
+}
+
+void WorkerPool::Run(WorkerTask *task, int count)
+{
+   mLock.Lock();
+
+   if (mTask || mThreads.empty() || count < 2) {
+      mLock.Unlock();
+      for (int i = 0; i < count; i++)
+         task->Run(i);
+      return;
+   }
+
+   mTask = task;
+   mCount = count;
+   mNext = 0;
+   mPending = count;
+   mWorkAvailable->Broadcast();
+
+   while (mNext < mCount) {
+      int index = mNext++;
+      mLock.Unlock();
+      task->Run(index);
+      mLock.Lock();
+      mPending--;
+   }
+
+   while (mPending > 0)
+      mWorkDone->Wait();
+
+   mTask = NULL;
+   mLock.Unlock();
+}
+
+void WorkerPool::WorkerLoop()
+{
+   mLock.Lock();
+
+   while (!mQuit) {
+      if (mTask && mNext < mCount) {
+         WorkerTask *task = mTask;
+         int index = mNext++;
+         mLock.Unlock();
+         task->Run(index);
+         mLock.Lock();
+         if (--mPending == 0)
+            mWorkDone->Signal();
+      }
+      else
+         mWorkAvailable->Wait();
+   }
+
+   mLock.Unlock();
+}
@@ -0,0 +1,73 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WorkerPool.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WORKER_POOL__
+#define __AUDACITY_WORKER_POOL__
+
+#include <vector>
+
+#include "Audacity.h"
+#include "ondemand/ODTaskThread.h"
+
+/// A piece of work that can be split into independent, numbered parts
+class AUDACITY_DLL_API WorkerTask
+{
+ public:
+   virtual ~WorkerTask() {}
+
+   /// Does part number index of the work.  Called on a worker thread or
+   /// on the thread that called WorkerPool::Run(), never twice for the
+   /// same index.
+   virtual void Run(int index) = 0;
+};
+
+class WorkerThread;
+
+class AUDACITY_DLL_API WorkerPool
+{
+ public:
+   /// The pool shared by the whole program, started on first use
+   static WorkerPool &Get();
+   /// Stops the worker threads; call once at exit
+   static void Quit();
+
+   /// A pool of its own, for work that must not wait on the shared one,
+   /// with threads workers besides the caller
+   WorkerPool(int threads);
+   ~WorkerPool();
+
+   /// Number of threads that work on a task, counting the caller
+   int GetThreadCount();
+
+   /// Calls task->Run(i) for every i in [0, count) and returns once all
+   /// have finished.  The calling thread takes parts too.  If the pool is
+   /// already busy (for instance when called from inside a task), the
+   /// parts run one after another on the calling thread instead.
+   void Run(WorkerTask *task, int count);
+
+ private:
+   friend class WorkerThread;
+   void WorkerLoop();
+
+   static WorkerPool *sInstance;
+   static ODLock sInstanceLock;
+
+   ODLock mLock;
+   ODCondition *mWorkAvailable;
+   ODCondition *mWorkDone;
+   std::vector<WorkerThread *> mThreads;
+
+   // The task being run and its progress, guarded by mLock
+   WorkerTask *mTask;
+   int mCount;
+   int mNext;      // next part to hand out
+   int mPending;   // parts not finished yet
+   bool mQuit;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedBlockCache.cpp
+
+*******************************************************************//**
+
+\class MappedBlockCache
+\brief Keeps recently read .au block files memory-mapped.
+
+Reading a SimpleBlockFile through libsndfile opens the file, parses
+its header and decodes through a temporary buffer on every call, and
+reading its summary opens the file again.  Scrolling and playback hit
+the same few blocks over and over, so instead SimpleBlockFile asks this
+cache for a mapping of the file, whose header is parsed once, and then
+copies samples or summary frames directly out of mapped memory.
+
+Mappings that are not in use are kept in least recently used order and
+unmapped once there are more than the limit.  Mappings must be dropped
+with Invalidate() before their file is rewritten, renamed or deleted,
+which Windows would otherwise refuse to do.
+
+*//****************************************************************//**
+
+\class MappedBlock
+\brief One mapped .au file, handed out by MappedBlockCache.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include <wx/defs.h>
+#include <wx/log.h>
+
+#if defined(__WXMSW__)
+   #include <windows.h>
+   #include <wx/msw/winundef.h>
+#else
+   #include <sys/types.h>
+   #include <sys/stat.h>
+   #include <sys/mman.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+#include "MappedBlockCache.h"
+#include "SimpleBlockFile.h"
+#include "../Internat.h"
+
+MappedBlock::MappedBlock()
+{
+   mBase = NULL;
+   mLength = 0;
+   mSummaryOffset = 0;
+   mDataOffset = 0;
+   mSampleCount = 0;
+   mFormat = floatSample;
+   mUsers = 0;
+   mStale = false;
+#if defined(__WXMSW__)
+   mMapping = NULL;
+#endif
+}
+
+bool MappedBlock::Map(const wxString &path)
+{
+   mPath = path;
+
+#if defined(__WXMSW__)
+   HANDLE file = ::CreateFileW(path.wc_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER size;
+   if (!::GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(auHeader) ||
+       size.HighPart != 0) {
+      ::CloseHandle(file);
+      return false;
+   }
+
+   HANDLE mapping = ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   // The mapping keeps the file open
+   ::CloseHandle(file);
+   if (!mapping)
+      return false;
+
+   void *base = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (!base) {
+      ::CloseHandle(mapping);
+      return false;
+   }
+
+   mMapping = mapping;
+   mBase = (char *)base;
+   mLength = (size_t)size.QuadPart;
+#else
+   int fd = open(OSFILENAME(path), O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(auHeader)) {
+      close(fd);
+      return false;
+   }
+
+   void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   // The mapping keeps the file open
+   close(fd);
+   if (base == MAP_FAILED)
+      return false;
+
+   mBase = (char *)base;
+   mLength = st.st_size;
+#endif
+
+   // Parse the header once.  Files of the other byte order are left
+   // to libsndfile, which knows how to swap them.
+   const auHeader *header = (const auHeader *)mBase;
+   if (header->magic != 0x2e736e64 ||
+       header->channels != 1 ||
+       header->dataOffset < sizeof(auHeader) ||
+       header->dataOffset > mLength) {
+      Unmap();
+      return false;
+   }
+
+   switch (header->encoding) {
+   case AU_SAMPLE_FORMAT_16:
+      mFormat = int16Sample;
+      break;
+   case AU_SAMPLE_FORMAT_24:
+      mFormat = int24Sample;
+      break;
+   case AU_SAMPLE_FORMAT_FLOAT:
+      mFormat = floatSample;
+      break;
+   default:
+      Unmap();
+      return false;
+   }
+
+   mSummaryOffset = sizeof(auHeader);
+   mDataOffset = header->dataOffset;
+   mSampleCount = (mLength - mDataOffset) / SAMPLE_SIZE_DISK(mFormat);
+
+   return true;
+}
+
+void MappedBlock::Unmap()
+{
+   if (!mBase)
+      return;
+
+#if defined(__WXMSW__)
+   ::UnmapViewOfFile(mBase);
+   ::CloseHandle((HANDLE)mMapping);
+   mMapping = NULL;
+#else
+   munmap(mBase, mLength);
+#endif
+
+   mBase = NULL;
+   mLength = 0;
+}
+
+MappedBlockCache &MappedBlockCache::Get()
+{
+   static MappedBlockCache cache;
+   return cache;
+}
+
+MappedBlockCache::MappedBlockCache()
+{
+   // Leave room in the address space of 32-bit builds
+   mMaxBlocks = sizeof(void *) > 4 ? 1024 : 64;
+}
+
+MappedBlockCache::~MappedBlockCache()
+{
+   Clear();
+}
+
+void MappedBlockCache::SetMaxBlocks(int maxBlocks)
+{
+   ODLocker locker(mLock);
+   mMaxBlocks = maxBlocks;
+   Trim();
+}
+
+MappedBlock *MappedBlockCache::Acquire(const wxString &path)
+{
+   ODLocker locker(mLock);
+
+   MappedBlockHash::iterator iter = mHash.find(path);
+   if (iter != mHash.end()) {
+      MappedBlock *block = iter->second;
+      // move to the front of the LRU list
+      mLRU.erase(block->mPosition);
+      mLRU.push_front(block);
+      block->mPosition = mLRU.begin();
+      block->mUsers++;
+      return block;
+   }
+
+   MappedBlock *block = new MappedBlock;
+   if (!block->Map(path)) {
+      delete block;
+      return NULL;
+   }
+
+   mLRU.push_front(block);
+   block->mPosition = mLRU.begin();
+   mHash[path] = block;
+   block->mUsers++;
+
+   Trim();
+
+   return block;
+}
+
+void MappedBlockCache::Release(MappedBlock *block)
+{
+   ODLocker locker(mLock);
+
+   block->mUsers--;
+   if (block->mStale && block->mUsers == 0) {
+      block->Unmap();
+      delete block;
+   }
+}
+
+void MappedBlockCache::Invalidate(const wxString &path)
+{
+   ODLocker locker(mLock);
+
+   MappedBlockHash::iterator iter = mHash.find(path);
+   if (iter != mHash.end())
+      Drop(iter->second);
+}
+
+void MappedBlockCache::Clear()
+{
+   ODLocker locker(mLock);
+
+   while (!mLRU.empty())
+      Drop(mLRU.back());
+}
+
+void MappedBlockCache::Drop(MappedBlock *block)
+{
+   mHash.erase(block->mPath);
+   mLRU.erase(block->mPosition);
+
+   if (block->mUsers > 0)
+      // Somebody is still reading; the last Release() unmaps it
+      block->mStale = true;
+   else {
+      block->Unmap();
+      delete block;
+   }
+}
+
+void MappedBlockCache::Trim()
+{
+   std::list<MappedBlock *>::iterator iter = mLRU.end();
+   int count = mLRU.size();
+   while (count > mMaxBlocks && iter != mLRU.begin()) {
+      --iter;
+      MappedBlock *block = *iter;
+      if (block->mUsers == 0) {
+         // Drop() erases the element, so step back over it first
+         std::list<MappedBlock *>::iterator next = iter;
+         ++next;
+         Drop(block);
+         iter = next;
+         count--;
+      }
+   }
+}
@@ -0,0 +1,96 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedBlockCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MAPPED_BLOCK_CACHE__
+#define __AUDACITY_MAPPED_BLOCK_CACHE__
+
+#include <list>
+
+#include <wx/string.h>
+#include <wx/hashmap.h>
+
+#include "../SampleFormat.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// A read-only memory mapping of one .au block file, with its header
+/// already parsed.  Only files written in this machine's byte order are
+/// mapped; others keep using libsndfile.
+class MappedBlock {
+ public:
+   /// Start of the summary data, just past the au header
+   const char *GetSummary() const { return mBase + mSummaryOffset; }
+   /// Start of the sample data
+   const char *GetSamples() const { return mBase + mDataOffset; }
+   /// Number of whole samples the file holds
+   sampleCount GetSampleCount() const { return mSampleCount; }
+   sampleFormat GetFormat() const { return mFormat; }
+   /// Bytes of summary data available in the file
+   size_t GetSummaryBytes() const { return mDataOffset - mSummaryOffset; }
+
+ private:
+   friend class MappedBlockCache;
+
+   MappedBlock();
+   bool Map(const wxString &path);
+   void Unmap();
+
+   wxString mPath;
+   char *mBase;
+   size_t mLength;
+   size_t mSummaryOffset;
+   size_t mDataOffset;
+   sampleCount mSampleCount;
+   sampleFormat mFormat;
+
+   int mUsers;      // readers currently holding this mapping
+   bool mStale;     // invalidated while in use; unmap on last release
+   std::list<MappedBlock *>::iterator mPosition;
+
+#if defined(__WXMSW__)
+   void *mMapping;  // HANDLE of the file mapping object
+#endif
+};
+
+WX_DECLARE_STRING_HASH_MAP(MappedBlock *, MappedBlockHash);
+
+/// \brief Process-wide, bounded LRU of mapped SimpleBlockFiles, so
+/// that repeated reads of the same block skip opening the file and
+/// decoding its header.
+class MappedBlockCache {
+ public:
+   static MappedBlockCache &Get();
+
+   /// Returns the mapping of the file at path, mapping it if needed, or
+   /// NULL if it can't be mapped.  Pair every non-NULL result with Release().
+   MappedBlock *Acquire(const wxString &path);
+   void Release(MappedBlock *block);
+
+   /// Drops the mapping of a file that is about to be rewritten,
+   /// renamed or removed.
+   void Invalidate(const wxString &path);
+   /// Drops all mappings
+   void Clear();
+
+   /// Limits how many files stay mapped when no longer in use
+   void SetMaxBlocks(int maxBlocks);
+
+ private:
+   MappedBlockCache();
+   ~MappedBlockCache();
+
+   // Must be called with mLock held
+   void Drop(MappedBlock *block);
+   void Trim();
+
+   ODLock mLock;
+   MappedBlockHash mHash;
+   std::list<MappedBlock *> mLRU;   // most recently used first
+   int mMaxBlocks;
+};
+
+#endif
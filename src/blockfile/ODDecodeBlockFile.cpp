@@ -376,8 +376,7 @@ wxFileName ODDecodeBlockFile::GetFileName()
    return name;
 }
 
-/// A thread-safe version of CalcSummary.  BlockFile::CalcSummary
-/// uses a static summary array across the class, which we can't use.
+/// A version of CalcSummary that writes this class's header tag.
 /// Get a buffer containing a summary block describing this sample
 /// data.  This must be called by derived classes when they
 /// are constructed, to allow them to construct their summary data,
@@ -386,9 +385,8 @@ wxFileName ODDecodeBlockFile::GetFileName()
 /// This method also has the side effect of setting the mMin, mMax,
 /// and mRMS members of this class.
 ///
-/// Unlike BlockFile's implementation You SHOULD delete the returned buffer.
-/// this is protected so it shouldn't be hard to deal with - just override
-/// all BlockFile methods that use this method.
+/// As with BlockFile's implementation, the caller must delete[] the
+/// returned buffer.
 ///
 /// @param buffer A buffer containing the sample data to be analyzed
 /// @param len    The length of the sample data
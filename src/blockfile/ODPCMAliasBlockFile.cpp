@@ -443,8 +443,7 @@ void ODPCMAliasBlockFile::WriteSummary()
 
 
 
-/// A thread-safe version of CalcSummary.  BlockFile::CalcSummary
-/// uses a static summary array across the class, which we can't use.
+/// A version of CalcSummary that writes this class's header tag.
 /// Get a buffer containing a summary block describing this sample
 /// data.  This must be called by derived classes when they
 /// are constructed, to allow them to construct their summary data,
@@ -453,9 +452,8 @@ void ODPCMAliasBlockFile::WriteSummary()
 /// This method also has the side effect of setting the mMin, mMax,
 /// and mRMS members of this class.
 ///
-/// Unlike BlockFile's implementation You SHOULD delete the returned buffer.
-/// this is protected so it shouldn't be hard to deal with - just override
-/// all BlockFile methods that use this method.
+/// As with BlockFile's implementation, the caller must delete[] the
+/// returned buffer.
 ///
 /// @param buffer A buffer containing the sample data to be analyzed
 /// @param len    The length of the sample data
@@ -641,9 +639,8 @@ int ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
 
    mSilentAliasLog=FALSE;
 
-   ODManager::LockLibSndFileMutex();
+   //only this thread uses sf, so reading it needs no lock.
    sf_seek(sf, mAliasStart + start, SEEK_SET);
-   ODManager::UnlockLibSndFileMutex();
 
    samplePtr buffer = NewSamples(len * info.channels, floatSample);
 
@@ -655,9 +652,7 @@ int ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
       // and the calling method wants 16-bit data, go ahead and
       // read 16-bit data directly.  This is a pretty common
       // case, as most audio files are 16-bit.
-      ODManager::LockLibSndFileMutex();
       framesRead = sf_readf_short(sf, (short *)buffer, len);
-      ODManager::UnlockLibSndFileMutex();
 
       for (int i = 0; i < framesRead; i++)
          ((short *)data)[i] =
@@ -667,9 +662,7 @@ int ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
       // Otherwise, let libsndfile handle the conversion and
       // scaling, and pass us normalized data as floats.  We can
       // then convert to whatever format we want.
-      ODManager::LockLibSndFileMutex();
       framesRead = sf_readf_float(sf, (float *)buffer, len);
-      ODManager::UnlockLibSndFileMutex();
       float *bufferPtr = &((float *)buffer)[mAliasChannel];
       CopySamples((samplePtr)bufferPtr, floatSample,
                   (samplePtr)data, format,
@@ -113,9 +113,8 @@ int PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
    if(silence) delete silence;
    mSilentAliasLog=FALSE;
 
-   ODManager::LockLibSndFileMutex();
+   //only this thread uses sf, so reading it needs no lock.
    sf_seek(sf, mAliasStart + start, SEEK_SET);
-   ODManager::UnlockLibSndFileMutex();
    samplePtr buffer = NewSamples(len * info.channels, floatSample);
 
    int framesRead = 0;
@@ -126,9 +125,7 @@ int PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
       // and the calling method wants 16-bit data, go ahead and
       // read 16-bit data directly.  This is a pretty common
       // case, as most audio files are 16-bit.
-      ODManager::LockLibSndFileMutex();
       framesRead = sf_readf_short(sf, (short *)buffer, len);
-      ODManager::UnlockLibSndFileMutex();
       for (int i = 0; i < framesRead; i++)
          ((short *)data)[i] =
             ((short *)buffer)[(info.channels * i) + mAliasChannel];
@@ -137,9 +134,7 @@ int PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
       // Otherwise, let libsndfile handle the conversion and
       // scaling, and pass us normalized data as floats.  We can
       // then convert to whatever format we want.
-      ODManager::LockLibSndFileMutex();
       framesRead = sf_readf_float(sf, (float *)buffer, len);
-      ODManager::UnlockLibSndFileMutex();
       float *bufferPtr = &((float *)buffer)[mAliasChannel];
       CopySamples((samplePtr)bufferPtr, floatSample,
                   (samplePtr)data, format,
@@ -0,0 +1,270 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.cpp
+
+*******************************************************************//**
+
+\class PackedBlockFile
+\brief A BlockFile whose summary and sample data are a record in one
+of the project's PackedBlockStore containers.
+
+Behaves like a SimpleBlockFile, but instead of writing an .au file of
+its own it appends the same summary and sample layout to a shared
+container, and remembers the container number and byte offset.  The
+record is never modified afterwards, so reference counting, copying and
+undo work exactly as for other block files.
+
+*//*******************************************************************/
+
+#include <wx/wx.h>
+#include <wx/log.h>
+
+#include "PackedBlockFile.h"
+#include "PackedBlockStore.h"
+#include "../Internat.h"
+
+/// Constructs a PackedBlockFile based on sample data and appends
+/// it to the store.
+///
+/// @param store        The store of the owning DirManager.
+/// @param sampleData   The sample data to be written to this block.
+/// @param sampleLen    The number of samples to be written to this block.
+/// @param format       The format of the given samples.
+PackedBlockFile::PackedBlockFile(PackedBlockStore *store,
+                                 samplePtr sampleData, sampleCount sampleLen,
+                                 sampleFormat format):
+   BlockFile(wxFileName(), sampleLen)
+{
+   mStore = store;
+   mFormat = format;
+   mContainer = -1;
+   mOffset = 0;
+
+   // If the record can't be written, mContainer stays -1 and
+   // WasAppended() says so; DirManager then writes the samples some
+   // other way.
+   void *summaryData = CalcSummary(sampleData, sampleLen, format);
+   if (!mStore->Append(summaryData, mSummaryInfo.totalSummaryBytes,
+                       sampleData, sampleLen, format,
+                       &mName, &mContainer, &mOffset))
+      wxLogWarning(wxT("Could not append a block to the packed store in %s."),
+                   mStore->GetDirectory().c_str());
+   delete [] (char *) summaryData;
+}
+
+/// Construct a PackedBlockFile memory structure that will point to an
+/// existing record.
+PackedBlockFile::PackedBlockFile(PackedBlockStore *store, wxString name,
+                                 int container, wxFileOffset offset,
+                                 sampleFormat format, sampleCount len,
+                                 float min, float max, float rms):
+   BlockFile(wxFileName(), len)
+{
+   mStore = store;
+   mName = name;
+   mContainer = container;
+   mOffset = offset;
+   mFormat = format;
+
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+
+   if (mContainer >= 0)
+      mStore->Register(mName, mContainer);
+}
+
+PackedBlockFile::~PackedBlockFile()
+{
+   // A locked block belongs to a saved project, whose container must stay
+   if (mContainer >= 0)
+      mStore->Release(mContainer, !IsLocked());
+}
+
+wxFileName PackedBlockFile::GetFileName()
+{
+   return wxFileName(mStore->GetDirectory(), mName, wxT("aupk"));
+}
+
+/// Read the summary section of the record.
+///
+/// @param *data The buffer to write the data to.  It must be at least
+/// mSummaryinfo.totalSummaryBytes long.
+bool PackedBlockFile::ReadSummary(void *data)
+{
+   if (mContainer < 0 ||
+       !mStore->ReadSummary(mContainer, mOffset, data,
+                            mSummaryInfo.totalSummaryBytes))
+   {
+      if (!mSilentLog)
+         wxLogWarning(wxT("Could not read summary of packed block %s."),
+                      mName.c_str());
+      memset(data, 0, (size_t)mSummaryInfo.totalSummaryBytes);
+      mSilentLog = TRUE;
+      return true;
+   }
+
+   mSilentLog = FALSE;
+   FixSummary(data);
+   return true;
+}
+
+/// Read the data portion of the record.  Convert it to the given
+/// format if it is not already.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+int PackedBlockFile::ReadData(samplePtr data, sampleFormat format,
+                              sampleCount start, sampleCount len)
+{
+   if (len > mLen - start)
+      len = mLen - start;
+
+   int framesRead = 0;
+   if (mContainer >= 0)
+      framesRead = mStore->ReadSamples(mContainer, mOffset,
+                                       mSummaryInfo.totalSummaryBytes,
+                                       mFormat, data, format, start, len);
+
+   if (framesRead == 0 && len > 0) {
+      // Record is missing: behave as SimpleBlockFile does for a missing .au
+      if (!mSilentLog)
+         wxLogWarning(wxT("Could not read data of packed block %s."),
+                      mName.c_str());
+      ClearSamples(data, format, 0, len);
+      mSilentLog = TRUE;
+      return len;
+   }
+
+   mSilentLog = FALSE;
+   return framesRead;
+}
+
+void PackedBlockFile::SaveXML(XMLWriter &xmlFile)
+{
+   xmlFile.StartTag(wxT("packedblockfile"));
+
+   xmlFile.WriteAttr(wxT("name"), mName);
+   xmlFile.WriteAttr(wxT("container"), mContainer);
+   xmlFile.WriteAttr(wxT("offset"), (long long) mOffset);
+   xmlFile.WriteAttr(wxT("sampleformat"), (long) mFormat);
+   xmlFile.WriteAttr(wxT("len"), mLen);
+   xmlFile.WriteAttr(wxT("min"), mMin);
+   xmlFile.WriteAttr(wxT("max"), mMax);
+   xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+   xmlFile.EndTag(wxT("packedblockfile"));
+}
+
+// BuildFromXML methods should always return a BlockFile, not NULL,
+// even if the result is flawed (e.g., refers to nonexistent record),
+// as testing will be done in DirManager::ProjectFSCK().
+/// static
+BlockFile *PackedBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
+{
+   wxString name;
+   int container = -1;
+   wxLongLong_t offset = 0;
+   sampleFormat format = int16Sample;
+   float min = 0.0f, max = 0.0f, rms = 0.0f;
+   sampleCount len = 0;
+   double dblValue;
+   long nValue;
+   wxLongLong_t nLongValue;
+
+   while(*attrs)
+   {
+      const wxChar *attr =  *attrs++;
+      const wxChar *value = *attrs++;
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (!wxStricmp(attr, wxT("name")) &&
+            XMLValueChecker::IsGoodFileString(strValue))
+         name = strValue;
+      else if (!wxStrcmp(attr, wxT("container")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               nValue >= 0)
+         container = nValue;
+      else if (!wxStrcmp(attr, wxT("offset")) &&
+               XMLValueChecker::IsGoodInt64(strValue) &&
+               strValue.ToLongLong(&nLongValue) && nLongValue >= 0)
+         offset = nLongValue;
+      else if (!wxStrcmp(attr, wxT("sampleformat")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               XMLValueChecker::IsValidSampleFormat(nValue))
+         format = (sampleFormat)nValue;
+      else if (!wxStrcmp(attr, wxT("len")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               nValue > 0)
+         len = nValue;
+      else if (XMLValueChecker::IsGoodString(strValue) && Internat::CompatibleToDouble(strValue, &dblValue))
+      {  // double parameters
+         if (!wxStricmp(attr, wxT("min")))
+            min = dblValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = dblValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
+            rms = dblValue;
+      }
+   }
+
+   return new PackedBlockFile(dm.GetPackedBlockStore(), name,
+                              container, offset, format, len,
+                              min, max, rms);
+}
+
+/// Create a copy of this BlockFile as a new record in the same store.
+/// The file name is ignored; the store names its records itself.
+BlockFile *PackedBlockFile::Copy(wxFileName WXUNUSED(newFileName))
+{
+   return CopyTo(mStore);
+}
+
+PackedBlockFile *PackedBlockFile::CopyTo(PackedBlockStore *store)
+{
+   SampleBuffer buffer(mLen, mFormat);
+   ReadData(buffer.ptr(), mFormat, 0, mLen);
+
+   return new PackedBlockFile(store, buffer.ptr(), mLen, mFormat);
+}
+
+wxLongLong PackedBlockFile::GetSpaceUsage()
+{
+   return PackedBlockStore::GetRecordBytes(mSummaryInfo.totalSummaryBytes,
+                                           mLen, mFormat);
+}
+
+bool PackedBlockFile::IsRecordAvailable()
+{
+   return mContainer >= 0 && mStore->HasRecord(mContainer, mOffset);
+}
+
+/// Replace a missing record with a new record of silence
+void PackedBlockFile::Recover()
+{
+   SampleBuffer silence(mLen, int16Sample);
+   ClearSamples(silence.ptr(), int16Sample, 0, mLen);
+
+   int oldContainer = mContainer;
+   void *summaryData = CalcSummary(silence.ptr(), mLen, int16Sample);
+   wxString name;
+   if (!mStore->Append(summaryData, mSummaryInfo.totalSummaryBytes,
+                       silence.ptr(), mLen, int16Sample,
+                       &name, &mContainer, &mOffset))
+   {
+      // Can't do anything else.
+      mContainer = -1;
+   }
+   delete [] (char *) summaryData;
+   // Keep our name, which is how the project refers to this block
+   mFormat = int16Sample;
+
+   if (oldContainer >= 0)
+      mStore->Release(oldContainer, false);
+}
@@ -0,0 +1,78 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCKFILE__
+#define __AUDACITY_PACKED_BLOCKFILE__
+
+#include <wx/string.h>
+#include <wx/filename.h>
+
+#include "../BlockFile.h"
+#include "../DirManager.h"
+#include "../xml/XMLWriter.h"
+
+class PackedBlockStore;
+
+class PackedBlockFile : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Append summary and sample data to the store as a new record
+   PackedBlockFile(PackedBlockStore *store,
+                   samplePtr sampleData, sampleCount sampleLen,
+                   sampleFormat format);
+   /// Create the memory structure to refer to an existing record
+   PackedBlockFile(PackedBlockStore *store, wxString name,
+                   int container, wxFileOffset offset,
+                   sampleFormat format, sampleCount len,
+                   float min, float max, float rms);
+
+   virtual ~PackedBlockFile();
+
+   /// The name of a file that does not exist, but which identifies
+   /// this block to DirManager just like a SimpleBlockFile's name does
+   virtual wxFileName GetFileName();
+
+   // Reading
+
+   /// Read the summary section of the record
+   virtual bool ReadSummary(void *data);
+   /// Read the data section of the record
+   virtual int ReadData(samplePtr data, sampleFormat format,
+                        sampleCount start, sampleCount len);
+
+   /// Create a new block file identical to this one, in the same store
+   virtual BlockFile *Copy(wxFileName newFileName);
+   /// Create a new block file identical to this one, in the given store
+   PackedBlockFile *CopyTo(PackedBlockStore *store);
+   /// Write an XML representation of this file
+   virtual void SaveXML(XMLWriter &xmlFile);
+
+   virtual wxLongLong GetSpaceUsage();
+   virtual void Recover();
+
+   virtual bool IsPacked() { return true; }
+
+   /// Returns true if the record this block refers to can be found
+   bool IsRecordAvailable();
+   /// Returns false if the constructor could not append the record
+   bool WasAppended() { return mContainer >= 0; }
+   PackedBlockStore *GetStore() { return mStore; }
+
+   static BlockFile *BuildFromXML(DirManager &dm, const wxChar **attrs);
+
+ private:
+   PackedBlockStore *mStore;
+   wxString mName;
+   int mContainer;       // -1 if the record could not be written
+   wxFileOffset mOffset;
+   sampleFormat mFormat;
+};
+
+#endif
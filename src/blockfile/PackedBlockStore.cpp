@@ -0,0 +1,464 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockStore.cpp
+
+*******************************************************************//**
+
+\class PackedBlockStore
+\brief Appends block data into a small number of large container files.
+
+A project with hundreds of thousands of SimpleBlockFiles spends most of
+its open, save and check time on filesystem metadata.  PackedBlockStore
+instead appends each block as a record (header, summary, samples) to
+the end of a container file in the project data directory, starting a
+new container when the current one reaches maxContainerBytes.  Records
+are never rewritten, so a block is fully described by its container
+number and byte offset, which PackedBlockFile saves in the project.
+
+Moving a project only needs to rename the containers.  A container is
+deleted when the last block referring into it goes away, unless a
+locked block (one belonging to a saved project) referred into it.
+
+All file access is serialized, since blocks are appended from the
+recording thread and read from the playback and on-demand threads.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include <string.h>
+
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include "PackedBlockStore.h"
+#include "SimpleBlockFile.h"
+
+// Containers are rolled over at this size, which bounds the amount of
+// dead data kept alive by a single remaining record.
+static const wxFileOffset maxContainerBytes = 256 * 1048576;
+
+static void SwapSamples(char *buffer, sampleFormat format, sampleCount len)
+{
+   sampleCount i;
+   switch (format) {
+   case int16Sample:
+      for (i = 0; i < len; i++) {
+         char t = buffer[2*i];
+         buffer[2*i] = buffer[2*i+1];
+         buffer[2*i+1] = t;
+      }
+      break;
+   case int24Sample:
+      for (i = 0; i < len; i++) {
+         char t = buffer[3*i];
+         buffer[3*i] = buffer[3*i+2];
+         buffer[3*i+2] = t;
+      }
+      break;
+   default:
+      for (i = 0; i < len; i++) {
+         wxUint32 *p = (wxUint32 *)(buffer + 4*i);
+         *p = wxUINT32_SWAP_ALWAYS(*p);
+      }
+      break;
+   }
+}
+
+PackedBlockStore::PackedBlockStore()
+{
+   mCurrent = -1;
+   mNextContainer = 0;
+}
+
+PackedBlockStore::~PackedBlockStore()
+{
+   CloseAll();
+}
+
+void PackedBlockStore::CloseAll()
+{
+   ContainerMap::iterator iter = mContainers.begin();
+   while (iter != mContainers.end())
+   {
+      delete iter->second.file;
+      iter->second.file = NULL;
+      iter->second.writable = false;
+      ++iter;
+   }
+}
+
+void PackedBlockStore::SetDirectory(const wxString &dir)
+{
+   ODLocker locker(mLock);
+   if (dir != mDir)
+      CloseAll();
+   mDir = dir;
+}
+
+wxString PackedBlockStore::GetDirectory()
+{
+   ODLocker locker(mLock);
+   return mDir;
+}
+
+wxString PackedBlockStore::GetContainerPath(const wxString &dir, int container)
+{
+   wxFileName fileName(dir, wxString::Format(wxT("c%04x"), container),
+                       GetContainerExt());
+   return fileName.GetFullPath();
+}
+
+wxString PackedBlockStore::GetContainerPath(int container)
+{
+   ODLocker locker(mLock);
+   return GetContainerPath(mDir, container);
+}
+
+bool PackedBlockStore::IsKnownContainer(const wxString &fullPath)
+{
+   ODLocker locker(mLock);
+   ContainerMap::iterator iter = mContainers.begin();
+   while (iter != mContainers.end())
+   {
+      if (wxFileName(GetContainerPath(mDir, iter->first)) == wxFileName(fullPath))
+         return true;
+      ++iter;
+   }
+   return false;
+}
+
+bool PackedBlockStore::MoveToDirectory(const wxString &dir, bool copy)
+{
+   ODLocker locker(mLock);
+
+   if (wxFileName(dir, wxT("")) == wxFileName(mDir, wxT(""))) {
+      mDir = dir;
+      return true;
+   }
+
+   // Windows will not rename files that are open
+   CloseAll();
+
+   wxArrayString moved;
+   bool success = true;
+   ContainerMap::iterator iter = mContainers.begin();
+   while (iter != mContainers.end())
+   {
+      wxString oldPath = GetContainerPath(mDir, iter->first);
+      wxString newPath = GetContainerPath(dir, iter->first);
+      ++iter;
+
+      if (!wxFileExists(oldPath))
+         continue;
+
+      if (copy)
+         success = wxCopyFile(oldPath, newPath);
+      else
+         success = wxRenameFile(oldPath, newPath);
+      if (!success)
+         break;
+
+      moved.Add(oldPath);
+      moved.Add(newPath);
+   }
+
+   if (!success) {
+      // Put back what we can; the caller restores its own state.
+      for (size_t i = 0; i < moved.GetCount(); i += 2) {
+         if (copy)
+            wxRemoveFile(moved[i + 1]);
+         else
+            wxRenameFile(moved[i + 1], moved[i]);
+      }
+      return false;
+   }
+
+   mDir = dir;
+   return true;
+}
+
+PackedBlockStore::Container *PackedBlockStore::OpenContainer(int container,
+                                                             bool forWrite)
+{
+   ContainerMap::iterator iter = mContainers.find(container);
+   if (iter == mContainers.end()) {
+      if (!forWrite)
+         return NULL;
+      iter = mContainers.insert(std::make_pair(container, Container())).first;
+   }
+
+   Container *c = &iter->second;
+   if (c->file && (c->writable || !forWrite))
+      return c;
+
+   delete c->file;
+   c->file = NULL;
+
+   wxString path = GetContainerPath(mDir, container);
+   wxFile *file = new wxFile;
+   bool ok;
+   if (forWrite) {
+      if (!wxFileExists(path)) {
+         wxFile create;
+         if (!create.Create(path)) {
+            delete file;
+            if (c->liveRecords == 0)
+               mContainers.erase(iter);
+            return NULL;
+         }
+      }
+      ok = file->Open(path, wxFile::read_write);
+   }
+   else {
+      wxLogNull silence;
+      ok = file->Open(path, wxFile::read);
+   }
+
+   if (!ok) {
+      delete file;
+      return NULL;
+   }
+
+   c->file = file;
+   c->writable = forWrite;
+   if (!c->checkedOrder && file->Length() >= (wxFileOffset)sizeof(packedRecordHeader)) {
+      // All records in a container are written by the same machine,
+      // so the first header tells us the byte order of all of them.
+      packedRecordHeader header;
+      if (file->Read(&header, sizeof(header)) == (ssize_t)sizeof(header))
+         c->swapped = (header.magic == wxUINT32_SWAP_ALWAYS(PACKED_RECORD_MAGIC));
+      c->checkedOrder = true;
+   }
+   if (forWrite)
+      c->size = file->Length();
+
+   return c;
+}
+
+bool PackedBlockStore::ReadAt(int container, wxFileOffset pos,
+                              void *buf, size_t len)
+{
+   Container *c = OpenContainer(container, false);
+   if (!c)
+      return false;
+
+   if (c->file->Seek(pos) == wxInvalidOffset)
+      return false;
+
+   return c->file->Read(buf, len) == (ssize_t)len;
+}
+
+// static
+wxFileOffset PackedBlockStore::GetRecordBytes(int summaryBytes,
+                                              sampleCount len,
+                                              sampleFormat format)
+{
+   return sizeof(packedRecordHeader) + summaryBytes +
+          (wxFileOffset)len * SAMPLE_SIZE_DISK(format);
+}
+
+bool PackedBlockStore::Append(const void *summaryData, int summaryBytes,
+                              samplePtr sampleData, sampleCount sampleLen,
+                              sampleFormat format,
+                              wxString *outName, int *outContainer,
+                              wxFileOffset *outOffset)
+{
+   wxFileOffset recordBytes = GetRecordBytes(summaryBytes, sampleLen, format);
+
+   // Pack the samples before taking the lock; 24-bit samples are stored
+   // in three bytes, like in an .au file.
+   char *packed = NULL;
+   if (format == int24Sample) {
+      packed = new char[sampleLen * 3];
+      int *int24sampleData = (int *)sampleData;
+      for (sampleCount i = 0; i < sampleLen; i++) {
+         #if wxBYTE_ORDER == wxBIG_ENDIAN
+            memcpy(packed + 3*i, (char *)&int24sampleData[i] + 1, 3);
+         #else
+            memcpy(packed + 3*i, (char *)&int24sampleData[i], 3);
+         #endif
+      }
+   }
+
+   ODLocker locker(mLock);
+
+   Container *c = NULL;
+   if (mCurrent >= 0) {
+      c = OpenContainer(mCurrent, true);
+      if (c && c->size > 0 && c->size + recordBytes > maxContainerBytes)
+         c = NULL;
+   }
+   if (!c) {
+      mCurrent = mNextContainer++;
+      c = OpenContainer(mCurrent, true);
+      if (!c) {
+         wxLogDebug(wxT("PackedBlockStore: could not create container %s"),
+                    GetContainerPath(mDir, mCurrent).c_str());
+         delete[] packed;
+         return false;
+      }
+      c->checkedOrder = true;
+   }
+
+   wxString name = wxString::Format(wxT("p%04x%08x"), mCurrent, c->records);
+
+   packedRecordHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = PACKED_RECORD_MAGIC;
+   switch (format) {
+      case int16Sample:
+         header.encoding = AU_SAMPLE_FORMAT_16;
+         break;
+      case int24Sample:
+         header.encoding = AU_SAMPLE_FORMAT_24;
+         break;
+      default:
+         header.encoding = AU_SAMPLE_FORMAT_FLOAT;
+         break;
+   }
+   header.sampleLen = sampleLen;
+   header.summaryBytes = summaryBytes;
+   strncpy(header.name, name.mb_str(), sizeof(header.name) - 1);
+
+   size_t sampleBytes = sampleLen * SAMPLE_SIZE_DISK(format);
+   bool ok =
+      c->file->Seek(c->size) != wxInvalidOffset &&
+      c->file->Write(&header, sizeof(header)) == sizeof(header) &&
+      c->file->Write(summaryData, summaryBytes) == (size_t)summaryBytes &&
+      c->file->Write(packed ? packed : (char *)sampleData, sampleBytes) == sampleBytes;
+
+   delete[] packed;
+
+   if (!ok) {
+      // Leave size alone so the next record overwrites the partial one
+      wxLogDebug(wxT("PackedBlockStore: write to %s failed."),
+                 GetContainerPath(mDir, mCurrent).c_str());
+      return false;
+   }
+
+   *outName = name;
+   *outContainer = mCurrent;
+   *outOffset = c->size;
+
+   c->size += recordBytes;
+   c->records++;
+   c->liveRecords++;
+
+   return true;
+}
+
+bool PackedBlockStore::ReadSummary(int container, wxFileOffset offset,
+                                   void *data, int summaryBytes)
+{
+   ODLocker locker(mLock);
+   return ReadAt(container, offset + sizeof(packedRecordHeader),
+                 data, summaryBytes);
+}
+
+int PackedBlockStore::ReadSamples(int container, wxFileOffset offset,
+                                  int summaryBytes, sampleFormat diskFormat,
+                                  samplePtr data, sampleFormat format,
+                                  sampleCount start, sampleCount len)
+{
+   int diskSize = SAMPLE_SIZE_DISK(diskFormat);
+   wxFileOffset pos = offset + sizeof(packedRecordHeader) + summaryBytes +
+                      (wxFileOffset)start * diskSize;
+
+   // Read straight into the caller's buffer when no conversion is needed
+   bool direct = (diskFormat == format && diskFormat != int24Sample);
+   char *raw = direct ? (char *)data : new char[len * diskSize];
+
+   ssize_t bytesRead = 0;
+   bool swapped = false;
+   {
+      ODLocker locker(mLock);
+      Container *c = OpenContainer(container, false);
+      if (c && c->file->Seek(pos) != wxInvalidOffset) {
+         bytesRead = c->file->Read(raw, len * diskSize);
+         swapped = c->swapped;
+      }
+   }
+
+   if (bytesRead < 0)
+      bytesRead = 0;
+   int framesRead = bytesRead / diskSize;
+
+   if (swapped)
+      SwapSamples(raw, diskFormat, framesRead);
+
+   if (!direct) {
+      if (diskFormat == int24Sample) {
+         samplePtr unpacked = NewSamples(framesRead, int24Sample);
+         int *intPtr = (int *)unpacked;
+         for (int i = 0; i < framesRead; i++) {
+            int value = 0;
+            #if wxBYTE_ORDER == wxBIG_ENDIAN
+               memcpy((char *)&value + 1, raw + 3*i, 3);
+            #else
+               memcpy((char *)&value, raw + 3*i, 3);
+            #endif
+            // sign-extend from 24 bits
+            intPtr[i] = (value << 8) >> 8;
+         }
+         CopySamples(unpacked, int24Sample, data, format, framesRead);
+         DeleteSamples(unpacked);
+      }
+      else
+         CopySamples((samplePtr)raw, diskFormat, data, format, framesRead);
+
+      delete[] raw;
+   }
+
+   return framesRead;
+}
+
+bool PackedBlockStore::HasRecord(int container, wxFileOffset offset)
+{
+   ODLocker locker(mLock);
+
+   packedRecordHeader header;
+   if (!ReadAt(container, offset, &header, sizeof(header)))
+      return false;
+
+   return header.magic == PACKED_RECORD_MAGIC ||
+          header.magic == wxUINT32_SWAP_ALWAYS(PACKED_RECORD_MAGIC);
+}
+
+void PackedBlockStore::Register(const wxString &name, int container)
+{
+   ODLocker locker(mLock);
+
+   mContainers[container].liveRecords++;
+
+   // Never hand out a name or container number that a loaded block uses
+   unsigned long nameContainer = 0;
+   if (name.Length() > 5 && name.Mid(1, 4).ToULong(&nameContainer, 16) &&
+       (int)nameContainer >= mNextContainer)
+      mNextContainer = nameContainer + 1;
+   if (container >= mNextContainer)
+      mNextContainer = container + 1;
+}
+
+void PackedBlockStore::Release(int container, bool mayRemove)
+{
+   ODLocker locker(mLock);
+
+   ContainerMap::iterator iter = mContainers.find(container);
+   if (iter == mContainers.end())
+      return;
+
+   Container &c = iter->second;
+   c.liveRecords--;
+   if (!mayRemove)
+      c.keep = true;
+
+   if (c.liveRecords <= 0 && !c.keep && container != mCurrent) {
+      delete c.file;
+      wxRemoveFile(GetContainerPath(mDir, container));
+      mContainers.erase(iter);
+   }
+}
@@ -0,0 +1,113 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockStore.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCK_STORE__
+#define __AUDACITY_PACKED_BLOCK_STORE__
+
+#include <map>
+
+#include <wx/string.h>
+#include <wx/file.h>
+
+#include "../SampleFormat.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// Every record in a container starts with this header, followed by
+/// summaryBytes of summary data and then the sample payload, packed
+/// the same way SimpleBlockFile lays out an .au file.
+typedef struct {
+   wxUint32 magic;        // PACKED_RECORD_MAGIC in the writer's byte order
+   wxUint32 encoding;     // AU_SAMPLE_FORMAT_* of the sample payload
+   wxUint32 sampleLen;    // samples in the payload
+   wxUint32 summaryBytes; // bytes of summary data before the payload
+   char     name[16];     // name of the owning block, for recovery scans
+} packedRecordHeader;
+
+#define PACKED_RECORD_MAGIC 0x6170626b // "apbk"
+
+class PackedBlockStore {
+ public:
+   PackedBlockStore();
+   ~PackedBlockStore();
+
+   /// Sets the directory the containers live in, without touching the disk
+   void SetDirectory(const wxString &dir);
+   wxString GetDirectory();
+
+   /// Renames (or copies) every container into dir.  On failure the
+   /// containers already moved are put back and the directory is unchanged.
+   bool MoveToDirectory(const wxString &dir, bool copy);
+
+   /// Append a record to the current container, starting a new one when
+   /// it is full.  Fills in the block name and location of the record.
+   bool Append(const void *summaryData, int summaryBytes,
+               samplePtr sampleData, sampleCount sampleLen,
+               sampleFormat format,
+               wxString *outName, int *outContainer, wxFileOffset *outOffset);
+
+   bool ReadSummary(int container, wxFileOffset offset,
+                    void *data, int summaryBytes);
+
+   /// Reads len samples starting at start, converting from diskFormat
+   /// to format.  Returns the number of samples read.
+   int ReadSamples(int container, wxFileOffset offset, int summaryBytes,
+                   sampleFormat diskFormat,
+                   samplePtr data, sampleFormat format,
+                   sampleCount start, sampleCount len);
+
+   /// Returns true if a valid record header is found at the given location
+   bool HasRecord(int container, wxFileOffset offset);
+
+   /// Called for each block that refers to an existing record when a
+   /// project is loaded, so the live record count is known.
+   void Register(const wxString &name, int container);
+
+   /// Called when a block referring to a record goes away.  When the last
+   /// record of a container is released and none of them belonged to a
+   /// locked block, the container is removed from disk.
+   void Release(int container, bool mayRemove);
+
+   wxString GetContainerPath(int container);
+   /// Returns true if fullPath names one of this store's containers
+   bool IsKnownContainer(const wxString &fullPath);
+
+   static wxFileOffset GetRecordBytes(int summaryBytes, sampleCount len,
+                                      sampleFormat format);
+   static wxString GetContainerExt() { return wxT("aubp"); }
+
+ private:
+
+   struct Container {
+      Container() : file(NULL), size(0), liveRecords(0), records(0),
+                    writable(false), keep(false), swapped(false),
+                    checkedOrder(false) {}
+      wxFile *file;
+      wxFileOffset size;   // bytes written so far
+      int liveRecords;     // blocks currently referring into this container
+      int records;         // records appended in this session
+      bool writable;       // file is open for appending
+      bool keep;           // a locked block referred into it
+      bool swapped;        // written on a machine of the other byte order
+      bool checkedOrder;
+   };
+   typedef std::map<int, Container> ContainerMap;
+
+   // Must be called with mLock held
+   Container *OpenContainer(int container, bool forWrite);
+   bool ReadAt(int container, wxFileOffset pos, void *buf, size_t len);
+   void CloseAll();
+   wxString GetContainerPath(const wxString &dir, int container);
+
+   ODLock mLock;
+   ContainerMap mContainers;
+   wxString mDir;
+   int mCurrent;        // container being appended to, or -1
+   int mNextContainer;  // smallest container number never used
+};
+
+#endif
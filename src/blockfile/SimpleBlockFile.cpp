@@ -66,6 +66,7 @@ to get its definition, rather than rolling our own.
 #include "../Prefs.h"
 
 #include "SimpleBlockFile.h"
+#include "MappedBlockCache.h"
 #include "../FileFormats.h"
 
 #include "sndfile.h"
@@ -126,6 +127,7 @@ SimpleBlockFile::SimpleBlockFile(wxFileName baseFileName,
       mCache.summaryData = new char[mSummaryInfo.totalSummaryBytes];
       memcpy(mCache.summaryData, summaryData,
              (size_t)mSummaryInfo.totalSummaryBytes);
+      delete [] (char *) summaryData;
     }
 }
 
@@ -149,6 +151,9 @@ SimpleBlockFile::SimpleBlockFile(wxFileName existingFile, sampleCount len,
 
 SimpleBlockFile::~SimpleBlockFile()
 {
+   // ~BlockFile may remove the file, which must not be mapped then
+   MappedBlockCache::Get().Invalidate(mFileName.GetFullPath());
+
    if (mCache.active)
    {
       delete[] mCache.sampleData;
@@ -162,6 +167,8 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
     sampleFormat format,
     void* summaryData)
 {
+   MappedBlockCache::Get().Invalidate(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
    if( !file.IsOpened() ){
       // Can't do anything else.
@@ -205,19 +212,22 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
    header.channels = 1;
 
    // Write the file
+   char *calcSummary = NULL;
    if (!summaryData)
-      summaryData = /*BlockFile::*/CalcSummary(sampleData, sampleLen, format); //mchinen:allowing virtual override of calc summary for ODDecodeBlockFile.
+      summaryData = calcSummary = (char *)/*BlockFile::*/CalcSummary(sampleData, sampleLen, format); //mchinen:allowing virtual override of calc summary for ODDecodeBlockFile.
 
    size_t nBytesToWrite = sizeof(header);
    size_t nBytesWritten = file.Write(&header, nBytesToWrite);
    if (nBytesWritten != nBytesToWrite)
    {
       wxLogDebug(wxT("Wrote %lld bytes, expected %lld."), (long long) nBytesWritten, (long long) nBytesToWrite);
+      delete [] calcSummary;
       return false;
    }
 
    nBytesToWrite = mSummaryInfo.totalSummaryBytes;
    nBytesWritten = file.Write(summaryData, nBytesToWrite);
+   delete [] calcSummary;
    if (nBytesWritten != nBytesToWrite)
    {
       wxLogDebug(wxT("Wrote %lld bytes, expected %lld."), (long long) nBytesWritten, (long long) nBytesToWrite);
@@ -341,6 +351,19 @@ bool SimpleBlockFile::ReadSummary(void *data)
       return true;
    } else
    {
+      MappedBlock *block = MappedBlockCache::Get().Acquire(mFileName.GetFullPath());
+      if (block) {
+         bool ok = block->GetSummaryBytes() >= (size_t)mSummaryInfo.totalSummaryBytes;
+         if (ok)
+            memcpy(data, block->GetSummary(), (size_t)mSummaryInfo.totalSummaryBytes);
+         MappedBlockCache::Get().Release(block);
+         if (ok) {
+            mSilentLog = FALSE;
+            FixSummary(data);
+            return true;
+         }
+      }
+
       //wxLogDebug("SimpleBlockFile::ReadSummary(): Reading summary from disk.");
 
       wxFFile file(mFileName.GetFullPath(), wxT("rb"));
@@ -397,6 +420,12 @@ int SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
       return len;
    } else
    {
+      int framesRead;
+      if (ReadMappedData(data, format, start, len, &framesRead)) {
+         mSilentLog = FALSE;
+         return framesRead;
+      }
+
       //wxLogDebug("SimpleBlockFile::ReadData(): Reading data from disk.");
 
       SF_INFO info;
@@ -469,6 +498,112 @@ int SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
    }
 }
 
+/// Copy samples out of a memory mapping of the file, converting them
+/// to the given format if needed.  Gives up (returning false) when the
+/// file can't be mapped, for instance when it has the other byte order.
+bool SimpleBlockFile::ReadMappedData(samplePtr data, sampleFormat format,
+                                     sampleCount start, sampleCount len,
+                                     int *framesRead)
+{
+   MappedBlock *block = MappedBlockCache::Get().Acquire(mFileName.GetFullPath());
+   if (!block)
+      return false;
+
+   sampleFormat diskFormat = block->GetFormat();
+   sampleCount count = block->GetSampleCount() - start;
+   if (count > len)
+      count = len;
+   if (count < 0)
+      count = 0;
+
+   const char *src = block->GetSamples() + start * SAMPLE_SIZE_DISK(diskFormat);
+
+   if (diskFormat == int24Sample) {
+      // Unpack the 3 byte samples into the 3 least significant bytes
+      // of an int, directly into the caller's buffer if we can
+      int *intPtr = (format == int24Sample) ? (int *)data :
+                    (int *)NewSamples(count, int24Sample);
+      for (int i = 0; i < count; i++) {
+         int value = 0;
+         #if wxBYTE_ORDER == wxBIG_ENDIAN
+            memcpy((char *)&value + 1, src + 3 * i, 3);
+         #else
+            memcpy((char *)&value, src + 3 * i, 3);
+         #endif
+         intPtr[i] = (value << 8) >> 8;
+      }
+      if (format != int24Sample) {
+         CopySamples((samplePtr)intPtr, int24Sample, data, format, count);
+         DeleteSamples((samplePtr)intPtr);
+      }
+   }
+   else if (diskFormat == format)
+      memcpy(data, src, count * SAMPLE_SIZE(format));
+   else
+      CopySamples((samplePtr)src, diskFormat, data, format, count);
+
+   MappedBlockCache::Get().Release(block);
+
+   *framesRead = count;
+   return true;
+}
+
+/// Copy summary frames from a memory mapping of the file.
+///
+/// @param offset The offset of the 256 or 64K summary in the summary data
+/// @param frames The number of frames in that summary
+bool SimpleBlockFile::ReadMappedSummary(float *buffer, int offset,
+                                        sampleCount start, sampleCount len,
+                                        sampleCount frames)
+{
+   if (mCache.active || mSummaryInfo.format != floatSample ||
+       mSummaryInfo.fields != 3)
+      return false;
+
+   MappedBlock *block = MappedBlockCache::Get().Acquire(mFileName.GetFullPath());
+   if (!block)
+      return false;
+
+   // A summary that FixSummary() would change, or that lacks the tag,
+   // is left to the unmapped path
+   bool ok = block->GetSummaryBytes() >= (size_t)mSummaryInfo.totalSummaryBytes &&
+             IsSummaryNative(block->GetSummary());
+   if (ok) {
+      if (start + len > frames)
+         len = frames - start;
+      memcpy(buffer,
+             block->GetSummary() + offset + start * mSummaryInfo.bytesPerFrame,
+             len * mSummaryInfo.bytesPerFrame);
+   }
+
+   MappedBlockCache::Get().Release(block);
+   return ok;
+}
+
+bool SimpleBlockFile::Read256(float *buffer,
+                              sampleCount start, sampleCount len)
+{
+   wxASSERT(start >= 0);
+
+   if (ReadMappedSummary(buffer, mSummaryInfo.offset256, start, len,
+                         mSummaryInfo.frames256))
+      return true;
+
+   return BlockFile::Read256(buffer, start, len);
+}
+
+bool SimpleBlockFile::Read64K(float *buffer,
+                              sampleCount start, sampleCount len)
+{
+   wxASSERT(start >= 0);
+
+   if (ReadMappedSummary(buffer, mSummaryInfo.offset64K, start, len,
+                         mSummaryInfo.frames64K))
+      return true;
+
+   return BlockFile::Read64K(buffer, start, len);
+}
+
 void SimpleBlockFile::SaveXML(XMLWriter &xmlFile)
 {
    xmlFile.StartTag(wxT("simpleblockfile"));
@@ -597,6 +732,8 @@ wxLongLong SimpleBlockFile::GetSpaceUsage()
 }
 
 void SimpleBlockFile::Recover(){
+   MappedBlockCache::Get().Invalidate(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
    int i;
 
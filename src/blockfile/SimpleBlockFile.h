@@ -67,6 +67,10 @@ class SimpleBlockFile : public BlockFile {
    virtual int ReadData(samplePtr data, sampleFormat format,
                         sampleCount start, sampleCount len);
 
+   /// Read summary frames straight out of the mapped file, if possible
+   virtual bool Read256(float *buffer, sampleCount start, sampleCount len);
+   virtual bool Read64K(float *buffer, sampleCount start, sampleCount len);
+
    /// Create a new block file identical to this one
    virtual BlockFile *Copy(wxFileName newFileName);
    /// Write an XML representation of this file
@@ -90,6 +94,13 @@ class SimpleBlockFile : public BlockFile {
    static bool GetCache();
    void ReadIntoCache();
 
+   /// Serve a read from a memory mapping of the file; returns false if
+   /// the file can't be mapped, so the caller falls back to libsndfile
+   bool ReadMappedData(samplePtr data, sampleFormat format,
+                       sampleCount start, sampleCount len, int *framesRead);
+   bool ReadMappedSummary(float *buffer, int offset,
+                          sampleCount start, sampleCount len, sampleCount frames);
+
    SimpleBlockFileCache mCache;
 
    sampleFormat mFormat;
@@ -136,6 +136,11 @@ bool EffectEcho::SetAutomationParameters(EffectAutomationParameters & parms)
    return true;
 }
 
+Effect *EffectEcho::NewProcessor()
+{
+   return new EffectEcho();
+}
+
 void EffectEcho::PopulateOrExchange(ShuttleGui & S)
 {
    S.AddSpace(0, 5);
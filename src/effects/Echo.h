@@ -48,6 +48,7 @@ public:
    virtual bool SetAutomationParameters(EffectAutomationParameters & parms);
 
    // Effect implementation
+   virtual Effect *NewProcessor();
    virtual void PopulateOrExchange(ShuttleGui & S);
    virtual bool TransferDataToWindow();
    virtual bool TransferDataFromWindow();
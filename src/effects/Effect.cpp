@@ -23,6 +23,8 @@ greater use in future.
 
 #include "../Audacity.h"
 
+#include <vector>
+
 #include <wx/defs.h>
 #include <wx/hashmap.h>
 #include <wx/msgdlg.h>
@@ -30,6 +32,7 @@ greater use in future.
 #include <wx/stockitem.h>
 #include <wx/string.h>
 #include <wx/tglbtn.h>
+#include <wx/thread.h>
 #include <wx/timer.h>
 #include <wx/utils.h>
 #include <wx/log.h>
@@ -45,6 +48,7 @@ greater use in future.
 #include "../toolbars/ControlToolBar.h"
 #include "../widgets/AButton.h"
 #include "../widgets/ProgressDialog.h"
+#include "../WorkerPool.h"
 #include "../ondemand/ODManager.h"
 #include "TimeWarper.h"
 #include "nyquist/Nyquist.h"
@@ -100,6 +104,7 @@ Effect::Effect()
    mNumTracks = 0;
    mNumGroups = 0;
    mProgress = NULL;
+   mParallelPass = NULL;
 
    mRealtimeSuspendLock.Enter();
    mRealtimeSuspendCount = 1;    // Effects are initially suspended
@@ -445,34 +450,32 @@ bool Effect::RealtimeFinalize()
 
 bool Effect::RealtimeSuspend()
 {
-   if (mClient)
+   // Built-in effects that support realtime have no client to ask
+   if (mClient && !mClient->RealtimeSuspend())
    {
-      if (mClient->RealtimeSuspend())
-      {
-         mRealtimeSuspendLock.Enter();
-         mRealtimeSuspendCount++;
-         mRealtimeSuspendLock.Leave();
-         return true;
-      }
+      return false;
    }
 
-   return false;
+   mRealtimeSuspendLock.Enter();
+   mRealtimeSuspendCount++;
+   mRealtimeSuspendLock.Leave();
+
+   return true;
 }
 
 bool Effect::RealtimeResume()
 {
-   if (mClient)
+   // Built-in effects that support realtime have no client to ask
+   if (mClient && !mClient->RealtimeResume())
    {
-      if (mClient->RealtimeResume())
-      {
-         mRealtimeSuspendLock.Enter();
-         mRealtimeSuspendCount--;
-         mRealtimeSuspendLock.Leave();
-         return true;
-      }
+      return false;
    }
 
-   return false;
+   mRealtimeSuspendLock.Enter();
+   mRealtimeSuspendCount--;
+   mRealtimeSuspendLock.Leave();
+
+   return true;
 }
 
 bool Effect::RealtimeProcessStart()
@@ -1241,6 +1244,11 @@ bool Effect::PromptUser(wxWindow *parent)
    return ShowInterface(parent, IsBatchProcessing());
 }
 
+Effect *Effect::NewProcessor()
+{
+   return NULL;
+}
+
 int Effect::GetPass()
 {
    return mPass;
@@ -1277,28 +1285,61 @@ bool Effect::Process()
    return bGoodResult;
 }
 
+/// Shares the track groups of one pass among copies of an effect.  Each
+/// copy takes the next group not yet taken until none are left.  The
+/// copies report their progress here rather than to a dialog, and the
+/// thread that started the pass shows the sum.
+struct Effect::ParallelPass
+{
+   Effect *parent;
+   std::vector<WaveTrack *> lefts;
+   std::vector<WaveTrack *> rights;
+
+   // Guarded by lock
+   ODLock lock;
+   size_t next;                  // first group not yet taken
+   int active;                   // groups taken but not finished
+   std::vector<double> fracs;    // how far each group has got
+   bool failed;
+   bool cancelled;
+};
+
+/// Runs one copy of the effect on groups until none are left
+class EffectPassTask : public WorkerTask
+{
+public:
+   EffectPassTask(std::vector<Effect *> &processors)
+      : mProcessors(processors)
+   {
+   }
+
+   virtual void Run(int index)
+   {
+      mProcessors[index]->RunParallelPass();
+   }
+
+private:
+   std::vector<Effect *> &mProcessors;
+};
+
 bool Effect::ProcessPass()
 {
    bool bGoodResult = true;
-   bool isGenerator = GetType() == EffectTypeGenerate;
    bool editClipCanMove;
    gPrefs->Read(wxT("/GUI/EditClipCanMove"), &editClipCanMove, true);
 
    mInBuffer = NULL;
    mOutBuffer = NULL;
-
-   ChannelName map[3];
-
-   sampleCount prevBufferSize = 0;
    mBufferSize = 0;
    mBlockSize = 0;
 
-   TrackListIterator iter(mOutputTracks);
-   int count = 0;
-   bool clear = false;
-   Track* t = iter.First();
+   // Gather the groups first; a group is a track alone or with the
+   // one linked to it, if the effect takes more than one channel
+   std::vector<WaveTrack *> lefts;
+   std::vector<WaveTrack *> rights;
 
-   for (t = iter.First(); t; t = iter.Next())
+   TrackListIterator iter(mOutputTracks);
+   for (Track *t = iter.First(); t; t = iter.Next())
    {
       if (t->GetKind() != Track::Wave || !t->GetSelected())
       {
@@ -1310,171 +1351,187 @@ bool Effect::ProcessPass()
       }
 
       WaveTrack *left = (WaveTrack *)t;
-      WaveTrack *right;
-      sampleCount len;
-      sampleCount leftStart;
-      sampleCount rightStart;
-
-      if (!isGenerator)
-      {
-         GetSamples(left, &leftStart, &len);
-         mSampleCnt = len;
-      }
-      else
+      WaveTrack *right = NULL;
+      if (left->GetLinked() && mNumAudioIn > 1)
       {
-         len = 0;
-         leftStart = 0;
-         mSampleCnt = left->TimeToLongSamples(mDuration);
+         right = (WaveTrack *) iter.Next();
       }
 
-      mNumChannels = 1;
+      lefts.push_back(left);
+      rights.push_back(right);
+   }
 
-      if (left->GetChannel() == Track::LeftChannel)
-      {
-         map[0] = ChannelNameFrontLeft;
-      }
-      else if (left->GetChannel() == Track::RightChannel)
-      {
-         map[0] = ChannelNameFrontRight;
-      }
-      else
-      {
-         map[0] = ChannelNameMono;
-      }
-      map[1] = ChannelNameEOL;
+   // Groups share no state in effects that can make processors, so
+   // each can be done by its own copy at the same time as the others
+   std::vector<Effect *> processors;
+   if (GetType() == EffectTypeProcess && lefts.size() > 1)
+   {
+      MakeProcessors(processors, lefts.size());
+   }
 
-      right = NULL;
-      rightStart = 0;
-      if (left->GetLinked() && mNumAudioIn > 1)
+   if (!processors.empty())
+   {
+      bGoodResult = ProcessGroupsInParallel(processors, lefts, rights);
+   }
+   else
+   {
+      for (size_t i = 0; i < lefts.size(); i++)
       {
-         right = (WaveTrack *) iter.Next();
-         if (!isGenerator)
-         {
-            GetSamples(right, &rightStart, &len);
-         }
-         clear = false;
-         mNumChannels = 2;
-
-         if (right->GetChannel() == Track::LeftChannel)
-         {
-            map[1] = ChannelNameFrontLeft;
-         }
-         else if (right->GetChannel() == Track::RightChannel)
-         {
-            map[1] = ChannelNameFrontRight;
-         }
-         else
+         bGoodResult = ProcessGroup(i, lefts[i], rights[i]);
+         if (!bGoodResult)
          {
-            map[1] = ChannelNameMono;
+            break;
          }
-         map[2] = ChannelNameEOL;
       }
+   }
 
-      // Let the client know the sample rate
-      SetSampleRate(left->GetRate());
+   FreeBuffers();
 
-      // Get the block size the client wants to use
-      sampleCount max = left->GetMaxBlockSize() * 2;
-      mBlockSize = SetBlockSize(max);
+   if (bGoodResult && GetType() == EffectTypeGenerate)
+   {
+      mT1 = mT0 + mDuration;
+   }
 
-      // Calculate the buffer size to be at least the max rounded up to the clients
-      // selected block size.
-      prevBufferSize = mBufferSize;
-      mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
+   return bGoodResult;
+}
 
-      // If the buffer size has changed, then (re)allocate the buffers
-      if (prevBufferSize != mBufferSize)
-      {
-         // Get rid of any previous buffers
-         if (mInBuffer)
-         {
-            for (int i = 0; i < mNumAudioIn; i++)
-            {
-               if (mInBuffer[i])
-               {
-                  delete [] mInBuffer[i];
-               }
-            }
-            delete [] mInBuffer;
-            delete [] mInBufPos;
-         }
+bool Effect::ProcessGroup(int count, WaveTrack *left, WaveTrack *right)
+{
+   bool isGenerator = GetType() == EffectTypeGenerate;
 
-         // Always create the number of input buffers the client expects even if we don't have
-         // the same number of channels.
-         mInBufPos = new float *[mNumAudioIn];
-         mInBuffer = new float *[mNumAudioIn];
-         for (int i = 0; i < mNumAudioIn; i++)
-         {
-            mInBuffer[i] = new float[mBufferSize];
-         }
+   ChannelName map[3];
 
-         // We won't be using more than the first 2 buffers, so clear the rest (if any)
-         for (int i = 2; i < mNumAudioIn; i++)
-         {
-            for (int j = 0; j < mBufferSize; j++)
-            {
-               mInBuffer[i][j] = 0.0;
-            }
-         }
+   sampleCount len;
+   sampleCount leftStart;
+   sampleCount rightStart;
 
-         // Get rid of any previous buffers
-         if (mOutBuffer)
-         {
-            for (int i = 0; i < mNumAudioOut; i++)
-            {
-               if (mOutBuffer[i])
-               {
-                  delete [] mOutBuffer[i];
-               }
-            }
-            delete [] mOutBuffer;
-            delete [] mOutBufPos;
-         }
+   if (!isGenerator)
+   {
+      GetSamples(left, &leftStart, &len);
+      mSampleCnt = len;
+   }
+   else
+   {
+      len = 0;
+      leftStart = 0;
+      mSampleCnt = left->TimeToLongSamples(mDuration);
+   }
 
-         // Always create the number of output buffers the client expects even if we don't have
-         // the same number of channels.
-         mOutBufPos = new float *[mNumAudioOut];
-         mOutBuffer = new float *[mNumAudioOut];
-         for (int i = 0; i < mNumAudioOut; i++)
-         {
-            // Output buffers get an extra mBlockSize worth to give extra room if
-            // the plugin adds latency
-            mOutBuffer[i] = new float[mBufferSize + mBlockSize];
-         }
+   mNumChannels = 1;
+
+   if (left->GetChannel() == Track::LeftChannel)
+   {
+      map[0] = ChannelNameFrontLeft;
+   }
+   else if (left->GetChannel() == Track::RightChannel)
+   {
+      map[0] = ChannelNameFrontRight;
+   }
+   else
+   {
+      map[0] = ChannelNameMono;
+   }
+   map[1] = ChannelNameEOL;
+
+   rightStart = 0;
+   if (right)
+   {
+      if (!isGenerator)
+      {
+         GetSamples(right, &rightStart, &len);
       }
+      mNumChannels = 2;
 
-      // (Re)Set the input buffer positions
-      for (int i = 0; i < mNumAudioIn; i++)
+      if (right->GetChannel() == Track::LeftChannel)
+      {
+         map[1] = ChannelNameFrontLeft;
+      }
+      else if (right->GetChannel() == Track::RightChannel)
       {
-         mInBufPos[i] = mInBuffer[i];
+         map[1] = ChannelNameFrontRight;
       }
+      else
+      {
+         map[1] = ChannelNameMono;
+      }
+      map[2] = ChannelNameEOL;
+   }
 
-      // (Re)Set the output buffer positions
-      for (int i = 0; i < mNumAudioOut; i++)
+   // Let the client know the sample rate
+   SetSampleRate(left->GetRate());
+
+   // Get the block size the client wants to use
+   sampleCount max = left->GetMaxBlockSize() * 2;
+   mBlockSize = SetBlockSize(max);
+
+   // Calculate the buffer size to be at least the max rounded up to the clients
+   // selected block size.
+   sampleCount prevBufferSize = mBufferSize;
+   mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
+
+   // If the buffer size has changed, then (re)allocate the buffers
+   if (prevBufferSize != mBufferSize)
+   {
+      // Get rid of any previous buffers
+      FreeBuffers();
+
+      // Always create the number of input buffers the client expects even if we don't have
+      // the same number of channels.
+      mInBufPos = new float *[mNumAudioIn];
+      mInBuffer = new float *[mNumAudioIn];
+      for (int i = 0; i < mNumAudioIn; i++)
       {
-         mOutBufPos[i] = mOutBuffer[i];
+         mInBuffer[i] = new float[mBufferSize];
       }
 
-      // Clear unused input buffers
-      if (!right && !clear && mNumAudioIn > 1)
+      // We won't be using more than the first 2 buffers, so clear the rest (if any)
+      for (int i = 2; i < mNumAudioIn; i++)
       {
          for (int j = 0; j < mBufferSize; j++)
          {
-            mInBuffer[1][j] = 0.0;
+            mInBuffer[i][j] = 0.0;
          }
-         clear = true;
       }
 
-      // Go process the track(s)
-      bGoodResult = ProcessTrack(count, map, left, right, leftStart, rightStart, len);
-      if (!bGoodResult)
+      // Always create the number of output buffers the client expects even if we don't have
+      // the same number of channels.
+      mOutBufPos = new float *[mNumAudioOut];
+      mOutBuffer = new float *[mNumAudioOut];
+      for (int i = 0; i < mNumAudioOut; i++)
       {
-         break;
+         // Output buffers get an extra mBlockSize worth to give extra room if
+         // the plugin adds latency
+         mOutBuffer[i] = new float[mBufferSize + mBlockSize];
       }
+   }
 
-      count++;
+   // (Re)Set the input buffer positions
+   for (int i = 0; i < mNumAudioIn; i++)
+   {
+      mInBufPos[i] = mInBuffer[i];
    }
 
+   // (Re)Set the output buffer positions
+   for (int i = 0; i < mNumAudioOut; i++)
+   {
+      mOutBufPos[i] = mOutBuffer[i];
+   }
+
+   // Clear unused input buffers
+   if (!right && mNumAudioIn > 1)
+   {
+      for (int j = 0; j < mBufferSize; j++)
+      {
+         mInBuffer[1][j] = 0.0;
+      }
+   }
+
+   // Go process the track(s)
+   return ProcessTrack(count, map, left, right, leftStart, rightStart, len);
+}
+
+void Effect::FreeBuffers()
+{
    if (mOutBuffer)
    {
       for (int i = 0; i < mNumAudioOut; i++)
@@ -1498,13 +1555,168 @@ bool Effect::ProcessPass()
       mInBuffer = NULL;
       mInBufPos = NULL;
    }
+}
 
-   if (bGoodResult && GetType() == EffectTypeGenerate)
+void Effect::MakeProcessors(std::vector<Effect *> &processors, int groups)
+{
+   int count = wxMin(WorkerPool::Get().GetThreadCount(), groups);
+   if (count < 2)
    {
-      mT1 = mT0 + mDuration;
+      return;
    }
 
-   return bGoodResult;
+   // The processors start out as the effect would from the effect list,
+   // then take the settings chosen for this run
+   EffectAutomationParameters parms;
+   GetAutomationParameters(parms);
+
+   for (int i = 0; i < count; i++)
+   {
+      Effect *processor = NewProcessor();
+      if (!processor)
+      {
+         break;
+      }
+
+      if (!processor->Startup(NULL) || !processor->SetAutomationParameters(parms))
+      {
+         delete processor;
+         break;
+      }
+
+      processor->mPass = mPass;
+      processor->mProjectRate = mProjectRate;
+      processor->mFactory = mFactory;
+      processor->mT0 = mT0;
+      processor->mT1 = mT1;
+      processor->mDuration = mDuration;
+      processor->mIsPreview = mIsPreview;
+      processor->mNumTracks = mNumTracks;
+      processor->mNumGroups = mNumGroups;
+      processor->mInBuffer = NULL;
+      processor->mOutBuffer = NULL;
+      processor->mBufferSize = 0;
+      processor->mBlockSize = 0;
+
+      processors.push_back(processor);
+   }
+}
+
+bool Effect::ProcessGroupsInParallel(std::vector<Effect *> &processors,
+                                     std::vector<WaveTrack *> &lefts,
+                                     std::vector<WaveTrack *> &rights)
+{
+   ParallelPass pass;
+   pass.parent = this;
+   pass.lefts = lefts;
+   pass.rights = rights;
+   pass.next = 0;
+   pass.active = 0;
+   pass.fracs.resize(lefts.size(), 0.0);
+   pass.failed = false;
+   pass.cancelled = false;
+
+   for (size_t i = 0; i < processors.size(); i++)
+   {
+      processors[i]->mParallelPass = &pass;
+   }
+
+   EffectPassTask task(processors);
+   WorkerPool::Get().Run(&task, processors.size());
+
+   for (size_t i = 0; i < processors.size(); i++)
+   {
+      processors[i]->FreeBuffers();
+      delete processors[i];
+   }
+
+   return !pass.failed && !pass.cancelled;
+}
+
+void Effect::RunParallelPass()
+{
+   ParallelPass *pass = mParallelPass;
+
+   while (true)
+   {
+      size_t group;
+      {
+         ODLocker locker(pass->lock);
+         if (pass->failed || pass->cancelled || pass->next >= pass->lefts.size())
+         {
+            break;
+         }
+         group = pass->next++;
+         pass->active++;
+      }
+
+      bool ok = ProcessGroup(group, pass->lefts[group], pass->rights[group]);
+
+      ODLocker locker(pass->lock);
+      pass->active--;
+      pass->fracs[group] = 1.0;
+      if (!ok)
+      {
+         pass->failed = true;
+      }
+   }
+
+   // Groups taken by other threads may still be running.  The thread that
+   // owns the progress dialog keeps it moving until they finish.
+   if (wxThread::IsMain())
+   {
+      while (true)
+      {
+         {
+            ODLocker locker(pass->lock);
+            if (pass->active == 0)
+            {
+               break;
+            }
+         }
+
+         ParallelProgress(-1, 0.0);
+         wxMilliSleep(50);
+      }
+   }
+}
+
+bool Effect::ParallelProgress(int whichGroup, double frac)
+{
+   ParallelPass *pass = mParallelPass;
+
+   double done = 0.0;
+   {
+      ODLocker locker(pass->lock);
+      if (whichGroup >= 0 && whichGroup < (int) pass->fracs.size())
+      {
+         pass->fracs[whichGroup] = frac;
+      }
+
+      if (!wxThread::IsMain() || pass->cancelled)
+      {
+         return pass->cancelled;
+      }
+
+      for (size_t i = 0; i < pass->fracs.size(); i++)
+      {
+         done += pass->fracs[i];
+      }
+   }
+
+   // Only the thread that started the pass may touch the dialog
+   ProgressDialog *progress = pass->parent->mProgress;
+   int updateResult = (progress ?
+      progress->Update(done, (double) pass->fracs.size()) :
+      eProgressSuccess);
+
+   if (updateResult != eProgressSuccess)
+   {
+      ODLocker locker(pass->lock);
+      pass->cancelled = true;
+   }
+
+   return updateResult != eProgressSuccess;
 }
 
 bool Effect::ProcessTrack(int count,
@@ -1597,10 +1809,12 @@ bool Effect::ProcessTrack(int count,
             }
 
             // Fill the input buffers
-            left->Get((samplePtr) mInBuffer[0], floatSample, inLeftPos, inputBufferCnt);
+            left->Get((samplePtr) mInBuffer[0], floatSample, inLeftPos, inputBufferCnt,
+                      fillZero, true);
             if (right)
             {
-               right->Get((samplePtr) mInBuffer[1], floatSample, inRightPos, inputBufferCnt);
+               right->Get((samplePtr) mInBuffer[1], floatSample, inRightPos, inputBufferCnt,
+                          fillZero, true);
             }
 
             // Reset the input buffer positions
@@ -1987,6 +2201,11 @@ bool Effect::TotalProgress(double frac)
 
 bool Effect::TrackProgress(int whichTrack, double frac, wxString msg)
 {
+   if (mParallelPass)
+   {
+      return ParallelProgress(whichTrack, frac);
+   }
+
    int updateResult = (mProgress ?
       mProgress->Update(whichTrack + frac, (double) mNumTracks, msg) :
       eProgressSuccess);
@@ -1995,6 +2214,11 @@ bool Effect::TrackProgress(int whichTrack, double frac, wxString msg)
 
 bool Effect::TrackGroupProgress(int whichGroup, double frac)
 {
+   if (mParallelPass)
+   {
+      return ParallelProgress(whichGroup, frac);
+   }
+
    int updateResult = (mProgress ?
       mProgress->Update(whichGroup + frac, (double) mNumGroups) :
       eProgressSuccess);
@@ -2259,7 +2483,7 @@ bool Effect::RealtimeAddProcessor(int group, int chans, float rate)
       }
 
       // Add a new processor
-      mClient->RealtimeAddProcessor(gchans, rate);
+      RealtimeAddProcessor(gchans, rate);
 
       // Bump to next processor
       mCurrentProcessor++;
@@ -2366,7 +2590,7 @@ sampleCount Effect::RealtimeProcess(int group,
       for (sampleCount block = 0; block < numSamples; block += mBlockSize)
       {
          sampleCount cnt = (block + mBlockSize > numSamples ? numSamples - block : mBlockSize);
-         len += mClient->RealtimeProcess(processor, clientIn, clientOut, cnt);
+         len += RealtimeProcess(processor, clientIn, clientOut, cnt);
 
          for (int i = 0 ; i < mNumAudioIn; i++)
          {
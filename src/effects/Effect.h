@@ -13,6 +13,7 @@
 #define __AUDACITY_EFFECT__
 
 #include <set>
+#include <vector>
 
 #include <wx/bmpbuttn.h>
 #include <wx/dynarray.h>
@@ -273,6 +274,13 @@ protected:
    virtual bool InitPass2();
    virtual int GetPass();
 
+   // Effects that keep all of their processing state in the instance, and
+   // start it afresh in ProcessInitialize, can return a new instance here.
+   // ProcessPass then gives the track groups to several such processors at
+   // once, each set up from the effect list and given this one's settings.
+   // The default returns NULL, and groups are processed one at a time.
+   virtual Effect *NewProcessor();
+
    // clean up any temporary memory
    virtual void End();
 
@@ -384,6 +392,8 @@ protected:
    void CountWaveTracks();
 
    // Driver for client effects
+   bool ProcessGroup(int count, WaveTrack *left, WaveTrack *right);
+   void FreeBuffers();
    bool ProcessTrack(int count,
                      ChannelNames map,
                      WaveTrack *left,
@@ -420,6 +430,17 @@ private:
    int mNumTracks; //v This is really mNumWaveTracks, per CountWaveTracks() and GetNumWaveTracks().
    int mNumGroups;
 
+   // Processing groups on several processors at once
+   struct ParallelPass;
+   friend class EffectPassTask;
+   void MakeProcessors(std::vector<Effect *> &processors, int groups);
+   bool ProcessGroupsInParallel(std::vector<Effect *> &processors,
+                                std::vector<WaveTrack *> &lefts,
+                                std::vector<WaveTrack *> &rights);
+   void RunParallelPass();
+   bool ParallelProgress(int whichGroup, double frac);
+   ParallelPass *mParallelPass;   // set only in processors
+
    // For client driver
    EffectClientInterface *mClient;
    int mNumAudioIn;
@@ -11,12 +11,18 @@
 
 #include "../Audacity.h"
 
+#include <algorithm>
+#include <string.h>
+
 #include <wx/msgdlg.h>
 #include <wx/stopwatch.h>
 #include <wx/tokenzr.h>
+#include <wx/utils.h>
 
 #include "../Experimental.h"
 
+#include "../../lib-src/portaudio-v19/src/common/pa_memorybarrier.h"
+
 #if defined(EXPERIMENTAL_EFFECTS_RACK)
 #include "EffectRack.h"
 #endif
@@ -37,11 +43,11 @@ EffectManager & EffectManager::Get()
 
 EffectManager::EffectManager()
 {
-   mRealtimeLock.Enter();
    mRealtimeActive = false;
    mRealtimeSuspended = true;
-   mRealtimeLatency = 0;
-   mRealtimeLock.Leave();
+   mRealtimeChain = new RealtimeChain(mRealtimeEffects);
+   mRealtimeCycleChain = NULL;
+   mRealtimeCycle = 0;
 
 #if defined(EXPERIMENTAL_EFFECTS_RACK)
    mRack = NULL;
@@ -61,6 +67,8 @@ EffectManager::~EffectManager()
       delete iter->second;
       ++iter;
    }
+
+   delete mRealtimeChain;
 }
 
 // Here solely for the purpose of Nyquist Workbench until
@@ -341,94 +349,96 @@ void EffectManager::ShowRack()
 {
    GetRack()->Show(!GetRack()->IsShown());
 }
+#endif
 
-void EffectManager::RealtimeSetEffects(const EffectArray & effects)
-{
-   int newCount = (int) effects.GetCount();
-   Effect **newEffects = new Effect *[newCount];
-   for (int i = 0; i < newCount; i++)
-   {
-      newEffects[i] = effects[i];
-   }
-
-   // Block RealtimeProcess()
-   RealtimeSuspend();
+// ============================================================================
+//
+// Realtime effect processing
+//
+// The main thread changes the effects only by building a new RealtimeChain and
+// swapping it for the current one.  The audio thread picks the chain up at the
+// start of each of its cycles (RealtimeProcessStart() ... RealtimeProcessEnd())
+// without taking a lock, so it never waits while effects are initialized or
+// cleaned up.  An old chain is deleted once no cycle that began before the
+// swap is still running.
+//
+// Only the audio thread changes mRealtimeCycle, and only the main thread
+// changes mRealtimeChain and mRealtimeSuspended.  Each side writes its own and
+// then, past a full barrier, reads the other's.  So either a cycle sees the new
+// chain, or the main thread sees that cycle under way and waits for it.
+//
+// ============================================================================
 
-   // Tell any effects no longer in the chain to clean up
-   for (int i = 0; i < mRealtimeCount; i++)
-   {
-      Effect *e = mRealtimeEffects[i];
+// Frames that each effect processes at a time, so that a block goes
+// through the whole chain while it's still in the cache
+static const sampleCount RealtimeBlockSize = 1024;
 
-      // Scan the new chain for the effect
-      for (int j = 0; j < newCount; j++)
-      {
-         // Found it so we're done
-         if (e == newEffects[j])
-         {
-            e = NULL;
-            break;
-         }
-      }
+// Tails can be long (or claimed to be), so play no more than this of one
+static const double MaxRealtimeTailSecs = 10.0;
 
-      // Must not have been in the new chain, so tell it to cleanup
-      if (e && mRealtimeActive)
-      {
-         e->RealtimeFinalize();
-      }
-   }
-      
-   // Tell any new effects to get ready
-   for (int i = 0; i < newCount; i++)
+struct EffectManager::RealtimeChain
+{
+   RealtimeChain(const EffectArray & chainEffects)
+   :  effects(chainEffects),
+      cycleTimes(chainEffects.GetCount(), 0),
+      times(chainEffects.GetCount(), 0)
    {
-      Effect *e = newEffects[i];
-
-      // Scan the old chain for the effect
-      for (int j = 0; j < mRealtimeCount; j++)
+      latency = 0;
+      tail = 0;
+      for (size_t i = 0, cnt = effects.GetCount(); i < cnt; i++)
       {
-         // Found it so tell effect to get ready
-         if (e == mRealtimeEffects[j])
-         {
-            e = NULL;
-         }
+         latency += effects[i]->GetLatency();
+         tail += effects[i]->GetTailSize();
       }
 
-      // Must not have been in the old chain, so tell it to initialize
-      if (e && mRealtimeActive)
-      {
-         e->RealtimeInitialize();
-      }
+      // What the effects hold back comes out after the input ends, too
+      tail += latency;
    }
 
-   // Get rid of the old chain
-   if (mRealtimeEffects)
-   {
-      delete [] mRealtimeEffects;
-   }
+   EffectArray effects;
+   std::vector<int> cycleTimes;  // microseconds each took in the current cycle
+   std::vector<int> times;       // and in the last whole cycle
+   sampleCount latency;
+   sampleCount tail;
+};
 
-   // And install the new one
-   mRealtimeEffects = newEffects;
-   mRealtimeCount = newCount;
-
-   // Allow RealtimeProcess() to, well, process 
-   RealtimeResume();
-}
+// Microseconds since the watch was started
+static wxLongLong_t ElapsedMicros(wxStopWatch & watch)
+{
+#if wxCHECK_VERSION(2, 9, 3)
+   return watch.TimeInMicro().GetValue();
+#else
+   return (wxLongLong_t) watch.Time() * 1000;
 #endif
+}
 
-bool EffectManager::RealtimeIsActive()
+void EffectManager::UpdateRealtimeChain()
 {
-   return mRealtimeEffects.GetCount() != 0;
+   RealtimeChain *chain = new RealtimeChain(mRealtimeEffects);
+   RealtimeChain *old = mRealtimeChain;
+
+   mRealtimeChain = chain;
+
+   // A cycle that began before the swap may still be using the old one
+   WaitForRealtimeCycle();
+   delete old;
 }
 
-bool EffectManager::RealtimeIsSuspended()
+void EffectManager::WaitForRealtimeCycle()
 {
-   return mRealtimeSuspended;
+   // Whatever the caller changed must be seen before the cycle is read
+   PaUtil_FullMemoryBarrier();
+   unsigned int cycle = mRealtimeCycle;
+
+   // Odd from RealtimeProcessStart() to RealtimeProcessEnd()
+   while ((cycle & 1) && mRealtimeCycle == cycle)
+   {
+      wxMilliSleep(1);
+   }
 }
 
-void EffectManager::RealtimeAddEffect(Effect *effect)
+void EffectManager::RealtimeStartEffect(Effect *effect)
 {
-   // Block RealtimeProcess()
-   RealtimeSuspend();
-
    // Initialize effect if realtime is already active
    if (mRealtimeActive)
    {
@@ -441,30 +451,82 @@ void EffectManager::RealtimeAddEffect(Effect *effect)
          effect->RealtimeAddProcessor(i, mRealtimeChans[i], mRealtimeRates[i]);
       }
    }
-   
-   // Add to list of active effects
-   mRealtimeEffects.Add(effect);
 
-   // Allow RealtimeProcess() to, well, process 
-   RealtimeResume();
+   // Effects start out suspended, like the rest are while we are
+   if (!mRealtimeSuspended)
+   {
+      effect->RealtimeResume();
+   }
 }
 
-void EffectManager::RealtimeRemoveEffect(Effect *effect)
+void EffectManager::RealtimeStopEffect(Effect *effect)
 {
-   // Block RealtimeProcess()
-   RealtimeSuspend();
+   // Leave it suspended, as it started out
+   if (!mRealtimeSuspended)
+   {
+      effect->RealtimeSuspend();
+   }
 
    if (mRealtimeActive)
    {
       // Cleanup realtime processing
       effect->RealtimeFinalize();
    }
-      
+}
+
+void EffectManager::RealtimeSetEffects(const EffectArray & effects)
+{
+   // Tell any new effects to get ready
+   for (size_t i = 0, cnt = effects.GetCount(); i < cnt; i++)
+   {
+      if (mRealtimeEffects.Index(effects[i]) == wxNOT_FOUND)
+      {
+         RealtimeStartEffect(effects[i]);
+      }
+   }
+
+   // Install the new chain
+   EffectArray old = mRealtimeEffects;
+   mRealtimeEffects = effects;
+   UpdateRealtimeChain();
+
+   // Tell any effects no longer in the chain to clean up
+   for (size_t i = 0, cnt = old.GetCount(); i < cnt; i++)
+   {
+      if (effects.Index(old[i]) == wxNOT_FOUND)
+      {
+         RealtimeStopEffect(old[i]);
+      }
+   }
+}
+
+bool EffectManager::RealtimeIsActive()
+{
+   return mRealtimeEffects.GetCount() != 0;
+}
+
+bool EffectManager::RealtimeIsSuspended()
+{
+   return mRealtimeSuspended;
+}
+
+void EffectManager::RealtimeAddEffect(Effect *effect)
+{
+   RealtimeStartEffect(effect);
+
+   // Add to list of active effects
+   mRealtimeEffects.Add(effect);
+   UpdateRealtimeChain();
+}
+
+void EffectManager::RealtimeRemoveEffect(Effect *effect)
+{
    // Remove from list of active effects
    mRealtimeEffects.Remove(effect);
+   UpdateRealtimeChain();
 
-   // Allow RealtimeProcess() to, well, process 
-   RealtimeResume();
+   // RealtimeProcess() is done with it now
+   RealtimeStopEffect(effect);
 }
 
 void EffectManager::RealtimeInitialize()
@@ -475,6 +537,7 @@ void EffectManager::RealtimeInitialize()
    // (Re)Set processor parameters
    mRealtimeChans.Clear();
    mRealtimeRates.Clear();
+   mRealtimeTails.clear();
 
    // RealtimeAdd/RemoveEffect() needs to know when we're active so it can
    // initialize newly added effects
@@ -486,6 +549,9 @@ void EffectManager::RealtimeInitialize()
       mRealtimeEffects[i]->RealtimeInitialize();
    }
 
+   // Their latencies may be known only now
+   UpdateRealtimeChain();
+
    // Get things moving
    RealtimeResume();
 }
@@ -499,6 +565,15 @@ void EffectManager::RealtimeAddProcessor(int group, int chans, float rate)
 
    mRealtimeChans.Add(chans);
    mRealtimeRates.Add(rate);
+   mRealtimeTails.push_back(0);
+
+   // Room for the widest group, so that RealtimeProcess() never allocates
+   if (chans > (int) mRealtimeIn.size())
+   {
+      mRealtimeBuffer.resize(chans * RealtimeBlockSize);
+      mRealtimeIn.resize(chans);
+      mRealtimeOut.resize(chans);
+   }
 }
 
 void EffectManager::RealtimeFinalize()
@@ -506,9 +581,6 @@ void EffectManager::RealtimeFinalize()
    // Make sure nothing is going on
    RealtimeSuspend();
 
-   // It is now safe to clean up
-   mRealtimeLatency = 0;
-
    // Tell each effect to clean up as well
    for (int i = 0, cnt = mRealtimeEffects.GetCount(); i < cnt; i++)
    {
@@ -518,6 +590,7 @@ void EffectManager::RealtimeFinalize()
    // Reset processor parameters
    mRealtimeChans.Clear();
    mRealtimeRates.Clear();
+   mRealtimeTails.clear();
 
    // No longer active
    mRealtimeActive = false;
@@ -525,35 +598,30 @@ void EffectManager::RealtimeFinalize()
 
 void EffectManager::RealtimeSuspend()
 {
-   mRealtimeLock.Enter();
-
    // Already suspended...bail
    if (mRealtimeSuspended)
    {
-      mRealtimeLock.Leave();
       return;
    }
 
-   // Show that we aren't going to be doing anything
+   // Show that we aren't going to be doing anything, and wait for any
+   // cycle that started before to finish
    mRealtimeSuspended = true;
 
+   WaitForRealtimeCycle();
+
    // And make sure the effects don't either
    for (int i = 0, cnt = mRealtimeEffects.GetCount(); i < cnt; i++)
    {
       mRealtimeEffects[i]->RealtimeSuspend();
    }
-
-   mRealtimeLock.Leave();
 }
 
 void EffectManager::RealtimeResume()
 {
-   mRealtimeLock.Enter();
-
    // Already running...bail
    if (!mRealtimeSuspended)
    {
-      mRealtimeLock.Leave();
       return;
    }
 
@@ -565,8 +633,6 @@ void EffectManager::RealtimeResume()
 
    // And we should too
    mRealtimeSuspended = false;
-
-   mRealtimeLock.Leave();
 }
 
 //
@@ -574,97 +640,117 @@ void EffectManager::RealtimeResume()
 //
 void EffectManager::RealtimeProcessStart()
 {
-   // Protect ourselves from the main thread
-   mRealtimeLock.Enter();
+   // Take the chain for this cycle.  Can be suspended because of the audio
+   // stream being paused or because effects have been suspended.
+   mRealtimeCycle++;
+   PaUtil_FullMemoryBarrier();
+   mRealtimeCycleChain = mRealtimeSuspended ? NULL : mRealtimeChain;
 
-   // Can be suspended because of the audio stream being paused or because effects
-   // have been suspended.
-   if (!mRealtimeSuspended)
+   RealtimeChain *chain = mRealtimeCycleChain;
+   if (chain)
    {
-      for (size_t i = 0, cnt = mRealtimeEffects.GetCount(); i < cnt; i++)
+      for (size_t i = 0, cnt = chain->effects.GetCount(); i < cnt; i++)
       {
-         if (mRealtimeEffects[i]->IsRealtimeActive())
+         chain->cycleTimes[i] = 0;
+         if (chain->effects[i]->IsRealtimeActive())
          {
-            mRealtimeEffects[i]->RealtimeProcessStart();
+            chain->effects[i]->RealtimeProcessStart();
          }
       }
    }
-
-   mRealtimeLock.Leave();
 }
 
 //
 // This will be called in a different thread than the main GUI thread.
 //
-sampleCount EffectManager::RealtimeProcess(int group, int chans, float **buffers, sampleCount numSamples)
+// The buffers have room for maxSamples.  Once the input has ended, the
+// effects' tails are added after what there is, in that room.  A short buffer
+// before then is an underrun, and is left as it is.
+//
+sampleCount EffectManager::RealtimeProcess(int group, int chans, float **buffers,
+                                           sampleCount numSamples,
+                                           sampleCount maxSamples,
+                                           bool inputEnded)
 {
-   // Protect ourselves from the main thread
-   mRealtimeLock.Enter();
+   RealtimeChain *chain = mRealtimeCycleChain;
 
-   // Can be suspended because of the audio stream being paused or because effects
-   // have been suspended, so allow the samples to pass as-is.
-   if (mRealtimeSuspended || mRealtimeEffects.IsEmpty())
+   // Without a chain, allow the samples to pass as-is.
+   if (!chain || chain->effects.IsEmpty() ||
+       chans > (int) mRealtimeIn.size() ||
+       group >= (int) mRealtimeTails.size())
    {
-      mRealtimeLock.Leave();
       return numSamples;
    }
 
-   // Remember when we started so we can calculate the amount of latency we
-   // are introducing
-   wxMilliClock_t start = wxGetLocalTimeMillis();
-
-   // Allocate the in/out buffer arrays
-   float **ibuf = (float **) alloca(chans * sizeof(float *));
-   float **obuf = (float **) alloca(chans * sizeof(float *));
-
-   // And populate the input with the buffers we've been given while allocating
-   // new output buffers
-   for (int i = 0; i < chans; i++)
+   // Keep going with silence after the input for as long as the tail lasts
+   sampleCount & tail = mRealtimeTails[group];
+   if (numSamples > 0)
    {
-      ibuf[i] = buffers[i];
-      obuf[i] = (float *) alloca(numSamples * sizeof(float));
+      tail = std::min(chain->tail,
+                      (sampleCount) (mRealtimeRates[group] * MaxRealtimeTailSecs));
    }
-
-   // Now call each effect in the chain while swapping buffer pointers to feed the
-   // output of one effect as the input to the next effect
-   size_t called = 0;
-   for (size_t i = 0, cnt = mRealtimeEffects.GetCount(); i < cnt; i++)
+   sampleCount extra = inputEnded ? std::min(maxSamples - numSamples, tail) : 0;
+   if (extra > 0)
    {
-      if (mRealtimeEffects[i]->IsRealtimeActive())
-      {
-         mRealtimeEffects[i]->RealtimeProcess(group, chans, ibuf, obuf, numSamples);
-         called++;
-      }
-
-      for (int j = 0; j < chans; j++)
+      for (int i = 0; i < chans; i++)
       {
-         float *temp;
-         temp = ibuf[j];
-         ibuf[j] = obuf[j];
-         obuf[j] = temp;
+         memset(buffers[i] + numSamples, 0, extra * sizeof(float));
       }
+      numSamples += extra;
+      tail -= extra;
    }
 
-   // Once we're done, we might wind up with the last effect storing its results
-   // in the temporary buffers.  If that's the case, we need to copy it over to
-   // the caller's buffers.  This happens when the number of effects proccessed
-   // is odd.
-   if (called & 1)
+   wxStopWatch watch;
+
+   // Put each block through the whole chain, swapping the input and output
+   // buffers to feed the output of one effect as the input to the next
+   for (sampleCount block = 0; block < numSamples; block += RealtimeBlockSize)
    {
+      sampleCount len = std::min(numSamples - block, RealtimeBlockSize);
+
+      float **ibuf = &mRealtimeIn[0];
+      float **obuf = &mRealtimeOut[0];
       for (int i = 0; i < chans; i++)
       {
-         memcpy(buffers[i], ibuf[i], numSamples * sizeof(float));
+         ibuf[i] = buffers[i] + block;
+         obuf[i] = &mRealtimeBuffer[i * RealtimeBlockSize];
       }
-   }
 
-   // Remember the latency
-   mRealtimeLatency = (int) (wxGetLocalTimeMillis() - start).GetValue();
+      wxLongLong_t last = ElapsedMicros(watch);
+      size_t called = 0;
+      for (size_t i = 0, cnt = chain->effects.GetCount(); i < cnt; i++)
+      {
+         Effect *effect = chain->effects[i];
+         if (!effect->IsRealtimeActive())
+         {
+            continue;
+         }
+
+         effect->RealtimeProcess(group, chans, ibuf, obuf, len);
+         called++;
 
-   mRealtimeLock.Leave();
+         wxLongLong_t now = ElapsedMicros(watch);
+         chain->cycleTimes[i] += (int) (now - last);
+         last = now;
+
+         float **temp = ibuf;
+         ibuf = obuf;
+         obuf = temp;
+      }
+
+      // Once we're done, we might wind up with the last effect storing its
+      // results in the temporary buffers.  If that's the case, we need to
+      // copy it over to the caller's buffers.  This happens when the number
+      // of effects processed is odd.
+      if (called & 1)
+      {
+         for (int i = 0; i < chans; i++)
+         {
+            memcpy(buffers[i] + block, ibuf[i], len * sizeof(float));
+         }
+      }
+   }
 
-   //
-   // This is wrong...needs to handle tails
-   //
    return numSamples;
 }
 
@@ -673,28 +759,44 @@ sampleCount EffectManager::RealtimeProcess(int group, int chans, float **buffers
 //
 void EffectManager::RealtimeProcessEnd()
 {
-   // Protect ourselves from the main thread
-   mRealtimeLock.Enter();
-
-   // Can be suspended because of the audio stream being paused or because effects
-   // have been suspended.
-   if (!mRealtimeSuspended)
+   RealtimeChain *chain = mRealtimeCycleChain;
+   if (chain)
    {
-      for (size_t i = 0, cnt = mRealtimeEffects.GetCount(); i < cnt; i++)
+      for (size_t i = 0, cnt = chain->effects.GetCount(); i < cnt; i++)
       {
-         if (mRealtimeEffects[i]->IsRealtimeActive())
+         if (chain->effects[i]->IsRealtimeActive())
          {
-            mRealtimeEffects[i]->RealtimeProcessEnd();
+            chain->effects[i]->RealtimeProcessEnd();
          }
+         chain->times[i] = chain->cycleTimes[i];
       }
    }
 
-   mRealtimeLock.Leave();
+   // Done with the chain
+   mRealtimeCycleChain = NULL;
+   PaUtil_FullMemoryBarrier();
+   mRealtimeCycle++;
 }
 
 int EffectManager::GetRealtimeLatency()
 {
-   return mRealtimeLatency;
+   return (int) mRealtimeChain->latency;
+}
+
+int EffectManager::GetRealtimeProcessTime(Effect *effect)
+{
+   RealtimeChain *chain = mRealtimeChain;
+
+   int time = 0;
+   for (size_t i = 0, cnt = chain->effects.GetCount(); i < cnt; i++)
+   {
+      if (!effect || chain->effects[i] == effect)
+      {
+         time += chain->times[i];
+      }
+   }
+
+   return time;
 }
 
 Effect *EffectManager::GetEffect(const PluginID & ID)
@@ -27,6 +27,8 @@ effects.
 #include <wx/listbox.h>
 #include <wx/string.h>
 
+#include <vector>
+
 #include "audacity/EffectInterface.h"
 #include "../PluginManager.h"
 #include "Effect.h"
@@ -101,9 +103,15 @@ public:
    void RealtimeSuspend();
    void RealtimeResume();
    void RealtimeProcessStart();
-   sampleCount RealtimeProcess(int group, int chans, float **buffers, sampleCount numSamples);
+   sampleCount RealtimeProcess(int group, int chans, float **buffers,
+                               sampleCount numSamples, sampleCount maxSamples,
+                               bool inputEnded);
    void RealtimeProcessEnd();
+   /** Samples of delay that the realtime effects add */
    int GetRealtimeLatency();
+   /** Microseconds that the effect, or all of them if NULL, took
+       in the last cycle of the audio thread */
+   int GetRealtimeProcessTime(Effect *effect = NULL);
 
 #if defined(EXPERIMENTAL_EFFECTS_RACK)
    void ShowRack();
@@ -119,19 +127,35 @@ private:
    EffectRack *GetRack();
 #endif
 
+   struct RealtimeChain;
+
+   /** Replace the chain that RealtimeProcess() uses with mRealtimeEffects */
+   void UpdateRealtimeChain();
+   /** Wait until any cycle of the audio thread that has begun has ended */
+   void WaitForRealtimeCycle();
+   void RealtimeStartEffect(Effect *effect);
+   void RealtimeStopEffect(Effect *effect);
+
 private:
    EffectMap mEffects;
    EffectMap mHostEffects;
 
    int mNumEffects;
 
-   wxCriticalSection mRealtimeLock;
+   // Shared with the audio thread without a lock; see RealtimeProcessStart()
    EffectArray mRealtimeEffects;
-   int mRealtimeLatency;
-   bool mRealtimeSuspended;
+   RealtimeChain * volatile mRealtimeChain;   // replaced, never changed
+   RealtimeChain *mRealtimeCycleChain;        // the one the audio thread is using
+   volatile unsigned int mRealtimeCycle;      // odd while the audio thread is in a cycle
+   volatile bool mRealtimeSuspended;
    bool mRealtimeActive;
    wxArrayInt mRealtimeChans;
    wxArrayDouble mRealtimeRates;
+   std::vector<sampleCount> mRealtimeTails;   // left to play, for each group
+   // Ping-pong buffers for the widest group, for RealtimeProcess()
+   std::vector<float> mRealtimeBuffer;
+   std::vector<float *> mRealtimeIn;
+   std::vector<float *> mRealtimeOut;
 
 #if defined(EXPERIMENTAL_EFFECTS_RACK)
    EffectRack *mRack;
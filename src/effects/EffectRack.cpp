@@ -30,6 +30,7 @@
 #include <wx/stattext.h>
 #include <wx/timer.h>
 #include <wx/tglbtn.h>
+#include <wx/tooltip.h>
 
 #include "EffectManager.h"
 #include "EffectRack.h"
@@ -87,6 +88,7 @@ EffectRack::EffectRack()
    mBypassing = false;
    mNumEffects = 0;
    mLastLatency = 0;
+   mLastTime = 0;
    mTimer.SetOwner(this);
 
    mPowerPushed = CreateBitmap(power_on_16x16_xpm, false, false);
@@ -112,7 +114,7 @@ EffectRack::EffectRack()
    wxBoxSizer *hs = new wxBoxSizer(wxHORIZONTAL);
    hs->Add(new wxButton(mPanel, wxID_APPLY, _("&Apply")), 0, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
    hs->AddStretchSpacer();
-   mLatency = new wxStaticText(mPanel, wxID_ANY, _("Latency: 0"));
+   mLatency = new wxStaticText(mPanel, wxID_ANY, _("Latency: 0  Processing: 0 us"));
    hs->Add(mLatency, 0, wxALIGN_CENTER);
    hs->AddStretchSpacer();
    hs->Add(new wxToggleButton(mPanel, wxID_CLEAR, _("&Bypass")), 0, wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL);
@@ -267,12 +269,30 @@ void EffectRack::OnClose(wxCloseEvent & evt)
 
 void EffectRack::OnTimer(wxTimerEvent & WXUNUSED(evt))
 {
-   int latency = EffectManager::Get().GetRealtimeLatency();
-   if (latency != mLastLatency)
+   EffectManager & em = EffectManager::Get();
+
+   int latency = em.GetRealtimeLatency();
+   int time = em.GetRealtimeProcessTime();
+   if (latency != mLastLatency || time != mLastTime)
    {
-      mLatency->SetLabel(wxString::Format(_("Latency: %4d"), latency));
+      mLatency->SetLabel(wxString::Format(_("Latency: %4d  Processing: %6d us"),
+                                          latency, time));
       mLatency->Refresh();
       mLastLatency = latency;
+      mLastTime = time;
+   }
+
+   // And what each effect took, on its name, if that has changed
+   for (size_t i = 0, cnt = mEffects.GetCount(); i < cnt; i++)
+   {
+      wxWindow *text = mMainSizer->GetItem((i * NUMCOLS) + COL_NAME)->GetWindow();
+      wxString tip = wxString::Format(_("Name of the effect (processing: %d us)"),
+                                      em.GetRealtimeProcessTime(mEffects[i]));
+      wxToolTip *oldTip = text->GetToolTip();
+      if (!oldTip || oldTip->GetTip() != tip)
+      {
+         text->SetToolTip(tip);
+      }
    }
 }
 
@@ -60,6 +60,7 @@ private:
 private:
    wxStaticText *mLatency;
    int mLastLatency;
+   int mLastTime;
 
    wxBitmap mPowerPushed;
    wxBitmap mPowerRaised;
@@ -210,7 +210,8 @@ END_EVENT_TABLE()
 
 EffectEqualization::EffectEqualization()
 {
-   hFFT = InitializeFFT(windowSize);
+   mPlan = FFTPlanner::Get().GetPlan(windowSize);
+   hFFT = mPlan->GetTables();
    mFFTBuffer = new float[windowSize];
    mFilterFuncR = new float[windowSize];
    mFilterFuncI = new float[windowSize];
@@ -222,6 +223,10 @@ EffectEqualization::EffectEqualization()
 #endif
 
    mM = DEF_FilterLength;
+   mFilter = NULL;
+   mSharedFilter = NULL;
+   mConvolver = NULL;
+   mLatency = 0;
    mLin = DEF_InterpLin;
    mInterp = DEF_InterpMeth;
    mCurveName = DEF_CurveName;
@@ -292,8 +297,6 @@ EffectEqualization::~EffectEqualization()
       delete mLinEnvelope;
    mLinEnvelope = NULL;
 
-   if(hFFT)
-      EndFFT(hFFT);
    hFFT = NULL;
    if(mFFTBuffer)
       delete[] mFFTBuffer;
@@ -308,6 +311,12 @@ EffectEqualization::~EffectEqualization()
    if(mEffectEqualization48x)
       delete mEffectEqualization48x;
 #endif
+
+   RealtimeFinalize();
+   if(mConvolver)
+      delete mConvolver;
+   if(mFilter)
+      delete mFilter;
 }
 
 // IdentInterface implementation
@@ -329,8 +338,117 @@ EffectType EffectEqualization::GetType()
    return EffectTypeProcess;
 }
 
+bool EffectEqualization::SupportsRealtime()
+{
+   return true;
+}
+
 // EffectClientInterface implementation
 
+int EffectEqualization::GetAudioInCount()
+{
+   return 1;
+}
+
+int EffectEqualization::GetAudioOutCount()
+{
+   return 1;
+}
+
+sampleCount EffectEqualization::GetLatency()
+{
+   // Reported once, at the start of each track
+   sampleCount latency = mLatency;
+   mLatency = 0;
+   return latency;
+}
+
+sampleCount EffectEqualization::GetTailSize()
+{
+   // What the realtime convolvers still have to give once input stops
+   return mFilter ? convolverBlockSize + mFilter->GetNumTaps() : 0;
+}
+
+bool EffectEqualization::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames WXUNUSED(chanMap))
+{
+   const PartitionedFilter *filter = mSharedFilter ? mSharedFilter : mFilter;
+   if (!filter)
+   {
+      return false;
+   }
+
+   mConvolver = new PartitionedConvolver(filter);
+
+   // The filter is symmetrical about its middle tap, where each output
+   // sample belongs
+   mLatency = mConvolver->GetLatency() + (filter->GetNumTaps() - 1) / 2;
+
+   return true;
+}
+
+bool EffectEqualization::ProcessFinalize()
+{
+   delete mConvolver;
+   mConvolver = NULL;
+
+   return true;
+}
+
+sampleCount EffectEqualization::ProcessBlock(float **inBlock, float **outBlock, sampleCount blockLen)
+{
+   mConvolver->Process(inBlock[0], outBlock[0], blockLen);
+
+   return blockLen;
+}
+
+bool EffectEqualization::RealtimeInitialize()
+{
+   SetBlockSize(512);
+
+   return mFilter != NULL;
+}
+
+bool EffectEqualization::RealtimeAddProcessor(int WXUNUSED(numChannels), float WXUNUSED(sampleRate))
+{
+   if (!mFilter)
+   {
+      return false;
+   }
+
+   ODLocker locker(mRealtimeLock);
+   mRealtimeConvolvers.push_back(new PartitionedConvolver(mFilter));
+
+   return true;
+}
+
+bool EffectEqualization::RealtimeFinalize()
+{
+   ODLocker locker(mRealtimeLock);
+   for (size_t i = 0; i < mRealtimeConvolvers.size(); i++)
+   {
+      delete mRealtimeConvolvers[i];
+   }
+   mRealtimeConvolvers.clear();
+
+   return true;
+}
+
+sampleCount EffectEqualization::RealtimeProcess(int group,
+                                                float **inbuf,
+                                                float **outbuf,
+                                                sampleCount numSamples)
+{
+   ODLocker locker(mRealtimeLock);
+   if (group < 0 || group >= (int) mRealtimeConvolvers.size())
+   {
+      return 0;
+   }
+
+   mRealtimeConvolvers[group]->Process(inbuf[0], outbuf[0], numSamples);
+
+   return numSamples;
+}
+
 bool EffectEqualization::GetAutomationParameters(EffectAutomationParameters & parms)
 {
    parms.Write(KEY_FilterLength, mM);
@@ -513,36 +631,18 @@ bool EffectEqualization::Process()
       } else
          return mEffectEqualization48x->Process(this);
 #endif
-   this->CopyInputTracks(); // Set up mOutputTracks.
-   bool bGoodResult = true;
-
-   SelectedTrackListOfKindIterator iter(Track::Wave, mOutputTracks);
-   WaveTrack *track = (WaveTrack *) iter.First();
-   int count = 0;
-   while (track) {
-      double trackStart = track->GetStartTime();
-      double trackEnd = track->GetEndTime();
-      double t0 = mT0 < trackStart? trackStart: mT0;
-      double t1 = mT1 > trackEnd? trackEnd: mT1;
-
-      if (t1 > t0) {
-         sampleCount start = track->TimeToLongSamples(t0);
-         sampleCount end = track->TimeToLongSamples(t1);
-         sampleCount len = (sampleCount)(end - start);
-
-         if (!ProcessOne(count, track, start, len))
-         {
-            bGoodResult = false;
-            break;
-         }
-      }
 
-      track = (WaveTrack *) iter.Next();
-      count++;
-   }
+   // Channels are filtered through ProcessBlock, each by its own
+   // processor where there are threads for them
+   return Effect::Process();
+}
 
-   this->ReplaceProcessedTracks(bGoodResult);
-   return bGoodResult;
+Effect *EffectEqualization::NewProcessor()
+{
+   EffectEqualization *processor = new EffectEqualization();
+   processor->mSharedFilter = mFilter;
+
+   return processor;
 }
 
 bool EffectEqualization::PopulateUI(wxWindow *parent)
@@ -1231,6 +1331,17 @@ bool EffectEqualization::CalcFilter()
       outr[i]=0.;
    }
 
+   // The mM taps are what the convolvers filter with
+   PartitionedFilter *oldFilter = mFilter;
+   mFilter = new PartitionedFilter(outr, mM, convolverBlockSize);
+   {
+      ODLocker locker(mRealtimeLock);
+      for (size_t c = 0; c < mRealtimeConvolvers.size(); c++)
+         mRealtimeConvolvers[c]->SetFilter(mFilter);
+   }
+   if (oldFilter)
+      delete oldFilter;
+
    //Back to the frequency domain so we can use it
    RealFFT(mWindowSize,outr,mFilterFuncR,mFilterFuncI);
 
@@ -1246,7 +1357,7 @@ void EffectEqualization::Filter(sampleCount len, float *buffer)
    int i;
    float re,im;
    // Apply FFT
-   RealFFTf(buffer, hFFT);
+   mPlan->Forward(buffer);
    //FFT(len, false, inr, NULL, outr, outi);
 
    // Apply filter
@@ -1263,7 +1374,7 @@ void EffectEqualization::Filter(sampleCount len, float *buffer)
    mFFTBuffer[1] = buffer[1] * mFilterFuncR[len/2];
 
    // Inverse FFT and normalization
-   InverseRealFFTf(mFFTBuffer, hFFT);
+   mPlan->Inverse(mFFTBuffer);
    ReorderToTime(hFFT, mFFTBuffer, buffer);
 }
 
@@ -40,7 +40,9 @@
 #include "../xml/XMLTagHandler.h"
 #include "../widgets/Grid.h"
 #include "../widgets/Ruler.h"
-#include "../RealFFTf.h"
+#include "../PartitionedConvolver.h"
+#include "../FFTPlanner.h"
+#include "../ondemand/ODTaskThread.h"
 
 #define EQUALIZATION_PLUGIN_SYMBOL XO("Equalization")
 
@@ -96,9 +98,24 @@ public:
    // EffectIdentInterface implementation
 
    virtual EffectType GetType();
+   virtual bool SupportsRealtime();
 
    // EffectClientInterface implementation
 
+   virtual int GetAudioInCount();
+   virtual int GetAudioOutCount();
+   virtual sampleCount GetLatency();
+   virtual sampleCount GetTailSize();
+   virtual bool ProcessInitialize(sampleCount totalLen, ChannelNames chanMap = NULL);
+   virtual bool ProcessFinalize();
+   virtual sampleCount ProcessBlock(float **inBlock, float **outBlock, sampleCount blockLen);
+   virtual bool RealtimeInitialize();
+   virtual bool RealtimeAddProcessor(int numChannels, float sampleRate);
+   virtual bool RealtimeFinalize();
+   virtual sampleCount RealtimeProcess(int group,
+                                       float **inbuf,
+                                       float **outbuf,
+                                       sampleCount numSamples);
    virtual bool GetAutomationParameters(EffectAutomationParameters & parms);
    virtual bool SetAutomationParameters(EffectAutomationParameters & parms);
    virtual bool LoadFactoryDefaults();
@@ -112,6 +129,7 @@ public:
    virtual bool Startup();
    virtual bool Init();
    virtual bool Process();
+   virtual Effect *NewProcessor();
 
    virtual bool PopulateUI(wxWindow *parent);
    virtual bool CloseUI();
@@ -129,6 +147,10 @@ private:
    // low range of human hearing
    enum {loFreqI=20};
 
+   // Samples in a partition of the filter, and the delay it adds
+   enum {convolverBlockSize=4096};
+
+   // Overlap-add in one window, kept for Equalization48x to compare with
    bool ProcessOne(int count, WaveTrack * t,
                    sampleCount start, sampleCount len);
    virtual bool CalcFilter();
@@ -183,11 +205,25 @@ private:
 #endif
 
 private:
+   const FFTPlan *mPlan;
    HFFT hFFT;
    float *mFFTBuffer;
    float *mFilterFuncR;
    float *mFilterFuncI;
    int mM;
+
+   // The filter as made by CalcFilter, or the one of the effect that
+   // made this one with NewProcessor, which it doesn't own
+   PartitionedFilter *mFilter;
+   const PartitionedFilter *mSharedFilter;
+   PartitionedConvolver *mConvolver;
+   sampleCount mLatency;   // not reported to the host yet
+
+   // One for each realtime processor.  Held by the audio thread while it
+   // processes, and by CalcFilter while it swaps in a new filter.
+   std::vector<PartitionedConvolver *> mRealtimeConvolvers;
+   ODLock mRealtimeLock;
+
    wxString mCurveName;
    bool mLin;
    float mdBMax;
@@ -76,3 +76,10 @@ sampleCount EffectInvert::ProcessBlock(float **inBlock, float **outBlock, sample
 
    return blockLen;
 }
+
+// Effect implementation
+
+Effect *EffectInvert::NewProcessor()
+{
+   return new EffectInvert();
+}
@@ -40,6 +40,10 @@ public:
    virtual int GetAudioInCount();
    virtual int GetAudioOutCount();
    virtual sampleCount ProcessBlock(float **inBlock, float **outBlock, sampleCount blockLen);
+
+   // Effect implementation
+
+   virtual Effect *NewProcessor();
 };
 
 #endif
@@ -33,6 +33,13 @@
   applied (depending on the advanced window types setting), and then
   the output signal is then pieced together using overlap/add.
 
+  Windows are taken in batches.  The forward FFTs of a batch, and the
+  frequency smoothing and inverse FFTs of the windows leaving the
+  history, are done on the WorkerPool, as each window needs only its
+  own data for those.  Statistics, the time smoothing of gains and the
+  overlap/add run in order on one thread in between, so the result is
+  the same to the bit as doing one window at a time.
+
 *//****************************************************************//**
 */
 
@@ -40,7 +47,9 @@
 #include "../Experimental.h"
 #include "NoiseReduction.h"
 
+#include "../FFTPlanner.h"
 #include "../Prefs.h"
+#include "../WorkerPool.h"
 
 #include <algorithm>
 #include <vector>
@@ -264,18 +273,28 @@ private:
                    int count, WaveTrack *track,
                    sampleCount start, sampleCount len);
 
+   struct Record;
+   class StageTask;
+
    void StartNewTrack();
    void ProcessSamples(Statistics &statistics,
       WaveTrack *outputTrack, sampleCount len, float *buffer);
-   void FillFirstHistoryWindow();
-   void ApplyFreqSmoothing(FloatVector &gains);
+   void ProcessBatch(Statistics &statistics, WaveTrack *outputTrack);
+   void RunStage(std::vector<Record*> &records, bool synthesize);
+   void FillFirstHistoryWindow(Record &record) const;
+   void ApplyFreqSmoothing(FloatVector &gains, FloatVector &scratch) const;
    void GatherStatistics(Statistics &statistics);
    inline bool Classify(const Statistics &statistics, int band);
-   void ReduceNoise(const Statistics &statistics, WaveTrack *outputTrack);
+   void ReduceNoise(const Statistics &statistics, sampleCount outStep);
+   void SynthesizeWindow(Record &record, FloatVector &scratch) const;
+   void OverlapAdd(const Record &record, WaveTrack *outputTrack);
    void RotateHistoryWindows();
    void FinishTrackStatistics(Statistics &statistics);
    void FinishTrack(Statistics &statistics, WaveTrack *outputTrack);
 
+   Record *NewRecord();
+   void FreeRecord(Record *record) { mFreeRecords.push_back(record); }
+
 private:
 
    const bool mDoProfile;
@@ -284,8 +303,8 @@ private:
 
    const int mWindowSize;
    // These have that size:
+   const FFTPlan *mPlan;
    HFFT     hFFT;
-   FloatVector mFFTBuffer;
    FloatVector mInWaveBuffer;
    FloatVector mOutOverlapBuffer;
    // These have that size, or 0:
@@ -293,7 +312,6 @@ private:
    FloatVector mOutWindow;
 
    const int mSpectrumSize;
-   FloatVector mFreqSmoothingScratch;
    const int mFreqSmoothingBins;
    // When spectral selection limits the affected band:
    int mBinLow;  // inclusive lower bound
@@ -321,11 +339,14 @@ private:
 
    struct Record
    {
-      Record(int spectrumSize)
+      Record(int windowSize, int spectrumSize)
          : mSpectrums(spectrumSize)
          , mGains(spectrumSize)
          , mRealFFTs(spectrumSize - 1)
          , mImagFFTs(spectrumSize - 1)
+         , mWave(windowSize)
+         , mOutStep(0)
+         , mAppend(false)
       {
       }
 
@@ -333,8 +354,58 @@ private:
       FloatVector mGains;
       FloatVector mRealFFTs;
       FloatVector mImagFFTs;
+
+      // The windowed input, transformed in place; then, after leaving the
+      // history, the inverse transform of the output
+      FloatVector mWave;
+      // mOutStepCount when the window was taken
+      sampleCount mOutStep;
+      // Whether the first step of its overlap-add is output
+      bool mAppend;
    };
+   // Front first; mQueue[0] is NULL between windows
    std::vector<Record*> mQueue;
+
+   // Windows taken but not yet transformed, and those that have left
+   // the history and wait for the inverse transform, in order
+   int mBatchSize;
+   std::vector<Record*> mPending;
+   std::vector<Record*> mOutputs;
+
+   std::vector<Record*> mRecords;   // owns them all
+   std::vector<Record*> mFreeRecords;
+};
+
+// Does one stage of a batch for a share of its records
+class EffectNoiseReduction::Worker::StageTask : public WorkerTask
+{
+public:
+   StageTask(const Worker &worker, std::vector<Record*> &records,
+             bool synthesize, int parts)
+      : mWorker(worker), mRecords(records)
+      , mSynthesize(synthesize), mParts(parts)
+   {
+   }
+
+   void Run(int index)
+   {
+      const int nn = mRecords.size();
+      const int first = (nn * index) / mParts;
+      const int end = (nn * (index + 1)) / mParts;
+      FloatVector scratch(mWorker.mSpectrumSize);
+      for (int ii = first; ii < end; ++ii) {
+         if (mSynthesize)
+            mWorker.SynthesizeWindow(*mRecords[ii], scratch);
+         else
+            mWorker.FillFirstHistoryWindow(*mRecords[ii]);
+      }
+   }
+
+private:
+   const Worker &mWorker;
+   std::vector<Record*> &mRecords;
+   const bool mSynthesize;
+   const int mParts;
 };
 
 /****************************************************************//**
@@ -636,9 +707,21 @@ bool EffectNoiseReduction::Process()
 
 EffectNoiseReduction::Worker::~Worker()
 {
-   EndFFT(hFFT);
-   for(int ii = 0, nn = mQueue.size(); ii < nn; ++ii)
-      delete mQueue[ii];
+   for(int ii = 0, nn = mRecords.size(); ii < nn; ++ii)
+      delete mRecords[ii];
+}
+
+EffectNoiseReduction::Worker::Record *EffectNoiseReduction::Worker::NewRecord()
+{
+   if (mFreeRecords.empty()) {
+      Record *record = new Record(mWindowSize, mSpectrumSize);
+      mRecords.push_back(record);
+      return record;
+   }
+
+   Record *record = mFreeRecords.back();
+   mFreeRecords.pop_back();
+   return record;
 }
 
 bool EffectNoiseReduction::Worker::Process
@@ -684,7 +767,8 @@ bool EffectNoiseReduction::Worker::Process
    return true;
 }
 
-void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
+void EffectNoiseReduction::Worker::ApplyFreqSmoothing
+(FloatVector &gains, FloatVector &scratch) const
 {
    // Given an array of gain mutipliers, average them
    // GEOMETRICALLY.  Don't multiply and take nth root --
@@ -693,25 +777,42 @@ void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
    if (mFreqSmoothingBins == 0)
       return;
 
-   {
-      float *pScratch = &mFreqSmoothingScratch[0];
-      std::fill(pScratch, pScratch + mSpectrumSize, 0.0f);
-   }
+   float *const pScratch = &scratch[0];
+   float *const pGains = &gains[0];
+   std::fill(pScratch, pScratch + mSpectrumSize, 0.0f);
 
    for (int ii = 0; ii < mSpectrumSize; ++ii)
-      gains[ii] = log(gains[ii]);
+      pGains[ii] = log(pGains[ii]);
 
+   // Bands whose neighborhood is cut off by either end
+   const int interiorBegin = std::min(mFreqSmoothingBins, mSpectrumSize);
+   const int interiorEnd =
+      std::max(interiorBegin, mSpectrumSize - mFreqSmoothingBins);
    for (int ii = 0; ii < mSpectrumSize; ++ii) {
+      if (ii == interiorBegin)
+         ii = interiorEnd;
+      if (ii == mSpectrumSize)
+         break;
       const int j0 = std::max(0, ii - mFreqSmoothingBins);
       const int j1 = std::min(mSpectrumSize - 1, ii + mFreqSmoothingBins);
       for(int jj = j0; jj <= j1; ++jj) {
-         mFreqSmoothingScratch[ii] += gains[jj];
+         pScratch[ii] += pGains[jj];
       }
-      mFreqSmoothingScratch[ii] /= (j1 - j0 + 1);
+      pScratch[ii] /= (j1 - j0 + 1);
+   }
+
+   // The rest, a neighbor at a time for all of them, which vectorizes;
+   // each band still sums its neighbors in the same order
+   const int count = 2 * mFreqSmoothingBins + 1;
+   for (int kk = -mFreqSmoothingBins; kk <= mFreqSmoothingBins; ++kk) {
+      for (int ii = interiorBegin; ii < interiorEnd; ++ii)
+         pScratch[ii] += pGains[ii + kk];
    }
+   for (int ii = interiorBegin; ii < interiorEnd; ++ii)
+      pScratch[ii] /= count;
 
    for (int ii = 0; ii < mSpectrumSize; ++ii)
-      gains[ii] = exp(mFreqSmoothingScratch[ii]);
+      pGains[ii] = exp(pScratch[ii]);
 }
 
 EffectNoiseReduction::Worker::Worker
@@ -725,15 +826,14 @@ EffectNoiseReduction::Worker::Worker
 , mSampleRate(sampleRate)
 
 , mWindowSize(settings.WindowSize())
-, hFFT(InitializeFFT(mWindowSize))
-, mFFTBuffer(mWindowSize)
+, mPlan(FFTPlanner::Get().GetPlan(mWindowSize))
+, hFFT(mPlan->GetTables())
 , mInWaveBuffer(mWindowSize)
 , mOutOverlapBuffer(mWindowSize)
 , mInWindow()
 , mOutWindow()
 
 , mSpectrumSize(1 + mWindowSize / 2)
-, mFreqSmoothingScratch(mSpectrumSize)
 , mFreqSmoothingBins(int(settings.mFreqSmoothingBands))
 , mBinLow(0)
 , mBinHigh(mSpectrumSize)
@@ -792,8 +892,11 @@ EffectNoiseReduction::Worker::Worker
    }
 
    mQueue.resize(mHistoryLen);
-   for (int ii = 0; ii < mHistoryLen; ++ii)
-      mQueue[ii] = new Record(mSpectrumSize);
+
+   // Enough windows for each thread to take several, but no more than
+   // about four megabytes of them
+   mBatchSize = std::max(4 * WorkerPool::Get().GetThreadCount(),
+                         (1 << 18) / mWindowSize);
 
    // Create windows
 
@@ -862,8 +965,15 @@ EffectNoiseReduction::Worker::Worker
 
 void EffectNoiseReduction::Worker::StartNewTrack()
 {
+   // Take back windows left by a cancelled track
+   mFreeRecords = mRecords;
+   mPending.clear();
+   mOutputs.clear();
+
    float *pFill;
-   for(int ii = 0; ii < mHistoryLen; ++ii) {
+   mQueue[0] = NULL;
+   for(int ii = 1; ii < mHistoryLen; ++ii) {
+      mQueue[ii] = NewRecord();
       Record &record = *mQueue[ii];
 
       pFill = &record.mSpectrums[0];
@@ -919,13 +1029,13 @@ void EffectNoiseReduction::Worker::ProcessSamples
       mInWavePos += avail;
 
       if (mInWavePos == mWindowSize) {
-         FillFirstHistoryWindow();
-         if (mDoProfile)
-            GatherStatistics(statistics);
-         else
-            ReduceNoise(statistics, outputTrack);
+         Record *record = NewRecord();
+         memmove(&record->mWave[0], &mInWaveBuffer[0], mWindowSize * sizeof(float));
+         record->mOutStep = mOutStepCount;
+         mPending.push_back(record);
+         if ((int)mPending.size() == mBatchSize)
+            ProcessBatch(statistics, outputTrack);
          ++mOutStepCount;
-         RotateHistoryWindows();
 
          // Rotate for overlap-add
          memmove(&mInWaveBuffer[0], &mInWaveBuffer[mStepSize],
@@ -935,17 +1045,55 @@ void EffectNoiseReduction::Worker::ProcessSamples
    }
 }
 
-void EffectNoiseReduction::Worker::FillFirstHistoryWindow()
+void EffectNoiseReduction::Worker::ProcessBatch
+(Statistics &statistics, WaveTrack *outputTrack)
+{
+   RunStage(mPending, false);
+
+   // Statistics and time smoothing go window by window
+   for (int ii = 0, nn = mPending.size(); ii < nn; ++ii) {
+      mQueue[0] = mPending[ii];
+      if (mDoProfile)
+         GatherStatistics(statistics);
+      else
+         ReduceNoise(statistics, mPending[ii]->mOutStep);
+      RotateHistoryWindows();
+   }
+   mPending.clear();
+
+   if (mOutputs.empty())
+      return;
+
+   RunStage(mOutputs, true);
+
+   for (int ii = 0, nn = mOutputs.size(); ii < nn; ++ii) {
+      OverlapAdd(*mOutputs[ii], outputTrack);
+      FreeRecord(mOutputs[ii]);
+   }
+   mOutputs.clear();
+}
+
+void EffectNoiseReduction::Worker::RunStage
+(std::vector<Record*> &records, bool synthesize)
+{
+   WorkerPool &pool = WorkerPool::Get();
+   const int parts =
+      std::min(int(records.size()), 4 * pool.GetThreadCount());
+   if (parts == 0)
+      return;
+
+   StageTask task(*this, records, synthesize, parts);
+   pool.Run(&task, parts);
+}
+
+void EffectNoiseReduction::Worker::FillFirstHistoryWindow(Record &record) const
 {
    // Transform samples to frequency domain, windowed as needed
+   float *const pFFTBuffer = &record.mWave[0];
    if (mInWindow.size() > 0)
       for (int ii = 0; ii < mWindowSize; ++ii)
-         mFFTBuffer[ii] = mInWaveBuffer[ii] * mInWindow[ii];
-   else
-      memmove(&mFFTBuffer[0], &mInWaveBuffer[0], mWindowSize * sizeof(float));
-   RealFFTf(&mFFTBuffer[0], hFFT);
-
-   Record &record = *mQueue[0];
+         pFFTBuffer[ii] = pFFTBuffer[ii] * mInWindow[ii];
+   mPlan->Forward(pFFTBuffer);
 
    // Store real and imaginary parts for later inverse FFT, and compute
    // power
@@ -957,16 +1105,16 @@ void EffectNoiseReduction::Worker::FillFirstHistoryWindow()
       const int last = mSpectrumSize - 1;
       for (int ii = 1; ii < last; ++ii) {
          const int kk = *pBitReversed++;
-         const float realPart = *pReal++ = mFFTBuffer[kk];
-         const float imagPart = *pImag++ = mFFTBuffer[kk + 1];
+         const float realPart = *pReal++ = pFFTBuffer[kk];
+         const float imagPart = *pImag++ = pFFTBuffer[kk + 1];
          *pPower++ = realPart * realPart + imagPart * imagPart;
       }
       // DC and Fs/2 bins need to be handled specially
-      const float dc = mFFTBuffer[0];
+      const float dc = pFFTBuffer[0];
       record.mRealFFTs[0] = dc;
       record.mSpectrums[0] = dc*dc;
 
-      const float nyquist = mFFTBuffer[1];
+      const float nyquist = pFFTBuffer[1];
       record.mImagFFTs[0] = nyquist; // For Fs/2, not really imaginary
       record.mSpectrums[last] = nyquist * nyquist;
    }
@@ -982,9 +1130,13 @@ void EffectNoiseReduction::Worker::FillFirstHistoryWindow()
 
 void EffectNoiseReduction::Worker::RotateHistoryWindows()
 {
+   // The last window leaves the history, to be output if ReduceNoise()
+   // put it in mOutputs
    Record *save = mQueue[mHistoryLen - 1];
+   if (mOutputs.empty() || mOutputs.back() != save)
+      FreeRecord(save);
    mQueue.pop_back();
-   mQueue.insert(mQueue.begin(), save);
+   mQueue.insert(mQueue.begin(), (Record *)NULL);
 }
 
 void EffectNoiseReduction::Worker::FinishTrackStatistics(Statistics &statistics)
@@ -1023,6 +1175,7 @@ void EffectNoiseReduction::Worker::FinishTrack
    while (mOutStepCount * mStepSize < mInSampleCount) {
       ProcessSamples(statistics, outputTrack, mStepSize, &empty[0]);
    }
+   ProcessBatch(statistics, outputTrack);
 }
 
 void EffectNoiseReduction::Worker::GatherStatistics(Statistics &statistics)
@@ -1132,7 +1285,7 @@ bool EffectNoiseReduction::Worker::Classify(const Statistics &statistics, int ba
 }
 
 void EffectNoiseReduction::Worker::ReduceNoise
-(const Statistics &statistics, WaveTrack *outputTrack)
+(const Statistics &statistics, sampleCount outStep)
 {
    // Raise the gain for elements in the center of the sliding history
    // or, if isolating noise, zero out the non-noise
@@ -1202,80 +1355,96 @@ void EffectNoiseReduction::Worker::ReduceNoise
    }
 
 
-   if (mOutStepCount >= -(mStepsPerWindow - 1)) {
-      Record &record = *mQueue[mHistoryLen - 1];  // end of the queue
-      const int last = mSpectrumSize - 1;
+   if (outStep >= -(mStepsPerWindow - 1)) {
+      // The end of the queue is done with; transform it back later
+      Record *record = mQueue[mHistoryLen - 1];
+      record->mAppend = outStep >= 0;
+      mOutputs.push_back(record);
+   }
+}
 
-      if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
-         // Apply frequency smoothing to output gain
-         // Gains are not less than mNoiseAttenFactor
-         ApplyFreqSmoothing(record.mGains);
+void EffectNoiseReduction::Worker::SynthesizeWindow
+(Record &record, FloatVector &scratch) const
+{
+   const int last = mSpectrumSize - 1;
+   float *const pFFTBuffer = &record.mWave[0];
 
-      // Apply gain to FFT
-      {
-         const float *pGain = &record.mGains[1];
-         const float *pReal = &record.mRealFFTs[1];
-         const float *pImag = &record.mImagFFTs[1];
-         float *pBuffer = &mFFTBuffer[2];
-         int nn = mSpectrumSize - 2;
-         if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
-            for (; nn--;) {
-               // Subtract the gain we would otherwise apply from 1, and
-               // negate that to flip the phase.
-               const double gain = *pGain++ - 1.0;
-               *pBuffer++ = *pReal++ * gain;
-               *pBuffer++ = *pImag++ * gain;
-            }
-            mFFTBuffer[0] = record.mRealFFTs[0] * (record.mGains[0] - 1.0);
-            // The Fs/2 component is stored as the imaginary part of the DC component
-            mFFTBuffer[1] = record.mImagFFTs[0] * (record.mGains[last] - 1.0);
-         }
-         else {
-            for (; nn--;) {
-               const double gain = *pGain++;
-               *pBuffer++ = *pReal++ * gain;
-               *pBuffer++ = *pImag++ * gain;
-            }
-            mFFTBuffer[0] = record.mRealFFTs[0] * record.mGains[0];
-            // The Fs/2 component is stored as the imaginary part of the DC component
-            mFFTBuffer[1] = record.mImagFFTs[0] * record.mGains[last];
-         }
-      }
+   if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
+      // Apply frequency smoothing to output gain
+      // Gains are not less than mNoiseAttenFactor
+      ApplyFreqSmoothing(record.mGains, scratch);
 
-      // Invert the FFT into the output buffer
-      InverseRealFFTf(&mFFTBuffer[0], hFFT);
-
-      // Overlap-add
-      if (mOutWindow.size() > 0) {
-         float *pOut = &mOutOverlapBuffer[0];
-         float *pWindow = &mOutWindow[0];
-         int *pBitReversed = &hFFT->BitReversed[0];
-         for (int jj = 0; jj < last; ++jj) {
-            int kk = *pBitReversed++;
-            *pOut++ += mFFTBuffer[kk] * (*pWindow++);
-            *pOut++ += mFFTBuffer[kk + 1] * (*pWindow++);
+   // Apply gain to FFT
+   {
+      const float *pGain = &record.mGains[1];
+      const float *pReal = &record.mRealFFTs[1];
+      const float *pImag = &record.mImagFFTs[1];
+      float *pBuffer = &pFFTBuffer[2];
+      int nn = mSpectrumSize - 2;
+      if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
+         for (; nn--;) {
+            // Subtract the gain we would otherwise apply from 1, and
+            // negate that to flip the phase.
+            const double gain = *pGain++ - 1.0;
+            *pBuffer++ = *pReal++ * gain;
+            *pBuffer++ = *pImag++ * gain;
          }
+         pFFTBuffer[0] = record.mRealFFTs[0] * (record.mGains[0] - 1.0);
+         // The Fs/2 component is stored as the imaginary part of the DC component
+         pFFTBuffer[1] = record.mImagFFTs[0] * (record.mGains[last] - 1.0);
       }
       else {
-         float *pOut = &mOutOverlapBuffer[0];
-         int *pBitReversed = &hFFT->BitReversed[0];
-         for (int jj = 0; jj < last; ++jj) {
-            int kk = *pBitReversed++;
-            *pOut++ += mFFTBuffer[kk];
-            *pOut++ += mFFTBuffer[kk + 1];
+         for (; nn--;) {
+            const double gain = *pGain++;
+            *pBuffer++ = *pReal++ * gain;
+            *pBuffer++ = *pImag++ * gain;
          }
+         pFFTBuffer[0] = record.mRealFFTs[0] * record.mGains[0];
+         // The Fs/2 component is stored as the imaginary part of the DC component
+         pFFTBuffer[1] = record.mImagFFTs[0] * record.mGains[last];
       }
+   }
+
+   // Invert the FFT in place
+   mPlan->Inverse(pFFTBuffer);
+}
 
-      float *buffer = &mOutOverlapBuffer[0];
-      if (mOutStepCount >= 0) {
-         // Output the first portion of the overlap buffer, they're done
-         outputTrack->Append((samplePtr)buffer, floatSample, mStepSize);
+void EffectNoiseReduction::Worker::OverlapAdd
+(const Record &record, WaveTrack *outputTrack)
+{
+   const int last = mSpectrumSize - 1;
+   const float *const pFFTBuffer = &record.mWave[0];
+
+   // Overlap-add
+   if (mOutWindow.size() > 0) {
+      float *pOut = &mOutOverlapBuffer[0];
+      float *pWindow = &mOutWindow[0];
+      int *pBitReversed = &hFFT->BitReversed[0];
+      for (int jj = 0; jj < last; ++jj) {
+         int kk = *pBitReversed++;
+         *pOut++ += pFFTBuffer[kk] * (*pWindow++);
+         *pOut++ += pFFTBuffer[kk + 1] * (*pWindow++);
+      }
+   }
+   else {
+      float *pOut = &mOutOverlapBuffer[0];
+      int *pBitReversed = &hFFT->BitReversed[0];
+      for (int jj = 0; jj < last; ++jj) {
+         int kk = *pBitReversed++;
+         *pOut++ += pFFTBuffer[kk];
+         *pOut++ += pFFTBuffer[kk + 1];
       }
+   }
 
-      // Shift the remainder over.
-      memmove(buffer, buffer + mStepSize, sizeof(float)*(mWindowSize - mStepSize));
-      std::fill(buffer + mWindowSize - mStepSize, buffer + mWindowSize, 0.0f);
+   float *buffer = &mOutOverlapBuffer[0];
+   if (record.mAppend) {
+      // Output the first portion of the overlap buffer, they're done
+      outputTrack->Append((samplePtr)buffer, floatSample, mStepSize);
    }
+
+   // Shift the remainder over.
+   memmove(buffer, buffer + mStepSize, sizeof(float)*(mWindowSize - mStepSize));
+   std::fill(buffer + mWindowSize - mStepSize, buffer + mWindowSize, 0.0f);
 }
 
 bool EffectNoiseReduction::Worker::ProcessOne
@@ -1314,8 +1483,10 @@ bool EffectNoiseReduction::Worker::ProcessOne
    }
 
    if (bLoopSuccess) {
-      if (mDoProfile)
+      if (mDoProfile) {
+         ProcessBatch(statistics, NULL);
          FinishTrackStatistics(statistics);
+      }
       else
          FinishTrack(statistics, &*outputTrack);
    }
@@ -218,6 +218,11 @@ bool EffectPhaser::SetAutomationParameters(EffectAutomationParameters & parms)
 
 // Effect implementation
 
+Effect *EffectPhaser::NewProcessor()
+{
+   return new EffectPhaser();
+}
+
 void EffectPhaser::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -55,6 +55,7 @@ public:
 
    // Effect implementation
 
+   Effect *NewProcessor();
    void PopulateOrExchange(ShuttleGui & S);
    bool TransferDataToWindow();
    bool TransferDataFromWindow();
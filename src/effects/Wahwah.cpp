@@ -208,6 +208,11 @@ bool EffectWahwah::SetAutomationParameters(EffectAutomationParameters & parms)
 
 // Effect implementation
 
+Effect *EffectWahwah::NewProcessor()
+{
+   return new EffectWahwah();
+}
+
 void EffectWahwah::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
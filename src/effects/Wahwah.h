@@ -53,6 +53,7 @@ public:
 
    // Effect implementation
 
+   virtual Effect *NewProcessor();
    virtual void PopulateOrExchange(ShuttleGui & S);
    virtual bool TransferDataToWindow();
    virtual bool TransferDataFromWindow();
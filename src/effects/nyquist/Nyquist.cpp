@@ -1566,7 +1566,7 @@ int NyquistEffect::GetCallback(float *buffer, int ch,
       if ((mCurStart[ch] + start) < mCurBufferStart[ch] ||
           (mCurStart[ch] + start)+len >
           mCurBufferStart[ch]+mCurBufferLen[ch]) {
-         delete[] mCurBuffer[ch];
+         DeleteSamples(mCurBuffer[ch]);
          mCurBuffer[ch] = NULL;
       }
    }
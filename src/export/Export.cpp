@@ -273,12 +273,14 @@ Mixer* ExportPlugin::CreateMixer(int numInputTracks, WaveTrack **inputTracks,
          bool highQuality, MixerSpec *mixerSpec)
 {
    // MB: the stop time should not be warped, this was a bug.
-   return new Mixer(numInputTracks, inputTracks,
+   Mixer *mixer = new Mixer(numInputTracks, inputTracks,
                   Mixer::WarpOptions(timeTrack),
                   startTime, stopTime,
                   numOutChannels, outBufferSize, outInterleaved,
                   outRate, outFormat,
                   highQuality, mixerSpec);
+   mixer->SetParallel(true);
+   return mixer;
 }
 //----------------------------------------------------------------------------
 // Export
@@ -349,28 +349,12 @@ ExtImportItem *Importer::CreateDefaultImportItem()
    return new_item;
 }
 
-// returns number of tracks imported
-int Importer::Import(wxString fName,
-                     TrackFactory *trackFactory,
-                     Track *** tracks,
-                     Tags *tags,
-                     wxString &errorMessage)
+// Fills importPlugins with the plug-ins to try on fName, in the order to try them
+void Importer::GetPluginsForFile(const wxString &fName, ImportPluginList &importPlugins)
 {
-   AudacityProject *pProj = GetActiveProject();
-   pProj->mbBusyImporting = true;
-
-   ImportFileHandle *inFile = NULL;
-   int numTracks = 0;
-
    wxString extension = fName.AfterLast(wxT('.'));
-
-   // This list is used to call plugins in correct order
-   ImportPluginList importPlugins;
    ImportPluginList::compatibility_iterator importPluginNode;
 
-   // This list is used to remember plugins that should have been compatible with the file.
-   ImportPluginList compatiblePlugins;
-
    // If user explicitly selected a filter,
    // then we should try importing via corresponding plugin first
    wxString type = gPrefs->Read(wxT("/LastOpenType"),wxT(""));
@@ -523,6 +507,50 @@ int Importer::Import(wxString fName,
 
       importPluginNode = importPluginNode->GetNext();
    }
+}
+
+// Opens fName with the first plug-in that takes it, in the order that
+// Import() tries them.  Returns NULL if none does.
+ImportFileHandle *Importer::Open(const wxString &fName)
+{
+   ImportPluginList importPlugins;
+   GetPluginsForFile(fName, importPlugins);
+
+   ImportPluginList::compatibility_iterator importPluginNode = importPlugins.GetFirst();
+   while(importPluginNode)
+   {
+      ImportFileHandle *inFile = importPluginNode->GetData()->Open(fName);
+      if (inFile != NULL && inFile->GetStreamCount() > 0)
+         return inFile;
+      delete inFile;
+      importPluginNode = importPluginNode->GetNext();
+   }
+   return NULL;
+}
+
+// returns number of tracks imported
+int Importer::Import(wxString fName,
+                     TrackFactory *trackFactory,
+                     Track *** tracks,
+                     Tags *tags,
+                     wxString &errorMessage)
+{
+   AudacityProject *pProj = GetActiveProject();
+   pProj->mbBusyImporting = true;
+
+   ImportFileHandle *inFile = NULL;
+   int numTracks = 0;
+
+   wxString extension = fName.AfterLast(wxT('.'));
+
+   // This list is used to call plugins in correct order
+   ImportPluginList importPlugins;
+   ImportPluginList::compatibility_iterator importPluginNode;
+
+   // This list is used to remember plugins that should have been compatible with the file.
+   ImportPluginList compatiblePlugins;
+
+   GetPluginsForFile(fName, importPlugins);
 
    importPluginNode = importPlugins.GetFirst();
    while(importPluginNode)
@@ -146,7 +146,16 @@ public:
               Tags *tags,
               wxString &errorMessage);
 
+   /**
+    * Opens fName with the first plug-in that recognizes it, without
+    * importing it.  Returns NULL if none does; the caller deletes the
+    * handle.
+    */
+   ImportFileHandle *Open(const wxString &fName);
+
 private:
+   void GetPluginsForFile(const wxString &fName, ImportPluginList &importPlugins);
+
    static Importer mInstance;
 
    ExtImportItems *mExtImportItems;
@@ -94,8 +94,6 @@ extern "C" {
 #endif
 
 
-//#define EXPERIMENTAL_OD_FLAC
-
 class FLACImportFileHandle;
 
 class MyFLACFile : public FLAC::Decoder::File
@@ -174,7 +172,7 @@ private:
    bool                  mStreamInfoDone;
    int                   mUpdateResult;
    WaveTrack           **mChannels;
-   ODDecodeFlacTask     *mDecoderTask;
+   ODDecodeFlacTask     *mDecoderTask; //NULL unless decoding on demand
 };
 
 
@@ -338,34 +336,28 @@ FLACImportFileHandle::FLACImportFileHandle(const wxString & name)
    mFormat = (sampleFormat)
       gPrefs->Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);
    mFile = new MyFLACFile(this);
+   mDecoderTask = NULL;
 }
 
 bool FLACImportFileHandle::Init()
 {
-#ifdef EXPERIMENTAL_OD_FLAC
-   mDecoderTask=new ODDecodeFlacTask;
-
-   ODFlacDecoder* odDecoder = (ODFlacDecoder*)mDecoderTask->CreateFileDecoder(mFilename);
-   if(!odDecoder || !odDecoder->ReadHeader())
+   //The blocks are decoded later by an ODDecodeFlacTask, if it can read the file.
+   //Normalizing on load would see silence, so it needs the samples now.
+   if (gPrefs->Read(wxT("/FileFormats/DecodeCompressedOnDemand"), true) &&
+       !gPrefs->Read(wxT("/AudioFiles/NormalizeOnLoad"), 0L))
    {
-      //delete the task only if it failed to read - otherwise the OD man takes care of it.
-      delete mDecoderTask;
-      return false;
-   }
-   //copy the meta data over to the class
-
-   mSampleRate=odDecoder->mSampleRate;
-   mNumChannels=odDecoder->mNumChannels;
-   mBitsPerSample=odDecoder->mBitsPerSample;
-
-   mNumSamples=odDecoder->mNumSamples;
-   mBitsPerSample=odDecoder->mBitsPerSample;
-   mFormat=odDecoder->mFormat;
-   mStreamInfoDone=true;
+      mDecoderTask=new ODDecodeFlacTask;
 
+      ODFlacDecoder* odDecoder = (ODFlacDecoder*)mDecoderTask->CreateFileDecoder(mFilename);
+      if(!odDecoder || !odDecoder->ReadHeader())
+      {
+         //decode the whole file now instead.
+         delete mDecoderTask;
+         mDecoderTask = NULL;
+      }
+   }
 
-   return true;
-#endif
+   //the metadata is read here either way, for the stream info and the tags.
 #ifdef LEGACY_FLAC
    bool success = mFile->set_filename(OSINPUT(mFilename));
    if (!success) {
@@ -462,15 +454,14 @@ int FLACImportFileHandle::Import(TrackFactory *trackFactory,
 
 
 //Start OD
-   bool useOD = false;
-#ifdef EXPERIMENTAL_OD_FLAC
-   useOD=true;
-#endif
+   bool useOD = mDecoderTask != NULL;
 
    // TODO: Vigilant Sentry: Variable res unused after assignment (error code DA1)
    //    Should check the result.
    #ifdef LEGACY_FLAC
-      bool res = (mFile->process_until_end_of_file() != 0);
+      bool res = true;
+      if(!useOD)
+         res = (mFile->process_until_end_of_file() != 0);
    #else
       bool res = true;
       if(!useOD)
@@ -495,20 +486,26 @@ int FLACImportFileHandle::Import(TrackFactory *trackFactory,
             break;
       }
 
-      bool moreThanStereo = mNumChannels>2;
-      for (c = 0; c < mNumChannels; c++)
+      //the tracks are deleted below if the user cancelled, so the task must not run.
+      if (mUpdateResult != eProgressFailed && mUpdateResult != eProgressCancelled)
       {
-         mDecoderTask->AddWaveTrack(mChannels[c]);
-         if(moreThanStereo)
+         bool moreThanStereo = mNumChannels>2;
+         for (c = 0; c < mNumChannels; c++)
          {
-            //if we have 3 more channels, they get imported on seperate tracks, so we add individual tasks for each.
-            ODManager::Instance()->AddNewTask(mDecoderTask);
-            mDecoderTask=new ODDecodeFlacTask; //TODO: see if we need to use clone to keep the metadata.
+            mDecoderTask->AddWaveTrack(mChannels[c]);
+            if(moreThanStereo)
+            {
+               //if we have 3 more channels, they get imported on seperate tracks, so we add individual tasks for each.
+               ODManager::Instance()->AddNewTask(mDecoderTask);
+               mDecoderTask = c + 1 < mNumChannels ? new ODDecodeFlacTask : NULL;
+            }
          }
+         //if we have mono or a linked track (stereo), we add ONE task for the one linked wave track
+         if(!moreThanStereo)
+            ODManager::Instance()->AddNewTask(mDecoderTask);
+         //the ODManager owns the tasks now.
+         mDecoderTask = NULL;
       }
-      //if we have mono or a linked track (stereo), we add ONE task for the one linked wave track
-      if(!moreThanStereo)
-         ODManager::Instance()->AddNewTask(mDecoderTask);
    }
 //END OD
 
@@ -550,11 +547,10 @@ int FLACImportFileHandle::Import(TrackFactory *trackFactory,
 
 FLACImportFileHandle::~FLACImportFileHandle()
 {
-   //don't delete mFile if we are using OD.
-#ifndef EXPERIMENTAL_OD_FLAC
    mFile->finish();
    delete mFile;
-#endif
+   //only set if the task was not handed to the ODManager.
+   delete mDecoderTask;
 }
 
 #endif /* USE_LIBFLAC */
@@ -84,6 +84,8 @@ extern "C" {
 }
 
 #include "../WaveTrack.h"
+#include "../ondemand/ODDecodeMP3Task.h"
+#include "../ondemand/ODManager.h"
 
 #define INPUT_BUFFER_SIZE 65535
 #define PROGRESS_SCALING_FACTOR 100000
@@ -142,6 +144,12 @@ public:
 private:
    void ImportID3(Tags *tags);
 
+   /// Makes tracks of blocks that an ODDecodeMP3Task decodes later.
+   /// Returns false, having made nothing, if libmad finds no frames to
+   /// index, so that the file is decoded now instead.
+   bool ImportOnDemand(TrackFactory *trackFactory, Track ***outTracks,
+                       int *outNumTracks, int *result);
+
    wxFile *mFile;
    void *mUserData;
    struct private_data mPrivateData;
@@ -209,6 +217,17 @@ int MP3ImportFileHandle::Import(TrackFactory *trackFactory, Track ***outTracks,
 
    CreateProgress();
 
+   // Normalizing on load would see silence, so it needs the samples now
+   if (gPrefs->Read(wxT("/FileFormats/DecodeCompressedOnDemand"), true) &&
+       !gPrefs->Read(wxT("/AudioFiles/NormalizeOnLoad"), 0L)) {
+      int result;
+      if (ImportOnDemand(trackFactory, outTracks, outNumTracks, &result)) {
+         if (result != eProgressFailed && result != eProgressCancelled)
+            ImportID3(tags);
+         return result;
+      }
+   }
+
    /* Prepare decoder data, initialize decoder */
 
    mPrivateData.file        = mFile;
@@ -265,6 +284,75 @@ int MP3ImportFileHandle::Import(TrackFactory *trackFactory, Track ***outTracks,
       return mPrivateData.updateResult;
    }
 
+bool MP3ImportFileHandle::ImportOnDemand(TrackFactory *trackFactory, Track ***outTracks,
+                                         int *outNumTracks, int *result)
+{
+   ODDecodeMP3Task *task = new ODDecodeMP3Task;
+   ODMP3Decoder *decoder = (ODMP3Decoder *)task->CreateFileDecoder(mFilename);
+   if (!decoder->ReadHeader() || decoder->GetNumChannels() == 0) {
+      delete task;
+      return false;
+   }
+
+   int numChannels = decoder->GetNumChannels();
+   sampleCount length = decoder->GetLength();
+   int chn;
+
+   sampleFormat format = (sampleFormat) gPrefs->
+      Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);
+
+   WaveTrack **channels = new WaveTrack* [numChannels];
+   for(chn = 0; chn < numChannels; chn++) {
+      channels[chn] = trackFactory->NewWaveTrack(format, decoder->GetSampleRate());
+      channels[chn]->SetChannel(Track::MonoChannel);
+   }
+
+   /* special case: 2 channels is understood to be stereo */
+   if(numChannels == 2) {
+      channels[0]->SetChannel(Track::LeftChannel);
+      channels[1]->SetChannel(Track::RightChannel);
+      channels[0]->SetLinked(true);
+   }
+
+   *result = eProgressSuccess;
+   sampleCount maxBlockSize = channels[0]->GetMaxBlockSize();
+   for (sampleCount i = 0; i < length; i += maxBlockSize) {
+      sampleCount blockLen = maxBlockSize;
+      if (i + blockLen > length)
+         blockLen = length - i;
+
+      for (chn = 0; chn < numChannels; chn++)
+         channels[chn]->AppendCoded(mFilename, i, blockLen, chn, ODTask::eODMP3);
+
+      *result = mProgress->Update(i, length);
+      if (*result != eProgressSuccess)
+         break;
+   }
+
+   if (*result == eProgressFailed || *result == eProgressCancelled) {
+      for (chn = 0; chn < numChannels; chn++)
+         delete channels[chn];
+      delete[] channels;
+      delete task;
+      return true;
+   }
+
+   // MP3 has at most two channels, so one task serves the track
+   for (chn = 0; chn < numChannels; chn++)
+      task->AddWaveTrack(channels[chn]);
+   ODManager::Instance()->AddNewTask(task);
+
+   *outNumTracks = numChannels;
+   *outTracks = new Track* [numChannels];
+   for (chn = 0; chn < numChannels; chn++) {
+      channels[chn]->Flush();
+      (*outTracks)[chn] = channels[chn];
+   }
+   delete[] channels;
+
+   return true;
+}
+
 MP3ImportFileHandle::~MP3ImportFileHandle()
 {
    if(mFile) {
@@ -78,6 +78,8 @@ void GetOGGImportPlugin(ImportPluginList *importPluginList,
 #include <vorbis/vorbisfile.h>
 
 #include "../WaveTrack.h"
+#include "../ondemand/ODDecodeOggTask.h"
+#include "../ondemand/ODManager.h"
 #include "ImportPlugin.h"
 
 class OggImportPlugin : public ImportPlugin
@@ -127,6 +129,11 @@ public:
    int Import(TrackFactory *trackFactory, Track ***outTracks,
               int *outNumTracks, Tags *tags);
 
+   /// Fills the tracks of a single, seekable stream with blocks that
+   /// ODDecodeOggTasks decode later.  Returns false, having appended
+   /// nothing, if the file should be decoded now instead.
+   bool ImportOnDemand(int *result);
+
    wxInt32 GetStreamCount()
    {
       if (mVorbisFile)
@@ -281,78 +288,81 @@ int OggImportFileHandle::Import(TrackFactory *trackFactory, Track ***outTracks,
  * Balance between responsiveness of the GUI and throughput of import. */
 #define SAMPLES_PER_CALLBACK 100000
 
-   short *mainBuffer = new short[CODEC_TRANSFER_SIZE];
-
-   /* determine endianness (clever trick courtesy of Nicholas Devillard,
-    * (http://www.eso.org/~ndevilla/endian/) */
-   int testvar = 1, endian;
-   if(*(char *)&testvar)
-      endian = 0;  // little endian
-   else
-      endian = 1;  // big endian
-
-   /* number of samples currently in each channel's buffer */
    int updateResult = eProgressSuccess;
    long bytesRead = 0;
-   long samplesRead = 0;
-   int bitstream = 0;
-   int samplesSinceLastCallback = 0;
-
-   // You would think that the stream would already be seeked to 0, and
-   // indeed it is if the file is legit.  But I had several ogg files on
-   // my hard drive that have malformed headers, and this added call
-   // causes them to be read correctly.  Otherwise they have lots of
-   // zeros inserted at the beginning
-   ov_pcm_seek(mVorbisFile, 0);
-
-   do {
-      /* get data from the decoder */
-      bytesRead = ov_read(mVorbisFile, (char *) mainBuffer,
-                          CODEC_TRANSFER_SIZE,
-                          endian,
-                          2,    // word length (2 for 16 bit samples)
-                          1,    // signed
-                          &bitstream);
-
-      if (bytesRead == OV_HOLE) {
-         wxFileName f(mFilename);
-         wxLogError(wxT("Ogg Vorbis importer: file %s is malformed, ov_read() reported a hole"),
-                    f.GetFullName().c_str());
-         /* http://lists.xiph.org/pipermail/vorbis-dev/2001-February/003223.html
-          * is the justification for doing this - best effort for malformed file,
-          * hence the message.
-          */
-         continue;
-      } else if (bytesRead < 0) {
-         /* Malformed Ogg Vorbis file. */
-         /* TODO: Return some sort of meaningful error. */
-         wxLogError(wxT("Ogg Vorbis importer: ov_read() returned error %i"),
-                    bytesRead);
-         break;
-      }
 
-      samplesRead = bytesRead / mVorbisFile->vi[bitstream].channels / sizeof(short);
+   if (!ImportOnDemand(&updateResult)) {
+      short *mainBuffer = new short[CODEC_TRANSFER_SIZE];
 
-      /* give the data to the wavetracks */
-      if (mStreamUsage[bitstream] != 0)
-      {
-         for (c = 0; c < mVorbisFile->vi[bitstream].channels; c++)
-            mChannels[bitstream][c]->Append((char *)(mainBuffer + c),
-            int16Sample,
-            samplesRead,
-            mVorbisFile->vi[bitstream].channels);
-      }
+      /* determine endianness (clever trick courtesy of Nicholas Devillard,
+       * (http://www.eso.org/~ndevilla/endian/) */
+      int testvar = 1, endian;
+      if(*(char *)&testvar)
+         endian = 0;  // little endian
+      else
+         endian = 1;  // big endian
+
+      /* number of samples currently in each channel's buffer */
+      long samplesRead = 0;
+      int bitstream = 0;
+      int samplesSinceLastCallback = 0;
+
+      // You would think that the stream would already be seeked to 0, and
+      // indeed it is if the file is legit.  But I had several ogg files on
+      // my hard drive that have malformed headers, and this added call
+      // causes them to be read correctly.  Otherwise they have lots of
+      // zeros inserted at the beginning
+      ov_pcm_seek(mVorbisFile, 0);
+
+      do {
+         /* get data from the decoder */
+         bytesRead = ov_read(mVorbisFile, (char *) mainBuffer,
+                             CODEC_TRANSFER_SIZE,
+                             endian,
+                             2,    // word length (2 for 16 bit samples)
+                             1,    // signed
+                             &bitstream);
+
+         if (bytesRead == OV_HOLE) {
+            wxFileName f(mFilename);
+            wxLogError(wxT("Ogg Vorbis importer: file %s is malformed, ov_read() reported a hole"),
+                       f.GetFullName().c_str());
+            /* http://lists.xiph.org/pipermail/vorbis-dev/2001-February/003223.html
+             * is the justification for doing this - best effort for malformed file,
+             * hence the message.
+             */
+            continue;
+         } else if (bytesRead < 0) {
+            /* Malformed Ogg Vorbis file. */
+            /* TODO: Return some sort of meaningful error. */
+            wxLogError(wxT("Ogg Vorbis importer: ov_read() returned error %i"),
+                       bytesRead);
+            break;
+         }
 
-      samplesSinceLastCallback += samplesRead;
-      if (samplesSinceLastCallback > SAMPLES_PER_CALLBACK) {
-          updateResult = mProgress->Update(ov_time_tell(mVorbisFile),
-                                         ov_time_total(mVorbisFile, bitstream));
-          samplesSinceLastCallback -= SAMPLES_PER_CALLBACK;
+         samplesRead = bytesRead / mVorbisFile->vi[bitstream].channels / sizeof(short);
 
-      }
-   } while (updateResult == eProgressSuccess && bytesRead != 0);
+         /* give the data to the wavetracks */
+         if (mStreamUsage[bitstream] != 0)
+         {
+            for (c = 0; c < mVorbisFile->vi[bitstream].channels; c++)
+               mChannels[bitstream][c]->Append((char *)(mainBuffer + c),
+               int16Sample,
+               samplesRead,
+               mVorbisFile->vi[bitstream].channels);
+         }
 
-   delete[]mainBuffer;
+         samplesSinceLastCallback += samplesRead;
+         if (samplesSinceLastCallback > SAMPLES_PER_CALLBACK) {
+             updateResult = mProgress->Update(ov_time_tell(mVorbisFile),
+                                            ov_time_total(mVorbisFile, bitstream));
+             samplesSinceLastCallback -= SAMPLES_PER_CALLBACK;
+
+         }
+      } while (updateResult == eProgressSuccess && bytesRead != 0);
+
+      delete[]mainBuffer;
+   }
 
    int res = updateResult;
    if (bytesRead < 0)
@@ -363,7 +373,7 @@ int OggImportFileHandle::Import(TrackFactory *trackFactory, Track ***outTracks,
       {
          if (mChannels[i])
          {
-            for(c = 0; c < mVorbisFile->vi[bitstream].channels; c++) {
+            for(c = 0; c < mVorbisFile->vi[i].channels; c++) {
                if (mChannels[i][c])
                   delete mChannels[i][c];
             }
@@ -417,6 +427,68 @@ int OggImportFileHandle::Import(TrackFactory *trackFactory, Track ***outTracks,
    return res;
 }
 
+bool OggImportFileHandle::ImportOnDemand(int *result)
+{
+   // Normalizing on load would see silence, so it needs the samples now.
+   // Chained files are decoded now, as the user may have left out streams.
+   if (!gPrefs->Read(wxT("/FileFormats/DecodeCompressedOnDemand"), true) ||
+       gPrefs->Read(wxT("/AudioFiles/NormalizeOnLoad"), 0L) ||
+       mVorbisFile->links != 1 || mStreamUsage[0] == 0 ||
+       !ov_seekable(mVorbisFile))
+      return false;
+
+   ODDecodeOggTask *task = new ODDecodeOggTask;
+   ODOggDecoder *decoder = (ODOggDecoder *)task->CreateFileDecoder(mFilename);
+   if (!decoder->ReadHeader()) {
+      delete task;
+      return false;
+   }
+
+   int numChannels = mVorbisFile->vi[0].channels;
+   WaveTrack **channels = mChannels[0];
+   sampleCount length = decoder->GetLength();
+   int c;
+
+   *result = eProgressSuccess;
+   sampleCount maxBlockSize = channels[0]->GetMaxBlockSize();
+   for (sampleCount i = 0; i < length; i += maxBlockSize) {
+      sampleCount blockLen = maxBlockSize;
+      if (i + blockLen > length)
+         blockLen = length - i;
+
+      for (c = 0; c < numChannels; c++)
+         channels[c]->AppendCoded(mFilename, i, blockLen, c, ODTask::eODOGG);
+
+      *result = mProgress->Update(i, length);
+      if (*result != eProgressSuccess)
+         break;
+   }
+
+   // Import() deletes the tracks, so the tasks must not run
+   if (*result == eProgressFailed || *result == eProgressCancelled) {
+      delete task;
+      return true;
+   }
+
+   // Mono and stereo make one track with one task; more channels are
+   // imported as separate tracks, each with a task of its own.
+   if (numChannels <= 2) {
+      for (c = 0; c < numChannels; c++)
+         task->AddWaveTrack(channels[c]);
+      ODManager::Instance()->AddNewTask(task);
+   }
+   else {
+      for (c = 0; c < numChannels; c++) {
+         if (c > 0)
+            task = new ODDecodeOggTask;
+         task->AddWaveTrack(channels[c]);
+         ODManager::Instance()->AddNewTask(task);
+      }
+   }
+
+   return true;
+}
+
 OggImportFileHandle::~OggImportFileHandle()
 {
    ov_clear(mVorbisFile);
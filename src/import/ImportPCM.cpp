@@ -101,10 +101,13 @@ public:
 
    void SetStreamUsage(wxInt32 WXUNUSED(StreamID), bool WXUNUSED(Use)){}
 
+   bool PrepareBackgroundImport(bool *cancelled);
+
 private:
    SNDFILE              *mFile;
    SF_INFO               mInfo;
    sampleFormat          mFormat;
+   wxString              mCopyEdit;   // asked before a background import
 };
 
 void GetPCMImportPlugin(ImportPluginList * importPluginList,
@@ -307,6 +310,17 @@ How do you want to import the current file(s)?"), oldCopyPref == wxT("copy") ? _
    return oldCopyPref;
 }
 
+// Asks about copying now, since the import runs where no dialog can be shown
+bool PCMImportFileHandle::PrepareBackgroundImport(bool *cancelled)
+{
+   mCopyEdit = AskCopyOrEdit();
+   if (mCopyEdit == wxT("cancel")) {
+      *cancelled = true;
+      return false;
+   }
+   return true;
+}
+
 int PCMImportFileHandle::Import(TrackFactory *trackFactory,
                                 Track ***outTracks,
                                 int *outNumTracks,
@@ -315,7 +329,9 @@ int PCMImportFileHandle::Import(TrackFactory *trackFactory,
    wxASSERT(mFile);
 
    // Get the preference / warn the user about aliased files.
-   wxString copyEdit = AskCopyOrEdit();
+   wxString copyEdit = mCopyEdit;
+   if (copyEdit.IsEmpty())
+      copyEdit = AskCopyOrEdit();
 
    if (copyEdit == wxT("cancel"))
       return eProgressCancelled;
@@ -381,13 +397,13 @@ int PCMImportFileHandle::Import(TrackFactory *trackFactory,
             channels[c]->AppendAlias(mFilename, i, blockLen, c,useOD);
 
          if (++updateCounter == 50) {
-            updateResult = mProgress->Update(i, fileTotalFrames);
+            updateResult = UpdateProgress(i, fileTotalFrames);
             updateCounter = 0;
             if (updateResult != eProgressSuccess)
                break;
          }
       }
-      updateResult = mProgress->Update(fileTotalFrames, fileTotalFrames);
+      updateResult = UpdateProgress(fileTotalFrames, fileTotalFrames);
 
       if(useOD)
       {
@@ -447,8 +463,8 @@ int PCMImportFileHandle::Import(TrackFactory *trackFactory,
             framescompleted += block;
          }
 
-         updateResult = mProgress->Update((long long unsigned)framescompleted,
-                                        (long long unsigned)fileTotalFrames);
+         updateResult = UpdateProgress((long long unsigned)framescompleted,
+                                       (long long unsigned)fileTotalFrames);
          if (updateResult != eProgressSuccess)
             break;
 
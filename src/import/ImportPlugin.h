@@ -27,6 +27,13 @@ Gives API for sound file import.
 
 *//****************************************************************//**
 
+\class ImportProgress
+\brief Stands in for the progress dialog of an ImportFileHandle that
+imports on a worker thread.  The importer reports how far it has got,
+and the thread showing the dialog hands back the user's answer.
+
+*//****************************************************************//**
+
 \class ImportPlugin
 \brief Base class for FlacImportPlugin, LOFImportPlugin,
 MP3ImportPlugin, OggImportPlugin and PCMImportPlugin.
@@ -61,6 +68,7 @@ but little else.
 #include <wx/list.h>
 
 #include "../widgets/ProgressDialog.h"
+#include "../ondemand/ODTaskThread.h"
 
 class TrackFactory;
 class Track;
@@ -68,6 +76,45 @@ class Tags;
 
 class ImportFileHandle;
 
+class ImportProgress
+{
+public:
+   ImportProgress()
+   :  mFraction(0.0),
+   mResult(eProgressSuccess)
+   {
+   }
+
+   // Called by the importer, like ProgressDialog::Update()
+   int Update(wxULongLong_t current, wxULongLong_t total)
+   {
+      ODLocker locker(mLock);
+      if (total > 0)
+         mFraction = (double)current / (double)total;
+      return mResult;
+   }
+
+   // How much of the file has been imported, from 0 to 1
+   double GetFraction()
+   {
+      ODLocker locker(mLock);
+      return mFraction;
+   }
+
+   // What the next Update() returns, so eProgressCancelled or
+   // eProgressStopped to end the import
+   void SetResult(int result)
+   {
+      ODLocker locker(mLock);
+      mResult = result;
+   }
+
+private:
+   ODLock mLock;
+   double mFraction;
+   int mResult;
+};
+
 class ImportPlugin
 {
 public:
@@ -119,7 +166,8 @@ class ImportFileHandle
 public:
    ImportFileHandle(const wxString & filename)
    :  mFilename(filename),
-   mProgress(NULL)
+   mProgress(NULL),
+   mBackgroundProgress(NULL)
    {
    }
 
@@ -136,6 +184,9 @@ public:
    // identify the filename being imported.
    void CreateProgress()
    {
+      if (mBackgroundProgress != NULL)
+         return;
+
       wxFileName f(mFilename);
       wxString title;
 
@@ -144,6 +195,31 @@ public:
                                      f.GetFullName());
    }
 
+   // The importer should report progress through this rather than
+   // mProgress, so that it can run on a worker thread.
+   int UpdateProgress(wxULongLong_t current, wxULongLong_t total)
+   {
+      if (mBackgroundProgress != NULL)
+         return mBackgroundProgress->Update(current, total);
+      return mProgress->Update(current, total);
+   }
+
+   // Have Import() report to progress instead of opening a dialog.
+   // The caller keeps ownership of progress.
+   void SetBackgroundProgress(ImportProgress *progress)
+   {
+      mBackgroundProgress = progress;
+   }
+
+   // Called on the main thread before Import() is called on a worker
+   // thread.  An importer that can run there asks the user anything it
+   // needs to now and returns true; setting *cancelled if the user
+   // cancels.  The default is to import on the main thread.
+   virtual bool PrepareBackgroundImport(bool *WXUNUSED(cancelled))
+   {
+      return false;
+   }
+
    // This is similar to GetImporterDescription, but if possible the
    // importer will return a more specific description of the
    // specific file that is open.
@@ -171,6 +247,7 @@ public:
 protected:
    wxString mFilename;
    ProgressDialog *mProgress;
+   ImportProgress *mBackgroundProgress;
 };
 
 
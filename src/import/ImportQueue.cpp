@@ -0,0 +1,219 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ImportQueue.cpp
+
+*******************************************************************//**
+
+\class ImportQueue
+\brief Imports the files the user opens or drops together on the
+WorkerPool, several at a time.
+
+Only an ImportFileHandle that says it can, in PrepareBackgroundImport(),
+is imported off the main thread.  Such an importer asks its questions
+when the file is added, and reports its progress to an ImportProgress
+rather than a dialog of its own; the main thread shows one dialog for
+the whole queue.  The workers never read gPrefs: the importer reads what
+it needs when opened or prepared, and the queue reads what new tracks
+need before starting them.  Every other file, and any file with several streams
+to choose from, is left to Importer::Import() as before.
+
+*//****************************************************************//**
+
+\class ImportQueueThread
+\brief Hands the queue to the WorkerPool, so that the main thread is
+free to show progress.
+
+*//*******************************************************************/
+
+#include "ImportQueue.h"
+
+#include <wx/intl.h>
+#include <wx/thread.h>
+#include <wx/utils.h>
+
+#include "Import.h"
+#include "../Tags.h"
+#include "../WaveTrack.h"
+#include "../ondemand/ODManager.h"
+#include "../widgets/ProgressDialog.h"
+
+class ImportQueueThread : public wxThread
+{
+ public:
+   ImportQueueThread(ImportQueue *queue)
+      : wxThread(wxTHREAD_JOINABLE), mQueue(queue) {}
+
+   virtual ExitCode Entry()
+   {
+      mQueue->ThreadFunc();
+      return 0;
+   }
+
+ private:
+   ImportQueue *mQueue;
+};
+
+ImportQueue::ImportQueue(DirManager *dirManager)
+:  mTrackFactory(dirManager)
+{
+   mDone = false;
+}
+
+ImportQueue::~ImportQueue()
+{
+   for (size_t i = 0; i < mJobs.size(); i++) {
+      Job *job = mJobs[i];
+      delete job->handle;
+      delete job->tags;
+      if (job->tracks) {
+         for (int t = 0; t < job->numTracks; t++)
+            delete job->tracks[t];
+         delete[] job->tracks;
+      }
+      delete job;
+   }
+}
+
+void ImportQueue::Add(const wxString &fileName)
+{
+   Job *job = new Job;
+   job->fileName = fileName;
+   job->handle = NULL;
+   job->tags = NULL;
+   job->tracks = NULL;
+   job->numTracks = 0;
+   job->result = -1;
+   mJobs.push_back(job);
+
+   ImportFileHandle *inFile = Importer::Get().Open(fileName);
+   if (inFile == NULL || inFile->GetStreamCount() != 1) {
+      delete inFile;
+      return;
+   }
+
+   inFile->SetStreamUsage(0, true);
+   inFile->SetBackgroundProgress(&job->progress);
+
+   bool cancelled = false;
+   if (!inFile->PrepareBackgroundImport(&cancelled)) {
+      delete inFile;
+      if (cancelled)
+         job->result = eProgressCancelled;
+      return;
+   }
+
+   job->handle = inFile;
+   job->tags = new Tags;
+   job->tags->Clear();
+   mPending.push_back(mJobs.size() - 1);
+}
+
+int ImportQueue::Import()
+{
+   if (mPending.empty())
+      return eProgressSuccess;
+
+   // Importers may queue on-demand tasks from the workers, and the
+   // manager must first be made on this thread.
+   ODManager::Instance();
+
+   // Nor may the workers read the preferences; the tracks they make
+   // take what is read here
+   WaveTrack::UpdateDefaultDisplay();
+
+   mDone = false;
+   ImportQueueThread *thread = new ImportQueueThread(this);
+   thread->Create();
+   thread->Run();
+
+   wxString message;
+   message.Printf(_("Importing %d files"), (int)mPending.size());
+   ProgressDialog progress(_("Import"), message);
+
+   int result = eProgressSuccess;
+   while (true) {
+      mDoneLock.Lock();
+      bool done = mDone;
+      mDoneLock.Unlock();
+      if (done)
+         break;
+
+      if (result == eProgressSuccess) {
+         double fraction = 0.0;
+         for (size_t i = 0; i < mPending.size(); i++)
+            fraction += mJobs[mPending[i]]->progress.GetFraction();
+
+         result = progress.Update(fraction, (double)mPending.size());
+         if (result != eProgressSuccess) {
+            for (size_t i = 0; i < mPending.size(); i++)
+               mJobs[mPending[i]]->progress.SetResult(result);
+         }
+      }
+
+      wxMilliSleep(50);
+   }
+
+   thread->Wait();
+   delete thread;
+
+   // Close the files here; libsndfile, for one, is not to be closed
+   // on another thread than the one that will reopen them
+   for (size_t i = 0; i < mPending.size(); i++) {
+      Job *job = mJobs[mPending[i]];
+      delete job->handle;
+      job->handle = NULL;
+   }
+
+   return result;
+}
+
+void ImportQueue::ThreadFunc()
+{
+   WorkerPool::Get().Run(this, mPending.size());
+
+   ODLocker locker(mDoneLock);
+   mDone = true;
+}
+
+void ImportQueue::Run(int index)
+{
+   Job *job = mJobs[mPending[index]];
+
+   // The user may have cancelled before this file was reached
+   int result = job->progress.Update(0, 1);
+   if (result == eProgressCancelled || result == eProgressFailed) {
+      job->result = result;
+      return;
+   }
+
+   job->result = job->handle->Import(&mTrackFactory, &job->tracks,
+                                     &job->numTracks, job->tags);
+
+   if (job->result != eProgressSuccess && job->result != eProgressStopped) {
+      job->tracks = NULL;
+      job->numTracks = 0;
+   }
+}
+
+bool ImportQueue::WasHandled(int index)
+{
+   return mJobs[index]->result != -1;
+}
+
+int ImportQueue::GetTracks(int index, Track ***tracks)
+{
+   Job *job = mJobs[index];
+   int numTracks = job->numTracks;
+   *tracks = job->tracks;
+
+   job->tracks = NULL;
+   job->numTracks = 0;
+   return numTracks;
+}
+
+Tags *ImportQueue::GetTags(int index)
+{
+   return mJobs[index]->tags;
+}
@@ -0,0 +1,77 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ImportQueue.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_IMPORT_QUEUE__
+#define __AUDACITY_IMPORT_QUEUE__
+
+#include <vector>
+
+#include <wx/string.h>
+
+#include "../WorkerPool.h"
+#include "../Track.h"
+#include "ImportPlugin.h"
+
+class DirManager;
+class Tags;
+
+/// Imports several files at once, one per worker thread
+class ImportQueue : public WorkerTask
+{
+ public:
+   ImportQueue(DirManager *dirManager);
+   virtual ~ImportQueue();
+
+   /// Adds a file to the queue, on the main thread.  Its importer may
+   /// ask the user about it now.
+   void Add(const wxString &fileName);
+
+   /// Imports the queued files that can be imported in the background,
+   /// showing one progress dialog for all of them.  Returns
+   /// eProgressCancelled or eProgressStopped if the user pressed that
+   /// button, eProgressSuccess otherwise.
+   int Import();
+
+   /// True if file index was imported, or cancelled, by Import().  If
+   /// false, it is left for the caller to import in the usual way.
+   bool WasHandled(int index);
+
+   /// The tracks imported from file index, or 0 if none were.  The
+   /// caller takes ownership of *tracks and the tracks in it.
+   int GetTracks(int index, Track ***tracks);
+
+   /// The tags read from file index.  Only those the file sets are
+   /// there, to be merged into the project's.
+   Tags *GetTags(int index);
+
+   virtual void Run(int index);
+
+ private:
+   struct Job
+   {
+      wxString fileName;
+      ImportFileHandle *handle;   // NULL unless imported in the background
+      ImportProgress progress;
+      Tags *tags;
+      Track **tracks;
+      int numTracks;
+      int result;                 // an eProgress value, or -1 until known
+   };
+
+   friend class ImportQueueThread;
+   void ThreadFunc();
+
+   TrackFactory mTrackFactory;
+   std::vector<Job *> mJobs;
+   std::vector<int> mPending;     // indexes of the jobs for the workers
+
+   ODLock mDoneLock;
+   bool mDone;
+};
+
+#endif
@@ -21,9 +21,7 @@ updating the ODPCMAliasBlockFile and the GUI of the newly available data.
 #include "ODComputeSummaryTask.h"
 #include "../blockfile/ODPCMAliasBlockFile.h"
 #include <wx/wx.h>
-
-//36 blockfiles > 3 minutes stereo 44.1kHz per ODTask::DoSome
-#define kNumBlockFilesPerDoSome 36
+#include <algorithm>
 
 ///Creates a new task that computes summaries for a wavetrack that needs to be specified through SetWaveTrack()
 ODComputeSummaryTask::ODComputeSummaryTask()
@@ -54,26 +52,26 @@ void ODComputeSummaryTask::Terminate()
 }
 
 ///Computes and writes the data for one BlockFile if it still has a refcount.
+///Several worker threads can be in here at once, each with its own BlockFile.
 void ODComputeSummaryTask::DoSomeInternal()
 {
-   if(mBlockFiles.size()<=0)
-   {
-      mPercentCompleteMutex.Lock();
-      mPercentComplete = 1.0;
-      mPercentCompleteMutex.Unlock();
-      return;
-   }
-
-   ODPCMAliasBlockFile* bf;
+   ODPCMAliasBlockFile* bf = NULL;
    sampleCount blockStartSample = 0;
    sampleCount blockEndSample = 0;
    bool success =false;
 
+   //take the next BlockFile in the order, so no other worker does it too.
    mBlockFilesMutex.Lock();
-   for(size_t i=0; i < mWaveTracks.size() && mBlockFiles.size();i++)
+   if(mBlockFiles.size()>0)
    {
       bf = mBlockFiles[0];
+      mBlockFiles.erase(mBlockFiles.begin());
+      mBlocksInProgress.push_back(bf);
+   }
+   mBlockFilesMutex.Unlock();
 
+   if(bf)
+   {
       //first check to see if the ref count is at least 2.  It should have one
       //from when we added it to this instance's mBlockFiles array, and one from
       //the Wavetrack/sequence.  If it doesn't it has been deleted and we should forget it.
@@ -83,29 +81,23 @@ void ODComputeSummaryTask::DoSomeInternal()
          success = true;
          blockStartSample = bf->GetStart();
          blockEndSample = blockStartSample + bf->GetLength();
-         mComputedBlockFiles++;
       }
+
+      mBlockFilesMutex.Lock();
+      if(success)
+         mComputedBlockFiles++;
       else
-      {
          //the waveform in the wavetrack now is shorter, so we need to update mMaxBlockFiles
          //because now there is less work to do.
          mMaxBlockFiles--;
-      }
+      mBlocksInProgress.erase(std::find(mBlocksInProgress.begin(), mBlocksInProgress.end(), bf));
+      mBlockFilesMutex.Unlock();
 
       //Release the refcount we placed on it.
       bf->Deref();
-      //take it out of the array - we are done with it.
-      mBlockFiles.erase(mBlockFiles.begin());
-
-      //This is a bit of a convenience in case someone tries to terminate the task by closing the trackpanel or window.
-      //ODComputeSummaryTask::Terminate() uses this lock to remove everything, and we don't want it to wait since the UI is being blocked.
-      mBlockFilesMutex.Unlock();
-      wxThread::This()->Yield();
-      mBlockFilesMutex.Lock();
 
       //upddate the gui for all associated blocks.  It doesn't matter that we're hitting more wavetracks then we should
-      //because this loop runs a number of times equal to the number of tracks, they probably are getting processed in
-      //the next iteration at the same sample window.
+      //because the blocks of the tracks are processed in the same sample window.
       mWaveTrackMutex.Lock();
       for(size_t i=0;i<mWaveTracks.size();i++)
       {
@@ -115,25 +107,17 @@ void ODComputeSummaryTask::DoSomeInternal()
       mWaveTrackMutex.Unlock();
    }
 
-   mBlockFilesMutex.Unlock();
-
    //update percentage complete.
    CalculatePercentComplete();
 }
 
-///compute the next time we should take a break in terms of overall percentage.
-///We want to do a constant number of blockfiles.
-float ODComputeSummaryTask::ComputeNextWorkUntilPercentageComplete()
+bool ODComputeSummaryTask::IsWorkLeft()
 {
-   if(mMaxBlockFiles==0)
-     return 1.0;
-
-   float nextPercent;
-   mPercentCompleteMutex.Lock();
-   nextPercent=mPercentComplete + ((float)kNumBlockFilesPerDoSome/(mMaxBlockFiles+1));
-   mPercentCompleteMutex.Unlock();
-
-   return nextPercent;
+   bool ret;
+   mBlockFilesMutex.Lock();
+   ret = mBlockFiles.size()>0;
+   mBlockFilesMutex.Unlock();
+   return ret;
 }
 
 void ODComputeSummaryTask::MarkUpdateRan()
@@ -156,9 +140,14 @@ void ODComputeSummaryTask::CalculatePercentComplete()
 {
    bool hasUpdateRan;
    hasUpdateRan = HasUpdateRan();
+   //the task is done only when the last worker is done with its BlockFile.
+   mBlockFilesMutex.Lock();
+   size_t remaining = mBlockFiles.size() + mBlocksInProgress.size();
+   int maxBlockFiles = mMaxBlockFiles;
+   mBlockFilesMutex.Unlock();
    mPercentCompleteMutex.Lock();
    if(hasUpdateRan)
-      mPercentComplete = (float) 1.0 - ((float)mBlockFiles.size() / (mMaxBlockFiles+1));
+      mPercentComplete = (float) 1.0 - ((float)remaining / (maxBlockFiles+1));
    else
       mPercentComplete =0.0;
    mPercentCompleteMutex.Unlock();
@@ -254,7 +243,10 @@ void ODComputeSummaryTask::OrderBlockFiles(std::vector<ODPCMAliasBlockFile*> &un
       //check to see if the refcount is at least two before we add it to the list.
       //There should be one Ref() from the one added by this ODTask, and one from the track.
       //If there isn't, then the block was deleted for some reason and we should ignore it.
-      if(unorderedBlocks[i]->RefCount()>=2)
+      //A block a worker is summarizing now would be done twice, so leave it out too.
+      if(unorderedBlocks[i]->RefCount()>=2 &&
+         std::find(mBlocksInProgress.begin(), mBlocksInProgress.end(), unorderedBlocks[i]) ==
+            mBlocksInProgress.end())
       {
          //test if the blockfiles are near the task cursor.  we use the last mBlockFiles[0] as our point of reference
          //and add ones that are closer.
@@ -19,6 +19,7 @@ updating the ODPCMAliasBlockFile and the GUI of the newly available data.
 #ifndef __AUDACITY_ODComputeSummaryTask__
 #define __AUDACITY_ODComputeSummaryTask__
 
+#include <limits.h>
 #include <vector>
 #include "ODTask.h"
 #include "ODTaskThread.h"
@@ -46,8 +47,8 @@ class ODComputeSummaryTask:public ODTask
 
    virtual const wxChar* GetTip(){return _("Import complete. Calculating waveform");}
 
-   virtual bool UsesCustomWorkUntilPercentage(){return true;}
-   virtual float ComputeNextWorkUntilPercentageComplete();
+   ///Each block is summarized on its own, so any number of workers can share the task.
+   virtual int GetMaxWorkers(){return INT_MAX;}
 
    ///releases memory that the ODTask owns.  Subclasses should override.
    virtual void Terminate();
@@ -59,6 +60,9 @@ protected:
    ///Computes and writes the data for one BlockFile if it still has a refcount.
    virtual void DoSomeInternal();
 
+   ///whether any BlockFiles are waiting for a worker.
+   virtual bool IsWorkLeft();
+
    ///Readjusts the blockfile order in the default manner.  If we have had an ODRequest
    ///Then it updates in the OD manner.
    virtual void Update();
@@ -73,6 +77,8 @@ protected:
    //mBlockFiles is touched on several threads- the OD terminate thread, and the task thread, so we need to mutex it.
    ODLock  mBlockFilesMutex;
    std::vector<ODPCMAliasBlockFile*> mBlockFiles;
+   //the ones taken out of mBlockFiles by workers that are not done with them yet.
+   std::vector<ODPCMAliasBlockFile*> mBlocksInProgress;
    int mMaxBlockFiles;
    int mComputedBlockFiles;
    ODLock  mHasUpdateRanMutex;
@@ -114,8 +114,27 @@ FLAC__StreamDecoderWriteStatus ODFLACFile::write_callback(const FLAC__Frame *fra
    if(bytesToCopy>mDecoder->mDecodeBufferLen-mDecoder->mDecodeBufferWritePosition)
       bytesToCopy=mDecoder->mDecodeBufferLen-mDecoder->mDecodeBufferWritePosition;
 
-   //the decodeBuffer was allocated to be the same format as the flac buffer, so we can do a straight up memcpy.
-   memcpy(mDecoder->mDecodeBuffer+SAMPLE_SIZE(mDecoder->mFormat)*mDecoder->mDecodeBufferWritePosition,buffer[mDecoder->mTargetChannel],SAMPLE_SIZE(mDecoder->mFormat) * bytesToCopy);
+   //libflac hands us 32 bit ints holding bits_per_sample bit samples, so they are
+   //shifted up to fill the format that the decodeBuffer was allocated in.
+   const FLAC__int32 *src = buffer[mDecoder->mTargetChannel];
+   unsigned int bits = frame->header.bits_per_sample;
+   samplePtr dst = mDecoder->mDecodeBuffer+SAMPLE_SIZE(mDecoder->mFormat)*mDecoder->mDecodeBufferWritePosition;
+   if (mDecoder->mFormat == int16Sample) {
+      short *out = (short *)dst;
+      for (unsigned int s = 0; s < bytesToCopy; s++)
+         out[s] = (short)(src[s] << (16 - bits));
+   }
+   else if (mDecoder->mFormat == int24Sample) {
+      int *out = (int *)dst;
+      for (unsigned int s = 0; s < bytesToCopy; s++)
+         out[s] = src[s] << (24 - bits);
+   }
+   else {
+      float *out = (float *)dst;
+      float scale = 1.0f / (float)((FLAC__int64)1 << (bits - 1));
+      for (unsigned int s = 0; s < bytesToCopy; s++)
+         out[s] = src[s] * scale;
+   }
 
    mDecoder->mDecodeBufferWritePosition+=bytesToCopy;
 /*
@@ -190,12 +209,22 @@ int ODFlacDecoder::Decode(samplePtr & data, sampleFormat & format, sampleCount s
 
    if(!mFile->seek_absolute(start))
    {
+      DeleteSamples(data);
+      data = NULL;
       mFlacFileLock.Unlock();
       return -1;
    }
 
+   //a damaged or short file can end before the buffer is full, so stop there
+   //and leave the rest silent.
    while(mDecodeBufferWritePosition<mDecodeBufferLen)
-      mFile->process_single();
+   {
+      if(!mFile->process_single() ||
+         mFile->get_state() == FLAC__STREAM_DECODER_END_OF_STREAM)
+         break;
+   }
+   if(mDecodeBufferWritePosition<mDecodeBufferLen)
+      ClearSamples(data, mFormat, mDecodeBufferWritePosition, mDecodeBufferLen-mDecodeBufferWritePosition);
 
    mFlacFileLock.Unlock();
    if(!usingCache)
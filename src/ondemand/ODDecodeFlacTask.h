@@ -96,7 +96,7 @@ class ODFlacDecoder:public ODFileDecoder
    friend class ODFLACFile;
 public:
    ///This should handle unicode converted to UTF-8 on mac/linux, but OD TODO:check on windows
-   ODFlacDecoder(const wxString & fileName):ODFileDecoder(fileName),mSamplesDone(0){mFile=NULL;}
+   ODFlacDecoder(const wxString & fileName):ODFileDecoder(fileName),mSamplesDone(0),mLastDecodeStartSample(-1){mFile=NULL;}
    virtual ~ODFlacDecoder();
 
    ///Decodes the samples for this blockfile from the real file into a float buffer.
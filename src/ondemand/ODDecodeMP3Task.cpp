@@ -0,0 +1,265 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeMP3Task.cpp
+
+******************************************************************//**
+
+\class ODMP3Decoder
+\brief Decodes stretches of an MP3 file for ODDecodeMP3Task.
+
+MP3 frames can't be found from a time without reading the ones before,
+so ReadHeader() walks the file once, reading only the frame headers,
+which is quick next to decoding.  It notes the byte offset and first
+sample of every few frames.  Decode() then starts from the noted frame
+one step before the samples wanted.  Decoding the frames in between
+fills the bit reservoir that layer III frames borrow from, and the
+state of the synthesis filter, so the samples come out as a decode of
+the whole file would give them.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#ifdef USE_LIBMAD
+
+#include "ODDecodeMP3Task.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef USE_LIBID3TAG
+extern "C" {
+#include <id3tag.h>
+}
+#endif
+
+#define INPUT_BUFFER_SIZE 65536
+
+// Frames between entries of the seek index.  Decode() starts up to twice
+// this many frames early.
+static const int sSeekIndexSpacing = 16;
+
+static inline float scale(mad_fixed_t sample)
+{
+   return (float) (sample / (float) (1L << MAD_F_FRACBITS));
+}
+
+ODTask* ODDecodeMP3Task::Clone()
+{
+   ODDecodeMP3Task* clone = new ODDecodeMP3Task;
+   clone->mDemandSample=GetDemandSample();
+
+   //the decoders and blockfiles should not be copied.  They are created as the task runs.
+   return clone;
+}
+
+///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+ODFileDecoder* ODDecodeMP3Task::CreateFileDecoder(const wxString & fileName)
+{
+   ODMP3Decoder *decoder = new ODMP3Decoder(fileName);
+   mDecoders.push_back(decoder);
+   return decoder;
+}
+
+ODMP3Decoder::ODMP3Decoder(const wxString & fileName)
+:  ODFileDecoder(fileName)
+{
+   mBuffer.resize(INPUT_BUFFER_SIZE + MAD_BUFFER_GUARD);
+   mEof = false;
+   mDataStart = 0;
+   mLength = 0;
+   mSampleRate = 0;
+   mNumChannels = 0;
+   mNumSamples = 0;
+}
+
+ODMP3Decoder::~ODMP3Decoder()
+{
+}
+
+bool ODMP3Decoder::FillBuffer()
+{
+   if (mEof)
+      return false;
+
+   // Keep the frame that was cut off at the end of the buffer
+   size_t keep = 0;
+   if (mStream.next_frame) {
+      keep = mStream.bufend - mStream.next_frame;
+      memmove(&mBuffer[0], mStream.next_frame, keep);
+   }
+
+   size_t want = INPUT_BUFFER_SIZE - keep;
+   ssize_t got = mFile.Read(&mBuffer[keep], want);
+   if (got < 0)
+      got = 0;
+
+   size_t len = keep + got;
+   if ((size_t)got < want) {
+      // libmad wants some zeros after the last frame to decode it
+      memset(&mBuffer[len], 0, MAD_BUFFER_GUARD);
+      len += MAD_BUFFER_GUARD;
+      mEof = true;
+   }
+
+   mad_stream_buffer(&mStream, &mBuffer[0], len);
+   return true;
+}
+
+///Walks the frame headers, noting where every sSeekIndexSpacing-th
+///frame starts in the file and in samples.
+bool ODMP3Decoder::ReadHeader()
+{
+   ODLocker locker(mDecodeLock);
+
+   if (!mFile.IsOpened() && !mFile.Open(mFName))
+      return false;
+
+   mDataStart = 0;
+#ifdef USE_LIBID3TAG
+   // Skip an ID3v2 tag, as the importer does
+   unsigned char query[ID3_TAG_QUERYSIZE];
+   if (mFile.Read(query, ID3_TAG_QUERYSIZE) == ID3_TAG_QUERYSIZE) {
+      long tagLen = id3_tag_query(query, ID3_TAG_QUERYSIZE);
+      if (tagLen > 0)
+         mDataStart = tagLen;
+   }
+#endif
+   mFile.Seek(mDataStart);
+
+   mSeekOffsets.clear();
+   mSeekSamples.clear();
+
+   struct mad_header header;
+   mad_header_init(&header);
+   mad_stream_init(&mStream);
+   mEof = false;
+   FillBuffer();
+
+   // The file offset of mBuffer[0]
+   wxFileOffset bufferStart = mDataStart;
+   sampleCount samples = 0;
+   int frames = 0;
+
+   while (true) {
+      if (mad_header_decode(&header, &mStream) == -1) {
+         if (mStream.error == MAD_ERROR_BUFLEN) {
+            // Count what FillBuffer() will throw away: up to the cut off
+            // frame, or all of it if libmad found none
+            if (mStream.next_frame)
+               bufferStart += mStream.next_frame - &mBuffer[0];
+            else
+               bufferStart += mStream.bufend - &mBuffer[0];
+            if (!FillBuffer())
+               break;
+            continue;
+         }
+         if (MAD_RECOVERABLE(mStream.error))
+            continue;
+         break;
+      }
+
+      if (frames == 0) {
+         mSampleRate = header.samplerate;
+         mNumChannels = MAD_NCHANNELS(&header);
+      }
+
+      if (frames % sSeekIndexSpacing == 0) {
+         mSeekOffsets.push_back(bufferStart + (mStream.this_frame - &mBuffer[0]));
+         mSeekSamples.push_back(samples);
+      }
+
+      samples += 32 * MAD_NSBSAMPLES(&header);
+      frames++;
+   }
+
+   mad_stream_finish(&mStream);
+   mad_header_finish(&header);
+
+   if (frames == 0)
+      return false;
+
+   mLength = samples;
+   mNumSamples = (unsigned int)samples;
+
+   MarkInitialized();
+   return true;
+}
+
+int ODMP3Decoder::Decode(samplePtr & data, sampleFormat & format, sampleCount start, sampleCount len, unsigned int channel)
+{
+   ODLocker locker(mDecodeLock);
+
+   if (mSeekSamples.empty())
+      return -1;
+
+   format = floatSample;
+   data = NewSamples(len, floatSample);
+   ClearSamples(data, floatSample, 0, len);
+   float *out = (float *)data;
+
+   // The index entry at or before start, and one more before that
+   size_t entry = std::upper_bound(mSeekSamples.begin(), mSeekSamples.end(), start)
+      - mSeekSamples.begin();
+   if (entry > 0)
+      entry--;
+   if (entry > 0)
+      entry--;
+
+   mFile.Seek(mSeekOffsets[entry]);
+   mad_stream_init(&mStream);
+   mad_frame_init(&mFrame);
+   mad_synth_init(&mSynth);
+   mEof = false;
+   FillBuffer();
+
+   const sampleCount end = start + len;
+   sampleCount pos = mSeekSamples[entry];
+
+   while (pos < end) {
+      if (mad_header_decode(&mFrame.header, &mStream) == -1) {
+         if (mStream.error == MAD_ERROR_BUFLEN) {
+            if (!FillBuffer())
+               break;
+            continue;
+         }
+         if (MAD_RECOVERABLE(mStream.error))
+            continue;
+         break;
+      }
+
+      sampleCount frameLen = 32 * MAD_NSBSAMPLES(&mFrame.header);
+
+      if (mad_frame_decode(&mFrame, &mStream) == -1) {
+         if (!MAD_RECOVERABLE(mStream.error))
+            break;
+         // A frame that won't decode stays silent, keeping the ones
+         // after it in their places
+         pos += frameLen;
+         continue;
+      }
+
+      mad_synth_frame(&mSynth, &mFrame);
+
+      const struct mad_pcm &pcm = mSynth.pcm;
+      if (pcm.channels > 0) {
+         unsigned int chn = channel < pcm.channels ? channel : pcm.channels - 1;
+         sampleCount from = std::max(start, pos);
+         sampleCount to = std::min(end, pos + std::min(frameLen, (sampleCount)pcm.length));
+         for (sampleCount s = from; s < to; s++)
+            out[s - start] = scale(pcm.samples[chn][s - pos]);
+      }
+
+      pos += frameLen;
+   }
+
+   mad_synth_finish(&mSynth);
+   mad_frame_finish(&mFrame);
+   mad_stream_finish(&mStream);
+
+   return 1;
+}
+
+#endif // USE_LIBMAD
@@ -0,0 +1,84 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeMP3Task.h
+
+******************************************************************//**
+
+\class ODDecodeMP3Task
+\brief Decodes an MP3 file into ODDecodeBlockFiles with libmad, block
+by block, starting where the user is looking.
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_ODDecodeMP3Task__
+#define __AUDACITY_ODDecodeMP3Task__
+
+#include <vector>
+
+#include <wx/file.h>
+
+#include "ODDecodeTask.h"
+#include "ODTaskThread.h"
+
+extern "C" {
+#include "mad.h"
+}
+
+/// A class representing a modular task to be used with the On-Demand structures.
+class ODDecodeMP3Task:public ODDecodeTask
+{
+ public:
+   ODDecodeMP3Task(){}
+   virtual ~ODDecodeMP3Task(){}
+
+   virtual ODTask* Clone();
+
+   ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+   virtual ODFileDecoder* CreateFileDecoder(const wxString & fileName);
+
+   ///Lets other classes know that this class handles mp3
+   virtual unsigned int GetODType(){return eODMP3;}
+};
+
+///Decodes any stretch of one MP3 file.  ReadHeader() walks the frame
+///headers once to index where every few frames start, so that Decode()
+///can start a few frames before the samples it is asked for.
+class ODMP3Decoder:public ODFileDecoder
+{
+public:
+   ODMP3Decoder(const wxString & fileName);
+   virtual ~ODMP3Decoder();
+
+   ///Decodes len samples of one channel from start, as floats
+   virtual int Decode(samplePtr & data, sampleFormat & format, sampleCount start, sampleCount len, unsigned int channel);
+
+   ///Indexes the frames of the file.  Returns false if it has none.
+   virtual bool ReadHeader();
+
+   unsigned int GetSampleRate(){return mSampleRate;}
+   unsigned int GetNumChannels(){return mNumChannels;}
+   sampleCount GetLength(){return mLength;}
+
+private:
+   ///Fills mBuffer from the file, keeping what mStream has not used yet
+   bool FillBuffer();
+
+   wxFile         mFile;
+   ODLock         mDecodeLock;   //for the file and the libmad state
+
+   struct mad_stream mStream;
+   struct mad_frame  mFrame;
+   struct mad_synth  mSynth;
+   std::vector<unsigned char> mBuffer;
+   bool           mEof;
+
+   // The byte offset and first sample of every so many frames
+   std::vector<wxFileOffset> mSeekOffsets;
+   std::vector<sampleCount>  mSeekSamples;
+   wxFileOffset   mDataStart;    //after any ID3v2 tag
+   sampleCount    mLength;
+};
+
+#endif
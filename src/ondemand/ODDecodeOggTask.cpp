@@ -0,0 +1,137 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeOggTask.cpp
+
+******************************************************************//**
+
+\class ODOggDecoder
+\brief Decodes stretches of an Ogg Vorbis file for ODDecodeOggTask.
+
+libvorbisfile seeks to an exact sample, decoding the packet before it
+to prime the overlap, so each block decodes on its own.  Chained files
+(more than one logical stream) are left to the importer, which lets the
+user pick among the streams.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#ifdef USE_LIBVORBIS
+
+#include "ODDecodeOggTask.h"
+
+ODTask* ODDecodeOggTask::Clone()
+{
+   ODDecodeOggTask* clone = new ODDecodeOggTask;
+   clone->mDemandSample=GetDemandSample();
+
+   //the decoders and blockfiles should not be copied.  They are created as the task runs.
+   return clone;
+}
+
+///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+ODFileDecoder* ODDecodeOggTask::CreateFileDecoder(const wxString & fileName)
+{
+   ODOggDecoder *decoder = new ODOggDecoder(fileName);
+   mDecoders.push_back(decoder);
+   return decoder;
+}
+
+ODOggDecoder::ODOggDecoder(const wxString & fileName)
+:  ODFileDecoder(fileName)
+{
+   mOpen = false;
+   mLength = 0;
+   mSampleRate = 0;
+   mNumChannels = 0;
+   mNumSamples = 0;
+}
+
+ODOggDecoder::~ODOggDecoder()
+{
+   Close();
+}
+
+void ODOggDecoder::Close()
+{
+   if (mOpen) {
+      ov_clear(&mVorbisFile);
+      mHandle.Detach();    // ov_clear() closed it
+      mOpen = false;
+   }
+}
+
+bool ODOggDecoder::ReadHeader()
+{
+   ODLocker locker(mDecodeLock);
+
+   Close();
+
+   // wxFFile opens names libvorbisfile can't, as in OggImportPlugin::Open()
+   if (!mHandle.Open(mFName, wxT("rb")))
+      return false;
+
+   if (ov_open(mHandle.fp(), &mVorbisFile, NULL, 0) < 0) {
+      mHandle.Close();
+      return false;
+   }
+   mOpen = true;
+
+   if (!ov_seekable(&mVorbisFile) || ov_streams(&mVorbisFile) != 1) {
+      Close();
+      return false;
+   }
+
+   vorbis_info *vi = ov_info(&mVorbisFile, 0);
+   ogg_int64_t total = ov_pcm_total(&mVorbisFile, 0);
+   if (!vi || total < 0) {
+      Close();
+      return false;
+   }
+
+   mSampleRate = vi->rate;
+   mNumChannels = vi->channels;
+   mLength = (sampleCount)total;
+   mNumSamples = (unsigned int)total;
+
+   MarkInitialized();
+   return true;
+}
+
+int ODOggDecoder::Decode(samplePtr & data, sampleFormat & format, sampleCount start, sampleCount len, unsigned int channel)
+{
+   ODLocker locker(mDecodeLock);
+
+   if (!mOpen || ov_pcm_seek(&mVorbisFile, start) != 0)
+      return -1;
+
+   format = floatSample;
+   data = NewSamples(len, floatSample);
+   float *out = (float *)data;
+
+   sampleCount done = 0;
+   while (done < len) {
+      float **pcm;
+      int bitstream;
+      long got = ov_read_float(&mVorbisFile, &pcm, (int)(len - done), &bitstream);
+      if (got == OV_HOLE)
+         continue;
+      if (got <= 0)
+         break;
+
+      unsigned int chn = channel < mNumChannels ? channel : mNumChannels - 1;
+      for (long s = 0; s < got; s++)
+         out[done + s] = pcm[chn][s];
+      done += got;
+   }
+
+   // A truncated file ends early; the rest stays silent
+   if (done < len)
+      ClearSamples(data, floatSample, done, len - done);
+
+   return 1;
+}
+
+#endif // USE_LIBVORBIS
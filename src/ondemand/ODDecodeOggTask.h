@@ -0,0 +1,70 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeOggTask.h
+
+******************************************************************//**
+
+\class ODDecodeOggTask
+\brief Decodes an Ogg Vorbis file into ODDecodeBlockFiles with
+libvorbisfile, block by block, starting where the user is looking.
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_ODDecodeOggTask__
+#define __AUDACITY_ODDecodeOggTask__
+
+#include <wx/ffile.h>
+
+#include "ODDecodeTask.h"
+#include "ODTaskThread.h"
+
+#include <vorbis/vorbisfile.h>
+
+/// A class representing a modular task to be used with the On-Demand structures.
+class ODDecodeOggTask:public ODDecodeTask
+{
+ public:
+   ODDecodeOggTask(){}
+   virtual ~ODDecodeOggTask(){}
+
+   virtual ODTask* Clone();
+
+   ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+   virtual ODFileDecoder* CreateFileDecoder(const wxString & fileName);
+
+   ///Lets other classes know that this class handles ogg vorbis
+   virtual unsigned int GetODType(){return eODOGG;}
+};
+
+///Decodes any stretch of one single-link Ogg Vorbis file, seeking with
+///ov_pcm_seek(), which finds the page by bisection.
+class ODOggDecoder:public ODFileDecoder
+{
+public:
+   ODOggDecoder(const wxString & fileName);
+   virtual ~ODOggDecoder();
+
+   ///Decodes len samples of one channel from start, as floats
+   virtual int Decode(samplePtr & data, sampleFormat & format, sampleCount start, sampleCount len, unsigned int channel);
+
+   ///Opens the file.  Returns false unless it is a seekable file of one
+   ///logical stream.
+   virtual bool ReadHeader();
+
+   unsigned int GetSampleRate(){return mSampleRate;}
+   unsigned int GetNumChannels(){return mNumChannels;}
+   sampleCount GetLength(){return mLength;}
+
+private:
+   void Close();
+
+   wxFFile        mHandle;
+   OggVorbis_File mVorbisFile;
+   bool           mOpen;
+   ODLock         mDecodeLock;   //for mVorbisFile
+   sampleCount    mLength;
+};
+
+#endif
@@ -59,6 +59,9 @@ class ODDecodeTask:public ODTask
    ///Subclasses should override to return respective type.
    virtual unsigned int GetODType(){return eODNone;}
 
+   //Decoders keep the state of the files they read, so decoding takes one worker
+   //at a time, the default of GetMaxWorkers().  Different files decode in parallel.
+
    ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
    virtual ODFileDecoder* CreateFileDecoder(const wxString & fileName)=0;
 
@@ -10,7 +10,8 @@
 
 \file ODManager.cpp
 \brief Singleton ODManager class.  Is the bridge between client side
-ODTask requests and internals.
+ODTask requests and internals, and runs the tasks on its pool of worker
+threads.
 
 *//*******************************************************************/
 
@@ -24,6 +25,7 @@ ODTask requests and internals.
 #include <wx/wx.h>
 #include <wx/thread.h>
 #include <wx/event.h>
+#include <algorithm>
 
 static ODLock gODInitedMutex;
 static bool gManagerCreated=false;
@@ -40,6 +42,9 @@ pfodman ODManager::Instance = &(ODManager::InstanceFirstTime);
 //libsndfile is not threadsafe - this deals with it
 static ODLock sLibSndFileMutex;
 
+//workers wake the manager loop after this many items, so it can schedule and redraw
+#define kItemsPerManagerUpdate 8
+
 DEFINE_EVENT_TYPE(EVT_ODTASK_UPDATE)
 
 //using this with wxStringArray::Sort will give you a list that
@@ -70,6 +75,13 @@ ODManager::ODManager()
 
    //must set up the queue condition
    mQueueNotEmptyCond = new ODCondition(&mQueueNotEmptyCondLock);
+   mQueueSignalled = false;
+
+   mWorkAvailableCond = new ODCondition(&mWorkItemsMutex);
+   mWorkItemDoneCond = new ODCondition(&mWorkItemsMutex);
+   mNextWorkQueue = 0;
+   mItemsDone = 0;
+   mStopWorkers = false;
 }
 
 //private destructor - delete with static method Quit()
@@ -81,57 +93,186 @@ ODManager::~ODManager()
       delete mQueues[i];
 
    delete mQueueNotEmptyCond;
+   delete mWorkAvailableCond;
+   delete mWorkItemDoneCond;
 }
 
-///Adds a task to running queue.  Thread-safe.
+///Adds work items for a task to the worker queues, as many as the task can use, spread over the queues
+///so that idle workers find them without stealing.  Thread-safe.
 void ODManager::AddTask(ODTask* task)
 {
-   mTasksMutex.Lock();
-   mTasks.push_back(task);
-   mTasksMutex.Unlock();
-   //signal the queue not empty condition.
+   mWorkItemsMutex.Lock();
+   int count = task->GetMaxWorkers();
+   if(count > (int)mWorkQueues.size())
+      count = mWorkQueues.size();
+   for(int i=0;i<count;i++)
+   {
+      mWorkQueues[mNextWorkQueue].push_back(task);
+      mNextWorkQueue = (mNextWorkQueue+1) % mWorkQueues.size();
+   }
+   //if we are paused the workers will go back to sleep.
+   mWorkAvailableCond->Broadcast();
+   mWorkItemsMutex.Unlock();
+}
+
+void ODManager::SignalTaskQueueLoop()
+{
    bool paused;
 
    mPauseLock.Lock();
    paused=mPause;
    mPauseLock.Unlock();
-
    mQueueNotEmptyCondLock.Lock();
-   //don't signal if we are paused since if we wake up the loop it will start processing other tasks while paused
+   //don't signal if we are paused
    if(!paused)
+   {
+      mQueueSignalled = true;
       mQueueNotEmptyCond->Signal();
+   }
    mQueueNotEmptyCondLock.Unlock();
 }
 
-void ODManager::SignalTaskQueueLoop()
+bool ODManager::IsPaused()
 {
    bool paused;
-
    mPauseLock.Lock();
    paused=mPause;
    mPauseLock.Unlock();
-   mQueueNotEmptyCondLock.Lock();
-   //don't signal if we are paused
-   if(!paused)
-      mQueueNotEmptyCond->Signal();
-   mQueueNotEmptyCondLock.Unlock();
+   return paused;
 }
 
-///removes a task from the active task queue
+//takes the items of a task out of a work queue and returns how many there were.
+static int RemoveWorkItems(std::deque<ODTask*> &queue, ODTask* task)
+{
+   std::deque<ODTask*>::iterator end = std::remove(queue.begin(), queue.end(), task);
+   int removed = queue.end() - end;
+   queue.erase(end, queue.end());
+   return removed;
+}
+
+///removes a task's work items from the worker queues, and waits for the workers running any to finish them
 void ODManager::RemoveTaskIfInQueue(ODTask* task)
 {
-   mTasksMutex.Lock();
-   //linear search okay for now, (probably only 1-5 tasks exist at a time.)
-   for(unsigned int i=0;i<mTasks.size();i++)
+   mWorkItemsMutex.Lock();
+   mRemovedTasks.push_back(task);
+
+   for(unsigned int i=0;i<mWorkQueues.size();i++)
+      RemoveWorkItems(mWorkQueues[i], task);
+   RemoveWorkItems(mDemandedItems, task);
+   mDemandedTasks.erase(std::remove(mDemandedTasks.begin(), mDemandedTasks.end(), task),
+                        mDemandedTasks.end());
+
+   while(std::find(mRunningTasks.begin(),mRunningTasks.end(),task)!=mRunningTasks.end())
+      mWorkItemDoneCond->Wait();
+
+   mRemovedTasks.erase(std::find(mRemovedTasks.begin(),mRemovedTasks.end(),task));
+   mWorkItemsMutex.Unlock();
+}
+
+///whether any worker is running an item of the task or has one queued.
+bool ODManager::HasWorkItems(ODTask* task)
+{
+   bool ret;
+   mWorkItemsMutex.Lock();
+   ret = std::find(mRunningTasks.begin(),mRunningTasks.end(),task)!=mRunningTasks.end() ||
+         std::find(mDemandedItems.begin(),mDemandedItems.end(),task)!=mDemandedItems.end();
+   for(unsigned int i=0;i<mWorkQueues.size() && !ret;i++)
+      ret = std::find(mWorkQueues[i].begin(),mWorkQueues[i].end(),task)!=mWorkQueues[i].end();
+   mWorkItemsMutex.Unlock();
+   return ret;
+}
+
+///Moves the work items of a task to the front of the demanded items, so that every worker
+///takes them before anything else once it is done with its current item.  The task stays
+///demanded until it is removed.
+void ODManager::PrioritizeTask(ODTask* task)
+{
+   mWorkItemsMutex.Lock();
+   int count = RemoveWorkItems(mDemandedItems, task);
+   for(unsigned int i=0;i<mWorkQueues.size();i++)
+      count += RemoveWorkItems(mWorkQueues[i], task);
+   mDemandedItems.insert(mDemandedItems.begin(), count, task);
+
+   if(std::find(mDemandedTasks.begin(),mDemandedTasks.end(),task)==mDemandedTasks.end())
+      mDemandedTasks.push_back(task);
+   mWorkItemsMutex.Unlock();
+}
+
+///Gets the next work item for a worker: a demanded one if there is any, else the newest one in its
+///own queue, else the oldest one in another worker's queue.  Call with mWorkItemsMutex held.
+ODTask* ODManager::GetWorkItem(int index)
+{
+   ODTask* task = NULL;
+
+   if(mDemandedItems.size())
    {
-      if(mTasks[i]==task)
+      task = mDemandedItems.front();
+      mDemandedItems.pop_front();
+   }
+   else if(mWorkQueues[index].size())
+   {
+      task = mWorkQueues[index].back();
+      mWorkQueues[index].pop_back();
+   }
+   else
+   {
+      for(unsigned int i=1;i<mWorkQueues.size() && !task;i++)
       {
-         mTasks.erase(mTasks.begin()+i);
-         break;
+         std::deque<ODTask*> &victim = mWorkQueues[(index+i) % mWorkQueues.size()];
+         if(victim.size())
+         {
+            task = victim.front();
+            victim.pop_front();
+         }
       }
    }
-   mTasksMutex.Unlock();
 
+   return task;
+}
+
+///Runs work items until Quit().  An item that finds more work to hand out goes back where the
+///worker takes from next, so the worker stays with the task.
+void ODManager::WorkerLoop(int index)
+{
+   ODTask* task;
+
+   mWorkItemsMutex.Lock();
+   while(!mStopWorkers)
+   {
+      if(IsPaused() || !(task = GetWorkItem(index)))
+      {
+         mWorkAvailableCond->Wait();
+         continue;
+      }
+
+      mRunningTasks[index] = task;
+      mWorkItemsMutex.Unlock();
+
+      bool more = task->DoWorkItem();
+
+      mWorkItemsMutex.Lock();
+      mRunningTasks[index] = NULL;
+      if(more && std::find(mRemovedTasks.begin(),mRemovedTasks.end(),task)==mRemovedTasks.end())
+      {
+         if(std::find(mDemandedTasks.begin(),mDemandedTasks.end(),task)!=mDemandedTasks.end())
+            mDemandedItems.push_front(task);
+         else
+            mWorkQueues[index].push_back(task);
+      }
+      mWorkItemDoneCond->Broadcast();
+
+      //a task that is out of work may be complete, and the next one in its track's queue can start.
+      bool update = !more || ++mItemsDone >= kItemsPerManagerUpdate;
+      if(update)
+         mItemsDone = 0;
+      mWorkItemsMutex.Unlock();
+
+      if(update)
+         SignalTaskQueueLoop();
+
+      mWorkItemsMutex.Lock();
+   }
+   mWorkItemsMutex.Unlock();
 }
 
 ///Adds a new task to the queue.  Creates a queue if the tracks associated with the task is not in the list
@@ -161,7 +302,7 @@ void ODManager::AddNewTask(ODTask* task, bool lockMutex)
    }
    else
    {
-      //Make a new one, add it to the local track queue, and to the immediate running task list,
+      //Make a new one, add it to the local track queue, and hand its work items to the workers,
       //since this task is definitely at the head
       queue = new ODWaveTrackTaskQueue();
       queue->AddTask(task);
@@ -206,11 +347,27 @@ bool ODManager::IsInstanceCreated()
    return ret;
 }
 
-///Launches a thread for the manager and starts accepting Tasks.
+///Launches a thread for the manager and the worker threads, and starts accepting Tasks.
 void ODManager::Init()
 {
    mCurrentThreads = 0;
-   mMaxThreads = 5;
+   mMaxThreads = wxThread::GetCPUCount();
+   if(mMaxThreads < 1)
+      mMaxThreads = 2;
+
+   //the queues and their slots must exist before any worker runs.
+   mWorkQueues.resize(mMaxThreads);
+   mRunningTasks.resize(mMaxThreads, NULL);
+   for(int i=0;i<mMaxThreads;i++)
+   {
+      ODTaskThread* worker = new ODTaskThread(i);
+      mCurrentThreadsMutex.Lock();
+      mCurrentThreads++;
+      mCurrentThreadsMutex.Unlock();
+      worker->Create();
+      worker->Run();
+      //destruction of thread is taken care of by thread library
+   }
 
    //   wxLogDebug(wxT("Initializing ODManager...Creating manager thread"));
    ODManagerHelperThread* startThread = new ODManagerHelperThread;
@@ -231,12 +388,10 @@ void ODManager::DecrementCurrentThreads()
    mCurrentThreadsMutex.Unlock();
 }
 
-///Main loop for managing threads and tasks.
+///Main loop for managing tasks.  The workers wake it when they have done a few items,
+///and when a task runs out of work.
 void ODManager::Start()
 {
-   ODTaskThread* thread;
-   bool tasksInArray;
-   bool paused;
    int  numQueues=0;
 
    mNeedsDraw=0;
@@ -251,48 +406,15 @@ void ODManager::Start()
       mTerminateMutex.Unlock();
 //    printf("ODManager thread running \n");
 
-      //we should look at our WaveTrack queues to see if we can process a new task to the running queue.
+      //we should look at our WaveTrack queues to see if we can give a new task to the workers.
       UpdateQueues();
 
-      //start some threads if necessary
-
-      mTasksMutex.Lock();
-      tasksInArray = mTasks.size()>0;
-      mTasksMutex.Unlock();
-
-      mPauseLock.Lock();
-      paused=mPause;
-      mPauseLock.Unlock();
-
-      mCurrentThreadsMutex.Lock();
-      // keep adding tasks if there is work to do, up to the limit.
-      while(!paused && tasksInArray && (mCurrentThreads < mMaxThreads))
-      {
-         mCurrentThreads++;
-         mCurrentThreadsMutex.Unlock();
-
-         mTasksMutex.Lock();
-         //detach a new thread.
-         thread = new ODTaskThread(mTasks[0]);//task);
-         //thread->SetPriority(10);//default is 50.
-         thread->Create();
-         thread->Run();
-
-         mTasks.erase(mTasks.begin());
-         tasksInArray = mTasks.size()>0;
-         mTasksMutex.Unlock();
-
-         mCurrentThreadsMutex.Lock();
-      }
-
-      mCurrentThreadsMutex.Unlock();
       //use a conditon variable to block here instead of a sleep.
-
-      // JKC: If there are no tasks ready to run, or we're paused then
-      // we wait for there to be tasks in the queue.
+      //wait for the workers to get somewhere, or for new tasks.
       mQueueNotEmptyCondLock.Lock();
-      if( (!tasksInArray) || paused)
+      while(!mQueueSignalled)
          mQueueNotEmptyCond->Wait();
+      mQueueSignalled = false;
       mQueueNotEmptyCondLock.Unlock();
 
       //if there is some ODTask running, then there will be something in the queue.  If so then redraw to show progress
@@ -339,8 +461,14 @@ void ODManager::Pause(bool pause)
 
       //we should check the queue again.
       pMan->mQueueNotEmptyCondLock.Lock();
+      pMan->mQueueSignalled = true;
       pMan->mQueueNotEmptyCond->Signal();
       pMan->mQueueNotEmptyCondLock.Unlock();
+
+      //and the workers should look for items again, or go to sleep.
+      pMan->mWorkItemsMutex.Lock();
+      pMan->mWorkAvailableCond->Broadcast();
+      pMan->mWorkItemsMutex.Unlock();
    }
    else
    {
@@ -371,12 +499,29 @@ void ODManager::Quit()
 
          //signal the queue not empty condition since the ODMan thread will wait on the queue condition
          pMan->mQueueNotEmptyCondLock.Lock();
+         pMan->mQueueSignalled = true;
          pMan->mQueueNotEmptyCond->Signal();
          pMan->mQueueNotEmptyCondLock.Unlock();
 
          pMan->mTerminatedMutex.Lock();
       }
       pMan->mTerminatedMutex.Unlock();
+
+      //then stop the workers, which finish the items they are running first.
+      pMan->mWorkItemsMutex.Lock();
+      pMan->mStopWorkers = true;
+      pMan->mWorkAvailableCond->Broadcast();
+      pMan->mWorkItemsMutex.Unlock();
+
+      pMan->mCurrentThreadsMutex.Lock();
+      while(pMan->mCurrentThreads > 0)
+      {
+         pMan->mCurrentThreadsMutex.Unlock();
+         wxThread::Sleep(50);
+         pMan->mCurrentThreadsMutex.Lock();
+      }
+      pMan->mCurrentThreadsMutex.Unlock();
+
       delete pMan;
    }
 }
@@ -481,6 +626,14 @@ void ODManager::DemandTrackUpdate(WaveTrack* track, double seconds)
    for(unsigned int i=0;i<mQueues.size();i++)
    {
       mQueues[i]->DemandTrackUpdate(track,seconds);
+
+      //and the task the track is waiting for goes before background work.
+      if(mQueues[i]->ContainsWaveTrack(track))
+      {
+         ODTask* task = mQueues[i]->GetFrontTask();
+         if(task)
+            PrioritizeTask(task);
+      }
    }
    mQueuesMutex.Unlock();
 }
@@ -489,24 +642,41 @@ void ODManager::DemandTrackUpdate(WaveTrack* track, double seconds)
 ///Also remove queues that have become empty.
 void ODManager::UpdateQueues()
 {
+   //no worker may hold on to a task once it is deleted.  Taking the finished tasks away from
+   //the workers waits for any still running an item, so do it without holding mQueuesMutex.
+   std::vector<ODTask*> finished;
+   mQueuesMutex.Lock();
+   for(unsigned int i=0;i<mQueues.size();i++)
+   {
+      if(mQueues[i]->IsFrontTaskComplete())
+         finished.push_back(mQueues[i]->GetFrontTask());
+   }
+   mQueuesMutex.Unlock();
+
+   for(unsigned int i=0;i<finished.size();i++)
+      RemoveTaskIfInQueue(finished[i]);
+
    mQueuesMutex.Lock();
    for(unsigned int i=0;i<mQueues.size();i++)
    {
+      //a task that finished since the first pass is left for the next update.
       if(mQueues[i]->IsFrontTaskComplete())
       {
-         //this should delete and remove the front task instance.
-         mQueues[i]->RemoveFrontTask();
-         //schedule next.
-         if(!mQueues[i]->IsEmpty())
+         if(std::find(finished.begin(),finished.end(),mQueues[i]->GetFrontTask())!=finished.end())
          {
-            //we need to release the lock on the queue vector before using the task vector's lock or we deadlock
-            //so get a temp.
-            ODWaveTrackTaskQueue* queue;
-            queue = mQueues[i];
-
-            AddTask(queue->GetFrontTask());
+            //this should delete and remove the front task instance.
+            mQueues[i]->RemoveFrontTask();
+            //schedule next.
+            if(!mQueues[i]->IsEmpty())
+               AddTask(mQueues[i]->GetFrontTask());
          }
       }
+      else if(!mQueues[i]->IsEmpty() && !HasWorkItems(mQueues[i]->GetFrontTask()))
+      {
+         //the task ran out of work items, but more work turned up for it,
+         //as when a track was merged into it.
+         AddTask(mQueues[i]->GetFrontTask());
+      }
 
       //if the queue is empty delete it.
       if(mQueues[i]->IsEmpty())
@@ -11,14 +11,23 @@
 ******************************************************************//**
 
 \class ODManager
-\brief A singleton that manages currently running Tasks on an arbitrary
-number of threads.
+\brief A singleton that manages currently running Tasks on a pool of
+worker threads, one per processor.
+
+Each worker has its own queue of work items.  An item is a task that a
+worker runs the smallest unit of work of, one block, with
+ODTask::DoWorkItem(); a task has as many items as it can use workers.  A
+worker keeps taking from the back of its own queue, so it stays with one
+task, and when that is empty steals from the front of the others'.  Items
+of tasks the user has demanded, by clicking in a track that is still being
+loaded, go in a queue that all workers look at first.
 
 *//*******************************************************************/
 
 #ifndef __AUDACITY_ODMANAGER__
 #define __AUDACITY_ODMANAGER__
 
+#include <deque>
 #include <vector>
 #include "ODTask.h"
 #include "ODTaskThread.h"
@@ -36,8 +45,8 @@ DECLARE_EXPORTED_EVENT_TYPE(AUDACITY_DLL_API, EVT_ODTASK_UPDATE, -1)
 
 ///wxstring compare function for sorting case, which is needed to load correctly.
 int CompareNoCaseFileName(const wxString& first, const wxString& second);
-/// A singleton that manages currently running Tasks on an arbitrary
-/// number of threads.
+/// A singleton that manages currently running Tasks on a pool of
+/// worker threads.
 class WaveTrack;
 class ODWaveTrackTaskQueue;
 class ODManager
@@ -61,6 +70,9 @@ class ODManager
    ///Reduces the count of current threads running.  Meant to be called when ODTaskThreads end in their own threads.  Thread-safe.
    void DecrementCurrentThreads();
 
+   ///Runs work items until Quit().  Called by the ODTaskThread with this index.
+   void WorkerLoop(int index);
+
    ///Adds a wavetrack, creates a queue member.
    void AddNewTask(ODTask* task, bool lockMutex=true);
 
@@ -80,9 +92,11 @@ class ODManager
    ///replace the wavetrack whose wavecache the gui watches for updates
    void ReplaceWaveTrack(WaveTrack* oldTrack,WaveTrack* newTrack);
 
-   ///Adds a task to the running queue.  Threas-safe.
+   ///Adds work items for a task to the worker queues.  Threas-safe.
    void AddTask(ODTask* task);
 
+   ///Takes the work items of a task out of the worker queues, and waits for workers that are running them.
+   ///After this the task can be deleted.
    void RemoveTaskIfInQueue(ODTask* task);
 
    ///sets a flag that is set if we have loaded some OD blockfiles from PCM.
@@ -110,6 +124,8 @@ class ODManager
    static void Pause(bool pause = true);
    static void Resume();
 
+   ///libsndfile keeps some global state when opening and closing files, so hold this
+   ///around sf_open*() and sf_close().  Reading a SNDFILE that only one thread uses is safe without it.
    static void LockLibSndFileMutex();
    static void UnlockLibSndFileMutex();
 
@@ -129,6 +145,17 @@ class ODManager
    ///Remove references in our array to Tasks that have been completed/Schedule new ones
    void UpdateQueues();
 
+   bool IsPaused();
+
+   ///Gets the next work item for a worker.  Call with mWorkItemsMutex held.
+   ODTask* GetWorkItem(int index);
+
+   ///whether any worker is running an item of the task or has one queued.
+   bool HasWorkItems(ODTask* task);
+
+   ///Moves the work items of a task to the front of the demanded items.
+   void PrioritizeTask(ODTask* task);
+
    //instance
    static ODManager* pMan;
 
@@ -136,10 +163,25 @@ class ODManager
    std::vector<ODWaveTrackTaskQueue*> mQueues;
    ODLock mQueuesMutex;
 
-   //List of current Task to do.
-   std::vector<ODTask*> mTasks;
-   //mutex for above variable
-   ODLock mTasksMutex;
+   //Work items to do; one queue per worker, and the demanded items which go first.
+   //Items take a block's worth of work, so a single lock is no bottleneck.
+   std::vector< std::deque<ODTask*> > mWorkQueues;
+   std::deque<ODTask*> mDemandedItems;
+   //the tasks whose items go in mDemandedItems
+   std::vector<ODTask*> mDemandedTasks;
+   //the task each worker is running an item of, or NULL
+   std::vector<ODTask*> mRunningTasks;
+   //tasks being taken out by RemoveTaskIfInQueue(), whose items the workers must not put back.
+   std::vector<ODTask*> mRemovedTasks;
+   //the queue the next item added goes to
+   int mNextWorkQueue;
+   //counts items done, to wake the manager loop every so often
+   int mItemsDone;
+   volatile bool mStopWorkers;
+   //mutex for above variables
+   ODLock mWorkItemsMutex;
+   ODCondition* mWorkAvailableCond;
+   ODCondition* mWorkItemDoneCond;
 
    //global pause switch for OD
    volatile bool mPause;
@@ -152,7 +194,7 @@ class ODManager
    //mutex for above variable
    ODLock mCurrentThreadsMutex;
 
-   ///Maximum number of threads allowed out.
+   ///Number of worker threads in the pool.
    int mMaxThreads;
 
    volatile bool mTerminate;
@@ -164,6 +206,8 @@ class ODManager
    //for the queue not empty comdition
    ODLock         mQueueNotEmptyCondLock;
    ODCondition*   mQueueNotEmptyCond;
+   //set when the condition is signalled, so that a signal while the loop is busy isn't lost
+   bool           mQueueSignalled;
 
 #ifdef __WXMAC__
 
@@ -28,149 +28,162 @@ in a background thread.
 
 DEFINE_EVENT_TYPE(EVT_ODTASK_COMPLETE)
 
+//how much progress a task makes between the times it marks its project as changed.
+#define kNotifyPercentStep 0.05f
+
 /// Constructs an ODTask
 ODTask::ODTask()
 {
 
    static int sTaskNumber=0;
    mPercentComplete=0;
-   mDoingTask=false;
+   mTaskStarted=false;
    mTerminate = false;
    mNeedsODUpdate=false;
-   mIsRunning = false;
+   mRunningItems = 0;
+   mNotifiedPercent = 0;
+   mNotifiedComplete = false;
+   mNotRunningCond = new ODCondition(&mIsRunningMutex);
 
    mTaskNumber=sTaskNumber++;
 
    mDemandSample=0;
 }
 
+ODTask::~ODTask()
+{
+   delete mNotRunningCond;
+}
+
 //outside code must ensure this task is not scheduled again.
 void ODTask::TerminateAndBlock()
 {
    //one mutex pair for the value of mTerminate
    mTerminateMutex.Lock();
    mTerminate=true;
-   //release all data the derived class may have allocated
    mTerminateMutex.Unlock();
 
-   //and one mutex pair for the exit of the function
-   mBlockUntilTerminateMutex.Lock();
-//TODO lock mTerminate?
-   mBlockUntilTerminateMutex.Unlock();
+   //wait till no worker thread is in DoWorkItem() to terminate.  None can start
+   //one now, since they check mTerminate while holding mIsRunningMutex.
+   mIsRunningMutex.Lock();
+   while(mRunningItems > 0)
+      mNotRunningCond->Wait();
+   mIsRunningMutex.Unlock();
 
-   //wait till we are out of doSome() to terminate.
+   //release all data the derived class may have allocated
    Terminate();
 }
 
-///Do a modular part of the task.  For example, if the task is to load the entire file, load one BlockFile.
+///Do one work item of the task.  For example, if the task is to load the entire file, load one BlockFile.
 ///Relies on DoSomeInternal(), which is the subclasses must implement.
-///@param amountWork the percent amount of the total job to do.  1.0 represents the entire job.  the default of 0.0
-/// will do the smallest unit of work possible
-void ODTask::DoSome(float amountWork)
+///@return whether there is more work to hand out.
+bool ODTask::DoWorkItem()
 {
-   SetIsRunning(true);
-   mBlockUntilTerminateMutex.Lock();
-
-//   printf("%s %i subtask starting on new thread with priority\n", GetTaskName(),GetTaskNumber());
-
-   mDoingTask=mTaskStarted=true;
-
-   float workUntil = amountWork+PercentComplete();
+   bool terminate;
 
-
-
-   //check periodically to see if we should exit.
+   //check to see if we should exit.
+   mIsRunningMutex.Lock();
    mTerminateMutex.Lock();
-   if(mTerminate)
+   terminate = mTerminate;
+   mTerminateMutex.Unlock();
+   if(terminate)
    {
-      mTerminateMutex.Unlock();
-      SetIsRunning(false);
-      mBlockUntilTerminateMutex.Unlock();
-      return;
+      mIsRunningMutex.Unlock();
+      return false;
    }
-   mTerminateMutex.Unlock();
-
-   Update();
+   mRunningItems++;
+   mIsRunningMutex.Unlock();
 
+//   printf("%s %i work item starting on new thread\n", GetTaskName(),GetTaskNumber());
 
-   if(UsesCustomWorkUntilPercentage())
-      workUntil = ComputeNextWorkUntilPercentageComplete();
+   //the first work item puts the blocks in order; the others wait for it.
+   mUpdateMutex.Lock();
+   if(!mTaskStarted)
+   {
+      Update();
+      ResetNeedsODUpdate();
+      mTaskStarted=true;
+   }
+   mUpdateMutex.Unlock();
 
-   if(workUntil<PercentComplete())
-      workUntil = PercentComplete();
+   //check to see if ondemand has been called
+   if(GetNeedsODUpdate() && PercentComplete() < 1.0)
+      ODUpdate();
 
    //Do Some of the task.
-
-   mTerminateMutex.Lock();
-   while(PercentComplete() < workUntil && PercentComplete() < 1.0 && !mTerminate)
+   if(PercentComplete() < 1.0)
    {
-      wxThread::This()->Yield();
-      //release within the loop so we can cut the number of iterations short
-
-      DoSomeInternal(); //keep the terminate mutex on so we don't remo
-      mTerminateMutex.Unlock();
-      //check to see if ondemand has been called
-      if(GetNeedsODUpdate() && PercentComplete() < 1.0)
-         ODUpdate();
+      if(GetMaxWorkers() > 1)
+         DoSomeInternal();
+      else
+      {
+         //a task that runs on one thread at a time need not worry
+         //about being reordered from another in the middle of its work.
+         ODLocker locker(mUpdateMutex);
+         DoSomeInternal();
+      }
+   }
 
+   bool more = IsWorkLeft();
+   float percent = PercentComplete();
+   bool complete = percent >= 1.0;
 
-      //But add the mutex lock back before we check the value again.
-      mTerminateMutex.Lock();
-   }
+   mTerminateMutex.Lock();
+   terminate = mTerminate;
    mTerminateMutex.Unlock();
-   mDoingTask=false;
 
-   mTerminateMutex.Lock();
-   //if it is not done, put it back onto the ODManager queue.
-   if(PercentComplete() < 1.0&& !mTerminate)
+   //tell the projects about it every so often, and when it is done.
+   bool notify = false;
+   mIsRunningMutex.Lock();
+   if(!terminate)
    {
-      ODManager::Instance()->AddTask(this);
-
-      //we did a bit of progress - we should allow a resave.
-      AudacityProject::AllProjectsDeleteLock();
-      for(unsigned i=0; i<gAudacityProjects.GetCount(); i++)
+      if(complete)
+      {
+         notify = !mNotifiedComplete;
+         mNotifiedComplete = true;
+      }
+      else
       {
-         if(IsTaskAssociatedWithProject(gAudacityProjects[i]))
+         //more work can turn up, as when a track is merged into the task.
+         mNotifiedComplete = false;
+         if(percent >= mNotifiedPercent + kNotifyPercentStep)
          {
-            //mark the changes so that the project can be resaved.
-            gAudacityProjects[i]->GetUndoManager()->SetODChangesFlag();
-            break;
+            notify = true;
+            mNotifiedPercent = percent;
          }
       }
-      AudacityProject::AllProjectsDeleteUnlock();
+   }
+   mIsRunningMutex.Unlock();
 
+   if(notify)
+      NotifyProjects(complete);
 
-//      printf("%s %i is %f done\n", GetTaskName(),GetTaskNumber(),PercentComplete());
-   }
-   else
-   {
-      //for profiling, uncomment and look in audacity.app/exe's folder for AudacityProfile.txt
-      //static int tempLog =0;
-      //if(++tempLog % 5==0)
-         //END_TASK_PROFILING("On Demand Drag and Drop 5 80 mb files into audacity, 5 wavs per task");
-      //END_TASK_PROFILING("On Demand open an 80 mb wav stereo file");
+   mIsRunningMutex.Lock();
+   if(--mRunningItems == 0)
+      mNotRunningCond->Broadcast();
+   mIsRunningMutex.Unlock();
 
-      wxCommandEvent event( EVT_ODTASK_COMPLETE );
-      AudacityProject::AllProjectsDeleteLock();
+   return more && !terminate;
+}
 
-      for(unsigned i=0; i<gAudacityProjects.GetCount(); i++)
+///tells the projects of the task's tracks about its progress, and that it is complete if it is.
+void ODTask::NotifyProjects(bool complete)
+{
+   wxCommandEvent event( EVT_ODTASK_COMPLETE );
+   AudacityProject::AllProjectsDeleteLock();
+   for(unsigned i=0; i<gAudacityProjects.GetCount(); i++)
+   {
+      if(IsTaskAssociatedWithProject(gAudacityProjects[i]))
       {
-         if(IsTaskAssociatedWithProject(gAudacityProjects[i]))
-         {
-            //this assumes tasks are only associated with one project.
+         //this assumes tasks are only associated with one project.
+         if(complete)
             gAudacityProjects[i]->GetEventHandler()->AddPendingEvent(event);
-            //mark the changes so that the project can be resaved.
-            gAudacityProjects[i]->GetUndoManager()->SetODChangesFlag();
-            break;
-         }
+         //mark the changes so that the project can be resaved.
+         gAudacityProjects[i]->GetUndoManager()->SetODChangesFlag();
+         break;
       }
-      AudacityProject::AllProjectsDeleteUnlock();
-
-//      printf("%s %i complete\n", GetTaskName(),GetTaskNumber());
    }
-   mTerminateMutex.Unlock();
-   SetIsRunning(false);
-   mBlockUntilTerminateMutex.Unlock();
+   AudacityProject::AllProjectsDeleteUnlock();
 }
 
 bool ODTask::IsTaskAssociatedWithProject(AudacityProject* proj)
@@ -206,22 +219,16 @@ bool ODTask::IsTaskAssociatedWithProject(AudacityProject* proj)
 
 void ODTask::ODUpdate()
 {
+   ODLocker locker(mUpdateMutex);
    Update();
    ResetNeedsODUpdate();
 }
 
-void ODTask::SetIsRunning(bool value)
-{
-   mIsRunningMutex.Lock();
-   mIsRunning=value;
-   mIsRunningMutex.Unlock();
-}
-
 bool ODTask::IsRunning()
 {
    bool ret;
    mIsRunningMutex.Lock();
-   ret= mIsRunning;
+   ret= mRunningItems > 0;
    mIsRunningMutex.Unlock();
    return ret;
 }
@@ -43,6 +43,7 @@ class ODTask
       eODFLAC     =  0x00000001,
       eODMP3      =  0x00000002,
       eODFFMPEG   =  0x00000004,
+      eODOGG      =  0x00000008,
       eODPCMSummary  = 0x00001000,
       eODOTHER    =  0x10000000,
    } ODTypeEnum;
@@ -51,7 +52,7 @@ class ODTask
    /// Constructs an ODTask
    ODTask();
 
-   virtual ~ODTask(){};
+   virtual ~ODTask();
 
    //clones everything except information about the tracks.
    virtual ODTask* Clone()=0;
@@ -60,20 +61,18 @@ class ODTask
    virtual unsigned int GetODType(){return eODNone;}
 
 
-///Do a modular part of the task.  For example, if the task is to load the entire file, load one BlockFile.
-///Relies on DoSomeInternal(), which is the subclasses must implement.
-///@param amountWork the percent amount of the total job to do.  1.0 represents the entire job.  the default of 0.0
-/// will do the smallest unit of work possible
-   void DoSome(float amountWork=0.0);
+   ///Do one work item of the task, that is, the smallest unit of work; for example, if the task is
+   ///to load the entire file, load one BlockFile.  Relies on DoSomeInternal(), which the subclasses must implement.
+   ///Called from the ODManager worker threads, by as many at once as GetMaxWorkers() allows.
+   ///@return whether there is more work to hand out.
+   bool DoWorkItem();
 
-   ///Call DoSome until PercentComplete >= 1.0
-   void DoAll();
+   ///How many worker threads may run DoWorkItem() at the same time.  Subclasses that return more
+   ///than one must make DoSomeInternal() safe to run on several threads at once.
+   virtual int GetMaxWorkers(){return 1;}
 
    virtual float PercentComplete();
 
-   virtual bool UsesCustomWorkUntilPercentage(){return false;}
-   virtual float ComputeNextWorkUntilPercentageComplete(){return 1.0;}
-
    ///returns whether or not this task and another task can merge together, as when we make two mono tracks stereo.
    ///for Loading/Summarizing, this is not an issue because the entire track is processed
    ///Effects that affect portions of a track will need to check this.
@@ -133,27 +132,32 @@ class ODTask
    ///Does the smallest unit of work for this task.
    virtual void DoSomeInternal() = 0;
 
-   ///virtual method called before DoSomeInternal is used from DoSome.
+   ///whether any work is left that a worker thread could start on now.  Tasks that allow several
+   ///workers can return false while the last of their work is still being done.
+   virtual bool IsWorkLeft(){return PercentComplete() < 1.0;}
+
+   ///tells the projects of the task's tracks about its progress, and that it is complete if it is.
+   void NotifyProjects(bool complete);
+
+   ///virtual method called before the first DoSomeInternal from DoWorkItem.
    virtual void Update(){}
 
-   ///virtual method called in DoSome everytime the user has demanded some OD function so that the
+   ///virtual method called in DoWorkItem everytime the user has demanded some OD function so that the
    ///ODTask can readjust its computation order.  By default just calls Update(), but subclasses with
    ///special needs can override this
    virtual void ODUpdate();
 
-   void SetIsRunning(bool value);
-
 
 
    int   mTaskNumber;
    volatile float mPercentComplete;
    ODLock mPercentCompleteMutex;
-   volatile bool  mDoingTask;
-   volatile bool  mTaskStarted;
    volatile bool mTerminate;
    ODLock mTerminateMutex;
-   //for a function not a member var.
-   ODLock mBlockUntilTerminateMutex;
+
+   //Update() is run by one thread at a time; the first work item runs it before any other starts
+   bool  mTaskStarted;
+   ODLock mUpdateMutex;
 
    std::vector<WaveTrack*> mWaveTracks;
    ODLock     mWaveTrackMutex;
@@ -161,8 +165,13 @@ class ODTask
    volatile sampleCount mDemandSample;
    ODLock      mDemandSampleMutex;
 
-   volatile bool mIsRunning;
+   //the number of worker threads in DoWorkItem(), and what has been told to the projects.
+   int mRunningItems;
+   float mNotifiedPercent;
+   bool mNotifiedComplete;
    ODLock mIsRunningMutex;
+   //signalled when mRunningItems goes to zero, for TerminateAndBlock().
+   ODCondition* mNotRunningCond;
 
 
    private:
@@ -11,22 +11,22 @@
 ******************************************************************//**
 
 \class ODTaskThread
-\brief A thread that executes a part of the task specfied by an ODTask.
+\brief One of the worker threads of the ODManager, which run the work
+items of ODTasks until the ODManager quits.
 
 *//*******************************************************************/
 
 
 #include "ODTaskThread.h"
-#include "ODTask.h"
 #include "ODManager.h"
 
 
-ODTaskThread::ODTaskThread(ODTask* task)
+ODTaskThread::ODTaskThread(int workerIndex)
 #ifndef __WXMAC__
 : wxThread()
 #endif
 {
-   mTask=task;
+   mWorkerIndex=workerIndex;
 #ifdef __WXMAC__
    mDestroy = false;
    mThread = NULL;
@@ -44,8 +44,7 @@ void *ODTaskThread::Entry()
 {
    //TODO: Figure out why this has no effect at all.
    //wxThread::This()->SetPriority( 40);
-   //Do at least 5 percent of the task
-   mTask->DoSome(0.05f);
+   ODManager::Instance()->WorkerLoop(mWorkerIndex);
 
    //release the thread count so that the ODManager knows how many active threads are alive.
    ODManager::Instance()->DecrementCurrentThreads();
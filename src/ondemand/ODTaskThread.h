@@ -11,7 +11,8 @@
 ******************************************************************//**
 
 \class ODTaskThread
-\brief A thread that executes a part of the task specfied by an ODTask.
+\brief One of the worker threads of the ODManager, which run the work
+items of ODTasks until the ODManager quits.
 
 *//*******************************************************************/
 
@@ -25,8 +26,6 @@
 
 #include "../Audacity.h"	// contains the set-up of AUDACITY_DLL_API
 
-class ODTask;
-
 #ifdef __WXMAC__
 
 // On Mac OS X, it's better not to use the wxThread class.
@@ -38,7 +37,7 @@ class ODTask;
 class ODTaskThread {
  public:
    typedef int ExitCode;
-   ODTaskThread(ODTask* task);
+   ODTaskThread(int workerIndex);
    /*ExitCode*/ void Entry();
    void Create() {}
    void Delete() {
@@ -77,7 +76,7 @@ class ODTaskThread {
    bool mDestroy;
    pthread_t mThread;
 
-   ODTask* mTask;
+   int mWorkerIndex;
 };
 
 class ODLock {
@@ -129,14 +128,14 @@ class ODTaskThread : public wxThread
 {
 public:
    ///Constructs a ODTaskThread
-   ///@param task the task to be launched as an
-   ODTaskThread(ODTask* task);
+   ///@param workerIndex which of the ODManager's work queues is this thread's own
+   ODTaskThread(int workerIndex);
 
 
 protected:
-   ///Executes a part of the task
+   ///Runs work items until the ODManager quits
    virtual void* Entry();
-   ODTask* mTask;
+   int mWorkerIndex;
 
 };
 
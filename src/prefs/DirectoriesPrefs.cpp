@@ -36,6 +36,8 @@
 #include "../AudacityApp.h"
 #include "../Internat.h"
 #include "../ShuttleGui.h"
+#include "../WaveformCache.h"
+#include "../BlockPrefetcher.h"
 #include "DirectoriesPrefs.h"
 
 enum {
@@ -100,6 +102,27 @@ void DirectoriesPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(_("Project data"));
+   {
+      S.TieCheckBox(_("Store audio data in &packed container files (for very large new projects)"),
+                    wxT("/Directories/PackedBlockFiles"),
+                    false);
+
+      S.StartTwoColumn();
+      {
+         S.TieNumericTextBox(_("&Waveform display cache (MB):"),
+                             wxT("/Directories/WaveformCacheMB"),
+                             64,
+                             9);
+         S.TieNumericTextBox(_("&Read-ahead cache per project (MB):"),
+                             wxT("/Directories/ReadAheadMB"),
+                             32,
+                             9);
+      }
+      S.EndTwoColumn();
+   }
+   S.EndStatic();
+
 #ifdef DEPRECATED_AUDIO_CACHE
    // See http://bugzilla.audacityteam.org/show_bug.cgi?id=545.
    S.StartStatic(_("Audio cache"));
@@ -240,5 +263,15 @@ bool DirectoriesPrefs::Apply()
    ShuttleGui S(this, eIsSavingToPrefs);
    PopulateOrExchange(S);
 
+   long cacheMB = gPrefs->Read(wxT("/Directories/WaveformCacheMB"), 64L);
+   if (cacheMB < 0)
+      cacheMB = 0;
+   WaveformCache::Get().SetBudget(cacheMB * 1048576);
+
+   long readAheadMB = gPrefs->Read(wxT("/Directories/ReadAheadMB"), 32L);
+   if (readAheadMB < 0)
+      readAheadMB = 0;
+   BlockPrefetcher::SetBudget(readAheadMB * 1048576);
+
    return true;
 }
@@ -61,6 +61,9 @@ void ImportExportPrefs::PopulateOrExchange(ShuttleGui & S)
       }
       S.EndRadioButtonGroup();
 
+      S.TieCheckBox(_("&Decode compressed audio files (MP3, Ogg, FLAC) while editing (faster)"),
+                    wxT("/FileFormats/DecodeCompressedOnDemand"),
+                    true);
       S.TieCheckBox(_("&Normalize all tracks in project"),
                     wxT("/AudioFiles/NormalizeOnLoad"),
                     false);
@@ -70,6 +70,14 @@ void ProjectsPrefs::PopulateOrExchange(ShuttleGui & S)
       S.EndRadioButtonGroup();
    }
    S.EndStatic();
+
+   S.StartStatic(_("Project files"));
+   {
+      S.TieCheckBox(_("Save projects in compact &binary format"),
+                    wxT("/FileFormats/BinaryProjects"),
+                    false);
+   }
+   S.EndStatic();
 }
 
 bool ProjectsPrefs::Apply()
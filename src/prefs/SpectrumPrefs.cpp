@@ -25,6 +25,7 @@
 #include "../Project.h"
 #include "../ShuttleGui.h"
 #include "../FFT.h"
+#include "../FFTPlanner.h"
 
 #include <algorithm>
 
@@ -372,7 +373,7 @@ BEGIN_EVENT_TABLE(SpectrumPrefs, PrefsPanel)
 END_EVENT_TABLE()
 
 SpectrogramSettings::SpectrogramSettings()
-: hFFT(0)
+: fftPlan(0)
 , window(0)
 {
    UpdatePrefs();
@@ -457,10 +458,8 @@ SpectrogramSettings::~SpectrogramSettings()
 void SpectrogramSettings::DestroyWindows()
 {
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   if (hFFT != NULL) {
-      EndFFT(hFFT);
-      hFFT = NULL;
-   }
+   // The planner keeps the plan for other users
+   fftPlan = NULL;
    if (window != NULL) {
       delete[] window;
       window = NULL;
@@ -533,15 +532,13 @@ namespace
 void SpectrogramSettings::CacheWindows() const
 {
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   if (hFFT == NULL || window == NULL) {
+   if (fftPlan == NULL || window == NULL) {
 
       double scale;
       const int fftLen = windowSize * zeroPaddingFactor;
       const int padding = (windowSize * (zeroPaddingFactor - 1)) / 2;
 
-      if (hFFT != NULL)
-         EndFFT(hFFT);
-      hFFT = InitializeFFT(fftLen);
+      fftPlan = FFTPlanner::Get().GetPlan(fftLen);
       RecreateWindow(window, WINDOW, fftLen, padding, windowType, windowSize, scale);
    }
 #endif // EXPERIMENTAL_USE_REALFFTF
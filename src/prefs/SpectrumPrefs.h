@@ -30,7 +30,7 @@
 
 #include "PrefsPanel.h"
 
-struct FFTParam;
+class FFTPlan;
 
 class SpectrumPrefs:public PrefsPanel
 {
@@ -122,7 +122,7 @@ public:
 
 #ifdef EXPERIMENTAL_USE_REALFFTF
    // Variables used for computing the spectrum
-   mutable FFTParam      *hFFT;
+   mutable const FFTPlan *fftPlan;
    mutable float         *window;
 #endif
 };
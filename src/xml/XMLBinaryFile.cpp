@@ -0,0 +1,919 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  XMLBinaryFile.cpp
+
+*******************************************************************//**
+
+\class XMLBinaryFileWriter
+\brief Writes the calls of an XMLWriter as a compact binary stream,
+for projects too large to save and load quickly as XML text.
+
+*//****************************************************************//**
+
+\class XMLBinaryFileReader
+\brief Maps a file written by XMLBinaryFileWriter and replays it, to
+an XMLTagHandler as XMLFileReader would, or to another XMLWriter.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include <wx/defs.h>
+#include <wx/filefn.h>
+#include <wx/intl.h>
+
+#include <string.h>
+
+#if defined(__WXMSW__)
+   #include <windows.h>
+   #include <wx/msw/winundef.h>
+#else
+   #include <sys/types.h>
+   #include <sys/stat.h>
+   #include <sys/mman.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+#include "../Internat.h"
+#include "XMLBinaryFile.h"
+#include "XMLFileReader.h"
+
+// The file is the ident, a byte of version, then a stream of fields.
+// As in AutoSaveFile, each element or attribute name is given a number
+// the first time it is used, in an FT_Name field ahead of it, so most
+// fields are a type byte, a two-byte name number and a value.  Numbers
+// keep their type and binary value, so nothing is formatted when saving
+// and the attributes of the blocks of a long track take a few bytes
+// each.  Unlike AutoSaveFile, the file may move between machines: all
+// numbers are little-endian, strings are UTF-8, and lengths are four
+// bytes.
+//
+// Fields, after the type byte:
+//
+//    FT_StartTag, FT_EndTag              name
+//    FT_String                           name, string
+//    FT_Int                              name, 4 bytes
+//    FT_Bool                             name, 1 byte
+//    FT_Long, FT_LongLong, FT_SizeT      name, 8 bytes
+//    FT_Float                            name, 4 bytes, 4 bytes of digits
+//    FT_Double                           name, 8 bytes, 4 bytes of digits
+//    FT_Data, FT_Raw, FT_SubTree         string
+//    FT_Name                             name, string
+//
+// where a name is its two-byte number and a string is its four-byte
+// length in bytes, then its bytes.
+
+enum FieldTypes
+{
+   FT_StartTag,
+   FT_EndTag,
+   FT_String,
+   FT_Int,
+   FT_Bool,
+   FT_Long,
+   FT_LongLong,
+   FT_SizeT,
+   FT_Float,
+   FT_Double,
+   FT_Data,
+   FT_Raw,
+   FT_SubTree,
+   FT_Name
+};
+
+// Bytes gathered before writing them to the file
+static const size_t kWriteBufferSize = 65536;
+
+///
+/// XMLBinaryFileWriter class
+///
+XMLBinaryFileWriter::XMLBinaryFileWriter()
+{
+   mBuffer.reserve(kWriteBufferSize + 1024);
+}
+
+XMLBinaryFileWriter::~XMLBinaryFileWriter()
+{
+   if (IsOpened()) {
+      Close();
+   }
+}
+
+void XMLBinaryFileWriter::Open(const wxString &name)
+{
+   if (!wxFFile::Open(name, wxT("wb")))
+      throw new XMLFileWriterException(_("Error Opening File"));
+
+   const size_t len = strlen(XMLBinaryIdent);
+   mBuffer.insert(mBuffer.end(), XMLBinaryIdent, XMLBinaryIdent + len);
+   PutByte(XMLBinaryVersion);
+}
+
+void XMLBinaryFileWriter::Close()
+{
+   while (mTagstack.GetCount()) {
+      EndTag(mTagstack[0]);
+   }
+
+   Flush();
+
+   // As in XMLFileWriter, try to close even if flushing fails
+   if (!wxFFile::Flush())
+   {
+      wxFFile::Close();
+      throw new XMLFileWriterException(_("Error Flushing File"));
+   }
+
+   if (!wxFFile::Close())
+      throw new XMLFileWriterException(_("Error Closing File"));
+}
+
+void XMLBinaryFileWriter::StartTag(const wxString &name)
+{
+   PutByte(FT_StartTag);
+   PutName(name);
+
+   mTagstack.Insert(name, 0);
+   mDepth++;
+}
+
+void XMLBinaryFileWriter::EndTag(const wxString &name)
+{
+   PutByte(FT_EndTag);
+   PutName(name);
+
+   if (mTagstack.GetCount() > 0 && mTagstack[0] == name)
+      mTagstack.RemoveAt(0);
+   mDepth--;
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, const wxString &value)
+{
+   PutByte(FT_String);
+   PutName(name);
+   PutString(value);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, const wxChar *value)
+{
+   WriteAttr(name, wxString(value));
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, int value)
+{
+   PutByte(FT_Int);
+   PutName(name);
+   PutInt((wxUint32)value);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, bool value)
+{
+   PutByte(FT_Bool);
+   PutName(name);
+   PutByte(value ? 1 : 0);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, long value)
+{
+   PutByte(FT_Long);
+   PutName(name);
+   PutLongLong((wxUint64)(long long)value);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, long long value)
+{
+   PutByte(FT_LongLong);
+   PutName(name);
+   PutLongLong((wxUint64)value);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, size_t value)
+{
+   PutByte(FT_SizeT);
+   PutName(name);
+   PutLongLong((wxUint64)value);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, float value, int digits)
+{
+   wxUint32 bits;
+   memcpy(&bits, &value, sizeof(bits));
+
+   PutByte(FT_Float);
+   PutName(name);
+   PutInt(bits);
+   PutInt((wxUint32)digits);
+}
+
+void XMLBinaryFileWriter::WriteAttr(const wxString &name, double value, int digits)
+{
+   wxUint64 bits;
+   memcpy(&bits, &value, sizeof(bits));
+
+   PutByte(FT_Double);
+   PutName(name);
+   PutLongLong(bits);
+   PutInt((wxUint32)digits);
+}
+
+void XMLBinaryFileWriter::WriteData(const wxString &value)
+{
+   PutByte(FT_Data);
+   PutString(value);
+}
+
+void XMLBinaryFileWriter::WriteSubTree(const wxString &value)
+{
+   PutByte(FT_SubTree);
+   PutString(value);
+}
+
+void XMLBinaryFileWriter::Write(const wxString &data)
+{
+   PutByte(FT_Raw);
+   PutString(data);
+}
+
+void XMLBinaryFileWriter::PutByte(int value)
+{
+   mBuffer.push_back((char)value);
+}
+
+void XMLBinaryFileWriter::PutInt(wxUint32 value)
+{
+   for (int i = 0; i < 4; i++)
+      mBuffer.push_back((char)(value >> (8 * i)));
+}
+
+void XMLBinaryFileWriter::PutLongLong(wxUint64 value)
+{
+   for (int i = 0; i < 8; i++)
+      mBuffer.push_back((char)(value >> (8 * i)));
+}
+
+void XMLBinaryFileWriter::PutString(const wxString &value)
+{
+   wxCharBuffer utf8 = value.mb_str(wxConvUTF8);
+   const char *bytes = utf8.data();
+   const size_t len = bytes ? strlen(bytes) : 0;
+
+   PutInt((wxUint32)len);
+   mBuffer.insert(mBuffer.end(), bytes, bytes + len);
+
+   if (mBuffer.size() >= kWriteBufferSize)
+      Flush();
+}
+
+void XMLBinaryFileWriter::PutName(const wxString &name)
+{
+   std::map<wxString, int>::iterator it = mNames.find(name);
+   int id;
+   if (it != mNames.end())
+      id = it->second;
+   else {
+      // Define the name ahead of the field that uses it.  The field's
+      // own type byte is already in the buffer, so put this before it.
+      id = mNames.size();
+      mNames[name] = id;
+
+      const char type = mBuffer.back();
+      mBuffer.pop_back();
+      PutByte(FT_Name);
+      PutByte(id & 0xff);
+      PutByte(id >> 8);
+      PutString(name);
+      PutByte(type);
+   }
+
+   PutByte(id & 0xff);
+   PutByte(id >> 8);
+
+   if (mBuffer.size() >= kWriteBufferSize)
+      Flush();
+}
+
+void XMLBinaryFileWriter::Flush()
+{
+   if (mBuffer.empty())
+      return;
+
+   if (wxFFile::Write(&mBuffer[0], mBuffer.size()) != mBuffer.size())
+   {
+      // As in XMLFileWriter, close so that the file can be deleted
+      wxFFile::Close();
+      throw new XMLFileWriterException(_("Error Writing to File"));
+   }
+   mBuffer.clear();
+}
+
+namespace {
+
+// Copies what an XMLFileReader reads into an XMLWriter
+class XMLCopyHandler : public XMLTagHandler
+{
+public:
+   XMLCopyHandler(XMLWriter &out) : mOut(out) {}
+
+   virtual bool HandleXMLTag(const wxChar *tag, const wxChar **attrs)
+   {
+      mOut.StartTag(tag);
+      for (; *attrs; attrs += 2)
+         mOut.WriteAttr(attrs[0], attrs[1]);
+      return true;
+   }
+
+   virtual void HandleXMLEndTag(const wxChar *tag)
+   {
+      mOut.EndTag(tag);
+   }
+
+   virtual void HandleXMLContent(const wxString &content)
+   {
+      // Leave out the indenting between tags
+      if (!content.Strip(wxString::both).IsEmpty())
+         mOut.WriteData(content);
+   }
+
+   virtual XMLTagHandler *HandleXMLChild(const wxChar * WXUNUSED(tag))
+   {
+      return this;
+   }
+
+private:
+   XMLWriter &mOut;
+};
+
+}
+
+// static
+bool XMLBinaryFileWriter::ConvertFromXML(const wxString &xmlName,
+                                         const wxString &binaryName,
+                                         wxString &error)
+{
+   XMLBinaryFileWriter out;
+   try
+   {
+      out.Open(binaryName);
+      // The declaration isn't passed to handlers; give the usual one
+      out.Write(wxT("<?xml version=\"1.0\" standalone=\"no\" ?>\n"));
+
+      XMLCopyHandler copier(out);
+      XMLFileReader reader;
+      if (!reader.Parse(&copier, xmlName)) {
+         error = reader.GetErrorStr();
+         out.wxFFile::Close();
+         wxRemoveFile(binaryName);
+         return false;
+      }
+
+      out.Close();
+   }
+   catch (XMLFileWriterException* pException)
+   {
+      error = pException->GetMessage();
+      delete pException;
+      wxRemoveFile(binaryName);
+      return false;
+   }
+
+   return true;
+}
+
+namespace {
+
+// Reads the fields of a mapped file, failing on any that would run
+// past its end
+class FieldCursor
+{
+public:
+   FieldCursor(const char *begin, const char *end)
+      : mPos(begin), mEnd(end), mOK(true)
+   {
+   }
+
+   bool AtEnd() const { return mPos >= mEnd; }
+   bool OK() const { return mOK; }
+
+   int GetByte()
+   {
+      if (!Need(1))
+         return -1;
+      return (unsigned char)*mPos++;
+   }
+
+   wxUint32 GetInt()
+   {
+      if (!Need(4))
+         return 0;
+      wxUint32 value = 0;
+      for (int i = 0; i < 4; i++)
+         value |= (wxUint32)(unsigned char)mPos[i] << (8 * i);
+      mPos += 4;
+      return value;
+   }
+
+   wxUint64 GetLongLong()
+   {
+      if (!Need(8))
+         return 0;
+      wxUint64 value = 0;
+      for (int i = 0; i < 8; i++)
+         value |= (wxUint64)(unsigned char)mPos[i] << (8 * i);
+      mPos += 8;
+      return value;
+   }
+
+   int GetId()
+   {
+      if (!Need(2))
+         return -1;
+      int id = (unsigned char)mPos[0] | ((unsigned char)mPos[1] << 8);
+      mPos += 2;
+      return id;
+   }
+
+   wxString GetString()
+   {
+      const wxUint32 len = GetInt();
+      if (!Need(len))
+         return wxString();
+      wxString value(mPos, wxConvUTF8, len);
+      mPos += len;
+      return value;
+   }
+
+   float GetFloat()
+   {
+      wxUint32 bits = GetInt();
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+   }
+
+   double GetDouble()
+   {
+      wxUint64 bits = GetLongLong();
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+   }
+
+private:
+   bool Need(size_t len)
+   {
+      if (mOK && (size_t)(mEnd - mPos) >= len)
+         return true;
+      mOK = false;
+      return false;
+   }
+
+   const char *mPos;
+   const char *mEnd;
+   bool mOK;
+};
+
+// Formats as XMLWriter does, without the cost of wxString::Format
+wxString FormatInteger(long long value)
+{
+   wxChar digits[24];
+   wxChar *p = digits + 24;
+   *--p = 0;
+   unsigned long long magnitude =
+      value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+   do {
+      *--p = wxT('0') + (wxChar)(magnitude % 10);
+      magnitude /= 10;
+   } while (magnitude);
+   if (value < 0)
+      *--p = wxT('-');
+   return wxString(p);
+}
+
+// Hands what it is written to XMLTagHandlers, as XMLFileReader hands
+// them what expat reads.  A start tag goes to its handler when the
+// next field after its attributes arrives.
+class TagHandlerWriter : public XMLWriter
+{
+public:
+   TagHandlerWriter(XMLTagHandler *baseHandler)
+      : mBaseHandler(baseHandler), mRootHandled(false), mPending(false)
+   {
+   }
+
+   bool RootHandled() const { return mRootHandled; }
+   bool Balanced() const { return mHandlers.empty() && !mPending; }
+
+   virtual void StartTag(const wxString &name)
+   {
+      FlushStartTag();
+      mPending = true;
+      mTag = name;
+      mAttrs.clear();
+   }
+
+   virtual void EndTag(const wxString &name)
+   {
+      FlushStartTag();
+      if (mHandlers.empty())
+         return;
+      XMLTagHandler *handler = mHandlers.back();
+      if (handler)
+         handler->HandleXMLEndTag(name.c_str());
+      mHandlers.pop_back();
+   }
+
+   virtual void WriteAttr(const wxString &name, const wxString &value)
+   {
+      mAttrs.push_back(name);
+      mAttrs.push_back(value);
+   }
+
+   virtual void WriteAttr(const wxString &name, const wxChar *value)
+   {
+      WriteAttr(name, wxString(value));
+   }
+
+   virtual void WriteAttr(const wxString &name, int value)
+   {
+      WriteAttr(name, FormatInteger(value));
+   }
+
+   virtual void WriteAttr(const wxString &name, bool value)
+   {
+      WriteAttr(name, FormatInteger(value ? 1 : 0));
+   }
+
+   virtual void WriteAttr(const wxString &name, long value)
+   {
+      WriteAttr(name, FormatInteger(value));
+   }
+
+   virtual void WriteAttr(const wxString &name, long long value)
+   {
+      WriteAttr(name, FormatInteger(value));
+   }
+
+   virtual void WriteAttr(const wxString &name, size_t value)
+   {
+      WriteAttr(name, FormatInteger((long long)value));
+   }
+
+   virtual void WriteAttr(const wxString &name, float value, int digits)
+   {
+      WriteAttr(name, Internat::ToString(value, digits));
+   }
+
+   virtual void WriteAttr(const wxString &name, double value, int digits)
+   {
+      WriteAttr(name, Internat::ToString(value, digits));
+   }
+
+   virtual void WriteData(const wxString &value)
+   {
+      FlushStartTag();
+      if (!mHandlers.empty() && mHandlers.back())
+         mHandlers.back()->HandleXMLContent(value);
+   }
+
+   virtual void WriteSubTree(const wxString &value)
+   {
+      WriteData(value);
+   }
+
+   virtual void Write(const wxString &data)
+   {
+      // Within an element, raw text is content as expat would see it;
+      // the declaration and the like, outside, are of no interest
+      if (!mHandlers.empty() || mPending)
+         WriteData(data);
+   }
+
+private:
+   void FlushStartTag()
+   {
+      if (!mPending)
+         return;
+      mPending = false;
+
+      XMLTagHandler *handler;
+      if (mHandlers.empty())
+         handler = mRootHandled ? NULL : mBaseHandler;
+      else if (mHandlers.back())
+         handler = mHandlers.back()->HandleXMLChild(mTag.c_str());
+      else
+         handler = NULL;
+
+      if (handler) {
+         std::vector<const wxChar *> attrs;
+         attrs.reserve(mAttrs.size() + 1);
+         for (size_t i = 0; i < mAttrs.size(); i++)
+            attrs.push_back(mAttrs[i].c_str());
+         attrs.push_back(NULL);
+
+         if (!handler->HandleXMLTag(mTag.c_str(), &attrs[0]))
+            handler = NULL;
+         else if (mHandlers.empty())
+            mRootHandled = true;
+      }
+
+      mHandlers.push_back(handler);
+   }
+
+   XMLTagHandler *mBaseHandler;
+   bool mRootHandled;
+
+   std::vector<XMLTagHandler *> mHandlers;
+
+   bool mPending;
+   wxString mTag;
+   std::vector<wxString> mAttrs;   // names and values, alternating
+};
+
+}
+
+///
+/// XMLBinaryFileReader class
+///
+XMLBinaryFileReader::XMLBinaryFileReader()
+{
+   mBase = NULL;
+   mLength = 0;
+#if defined(__WXMSW__)
+   mMapping = NULL;
+#else
+   mMapped = false;
+#endif
+}
+
+XMLBinaryFileReader::~XMLBinaryFileReader()
+{
+   Close();
+}
+
+wxString XMLBinaryFileReader::GetErrorStr()
+{
+   return mErrorStr;
+}
+
+bool XMLBinaryFileReader::Open(const wxString &fname)
+{
+   Close();
+
+   // Map the file if possible; the system then reads it as it is parsed
+#if defined(__WXMSW__)
+   HANDLE file = ::CreateFileW(fname.wc_str(), GENERIC_READ, FILE_SHARE_READ,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file != INVALID_HANDLE_VALUE) {
+      LARGE_INTEGER size;
+      if (::GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+          (wxUint64)size.QuadPart <= (wxUint64)(size_t)-1) {
+         HANDLE mapping = ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+         if (mapping) {
+            void *base = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (base) {
+               mMapping = mapping;
+               mBase = (const char *)base;
+               mLength = (size_t)size.QuadPart;
+            }
+            else
+               ::CloseHandle(mapping);
+         }
+      }
+      ::CloseHandle(file);
+   }
+#else
+   int fd = open(OSFILENAME(fname), O_RDONLY);
+   if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+         void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+         if (base != MAP_FAILED) {
+            madvise(base, st.st_size, MADV_SEQUENTIAL);
+            mMapped = true;
+            mBase = (const char *)base;
+            mLength = st.st_size;
+         }
+      }
+      close(fd);
+   }
+#endif
+
+   if (!mBase) {
+      wxFFile file(fname, wxT("rb"));
+      if (!file.IsOpened()) {
+         mErrorStr.Printf(_("Could not open file: \"%s\""), fname.c_str());
+         return false;
+      }
+      mCopy.resize((size_t)file.Length());
+      if (mCopy.empty() || file.Read(&mCopy[0], mCopy.size()) != mCopy.size()) {
+         mErrorStr.Printf(_("Could not read file: \"%s\""), fname.c_str());
+         mCopy.clear();
+         return false;
+      }
+      mBase = &mCopy[0];
+      mLength = mCopy.size();
+   }
+
+   return true;
+}
+
+void XMLBinaryFileReader::Close()
+{
+#if defined(__WXMSW__)
+   if (mMapping) {
+      ::UnmapViewOfFile(mBase);
+      ::CloseHandle(mMapping);
+      mMapping = NULL;
+   }
+#else
+   if (mMapped) {
+      munmap((void *)mBase, mLength);
+      mMapped = false;
+   }
+#endif
+   mCopy.clear();
+   mBase = NULL;
+   mLength = 0;
+}
+
+bool XMLBinaryFileReader::Decode(const wxString &fname, XMLWriter &out)
+{
+   if (!Open(fname))
+      return false;
+
+   const size_t identLen = strlen(XMLBinaryIdent);
+   if (mLength < identLen + 1 || strncmp(mBase, XMLBinaryIdent, identLen) != 0) {
+      mErrorStr.Printf(_("File may be invalid or corrupted: \n%s"), fname.c_str());
+      Close();
+      return false;
+   }
+   if ((unsigned char)mBase[identLen] > XMLBinaryVersion) {
+      mErrorStr.Printf(_("\"%s\" was saved by a newer version of Audacity."),
+                       fname.c_str());
+      Close();
+      return false;
+   }
+
+   FieldCursor in(mBase + identLen + 1, mBase + mLength);
+   std::vector<wxString> names;
+   bool good = true;
+
+   while (good && !in.AtEnd()) {
+      const int type = in.GetByte();
+      int id = -1;
+      if (type != FT_Data && type != FT_Raw && type != FT_SubTree) {
+         id = in.GetId();
+         if (type != FT_Name && (id < 0 || id >= (int)names.size())) {
+            good = false;
+            break;
+         }
+      }
+
+      switch (type)
+      {
+         case FT_Name:
+         {
+            if (id < 0 || id > (int)names.size()) {
+               good = false;
+               break;
+            }
+            wxString name = in.GetString();
+            if (id == (int)names.size())
+               names.push_back(name);
+            else
+               names[id] = name;
+         }
+         break;
+
+         case FT_StartTag:
+            out.StartTag(names[id]);
+         break;
+
+         case FT_EndTag:
+            out.EndTag(names[id]);
+         break;
+
+         case FT_String:
+            out.WriteAttr(names[id], in.GetString());
+         break;
+
+         case FT_Int:
+            out.WriteAttr(names[id], (int)in.GetInt());
+         break;
+
+         case FT_Bool:
+            out.WriteAttr(names[id], in.GetByte() != 0);
+         break;
+
+         case FT_Long:
+            out.WriteAttr(names[id], (long)(long long)in.GetLongLong());
+         break;
+
+         case FT_LongLong:
+            out.WriteAttr(names[id], (long long)in.GetLongLong());
+         break;
+
+         case FT_SizeT:
+            out.WriteAttr(names[id], (size_t)in.GetLongLong());
+         break;
+
+         case FT_Float:
+         {
+            float value = in.GetFloat();
+            out.WriteAttr(names[id], value, (int)in.GetInt());
+         }
+         break;
+
+         case FT_Double:
+         {
+            double value = in.GetDouble();
+            out.WriteAttr(names[id], value, (int)in.GetInt());
+         }
+         break;
+
+         case FT_Data:
+            out.WriteData(in.GetString());
+         break;
+
+         case FT_Raw:
+            out.Write(in.GetString());
+         break;
+
+         case FT_SubTree:
+            out.WriteSubTree(in.GetString());
+         break;
+
+         default:
+            good = false;
+         break;
+      }
+
+      good = good && in.OK();
+   }
+
+   Close();
+
+   if (!good) {
+      mErrorStr.Printf(_("File may be invalid or corrupted: \n%s"), fname.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+bool XMLBinaryFileReader::Parse(XMLTagHandler *baseHandler,
+                                const wxString &fname)
+{
+   TagHandlerWriter writer(baseHandler);
+
+   if (!Decode(fname, writer))
+      return false;
+
+   if (!writer.Balanced()) {
+      mErrorStr.Printf(_("File may be invalid or corrupted: \n%s"), fname.c_str());
+      return false;
+   }
+
+   // As with XMLFileReader, succeed only if the first-level handler
+   // was called and didn't return false
+   if (!writer.RootHandled()) {
+      mErrorStr.Printf(_("Could not load file: \"%s\""), fname.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+// static
+bool XMLBinaryFileReader::ConvertToXML(const wxString &binaryName,
+                                       const wxString &xmlName,
+                                       wxString &error)
+{
+   XMLFileWriter out;
+   try
+   {
+      out.Open(xmlName, wxT("wb"));
+
+      XMLBinaryFileReader reader;
+      if (!reader.Decode(binaryName, out)) {
+         error = reader.GetErrorStr();
+         out.CloseWithoutEndingTags();
+         wxRemoveFile(xmlName);
+         return false;
+      }
+
+      out.Close();
+   }
+   catch (XMLFileWriterException* pException)
+   {
+      error = pException->GetMessage();
+      delete pException;
+      wxRemoveFile(xmlName);
+      return false;
+   }
+
+   return true;
+}
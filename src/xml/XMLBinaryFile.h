@@ -0,0 +1,130 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  XMLBinaryFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_XML_BINARY_FILE__
+#define __AUDACITY_XML_BINARY_FILE__
+
+#include "../Audacity.h"
+
+#include <map>
+#include <vector>
+
+#include <wx/ffile.h>
+#include <wx/string.h>
+
+#include "XMLTagHandler.h"
+#include "XMLWriter.h"
+
+// Should be plain ASCII, and start as XML does, so that a project in
+// either format is known as one by its first bytes
+#define XMLBinaryIdent "<?xml binary>"
+
+// Stored after the ident; raised when older readers could not follow
+#define XMLBinaryVersion 1
+
+///
+/// XMLBinaryFileWriter
+///
+class AUDACITY_DLL_API XMLBinaryFileWriter : public wxFFile, public XMLWriter {
+
+ public:
+
+   XMLBinaryFileWriter();
+   virtual ~XMLBinaryFileWriter();
+
+   /// Open the file and write the header. Might throw XMLFileWriterException.
+   void Open(const wxString &name);
+
+   /// End any tags left open and close the file.
+   /// Might throw XMLFileWriterException.
+   void Close();
+
+   virtual void StartTag(const wxString &name);
+   virtual void EndTag(const wxString &name);
+
+   virtual void WriteAttr(const wxString &name, const wxString &value);
+   virtual void WriteAttr(const wxString &name, const wxChar *value);
+
+   virtual void WriteAttr(const wxString &name, int value);
+   virtual void WriteAttr(const wxString &name, bool value);
+   virtual void WriteAttr(const wxString &name, long value);
+   virtual void WriteAttr(const wxString &name, long long value);
+   virtual void WriteAttr(const wxString &name, size_t value);
+   virtual void WriteAttr(const wxString &name, float value, int digits = -1);
+   virtual void WriteAttr(const wxString &name, double value, int digits = -1);
+
+   virtual void WriteData(const wxString &value);
+
+   virtual void WriteSubTree(const wxString &value);
+
+   /// Text outside the tree, such as the XML declaration; kept only
+   /// for conversion back to XML
+   virtual void Write(const wxString &data);
+
+   /// Writes the XML file xmlName out in this format, with every
+   /// attribute as a string
+   static bool ConvertFromXML(const wxString &xmlName,
+                              const wxString &binaryName,
+                              wxString &error);
+
+ private:
+
+   void PutByte(int value);
+   void PutInt(wxUint32 value);
+   void PutLongLong(wxUint64 value);
+   void PutString(const wxString &value);
+   void PutName(const wxString &name);
+   void Flush();
+
+   std::map<wxString, int> mNames;
+   std::vector<char> mBuffer;
+};
+
+///
+/// XMLBinaryFileReader
+///
+class AUDACITY_DLL_API XMLBinaryFileReader {
+
+ public:
+
+   XMLBinaryFileReader();
+   ~XMLBinaryFileReader();
+
+   /// Passes the file through an XMLTagHandler as XMLFileReader does.
+   /// Numbers reach it formatted as XMLWriter would have written them.
+   bool Parse(XMLTagHandler *baseHandler, const wxString &fname);
+
+   /// Replays the file into out, call for call as it was written
+   bool Decode(const wxString &fname, XMLWriter &out);
+
+   wxString GetErrorStr();
+
+   /// Writes the file binaryName out again as XML text
+   static bool ConvertToXML(const wxString &binaryName,
+                            const wxString &xmlName,
+                            wxString &error);
+
+ private:
+
+   bool Open(const wxString &fname);
+   void Close();
+
+   // The whole file, mapped or read in
+   const char *mBase;
+   size_t mLength;
+   std::vector<char> mCopy;
+#if defined(__WXMSW__)
+   void *mMapping;
+#else
+   bool mMapped;
+#endif
+
+   wxString mErrorStr;
+};
+
+#endif